@@ -0,0 +1,414 @@
+//
+//  bench.c
+//
+//  Benchmark harness: runs the cases of a suite (benchHpos.c,
+//  benchJdots.c), writes the results as JSON, compares them with a
+//  baseline (see bench.h)
+//
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "io.h"
+#include "bufOut.h"
+#include "bench.h"
+
+#define     MAX_OPTIONS     20  // Max # command line options
+
+// Flags indices
+#define     FL_HELP         0   // Print usage
+#define     FL_E2E          1   // Also run end-to-end cases
+#define     FL_QUICK        2   // Smaller end-to-end data
+
+#define     BASE_MAX        ( 1024 * 1024 ) // Max baseline file [bytes]
+#define     NAME_LEN        64              // Max case name [chars]
+
+#ifdef _WIN32
+#define     CMD_FMT     TEXT( "\"\"%s\" %s > NUL 2>&1\"" )
+#else
+#define     CMD_FMT     TEXT( "\"%s\" %s > /dev/null 2>&1" )
+#endif
+
+extern DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... );
+extern LPCWSTR OptionValue( int argc, LPCWSTR argv[], int iFirst,
+    LPCWSTR key );
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+// Result of a case
+typedef struct benchResult
+{
+    const char* name;
+    int passes;
+    BenchPass work;             // Work of one pass
+    LONGLONG bestNs;            // Fastest pass [ns]
+    LONGLONG meanNs;            // Mean of all passes [ns]
+    double nsPerOp;             // Of the fastest pass
+    double mbPerSec;            // Of the fastest pass (0: no input)
+} BenchResult;
+
+// Case of a baseline
+typedef struct baseCase
+{
+    char name[ NAME_LEN ];
+    double nsPerOp;
+} BaseCase;
+
+BOOL runCase( const BenchCase* pCase, const BenchCfg* pCfg,
+    BenchResult* pRes );
+BOOL writeJson( LPCTSTR fName, const BenchResult* results, int ct,
+    BOOL quick );
+int loadBase( LPCTSTR fName, BaseCase** pCases );
+int compareBase( const BenchResult* results, int ct,
+    const BaseCase* base, int ctBase, double tol );
+
+
+int wmain( int argc, LPTSTR argv[] )
+{
+    int setInd = 0;
+    BOOL flags[ MAX_OPTIONS ] = { 0 };
+    BenchCfg cfg = { 0 };
+    BenchResult* results = NULL;
+    BaseCase* base = NULL;
+    LPCWSTR outFile, baseFile, tolStr, only;
+    TCHAR defOut[ MAX_PATH ] = { 0 };
+    TCHAR name[ NAME_LEN ] = { 0 };
+    double tol = BENCH_TOL_DEF;
+    int ctCases, ct = 0, ctBase, ctSlower = 0, i;
+
+    // Get index of first setting after options
+    // Also determine which options are active
+    setInd = Options( argc, ( LPCWSTR* )argv, TEXT( "heq" ),
+        &flags[ FL_HELP ], &flags[ FL_E2E ], &flags[ FL_QUICK ], NULL );
+
+    cfg.quick = flags[ FL_QUICK ];
+    cfg.tool = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "tool" ) );
+    cfg.workDir = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "dir" ) );
+    outFile = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "out" ) );
+    baseFile = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "base" ) );
+    tolStr = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "tol" ) );
+    only = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "only" ) );
+
+    if ( tolStr != NULL )
+        tol = wcstod( tolStr, NULL );
+
+    if ( cfg.workDir == NULL )
+        cfg.workDir = TEXT( "bench.data" );
+
+    // Validate args
+    if ( flags[ FL_HELP ] || tol <= 0 ||
+        ( flags[ FL_E2E ] && cfg.tool == NULL ) )
+    {
+        // Print usage
+        wprintf_s( TEXT( "\n    Usage:  %Sbench [options] [key=value ...]\n\n" ),
+            benchSuite );
+        wprintf_s( TEXT( "    Options:\n\n" ) );
+        wprintf_s( TEXT( "      -h   :  Print usage\n" ) );
+        wprintf_s( TEXT( "      -e   :  Also run end-to-end cases (needs tool=)\n" ) );
+        wprintf_s( TEXT( "      -q   :  Quick: smaller data for end-to-end cases\n\n" ) );
+        wprintf_s( TEXT( "    Settings:\n\n" ) );
+        wprintf_s( TEXT( "      out=file      JSON results (%Sbench.json)\n" ), benchSuite );
+        wprintf_s( TEXT( "      base=file     Compare with earlier JSON results\n" ) );
+        wprintf_s( TEXT( "      tol=%.0f         Slower by more is a regression [%%]\n" ),
+            BENCH_TOL_DEF );
+        wprintf_s( TEXT( "      tool=path     %S executable of end-to-end cases\n" ),
+            benchSuite );
+        wprintf_s( TEXT( "      dir=path      Generated data (bench.data, reused)\n" ) );
+        wprintf_s( TEXT( "      only=text     Cases whose name contains text\n\n" ) );
+        wprintf_s( TEXT( "    Exits with 2 if a case is slower than the baseline\n" ) );
+        return 1;
+    }
+
+    if ( outFile == NULL )
+    {
+        swprintf_s( defOut, _countof( defOut ), TEXT( "%Sbench.json" ),
+            benchSuite );
+        outFile = defOut;
+    }
+
+    for ( ctCases = 0; benchCases[ ctCases ].name != NULL; ctCases++ )
+        ;
+
+    if ( ( results = ( BenchResult* )calloc( ctCases,
+        sizeof( BenchResult ) ) ) == NULL )
+    {
+        wprintf_s( TEXT( "\nNo memory available!\n" ) );
+        return 1;
+    }
+
+    wprintf_s( TEXT( "\n    %-28s %8s %14s %10s\n" ), TEXT( "Case" ),
+        TEXT( "Passes" ), TEXT( "ns/op" ), TEXT( "MB/s" ) );
+    wprintf_s( TEXT( "    ---------------------------- -------- -------------- ----------\n" ) );
+
+    for ( i = 0; i < ctCases; i++ )
+    {
+        if ( benchCases[ i ].endToEnd && !flags[ FL_E2E ] )
+            continue;
+
+        swprintf_s( name, _countof( name ), TEXT( "%S" ),
+            benchCases[ i ].name );
+        if ( only != NULL && wcsstr( name, only ) == NULL )
+            continue;
+
+        if ( !runCase( &benchCases[ i ], &cfg, &results[ ct ] ) )
+        {
+            wprintf_s( TEXT( "    %-28s failed\n" ), name );
+            continue;
+        }
+
+        wprintf_s( TEXT( "    %-28s %8d %14.3f %10.1f\n" ), name,
+            results[ ct ].passes, results[ ct ].nsPerOp,
+            results[ ct ].mbPerSec );
+        ct++;
+    }
+
+    // Comparison with a baseline (may be the results file)
+    if ( baseFile != NULL )
+    {
+        if ( ( ctBase = loadBase( baseFile, &base ) ) < 0 )
+        {
+            ReportError( TEXT( "\nReading baseline failed" ), 0, TRUE );
+            free( results );
+            return 1;
+        }
+
+        wprintf_s( TEXT( "\n    Baseline: \"%s\"\n" ), baseFile );
+        ctSlower = compareBase( results, ct, base, ctBase, tol );
+        free( base );
+    }
+
+    if ( !writeJson( outFile, results, ct, cfg.quick ) )
+    {
+        free( results );
+        return 1;
+    }
+
+    wprintf_s( TEXT( "\n    Results: \"%s\"\n" ), outFile );
+
+    free( results );
+
+    return ( ctSlower > 0 ) ? 2 : 0;
+}
+
+LONGLONG BenchNow( void )
+{
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER count;
+
+    if ( freq.QuadPart == 0 )
+        QueryPerformanceFrequency( &freq );
+
+    QueryPerformanceCounter( &count );
+
+    // No overflow of count * 10 ^ 9
+    return ( count.QuadPart / freq.QuadPart ) * 1000000000 +
+        ( count.QuadPart % freq.QuadPart ) * 1000000000 / freq.QuadPart;
+}
+
+BOOL BenchRunTool( LPCTSTR tool, LPCTSTR args )
+{
+    TCHAR cmd[ 4 * MAX_PATH ] = { 0 };
+
+    if ( swprintf_s( cmd, _countof( cmd ), CMD_FMT, tool, args ) < 0 )
+        return FALSE;
+
+    return _wsystem( cmd ) == 0;
+}
+
+// Set up, time the passes, tear down
+BOOL runCase( const BenchCase* pCase, const BenchCfg* pCfg,
+    BenchResult* pRes )
+{
+    void* state;
+    LONGLONG start, elapsed, total = 0;
+    BOOL ok = TRUE;
+
+    memset( pRes, 0, sizeof( BenchResult ) );
+    pRes->name = pCase->name;
+
+    if ( ( state = ( *pCase->pSetup )( pCfg ) ) == NULL )
+        return FALSE;
+
+    while ( pRes->passes < ( pCase->endToEnd ? BENCH_E2E_PASSES :
+        BENCH_MAX_PASSES ) )
+    {
+        if ( !pCase->endToEnd && pRes->passes >= BENCH_MIN_PASSES &&
+            total >= BENCH_MIN_MS * 1000000LL )
+            break;
+
+        if ( pCase->pReset != NULL )
+            ( *pCase->pReset )( state );
+
+        start = BenchNow();
+        ok = ( *pCase->pRun )( state, &pRes->work );
+        elapsed = BenchNow() - start;
+
+        if ( !ok )
+            break;
+
+        if ( pRes->passes == 0 || elapsed < pRes->bestNs )
+            pRes->bestNs = elapsed;
+
+        total += elapsed;
+        pRes->passes++;
+    }
+
+    ( *pCase->pTeardown )( state );
+
+    if ( !ok || pRes->passes == 0 )
+        return FALSE;
+
+    pRes->meanNs = total / pRes->passes;
+
+    if ( pRes->work.ops > 0 )
+        pRes->nsPerOp = ( double )pRes->bestNs / ( double )pRes->work.ops;
+
+    if ( pRes->work.bytes > 0 && pRes->bestNs > 0 )
+        pRes->mbPerSec = ( double )pRes->work.bytes * 1000.0 /
+            ( double )pRes->bestNs;
+
+    return TRUE;
+}
+
+// One case per line (read back by loadBase)
+BOOL writeJson( LPCTSTR fName, const BenchResult* results, int ct,
+    BOOL quick )
+{
+    BufOut out;
+    int i;
+
+    if ( !OpenBufOut( &out, fName ) )
+        return FALSE;
+
+    BufOutPrintf( &out, "{\n  \"suite\": \"%s\",\n  \"quick\": %s,\n"
+        "  \"cases\": [\n", benchSuite, quick ? "true" : "false" );
+
+    for ( i = 0; i < ct; i++ )
+        BufOutPrintf( &out, "    { \"name\": \"%s\", \"passes\": %d, "
+            "\"ops\": %llu, \"bytes\": %llu, \"best_ns\": %lld, "
+            "\"mean_ns\": %lld, \"ns_per_op\": %.3f, \"mb_per_s\": %.1f }%s\n",
+            results[ i ].name, results[ i ].passes, results[ i ].work.ops,
+            results[ i ].work.bytes, results[ i ].bestNs, results[ i ].meanNs,
+            results[ i ].nsPerOp, results[ i ].mbPerSec,
+            ( i + 1 < ct ) ? "," : "" );
+
+    BufOutText( &out, "  ]\n}\n" );
+
+    return CloseBufOut( &out );
+}
+
+// Name and ns_per_op of each case of a JSON results file
+// Returns the number of cases, -1 on error
+int loadBase( LPCTSTR fName, BaseCase** pCases )
+{
+    IoFile hIn;
+    UINT64 fileSize = 0;
+    DWORD bytesRead = 0;
+    char* text = NULL;
+    char* pCh;
+    char* pEnd;
+    BaseCase* cases = NULL;
+    int ct = 0, size = 0;
+    size_t len;
+
+    *pCases = NULL;
+
+    if ( ( hIn = IoOpenFile( fName ) ) == IO_NO_FILE )
+        return -1;
+
+    if ( !IoFileSize( hIn, &fileSize ) || fileSize > BASE_MAX ||
+        ( text = ( char* )malloc( ( size_t )fileSize + 1 ) ) == NULL ||
+        !IoRead( hIn, text, ( DWORD )fileSize, &bytesRead ) )
+    {
+        free( text );
+        IoCloseFile( hIn );
+        return -1;
+    }
+
+    IoCloseFile( hIn );
+    text[ bytesRead ] = '\0';
+
+    for ( pCh = strstr( text, "\"name\": \"" ); pCh != NULL;
+        pCh = strstr( pCh, "\"name\": \"" ) )
+    {
+        pCh += strlen( "\"name\": \"" );
+
+        if ( ( pEnd = strchr( pCh, '"' ) ) == NULL )
+            break;
+
+        if ( ct == size )
+        {
+            BaseCase* tmpCases = ( BaseCase* )realloc( cases,
+                ( size == 0 ? 16 : 2 * size ) * sizeof( BaseCase ) );
+
+            if ( tmpCases == NULL )
+                break;
+
+            cases = tmpCases;
+            size = ( size == 0 ) ? 16 : 2 * size;
+        }
+
+        len = ( size_t )( pEnd - pCh );
+        if ( len >= NAME_LEN )
+            len = NAME_LEN - 1;
+        memcpy( cases[ ct ].name, pCh, len );
+        cases[ ct ].name[ len ] = '\0';
+
+        pCh = pEnd;
+        if ( ( pEnd = strstr( pCh, "\"ns_per_op\": " ) ) == NULL )
+            break;
+
+        cases[ ct ].nsPerOp = strtod( pEnd + strlen( "\"ns_per_op\": " ),
+            NULL );
+        ct++;
+    }
+
+    free( text );
+    *pCases = cases;
+
+    return ct;
+}
+
+// Print the change per case
+// Returns the number of cases slower by more than tol [%]
+int compareBase( const BenchResult* results, int ct,
+    const BaseCase* base, int ctBase, double tol )
+{
+    TCHAR name[ NAME_LEN ] = { 0 };
+    double change;
+    int ctSlower = 0, i, j;
+
+    wprintf_s( TEXT( "\n    %-28s %14s %14s %9s\n" ), TEXT( "Case" ),
+        TEXT( "Base ns/op" ), TEXT( "Now ns/op" ), TEXT( "Change" ) );
+    wprintf_s( TEXT( "    ---------------------------- -------------- -------------- ---------\n" ) );
+
+    for ( i = 0; i < ct; i++ )
+    {
+        swprintf_s( name, _countof( name ), TEXT( "%S" ), results[ i ].name );
+
+        for ( j = 0; j < ctBase; j++ )
+            if ( strcmp( base[ j ].name, results[ i ].name ) == 0 )
+                break;
+
+        if ( j == ctBase || base[ j ].nsPerOp <= 0 )
+        {
+            wprintf_s( TEXT( "    %-28s %14s %14.3f\n" ), name, TEXT( "-" ),
+                results[ i ].nsPerOp );
+            continue;
+        }
+
+        change = ( results[ i ].nsPerOp - base[ j ].nsPerOp ) * 100.0 /
+            base[ j ].nsPerOp;
+
+        wprintf_s( TEXT( "    %-28s %14.3f %14.3f %+7.1f %%%s\n" ), name,
+            base[ j ].nsPerOp, results[ i ].nsPerOp, change,
+            ( change > tol ) ? TEXT( "  slower" ) :
+            ( change < -tol ) ? TEXT( "  faster" ) : TEXT( "" ) );
+
+        if ( change > tol )
+            ctSlower++;
+    }
+
+    return ctSlower;
+}
@@ -0,0 +1,62 @@
+//
+// bench.h -- benchmark harness
+//
+// A suite (hposbench, jdotsbench) is a table of cases. The harness
+// sets a case up once, runs timed passes until BENCH_MIN_MS have
+// passed (end-to-end cases: BENCH_E2E_PASSES), keeps the fastest and
+// writes all results as JSON. Given a baseline (results of an earlier
+// run), it prints the change per case and flags regressions.
+//
+// Benchmarks - Interface declarations
+//
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "platform.h"
+
+#define     BENCH_MIN_MS        1000    // Min time of a micro case [ms]
+#define     BENCH_MIN_PASSES    3       // Min passes of a micro case
+#define     BENCH_MAX_PASSES    100000
+#define     BENCH_E2E_PASSES    3       // Passes of an end-to-end case
+#define     BENCH_TOL_DEF       5.0     // Default regression limit [%]
+
+typedef struct benchCfg
+{
+    BOOL quick;                 // Smaller data (end-to-end cases)
+    LPCTSTR tool;               // Tool run by end-to-end cases
+    LPCTSTR workDir;            // Generated data of end-to-end cases
+} BenchCfg;
+
+typedef struct benchPass
+{
+    UINT64 ops;                 // Units of work done by one pass
+    UINT64 bytes;               // Input bytes of one pass (0: none)
+} BenchPass;
+
+typedef struct benchCase
+{
+    const char* name;           // NULL ends the table
+    BOOL endToEnd;              // Only run with -e
+    void* ( *pSetup )( const BenchCfg* pCfg );  // NULL on error
+    void ( *pReset )( void* state );    // Before each pass, not timed
+    BOOL ( *pRun )( void* state, BenchPass* pPass );
+    void ( *pTeardown )( void* state );
+} BenchCase;
+
+// Defined by each suite
+extern const char* const benchSuite;
+extern const BenchCase benchCases[];
+
+/* function prototypes */
+
+/* operation:      time in [ns] from a fixed point     */
+LONGLONG BenchNow( void );
+
+/* operation:      run a tool of an end-to-end case    */
+/* preconditions:  args are quoted as needed           */
+/* postconditions: the tool's output is discarded,     */
+/*                 returns true if it exited with 0    */
+BOOL BenchRunTool( LPCTSTR tool, LPCTSTR args );
+
+#endif
@@ -0,0 +1,445 @@
+//
+//  benchHpos.c
+//
+//  hpos suite: nmea parsing, coord decoding, value trees, CSV
+//  formatting; end-to-end: hpos on a 1 GB file
+//
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "io.h"
+#include "bufOut.h"
+#include "fmtNum.h"
+#include "hposEng.h"
+#include "nmeaGen.h"
+#include "tree.h"
+#include "bench.h"
+
+#define     PARSE_BYTES     ( 8 * 1024 * 1024 ) // Parsed text [bytes]
+#define     LINEIN          128                 // As hpos reads lines
+#define     CT_COORDS       65536               // Decoded coords
+#define     CT_TREE_KEYS    10000               // Keys inserted
+#define     TREE_KEY_RANGE  1000000             // Random keys [ms]
+#define     CT_CSV_ROWS     4096                // Formatted rows
+#define     CSV_LINE        256
+
+#define     E2E_BYTES       ( 1024ULL * 1024 * 1024 )   // hpos input
+#define     E2E_BYTES_QUICK ( 64ULL * 1024 * 1024 )
+
+// Generated nmea text
+typedef struct textState
+{
+    char* text;
+    size_t ctText;
+    UINT64 ctEpochs;
+    UINT64 ctLines;
+    HposResult result;          // Kept, so parsing is not optimized out
+} TextState;
+
+// Coord fields
+typedef struct coordState
+{
+    char lat[ CT_COORDS ][ 12 ];
+    char lon[ CT_COORDS ][ 12 ];
+    char alt[ CT_COORDS ][ 12 ];
+    long long sum;
+} CoordState;
+
+// Keys of a value tree
+typedef struct treeState
+{
+    int keys[ CT_TREE_KEYS ];
+    Tree tree;
+} TreeState;
+
+// Rows of a CSV file
+typedef struct csvState
+{
+    Item items[ CT_CSV_ROWS ];
+    BufOut out;
+    UINT64 ctBytes;
+} CsvState;
+
+// Generated file of hpos
+typedef struct e2eState
+{
+    LPCTSTR tool;
+    TCHAR args[ 2 * MAX_PATH ];
+    UINT64 size;
+} E2eState;
+
+void* setupText( const BenchCfg* pCfg );
+BOOL runParse( void* state, BenchPass* pPass );
+BOOL runTokenize( void* state, BenchPass* pPass );
+void* setupCoords( const BenchCfg* pCfg );
+BOOL runCoords( void* state, BenchPass* pPass );
+void* setupTreeRandom( const BenchCfg* pCfg );
+void* setupTreeMonotonic( const BenchCfg* pCfg );
+void resetTree( void* state );
+BOOL runTree( void* state, BenchPass* pPass );
+void freeTree( void* state );
+void* setupCsv( const BenchCfg* pCfg );
+BOOL runCsv( void* state, BenchPass* pPass );
+void freeCsv( void* state );
+int discardOut( void* ctx, const CHAR* data, DWORD len );
+void* setupHpos( const BenchCfg* pCfg );
+void* setupHposBasic( const BenchCfg* pCfg );
+void* setupHposFile( const BenchCfg* pCfg, LPCTSTR options );
+BOOL runHpos( void* state, BenchPass* pPass );
+void freeText( void* state );
+
+const char* const benchSuite = "hpos";
+
+const BenchCase benchCases[] =
+{
+    { "parse_buffer", FALSE, setupText, NULL, runParse, freeText },
+    { "tokenize_fields", FALSE, setupText, NULL, runTokenize, freeText },
+    { "decode_coords", FALSE, setupCoords, NULL, runCoords, free },
+    { "tree_insert_random", FALSE, setupTreeRandom, resetTree, runTree,
+        freeTree },
+    { "tree_insert_monotonic", FALSE, setupTreeMonotonic, resetTree, runTree,
+        freeTree },
+    { "csv_format", FALSE, setupCsv, NULL, runCsv, freeCsv },
+    { "hpos_1g", TRUE, setupHpos, NULL, runHpos, free },
+    { "hpos_1g_basic", TRUE, setupHposBasic, NULL, runHpos, free },
+    { NULL, FALSE, NULL, NULL, NULL, NULL }
+};
+
+
+// Default generator settings, a few corrupted and GN sentences
+void* setupText( const BenchCfg* pCfg )
+{
+    TextState* pState;
+    NmeaGenCfg cfg;
+    NmeaGen gen;
+    size_t i;
+
+    if ( ( pState = ( TextState* )calloc( 1, sizeof( TextState ) ) ) == NULL ||
+        ( pState->text = ( char* )malloc( PARSE_BYTES +
+            NMEAGEN_EPOCH_MAX ) ) == NULL )
+    {
+        free( pState );
+        return NULL;
+    }
+
+    NmeaGenDefaults( &cfg );
+    strcpy_s( cfg.talkers[ 1 ], _countof( cfg.talkers[ 1 ] ), "GN" );
+    cfg.ctTalkers = 2;
+    cfg.corrupt = 0.1;
+    NmeaGenInit( &gen, &cfg );
+
+    while ( pState->ctText < PARSE_BYTES )
+    {
+        pState->ctText += NmeaGenEpoch( &gen, pState->text + pState->ctText );
+        pState->ctEpochs++;
+    }
+
+    for ( i = 0; i < pState->ctText; i++ )
+        if ( pState->text[ i ] == '\n' )
+            pState->ctLines++;
+
+    return pState;
+}
+
+// Whole engine on text in memory
+BOOL runParse( void* state, BenchPass* pPass )
+{
+    TextState* pState = ( TextState* )state;
+
+    HposProcBuffer( pState->text, pState->ctText, NULL, &pState->result,
+        NULL, NULL );
+
+    pPass->ops = pState->ctEpochs;
+    pPass->bytes = pState->ctText;
+
+    return pState->result.ctMeas > 0;
+}
+
+// Fields of each line, as the engine splits them
+BOOL runTokenize( void* state, BenchPass* pPass )
+{
+    TextState* pState = ( TextState* )state;
+    const char* pCh = pState->text;
+    const char* pEnd = pState->text + pState->ctText;
+    char line[ LINEIN ];
+    char* pField;
+    char* pNext;
+    size_t len;
+    UINT64 ctFields = 0;
+
+    while ( pCh < pEnd )
+    {
+        for ( len = 0; pCh < pEnd && *pCh != '\n' && len < LINEIN - 1; )
+            line[ len++ ] = *pCh++;
+
+        line[ len ] = '\0';
+        pCh++;
+
+        for ( pField = strtok_s( line, ",*", &pNext ); pField != NULL;
+            pField = strtok_s( NULL, ",*", &pNext ) )
+            ctFields++;
+    }
+
+    pPass->ops = pState->ctLines;
+    pPass->bytes = pState->ctText;
+
+    return ctFields > 0;
+}
+
+// Coords around the default position
+void* setupCoords( const BenchCfg* pCfg )
+{
+    CoordState* pState;
+    UINT64 rng = 1;
+    int i;
+
+    if ( ( pState = ( CoordState* )calloc( 1, sizeof( CoordState ) ) ) == NULL )
+        return NULL;
+
+    for ( i = 0; i < CT_COORDS; i++ )
+    {
+        _snprintf_s( pState->lat[ i ], 12, _TRUNCATE, "4722.%04d",
+            ( int )( NmeaGenRand( &rng ) % 10000 ) );
+        _snprintf_s( pState->lon[ i ], 12, _TRUNCATE, "00832.%04d",
+            ( int )( NmeaGenRand( &rng ) % 10000 ) );
+        _snprintf_s( pState->alt[ i ], 12, _TRUNCATE, "%d.%d",
+            400 + ( int )( NmeaGenRand( &rng ) % 20 ),
+            ( int )( NmeaGenRand( &rng ) % 10 ) );
+    }
+
+    return pState;
+}
+
+// Lat, lon and alt of a fix per op
+BOOL runCoords( void* state, BenchPass* pPass )
+{
+    CoordState* pState = ( CoordState* )state;
+    long long sum = 0;
+    int i;
+
+    for ( i = 0; i < CT_COORDS; i++ )
+        sum += HposLatToInt( "N", pState->lat[ i ] ) +
+            HposLonToInt( "W", pState->lon[ i ] ) +
+            HposAltToInt( pState->alt[ i ] );
+
+    pState->sum = sum;
+    pPass->ops = CT_COORDS;
+    pPass->bytes = 0;
+
+    return sum != 0;
+}
+
+void* setupTreeRandom( const BenchCfg* pCfg )
+{
+    TreeState* pState;
+    UINT64 rng = 1;
+    int i;
+
+    if ( ( pState = ( TreeState* )calloc( 1, sizeof( TreeState ) ) ) == NULL )
+        return NULL;
+
+    for ( i = 0; i < CT_TREE_KEYS; i++ )
+        pState->keys[ i ] = ( int )( NmeaGenRand( &rng ) % TREE_KEY_RANGE );
+
+    InitializeTree( &pState->tree );
+
+    return pState;
+}
+
+// Sorted keys: the tree degenerates to a list
+void* setupTreeMonotonic( const BenchCfg* pCfg )
+{
+    TreeState* pState;
+    int i;
+
+    if ( ( pState = ( TreeState* )calloc( 1, sizeof( TreeState ) ) ) == NULL )
+        return NULL;
+
+    for ( i = 0; i < CT_TREE_KEYS; i++ )
+        pState->keys[ i ] = i;
+
+    InitializeTree( &pState->tree );
+
+    return pState;
+}
+
+void resetTree( void* state )
+{
+    DeleteAll( &( ( TreeState* )state )->tree );
+}
+
+// Keys added as hpos adds values
+BOOL runTree( void* state, BenchPass* pPass )
+{
+    TreeState* pState = ( TreeState* )state;
+    Item item = { 0 };
+    int i;
+
+    item.scale = HPOS_SCALE_DEG;
+    item.ct = 1;
+
+    for ( i = 0; i < CT_TREE_KEYS; i++ )
+    {
+        item.intVal = pState->keys[ i ];
+        item.dblVal = ( double )item.intVal / item.scale;
+
+        if ( !AddItem( &item, &pState->tree ) )
+            return FALSE;
+    }
+
+    pPass->ops = CT_TREE_KEYS;
+    pPass->bytes = 0;
+
+    return TRUE;
+}
+
+void freeTree( void* state )
+{
+    DeleteAll( &( ( TreeState* )state )->tree );
+    free( state );
+}
+
+// Values as in a lat tree
+void* setupCsv( const BenchCfg* pCfg )
+{
+    CsvState* pState;
+    UINT64 rng = 1;
+    int i;
+
+    if ( ( pState = ( CsvState* )calloc( 1, sizeof( CsvState ) ) ) == NULL )
+        return NULL;
+
+    if ( !AttachBufOutSink( &pState->out, discardOut, &pState->ctBytes ) )
+    {
+        free( pState );
+        return NULL;
+    }
+
+    for ( i = 0; i < CT_CSV_ROWS; i++ )
+    {
+        pState->items[ i ].intVal = 170556000 +
+            ( int )( NmeaGenRand( &rng ) % 200000 );
+        pState->items[ i ].scale = HPOS_SCALE_DEG;
+        pState->items[ i ].ct = 1 + ( int )( NmeaGenRand( &rng ) % 50 );
+        pState->items[ i ].wtVal = ( double )pState->items[ i ].intVal *
+            pState->items[ i ].ct / ( HPOS_SCALE_DEG * 1000.0 );
+        _snprintf_s( pState->items[ i ].nmeaVal, VALSTR, _TRUNCATE,
+            "4722.%04d", i % 10000 );
+    }
+
+    return pState;
+}
+
+// Rows formatted as printItemCSV() of hpos does
+BOOL runCsv( void* state, BenchPass* pPass )
+{
+    CsvState* pState = ( CsvState* )state;
+    const Item* pItem;
+    CHAR* bufOut;
+    int len, i;
+
+    for ( i = 0; i < CT_CSV_ROWS; i++ )
+    {
+        pItem = &pState->items[ i ];
+
+        if ( ( bufOut = BufOutReserve( &pState->out, CSV_LINE ) ) == NULL )
+            return FALSE;
+
+        len = FmtStr( bufOut, pItem->nmeaVal );
+        bufOut[ len++ ] = ',';
+        len += FmtInt( bufOut + len, pItem->intVal );
+        bufOut[ len++ ] = ',';
+        len += FmtScaled( bufOut + len, pItem->intVal, pItem->scale );
+        bufOut[ len++ ] = ',';
+        len += FmtInt( bufOut + len, pItem->ct );
+        bufOut[ len++ ] = ',';
+        len += FmtInt( bufOut + len, CT_CSV_ROWS );
+        bufOut[ len++ ] = ',';
+        len += FmtDouble( bufOut + len, pItem->wtVal );
+        bufOut[ len++ ] = '\n';
+
+        BufOutCommit( &pState->out, len );
+    }
+
+    pPass->ops = CT_CSV_ROWS;
+    pPass->bytes = 0;
+
+    return FlushBufOut( &pState->out );
+}
+
+void freeCsv( void* state )
+{
+    CloseBufOut( &( ( CsvState* )state )->out );
+    free( state );
+}
+
+int discardOut( void* ctx, const CHAR* data, DWORD len )
+{
+    *( UINT64* )ctx += len;
+
+    return TRUE;
+}
+
+void* setupHpos( const BenchCfg* pCfg )
+{
+    return setupHposFile( pCfg, TEXT( "" ) );
+}
+
+void* setupHposBasic( const BenchCfg* pCfg )
+{
+    return setupHposFile( pCfg, TEXT( "-b " ) );
+}
+
+// Generated once, reused while it has the size
+void* setupHposFile( const BenchCfg* pCfg, LPCTSTR options )
+{
+    E2eState* pState;
+    TCHAR fName[ MAX_PATH ] = { 0 };
+    IoEntry entry;
+    NmeaGenCfg cfg;
+
+    if ( ( pState = ( E2eState* )calloc( 1, sizeof( E2eState ) ) ) == NULL )
+        return NULL;
+
+    pState->tool = pCfg->tool;
+    pState->size = pCfg->quick ? E2E_BYTES_QUICK : E2E_BYTES;
+
+    swprintf_s( fName, _countof( fName ), TEXT( "%s%shpos%s.nmea" ),
+        pCfg->workDir, IO_SEP, pCfg->quick ? TEXT( "64m" ) : TEXT( "1g" ) );
+
+    if ( !IoStat( fName, &entry ) || entry.size < pState->size )
+    {
+        NmeaGenDefaults( &cfg );
+
+        if ( !IoCreateDir( pCfg->workDir ) ||
+            !NmeaGenFile( fName, &cfg, pState->size ) )
+        {
+            free( pState );
+            return NULL;
+        }
+    }
+
+    swprintf_s( pState->args, _countof( pState->args ), TEXT( "%s\"%s\"" ),
+        options, fName );
+
+    return pState;
+}
+
+BOOL runHpos( void* state, BenchPass* pPass )
+{
+    E2eState* pState = ( E2eState* )state;
+
+    pPass->ops = 1;
+    pPass->bytes = pState->size;
+
+    return BenchRunTool( pState->tool, pState->args );
+}
+
+void freeText( void* state )
+{
+    free( ( ( TextState* )state )->text );
+    free( state );
+}
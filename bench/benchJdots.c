@@ -0,0 +1,271 @@
+//
+//  benchJdots.c
+//
+//  jdots suite: sorting result lists; end-to-end: jdots on a dir of
+//  10k nmea files
+//
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include "io.h"
+#include "list.h"
+#include "nmeaGen.h"
+#include "bench.h"
+
+#define     CT_SORT_ITEMS   10000               // Items sorted
+
+#define     E2E_FILES       10000               // jdots input
+#define     E2E_FILES_QUICK 1000
+#define     E2E_FILE_BYTES  ( 8 * 1024 )        // Size of each file
+#define     CACHE_FILE      TEXT( "jdots.cache" )   // As jdots names it
+
+// Items in the order of a dir listing
+typedef struct sortState
+{
+    List list;
+    TCHAR ( *paths )[ MAX_PATH ];
+    UINT64* sizes;
+    size_t ( *keyFun )( const Item* pItem, LPCTSTR path, TCHAR* key );
+} SortState;
+
+// Generated dir of jdots
+typedef struct e2eState
+{
+    LPCTSTR tool;
+    TCHAR dir[ MAX_PATH ];
+    TCHAR args[ 2 * MAX_PATH ];
+    int ctFiles;
+    BOOL cold;                  // Cache deleted before each pass
+} E2eState;
+
+void* setupSortPath( const BenchCfg* pCfg );
+void* setupSortSize( const BenchCfg* pCfg );
+void* setupSort( size_t ( *keyFun )( const Item* pItem, LPCTSTR path,
+    TCHAR* key ) );
+void resetSort( void* state );
+BOOL runSort( void* state, BenchPass* pPass );
+void freeSort( void* state );
+size_t keyPath( const Item* pItem, LPCTSTR path, TCHAR* key );
+size_t keySize( const Item* pItem, LPCTSTR path, TCHAR* key );
+void* setupJdotsCold( const BenchCfg* pCfg );
+void* setupJdotsCached( const BenchCfg* pCfg );
+void* setupJdotsDir( const BenchCfg* pCfg, BOOL cold );
+void resetJdots( void* state );
+BOOL runJdots( void* state, BenchPass* pPass );
+
+const char* const benchSuite = "jdots";
+
+const BenchCase benchCases[] =
+{
+    { "sort_list_path", FALSE, setupSortPath, resetSort, runSort, freeSort },
+    { "sort_list_size", FALSE, setupSortSize, resetSort, runSort, freeSort },
+    { "jdots_10k_cold", TRUE, setupJdotsCold, resetJdots, runJdots, free },
+    { "jdots_10k_cached", TRUE, setupJdotsCached, resetJdots, runJdots,
+        free },
+    { NULL, FALSE, NULL, NULL, NULL, NULL }
+};
+
+
+void* setupSortPath( const BenchCfg* pCfg )
+{
+    return setupSort( keyPath );
+}
+
+void* setupSortSize( const BenchCfg* pCfg )
+{
+    return setupSort( keySize );
+}
+
+// Paths and sizes in random order
+void* setupSort( size_t ( *keyFun )( const Item* pItem, LPCTSTR path,
+    TCHAR* key ) )
+{
+    SortState* pState;
+    UINT64 rng = 1;
+    int i;
+
+    if ( ( pState = ( SortState* )calloc( 1, sizeof( SortState ) ) ) == NULL )
+        return NULL;
+
+    pState->paths = calloc( CT_SORT_ITEMS, sizeof( *pState->paths ) );
+    pState->sizes = ( UINT64* )calloc( CT_SORT_ITEMS, sizeof( UINT64 ) );
+    pState->keyFun = keyFun;
+
+    if ( pState->paths == NULL || pState->sizes == NULL )
+    {
+        freeSort( pState );
+        return NULL;
+    }
+
+    for ( i = 0; i < CT_SORT_ITEMS; i++ )
+    {
+        swprintf_s( pState->paths[ i ], MAX_PATH,
+            TEXT( "Measurements%sSite%d%sPoint%05d.nmea" ), IO_SEP,
+            ( int )( NmeaGenRand( &rng ) % 50 ), IO_SEP,
+            ( int )( NmeaGenRand( &rng ) % 100000 ) );
+        pState->sizes[ i ] = NmeaGenRand( &rng ) % ( 64 * 1024 * 1024 );
+    }
+
+    InitializeList( &pState->list );
+
+    return pState;
+}
+
+// Unsorted list again
+void resetSort( void* state )
+{
+    SortState* pState = ( SortState* )state;
+    Item item = { 0 };
+    int i;
+
+    EmptyTheList( &pState->list );
+    InitializeList( &pState->list );
+
+    for ( i = 0; i < CT_SORT_ITEMS; i++ )
+    {
+        item.size = pState->sizes[ i ];
+        AddItem( &item, pState->paths[ i ], &pState->list );
+    }
+}
+
+BOOL runSort( void* state, BenchPass* pPass )
+{
+    SortState* pState = ( SortState* )state;
+
+    pPass->ops = CT_SORT_ITEMS;
+    pPass->bytes = 0;
+
+    return ListItemCount( &pState->list ) == CT_SORT_ITEMS &&
+        SortList( &pState->list, pState->keyFun );
+}
+
+void freeSort( void* state )
+{
+    SortState* pState = ( SortState* )state;
+
+    EmptyTheList( &pState->list );
+    free( pState->paths );
+    free( pState->sizes );
+    free( pState );
+}
+
+// Lower case path, as jdots sorts by name
+size_t keyPath( const Item* pItem, LPCTSTR path, TCHAR* key )
+{
+    size_t len;
+
+    for ( len = 0; path[ len ] != TEXT( '\0' ); len++ )
+        key[ len ] = ( TCHAR )towlower( path[ len ] );
+
+    key[ len ] = TEXT( '\0' );
+
+    return len;
+}
+
+// Size as 20 digits
+size_t keySize( const Item* pItem, LPCTSTR path, TCHAR* key )
+{
+    UINT64 size = pItem->size;
+    int i;
+
+    for ( i = 19; i >= 0; i-- )
+    {
+        key[ i ] = ( TCHAR )( TEXT( '0' ) + size % 10 );
+        size /= 10;
+    }
+
+    key[ 20 ] = TEXT( '\0' );
+
+    return 20;
+}
+
+void* setupJdotsCold( const BenchCfg* pCfg )
+{
+    return setupJdotsDir( pCfg, TRUE );
+}
+
+void* setupJdotsCached( const BenchCfg* pCfg )
+{
+    return setupJdotsDir( pCfg, FALSE );
+}
+
+// Generated once, reused while its last file exists
+void* setupJdotsDir( const BenchCfg* pCfg, BOOL cold )
+{
+    E2eState* pState;
+    TCHAR fName[ MAX_PATH ] = { 0 };
+    IoEntry entry;
+    NmeaGenCfg cfg;
+    int i;
+
+    if ( ( pState = ( E2eState* )calloc( 1, sizeof( E2eState ) ) ) == NULL )
+        return NULL;
+
+    pState->tool = pCfg->tool;
+    pState->cold = cold;
+    pState->ctFiles = pCfg->quick ? E2E_FILES_QUICK : E2E_FILES;
+
+    swprintf_s( pState->dir, _countof( pState->dir ), TEXT( "%s%sjdots%s" ),
+        pCfg->workDir, IO_SEP, pCfg->quick ? TEXT( "1k" ) : TEXT( "10k" ) );
+    swprintf_s( fName, _countof( fName ), TEXT( "%s%sgen%05d.nmea" ),
+        pState->dir, IO_SEP, pState->ctFiles );
+
+    if ( !IoStat( fName, &entry ) )
+    {
+        NmeaGenDefaults( &cfg );
+
+        if ( !IoCreateDir( pCfg->workDir ) || !IoCreateDir( pState->dir ) )
+        {
+            free( pState );
+            return NULL;
+        }
+
+        // Same files as 'nmeagen -d' writes
+        for ( i = 0; i < pState->ctFiles; i++ )
+        {
+            swprintf_s( fName, _countof( fName ), TEXT( "%s%sgen%05d.nmea" ),
+                pState->dir, IO_SEP, i + 1 );
+
+            if ( !NmeaGenFile( fName, &cfg, E2E_FILE_BYTES ) )
+            {
+                free( pState );
+                return NULL;
+            }
+
+            cfg.seed++;
+        }
+    }
+
+    swprintf_s( pState->args, _countof( pState->args ), TEXT( "\"%s\"" ),
+        pState->dir );
+
+    return pState;
+}
+
+// Cold: every file is parsed
+void resetJdots( void* state )
+{
+    E2eState* pState = ( E2eState* )state;
+    TCHAR fName[ MAX_PATH ] = { 0 };
+
+    if ( pState->cold )
+    {
+        swprintf_s( fName, _countof( fName ), TEXT( "%s%s%s" ), pState->dir,
+            IO_SEP, CACHE_FILE );
+        IoDelete( fName );
+    }
+}
+
+BOOL runJdots( void* state, BenchPass* pPass )
+{
+    E2eState* pState = ( E2eState* )state;
+
+    pPass->ops = pState->ctFiles;
+    pPass->bytes = ( UINT64 )pState->ctFiles * E2E_FILE_BYTES;
+
+    return BenchRunTool( pState->tool, pState->args );
+}
@@ -0,0 +1,385 @@
+//
+// bufOut.c -- buffered output writer
+//
+// Buffered Writer ADT - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "bufOut.h"
+#include "probes.h"
+
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+PROBE_SEMAPHORE( buf_flush );
+
+/* protototypes for local functions */
+static int MakeRoom( BufOut* pOut, DWORD len );
+static int PutEscaped( BufOut* pOut, const TCHAR* txt, size_t len,
+    BOOL json );
+static const CHAR* EscapeXml( UINT32 cp );
+static const CHAR* EscapeJson( UINT32 cp, CHAR* esc );
+
+/* function definitions */
+int OpenBufOut( BufOut* pOut, LPCTSTR fName )
+{
+    IoFile hOut;
+
+    // Open output file
+    hOut = IoCreateFile( fName );
+
+    // Validate output file
+    if ( hOut == IO_NO_FILE )
+    {
+        ReportError( TEXT( "Open output file failed." ), 0, TRUE );
+        return FALSE;
+    }
+
+    if ( !AttachBufOut( pOut, hOut ) )
+    {
+        IoCloseFile( hOut );
+        return FALSE;
+    }
+
+    pOut->ownHandle = TRUE;
+
+    return TRUE;
+}
+
+int AttachBufOut( BufOut* pOut, IoFile hOut )
+{
+    pOut->hOut = hOut;
+    pOut->ownHandle = FALSE;
+    pOut->ctBuf = 0;
+    pOut->failed = FALSE;
+    pOut->pfun = NULL;
+    pOut->ctx = NULL;
+    pOut->buf = ( CHAR* )malloc( BUFOUT_SIZE );
+    pOut->sizeBuf = ( pOut->buf != NULL ) ? BUFOUT_SIZE : 0;
+
+    if ( pOut->buf == NULL )
+    {
+        fwprintf( stderr, TEXT( "No memory available for output buffer\n" ) );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int AttachBufOutSink( BufOut* pOut,
+    int ( *pfun )( void* ctx, const CHAR* data, DWORD len ), void* ctx )
+{
+    if ( !AttachBufOut( pOut, IO_NO_FILE ) )
+        return FALSE;
+
+    pOut->pfun = pfun;
+    pOut->ctx = ctx;
+
+    return TRUE;
+}
+
+int BufOutWrite( BufOut* pOut, const void* data, DWORD len )
+{
+    const CHAR* src = ( const CHAR* )data;
+    DWORD chunk;
+
+    while ( len > 0 )
+    {
+        if ( !MakeRoom( pOut, 1 ) )
+            return FALSE;
+
+        // Copy as much as fits
+        chunk = pOut->sizeBuf - pOut->ctBuf;
+        if ( chunk > len )
+            chunk = len;
+
+        memcpy( pOut->buf + pOut->ctBuf, src, chunk );
+        pOut->ctBuf += chunk;
+        src += chunk;
+        len -= chunk;
+    }
+
+    return TRUE;
+}
+
+int BufOutText( BufOut* pOut, const CHAR* txt )
+{
+    return BufOutWrite( pOut, txt, ( DWORD )strlen( txt ) );
+}
+
+int BufOutPrintf( BufOut* pOut, const CHAR* fmt, ... )
+{
+    va_list args;
+    int len;
+
+    if ( !MakeRoom( pOut, BUFOUT_LINE ) )
+        return FALSE;
+
+    // Format straight into the free part of the buffer
+    va_start( args, fmt );
+    len = _vsnprintf_s( pOut->buf + pOut->ctBuf, pOut->sizeBuf - pOut->ctBuf,
+        _TRUNCATE, fmt, args );
+    va_end( args );
+
+    if ( len < 0 )
+    {
+        fprintf( stderr, "String length error.\n" );
+        return FALSE;
+    }
+
+    pOut->ctBuf += len;
+
+    return TRUE;
+}
+
+int BufOutPrintfW( BufOut* pOut, const TCHAR* fmt, ... )
+{
+    TCHAR lineW[ BUFOUT_LINE ];
+    va_list args;
+    int lenW, len;
+
+    // Format wide text
+    va_start( args, fmt );
+    lenW = _vsnwprintf_s( lineW, _countof( lineW ), _TRUNCATE, fmt, args );
+    va_end( args );
+
+    if ( lenW < 0 )
+    {
+        fprintf( stderr, "String length error.\n" );
+        return FALSE;
+    }
+
+    if ( lenW == 0 )
+        return TRUE;
+
+    // Worst case: 3 UTF-8 bytes per UTF-16 unit, 4 per UTF-32 unit
+    if ( !MakeRoom( pOut, lenW * ( sizeof( TCHAR ) > 2 ? 4 : 3 ) ) )
+        return FALSE;
+
+    // Convert straight into the free part of the buffer
+    len = WideCharToMultiByte( CP_UTF8, 0, lineW, lenW,
+        pOut->buf + pOut->ctBuf, pOut->sizeBuf - pOut->ctBuf, NULL, NULL );
+
+    if ( len == 0 )
+    {
+        ReportError( TEXT( "UTF-8 conversion failed." ), 0, TRUE );
+        return FALSE;
+    }
+
+    pOut->ctBuf += len;
+
+    return TRUE;
+}
+
+int BufOutXml( BufOut* pOut, const TCHAR* txt, size_t len )
+{
+    return PutEscaped( pOut, txt, len, FALSE );
+}
+
+int BufOutJson( BufOut* pOut, const TCHAR* txt, size_t len )
+{
+    return PutEscaped( pOut, txt, len, TRUE );
+}
+
+CHAR* BufOutReserve( BufOut* pOut, DWORD len )
+{
+    if ( !MakeRoom( pOut, len ) )
+        return NULL;
+
+    return pOut->buf + pOut->ctBuf;
+}
+
+void BufOutCommit( BufOut* pOut, DWORD len )
+{
+    pOut->ctBuf += len;
+}
+
+int FlushBufOut( BufOut* pOut )
+{
+    LONGLONG start = 0;
+
+    if ( pOut->ctBuf == 0 )
+        return !pOut->failed;
+
+    if ( PROBE_ENABLED( buf_flush ) )
+        start = PROBE_NOW();
+
+    // Sink reports its own errors
+    if ( pOut->pfun != NULL )
+    {
+        if ( !pOut->failed &&
+            !( *pOut->pfun )( pOut->ctx, pOut->buf, pOut->ctBuf ) )
+            pOut->failed = TRUE;
+    }
+    // Write pending bytes at once
+    else if ( !IoWrite( pOut->hOut, pOut->buf, pOut->ctBuf ) )
+    {
+        // Report only the first failure
+        if ( !pOut->failed )
+            ReportError( TEXT( "Output to file failed." ), 0, TRUE );
+
+        pOut->failed = TRUE;
+    }
+
+    if ( PROBE_ENABLED( buf_flush ) )
+        PROBE_SEM2( buf_flush, pOut->ctBuf, PROBE_NOW() - start );
+
+    pOut->ctBuf = 0;
+
+    return !pOut->failed;
+}
+
+int CloseBufOut( BufOut* pOut )
+{
+    int ok;
+
+    ok = FlushBufOut( pOut );
+
+    if ( pOut->ownHandle && pOut->hOut != IO_NO_FILE )
+        IoCloseFile( pOut->hOut );
+
+    free( pOut->buf );
+
+    pOut->hOut = IO_NO_FILE;
+    pOut->ownHandle = FALSE;
+    pOut->buf = NULL;
+    pOut->sizeBuf = 0;
+
+    return ok;
+}
+
+
+/* local functions */
+
+// Make sure len bytes are free in the buffer
+// Flushes pending bytes when needed
+static int MakeRoom( BufOut* pOut, DWORD len )
+{
+    if ( pOut->buf == NULL )
+        return FALSE;
+
+    if ( pOut->sizeBuf - pOut->ctBuf < len )
+        return FlushBufOut( pOut );
+
+    return TRUE;
+}
+
+// Encode UTF-16 as UTF-8, escaped for XML or JSON text
+static int PutEscaped( BufOut* pOut, const TCHAR* txt, size_t len,
+    BOOL json )
+{
+    CHAR* dst;
+    const CHAR* esc;
+    CHAR escJson[ 8 ];
+    UINT32 cp;
+    size_t i;
+
+    for ( i = 0; i < len; i++ )
+    {
+        // Room for the longest escape ( "&quot;", "\u001f" )
+        if ( !MakeRoom( pOut, 6 ) )
+            return FALSE;
+
+        dst = pOut->buf + pOut->ctBuf;
+        cp = txt[ i ];
+        esc = NULL;
+
+        if ( json )
+            esc = EscapeJson( cp, escJson );
+        else
+            esc = EscapeXml( cp );
+
+        if ( esc != NULL )
+        {
+            while ( *esc != '\0' )
+                pOut->buf[ pOut->ctBuf++ ] = *esc++;
+            continue;
+        }
+
+        // Surrogate pair -> one code point
+        if ( cp >= 0xD800 && cp <= 0xDBFF && i + 1 < len &&
+            txt[ i + 1 ] >= 0xDC00 && txt[ i + 1 ] <= 0xDFFF )
+        {
+            cp = 0x10000 + ( ( cp - 0xD800 ) << 10 ) + ( txt[ ++i ] - 0xDC00 );
+        }
+        else if ( cp >= 0xD800 && cp <= 0xDFFF )
+            cp = 0xFFFD;
+
+        // Control chars and non-chars are not allowed in XML 1.0
+        if ( !json && ( ( cp < 0x20 && cp != '\t' && cp != '\n' &&
+            cp != '\r' ) || cp == 0xFFFE || cp == 0xFFFF ) )
+            continue;
+
+        if ( cp < 0x80 )
+        {
+            dst[ 0 ] = ( CHAR )cp;
+            pOut->ctBuf += 1;
+        }
+        else if ( cp < 0x800 )
+        {
+            dst[ 0 ] = ( CHAR )( 0xC0 | ( cp >> 6 ) );
+            dst[ 1 ] = ( CHAR )( 0x80 | ( cp & 0x3F ) );
+            pOut->ctBuf += 2;
+        }
+        else if ( cp < 0x10000 )
+        {
+            dst[ 0 ] = ( CHAR )( 0xE0 | ( cp >> 12 ) );
+            dst[ 1 ] = ( CHAR )( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+            dst[ 2 ] = ( CHAR )( 0x80 | ( cp & 0x3F ) );
+            pOut->ctBuf += 3;
+        }
+        else
+        {
+            dst[ 0 ] = ( CHAR )( 0xF0 | ( cp >> 18 ) );
+            dst[ 1 ] = ( CHAR )( 0x80 | ( ( cp >> 12 ) & 0x3F ) );
+            dst[ 2 ] = ( CHAR )( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+            dst[ 3 ] = ( CHAR )( 0x80 | ( cp & 0x3F ) );
+            pOut->ctBuf += 4;
+        }
+    }
+
+    return TRUE;
+}
+
+static const CHAR* EscapeXml( UINT32 cp )
+{
+    switch ( cp )
+    {
+    case '&':   return "&amp;";
+    case '<':   return "&lt;";
+    case '>':   return "&gt;";
+    case '"':   return "&quot;";
+    case '\'':  return "&apos;";
+    }
+
+    return NULL;
+}
+
+// Quote, backslash and control chars ( RFC 8259, 7 )
+static const CHAR* EscapeJson( UINT32 cp, CHAR* esc )
+{
+    static const CHAR hex[] = "0123456789abcdef";
+
+    switch ( cp )
+    {
+    case '"':   return "\\\"";
+    case '\\':  return "\\\\";
+    case '\b':  return "\\b";
+    case '\f':  return "\\f";
+    case '\n':  return "\\n";
+    case '\r':  return "\\r";
+    case '\t':  return "\\t";
+    }
+
+    if ( cp >= 0x20 )
+        return NULL;
+
+    strcpy_s( esc, 8, "\\u00" );
+    esc[ 4 ] = hex[ cp >> 4 ];
+    esc[ 5 ] = hex[ cp & 0xF ];
+    esc[ 6 ] = '\0';
+
+    return esc;
+}
@@ -0,0 +1,134 @@
+//
+// bufOut.h -- buffered output writer
+//
+// Text and binary output is collected in a large user-space buffer
+// and handed to the system in big writes (one write per buffer),
+// instead of one write per output line.
+//
+// Buffered Writer ADT - Interface declarations
+//
+
+#ifndef _BUFOUT_H_
+#define _BUFOUT_H_
+
+#include "io.h"
+
+#define     BUFOUT_SIZE     ( 256 * 1024 )  // Buffer size [bytes]
+#define     BUFOUT_LINE     1024            // Max formatted line [chars]
+
+typedef struct bufOut
+{
+    IoFile hOut;            // Output file
+    BOOL ownHandle;         // File closed by CloseBufOut()
+    CHAR* buf;              // Pending output
+    DWORD ctBuf;            // Bytes pending
+    DWORD sizeBuf;          // Buffer capacity [bytes]
+    BOOL failed;            // A write failed (already reported)
+    int ( *pfun )( void* ctx, const CHAR* data, DWORD len );
+    void* ctx;              // Sink (instead of hOut) if pfun set
+} BufOut;
+
+/* function prototypes */
+
+/* operation:      create a file and attach a writer   */
+/* preconditions:  pOut points to a writer             */
+/*                 fName points to the file's name     */
+/* postconditions: file is created (truncated), returns*/
+/*                 true on success, otherwise reports  */
+/*                 the error and returns false         */
+int OpenBufOut( BufOut* pOut, LPCTSTR fName );
+
+/* operation:      attach a writer to an open file     */
+/* preconditions:  pOut points to a writer             */
+/*                 hOut is an open file (e.g. stdout)  */
+/* postconditions: returns true on success, false if   */
+/*                 no memory                           */
+int AttachBufOut( BufOut* pOut, IoFile hOut );
+
+/* operation:      attach a writer to a sink function  */
+/* preconditions:  pOut points to a writer             */
+/*                 pfun points to a function that      */
+/*                 consumes bytes and returns false on */
+/*                 error (reported), ctx is passed on  */
+/* postconditions: returns true on success, false if   */
+/*                 no memory                           */
+int AttachBufOutSink( BufOut* pOut,
+    int ( *pfun )( void* ctx, const CHAR* data, DWORD len ), void* ctx );
+
+/* operation:      append bytes to the output          */
+/* preconditions:  pOut points to an open writer       */
+/* postconditions: bytes are buffered (flushed to the  */
+/*                 handle when the buffer is full),    */
+/*                 returns false if a write failed     */
+int BufOutWrite( BufOut* pOut, const void* data, DWORD len );
+
+/* operation:      append a null terminated string     */
+/* preconditions:  pOut points to an open writer       */
+/* postconditions: see BufOutWrite()                   */
+int BufOutText( BufOut* pOut, const CHAR* txt );
+
+/* operation:      append formatted text               */
+/* preconditions:  pOut points to an open writer       */
+/*                 fmt is a printf format string       */
+/* postconditions: text is formatted straight into the */
+/*                 buffer, returns false on error      */
+int BufOutPrintf( BufOut* pOut, const CHAR* fmt, ... ) PLAT_PRINTF( 2, 3 );
+
+/* operation:      append formatted wide text as UTF-8 */
+/* preconditions:  pOut points to an open writer       */
+/*                 fmt is a wide printf format string  */
+/* postconditions: see BufOutPrintf()                  */
+int BufOutPrintfW( BufOut* pOut, const TCHAR* fmt, ... );
+
+/* operation:      append wide text as escaped UTF-8   */
+/*                 ( XML character data or attribute ) */
+/* preconditions:  pOut points to an open writer       */
+/*                 txt points to len UTF-16 units      */
+/* postconditions: text is encoded straight into the   */
+/*                 buffer, & < > " ' are escaped, chars*/
+/*                 not allowed in XML are dropped and  */
+/*                 unpaired surrogates become U+FFFD;  */
+/*                 returns false if a write failed     */
+int BufOutXml( BufOut* pOut, const TCHAR* txt, size_t len );
+
+/* operation:      append wide text as escaped UTF-8   */
+/*                 ( JSON string contents )            */
+/* preconditions:  pOut points to an open writer       */
+/*                 txt points to len UTF-16 units      */
+/* postconditions: text is encoded straight into the   */
+/*                 buffer, quote, backslash and control*/
+/*                 chars are escaped, unpaired         */
+/*                 surrogates become U+FFFD; returns   */
+/*                 false if a write failed             */
+int BufOutJson( BufOut* pOut, const TCHAR* txt, size_t len );
+
+/* operation:      get room to format text in place    */
+/* preconditions:  pOut points to an open writer       */
+/*                 len <= BUFOUT_LINE                  */
+/* postconditions: returns address of at least len     */
+/*                 free bytes in the buffer (NULL on   */
+/*                 error), BufOutCommit() appends them */
+CHAR* BufOutReserve( BufOut* pOut, DWORD len );
+
+/* operation:      append bytes written in place       */
+/* preconditions:  len bytes were written at the       */
+/*                 address returned by BufOutReserve() */
+/* postconditions: bytes are part of the output        */
+void BufOutCommit( BufOut* pOut, DWORD len );
+
+/* operation:      write pending bytes to the handle   */
+/*                 ( or hand them to the sink )        */
+/* preconditions:  pOut points to an open writer       */
+/* postconditions: buffer is empty, returns false if   */
+/*                 the write failed (error reported)   */
+int FlushBufOut( BufOut* pOut );
+
+/* operation:      flush and detach the writer         */
+/* preconditions:  pOut points to an open writer       */
+/* postconditions: pending bytes are written, handle   */
+/*                 is closed if opened by OpenBufOut(),*/
+/*                 memory is freed, returns false if   */
+/*                 any write failed                    */
+int CloseBufOut( BufOut* pOut );
+
+#endif
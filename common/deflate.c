@@ -0,0 +1,335 @@
+//
+// deflate.c -- streaming deflate compressor ( RFC 1951 )
+//
+// Deflate Compressor ADT - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "deflate.h"
+
+#define     MIN_MATCH       3
+#define     MAX_MATCH       258
+#define     MIN_LOOKAHEAD   ( MAX_MATCH + MIN_MATCH )
+#define     MAX_CHAIN       64          // Candidates tried per pos
+#define     GOOD_MATCH      32          // Stop searching at this length
+#define     WMASK           ( DEFL_WSIZE - 1 )
+#define     BUF_SIZE        ( 2 * DEFL_WSIZE )
+#define     END_BLOCK       256
+
+#define     HASH( p )       ( ( ( ( p )[ 0 ] << 10 ) ^ ( ( p )[ 1 ] << 5 ) ^ \
+                            ( p )[ 2 ] ) & ( DEFL_HASH - 1 ) )
+
+// Length codes 257.. and distance codes 0.. ( RFC 1951, 3.2.5 )
+static const WORD lenBase[ 29 ] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15,
+    17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195,
+    227, 258 };
+static const BYTE lenExtra[ 29 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1,
+    2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const WORD distBase[ 30 ] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33,
+    49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577 };
+static const BYTE distExtra[ 30 ] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4,
+    5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/* protototypes for local functions */
+static void Compress( Deflater* pDefl, BOOL flush );
+static void Slide( Deflater* pDefl );
+static void PutBits( Deflater* pDefl, UINT32 bits, int ctBits );
+static void PutLiteral( Deflater* pDefl, int lit );
+static void PutMatch( Deflater* pDefl, int len, int dist );
+static void SinkOut( Deflater* pDefl );
+static UINT32 Reverse( UINT32 code, int ctBits );
+
+/* function definitions */
+int DeflateInit( Deflater* pDefl,
+    int ( *pfun )( void* ctx, const BYTE* data, DWORD len ), void* ctx )
+{
+    int i;
+
+    memset( pDefl, 0, sizeof( Deflater ) );
+
+    pDefl->buf = ( BYTE* )malloc( BUF_SIZE );
+    pDefl->head = ( INT32* )malloc( DEFL_HASH * sizeof( INT32 ) );
+    pDefl->prev = ( INT32* )malloc( DEFL_WSIZE * sizeof( INT32 ) );
+    pDefl->out = ( BYTE* )malloc( DEFL_OUT );
+
+    if ( pDefl->buf == NULL || pDefl->head == NULL || pDefl->prev == NULL ||
+        pDefl->out == NULL )
+    {
+        fwprintf( stderr, TEXT( "No memory available for compression\n" ) );
+        DeflateEnd( pDefl );
+        return FALSE;
+    }
+
+    for ( i = 0; i < DEFL_HASH; i++ )
+        pDefl->head[ i ] = -1;
+
+    pDefl->pfun = pfun;
+    pDefl->ctx = ctx;
+
+    // Fixed Huffman codes ( RFC 1951, 3.2.6 )
+    for ( i = 0; i < 288; i++ )
+    {
+        if ( i < 144 )
+        {
+            pDefl->litLens[ i ] = 8;
+            pDefl->litCodes[ i ] = ( WORD )Reverse( 0x30 + i, 8 );
+        }
+        else if ( i < 256 )
+        {
+            pDefl->litLens[ i ] = 9;
+            pDefl->litCodes[ i ] = ( WORD )Reverse( 0x190 + i - 144, 9 );
+        }
+        else if ( i < 280 )
+        {
+            pDefl->litLens[ i ] = 7;
+            pDefl->litCodes[ i ] = ( WORD )Reverse( i - 256, 7 );
+        }
+        else
+        {
+            pDefl->litLens[ i ] = 8;
+            pDefl->litCodes[ i ] = ( WORD )Reverse( 0xC0 + i - 280, 8 );
+        }
+    }
+
+    for ( i = 0; i < 30; i++ )
+        pDefl->distCodes[ i ] = ( BYTE )Reverse( i, 5 );
+
+    // One block with fixed codes, not final ( BFINAL 0, BTYPE 01 )
+    PutBits( pDefl, 0, 1 );
+    PutBits( pDefl, 1, 2 );
+
+    return TRUE;
+}
+
+int DeflateWrite( Deflater* pDefl, const BYTE* data, DWORD len )
+{
+    DWORD chunk;
+
+    while ( len > 0 && !pDefl->failed )
+    {
+        // Window full: drop its older half
+        if ( pDefl->ctBuf == BUF_SIZE )
+            Slide( pDefl );
+
+        chunk = BUF_SIZE - pDefl->ctBuf;
+        if ( chunk > len )
+            chunk = len;
+
+        memcpy( pDefl->buf + pDefl->ctBuf, data, chunk );
+        pDefl->ctBuf += chunk;
+        data += chunk;
+        len -= chunk;
+
+        Compress( pDefl, FALSE );
+    }
+
+    return !pDefl->failed;
+}
+
+int DeflateEnd( Deflater* pDefl )
+{
+    int ok = FALSE;
+
+    if ( pDefl->buf != NULL && pDefl->head != NULL &&
+        pDefl->prev != NULL && pDefl->out != NULL )
+    {
+        // Rest of the input, end of block
+        Compress( pDefl, TRUE );
+        PutLiteral( pDefl, END_BLOCK );
+
+        // Empty final block ( BFINAL 1, BTYPE 01 )
+        PutBits( pDefl, 1, 1 );
+        PutBits( pDefl, 1, 2 );
+        PutLiteral( pDefl, END_BLOCK );
+
+        // Pad last byte
+        PutBits( pDefl, 0, 7 );
+        SinkOut( pDefl );
+
+        ok = !pDefl->failed;
+    }
+
+    free( pDefl->buf );
+    free( pDefl->head );
+    free( pDefl->prev );
+    free( pDefl->out );
+
+    pDefl->buf = NULL;
+    pDefl->head = NULL;
+    pDefl->prev = NULL;
+    pDefl->out = NULL;
+
+    return ok;
+}
+
+
+/* local functions */
+
+// Compress while enough lookahead is buffered (all of it if flush)
+static void Compress( Deflater* pDefl, BOOL flush )
+{
+    BYTE* buf = pDefl->buf;
+    DWORD avail;
+    INT32 cand;
+    INT32 limit;
+    int chain;
+    int len, maxLen;
+    int bestLen, bestDist;
+    UINT32 h;
+    DWORD i;
+
+    while ( pDefl->pos < pDefl->ctBuf &&
+        ( flush || pDefl->ctBuf - pDefl->pos >= MIN_LOOKAHEAD ) )
+    {
+        avail = pDefl->ctBuf - pDefl->pos;
+        bestLen = 0;
+        bestDist = 0;
+
+        if ( avail >= MIN_MATCH )
+        {
+            maxLen = ( avail < MAX_MATCH ) ? ( int )avail : MAX_MATCH;
+            limit = ( INT32 )pDefl->pos - DEFL_WSIZE;
+            h = HASH( buf + pDefl->pos );
+
+            // Longest match among the latest candidates
+            for ( cand = pDefl->head[ h ], chain = MAX_CHAIN;
+                cand > limit && cand >= 0 && chain > 0;
+                cand = pDefl->prev[ cand & WMASK ], chain-- )
+            {
+                if ( buf[ cand + bestLen ] != buf[ pDefl->pos + bestLen ] ||
+                    buf[ cand ] != buf[ pDefl->pos ] )
+                    continue;
+
+                for ( len = 0; len < maxLen &&
+                    buf[ cand + len ] == buf[ pDefl->pos + len ]; len++ )
+                    ;
+
+                if ( len > bestLen )
+                {
+                    bestLen = len;
+                    bestDist = pDefl->pos - cand;
+
+                    if ( len >= GOOD_MATCH || len == maxLen )
+                        break;
+                }
+            }
+
+            pDefl->prev[ pDefl->pos & WMASK ] = pDefl->head[ h ];
+            pDefl->head[ h ] = pDefl->pos;
+        }
+
+        if ( bestLen >= MIN_MATCH )
+        {
+            PutMatch( pDefl, bestLen, bestDist );
+
+            // Hash the matched bytes too
+            for ( i = 1; i < ( DWORD )bestLen &&
+                pDefl->pos + i + MIN_MATCH <= pDefl->ctBuf; i++ )
+            {
+                h = HASH( buf + pDefl->pos + i );
+                pDefl->prev[ ( pDefl->pos + i ) & WMASK ] = pDefl->head[ h ];
+                pDefl->head[ h ] = pDefl->pos + i;
+            }
+
+            pDefl->pos += bestLen;
+        }
+        else
+        {
+            PutLiteral( pDefl, buf[ pDefl->pos ] );
+            pDefl->pos++;
+        }
+
+        if ( pDefl->failed )
+            return;
+    }
+}
+
+// Move the newer half of the window down
+static void Slide( Deflater* pDefl )
+{
+    int i;
+
+    memmove( pDefl->buf, pDefl->buf + DEFL_WSIZE, BUF_SIZE - DEFL_WSIZE );
+    pDefl->ctBuf -= DEFL_WSIZE;
+    pDefl->pos -= DEFL_WSIZE;
+
+    for ( i = 0; i < DEFL_HASH; i++ )
+        pDefl->head[ i ] = ( pDefl->head[ i ] >= DEFL_WSIZE ) ?
+            pDefl->head[ i ] - DEFL_WSIZE : -1;
+
+    for ( i = 0; i < DEFL_WSIZE; i++ )
+        pDefl->prev[ i ] = ( pDefl->prev[ i ] >= DEFL_WSIZE ) ?
+            pDefl->prev[ i ] - DEFL_WSIZE : -1;
+}
+
+// Append bits, LSB first
+static void PutBits( Deflater* pDefl, UINT32 bits, int ctBits )
+{
+    pDefl->bitBuf |= ( UINT64 )bits << pDefl->ctBits;
+    pDefl->ctBits += ctBits;
+
+    while ( pDefl->ctBits >= 8 )
+    {
+        if ( pDefl->ctOut == DEFL_OUT )
+            SinkOut( pDefl );
+
+        pDefl->out[ pDefl->ctOut++ ] = ( BYTE )pDefl->bitBuf;
+        pDefl->bitBuf >>= 8;
+        pDefl->ctBits -= 8;
+    }
+}
+
+static void PutLiteral( Deflater* pDefl, int lit )
+{
+    PutBits( pDefl, pDefl->litCodes[ lit ], pDefl->litLens[ lit ] );
+}
+
+static void PutMatch( Deflater* pDefl, int len, int dist )
+{
+    int code;
+
+    // Length code and extra bits
+    for ( code = 28; lenBase[ code ] > len; code-- )
+        ;
+
+    PutLiteral( pDefl, 257 + code );
+    PutBits( pDefl, len - lenBase[ code ], lenExtra[ code ] );
+
+    // Distance code and extra bits
+    for ( code = 29; distBase[ code ] > dist; code-- )
+        ;
+
+    PutBits( pDefl, pDefl->distCodes[ code ], 5 );
+    PutBits( pDefl, dist - distBase[ code ], distExtra[ code ] );
+}
+
+// Hand compressed bytes to the sink
+static void SinkOut( Deflater* pDefl )
+{
+    if ( pDefl->ctOut == 0 )
+        return;
+
+    if ( !pDefl->failed &&
+        !( *pDefl->pfun )( pDefl->ctx, pDefl->out, pDefl->ctOut ) )
+        pDefl->failed = TRUE;
+
+    pDefl->sizeOut += pDefl->ctOut;
+    pDefl->ctOut = 0;
+}
+
+// Huffman codes are sent MSB first
+static UINT32 Reverse( UINT32 code, int ctBits )
+{
+    UINT32 rev = 0;
+
+    while ( ctBits-- > 0 )
+    {
+        rev = ( rev << 1 ) | ( code & 1 );
+        code >>= 1;
+    }
+
+    return rev;
+}
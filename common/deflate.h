@@ -0,0 +1,71 @@
+//
+// deflate.h -- streaming deflate compressor ( RFC 1951 )
+//
+// LZ77 over a 32 KB window (hash chains, greedy matching) with the
+// fixed Huffman codes of deflate. Input is compressed as it arrives,
+// matches reach back across writes. Output is handed to a sink
+// function in chunks of up to DEFL_OUT bytes.
+//
+// Fixed codes need no code tables in the stream and no second pass,
+// which suits markup like kml (long repeats, small alphabet).
+//
+// Deflate Compressor ADT - Interface declarations
+//
+
+#ifndef _DEFLATE_H_
+#define _DEFLATE_H_
+
+#include "platform.h"
+
+#define     DEFL_WSIZE      32768           // Window [bytes]
+#define     DEFL_HASH       ( 1 << 15 )     // Hash heads
+#define     DEFL_OUT        ( 64 * 1024 )   // Output chunk [bytes]
+
+typedef struct deflater
+{
+    BYTE* buf;              // Window + lookahead ( 2 * DEFL_WSIZE )
+    DWORD ctBuf;            // Bytes in buf
+    DWORD pos;              // Next byte to compress
+    INT32* head;            // Latest pos per hash (-1: none)
+    INT32* prev;            // Previous pos of same hash (per pos)
+    WORD litCodes[ 288 ];   // Fixed lit/len codes (bit reversed)
+    BYTE litLens[ 288 ];    // Their lengths [bits]
+    BYTE distCodes[ 30 ];   // Fixed dist codes (5 bits, reversed)
+    UINT64 bitBuf;          // Pending bits (LSB first)
+    int ctBits;
+    BYTE* out;              // Compressed bytes not yet sunk
+    DWORD ctOut;
+    UINT64 sizeOut;         // Compressed bytes in total
+    int ( *pfun )( void* ctx, const BYTE* data, DWORD len );
+    void* ctx;              // Passed on to pfun
+    BOOL failed;            // Sink failed
+} Deflater;
+
+/* function prototypes */
+
+/* operation:      start a deflate stream              */
+/* preconditions:  pDefl points to a compressor        */
+/*                 pfun points to a sink function that */
+/*                 returns false on error, ctx is      */
+/*                 passed on to it                     */
+/* postconditions: returns true on success, false if   */
+/*                 no memory                           */
+int DeflateInit( Deflater* pDefl,
+    int ( *pfun )( void* ctx, const BYTE* data, DWORD len ), void* ctx );
+
+/* operation:      compress bytes                      */
+/* preconditions:  pDefl points to a started stream    */
+/* postconditions: bytes are compressed (up to 261     */
+/*                 bytes are held back as lookahead),  */
+/*                 returns false if the sink failed    */
+int DeflateWrite( Deflater* pDefl, const BYTE* data, DWORD len );
+
+/* operation:      end a deflate stream                */
+/* preconditions:  pDefl points to a started stream    */
+/* postconditions: all bytes are compressed, the final */
+/*                 block is written and sunk, memory is*/
+/*                 freed; returns false if the sink    */
+/*                 failed                              */
+int DeflateEnd( Deflater* pDefl );
+
+#endif
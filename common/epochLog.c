@@ -0,0 +1,260 @@
+//
+// epochLog.c -- columnar log of parsed epochs ( <name>.epochs )
+//
+// Epoch Log - Interface implementation
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "epochLog.h"
+
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+/* protototypes for local functions */
+static void WriteBlock( EpochLog* pLog );
+static DWORD EncodeColumn( const LONGLONG* vals, UINT32 ctVals, BYTE* enc );
+static void MinMax( const LONGLONG* vals, UINT32 ctVals, LONGLONG* pMin,
+    LONGLONG* pMax );
+
+/* function definitions */
+int OpenEpochLog( EpochLog* pLog, LPCTSTR fName )
+{
+    EpochHeader header = { 0 };
+
+    memset( pLog, 0, sizeof( EpochLog ) );
+
+    pLog->cols = ( LONGLONG* )malloc( sizeof( LONGLONG ) * EPOCH_COLS *
+        EPOCH_BLOCK );
+    pLog->enc = ( BYTE* )malloc( EPOCH_VARINT * EPOCH_COLS * EPOCH_BLOCK );
+
+    if ( pLog->cols == NULL || pLog->enc == NULL )
+    {
+        ReportError( TEXT( "\nNo memory available for epoch log" ), 0,
+            FALSE );
+        free( pLog->cols );
+        free( pLog->enc );
+        return FALSE;
+    }
+
+    if ( !OpenBufOut( &pLog->out, fName ) )
+    {
+        free( pLog->cols );
+        free( pLog->enc );
+        return FALSE;
+    }
+
+    memcpy( header.magic, EPOCH_MAGIC, sizeof( header.magic ) );
+    header.version = EPOCH_VERSION;
+    header.ctCols = EPOCH_COLS;
+    header.ctBlock = EPOCH_BLOCK;
+
+    BufOutWrite( &pLog->out, &header, sizeof( header ) );
+
+    return TRUE;
+}
+
+void EpochLogAdd( EpochLog* pLog, const LONGLONG* vals )
+{
+    int col;
+
+    for ( col = 0; col < EPOCH_COLS; col++ )
+        pLog->cols[ col * EPOCH_BLOCK + pLog->ctEpochs ] = vals[ col ];
+
+    if ( ++pLog->ctEpochs == EPOCH_BLOCK )
+        WriteBlock( pLog );
+}
+
+int CloseEpochLog( EpochLog* pLog )
+{
+    int ok;
+
+    if ( pLog->ctEpochs > 0 )
+        WriteBlock( pLog );
+
+    ok = CloseBufOut( &pLog->out );
+
+    free( pLog->cols );
+    free( pLog->enc );
+    pLog->cols = NULL;
+    pLog->enc = NULL;
+
+    return ok;
+}
+
+int OpenEpochReader( EpochReader* pRd, LPCTSTR fName )
+{
+    EpochHeader header;
+
+    memset( pRd, 0, sizeof( EpochReader ) );
+
+    if ( !IoMapFile( fName, &pRd->map ) )
+    {
+        ReportError( TEXT( "\nOpening epoch log failed" ), 0, TRUE );
+        return FALSE;
+    }
+
+    if ( pRd->map.size >= sizeof( header ) )
+        memcpy( &header, pRd->map.data, sizeof( header ) );
+
+    if ( pRd->map.size < sizeof( header ) ||
+        memcmp( header.magic, EPOCH_MAGIC, sizeof( header.magic ) ) != 0 ||
+        header.version != EPOCH_VERSION || header.ctCols != EPOCH_COLS )
+    {
+        ReportError( TEXT( "\nNot an epoch log of this version" ), 0,
+            FALSE );
+        IoUnmapFile( &pRd->map );
+        return FALSE;
+    }
+
+    pRd->pos = sizeof( header );
+
+    return TRUE;
+}
+
+const EpochBlock* NextEpochBlock( EpochReader* pRd )
+{
+    const BYTE* pCol;
+    int col;
+
+    if ( pRd->map.size - pRd->pos < sizeof( EpochBlock ) )
+        return NULL;
+
+    memcpy( &pRd->block, pRd->map.data + pRd->pos, sizeof( EpochBlock ) );
+    pRd->pos += sizeof( EpochBlock );
+
+    if ( pRd->block.ctEpochs == 0 || pRd->block.ctEpochs > EPOCH_BLOCK ||
+        pRd->map.size - pRd->pos < pRd->block.ctBytes )
+    {
+        pRd->pos = pRd->map.size;
+        return NULL;
+    }
+
+    // Start of each column's varints
+    pCol = ( const BYTE* )pRd->map.data + pRd->pos;
+
+    for ( col = 0; col < EPOCH_COLS; col++ )
+    {
+        pRd->cols[ col ] = pCol;
+        pCol += pRd->block.colBytes[ col ];
+    }
+
+    if ( pCol != ( const BYTE* )pRd->map.data + pRd->pos +
+        pRd->block.ctBytes )
+    {
+        pRd->pos = pRd->map.size;
+        return NULL;
+    }
+
+    pRd->pos += pRd->block.ctBytes;
+
+    return &pRd->block;
+}
+
+int ReadEpochColumn( EpochReader* pRd, int col, LONGLONG* vals )
+{
+    const BYTE* pCh = pRd->cols[ col ];
+    const BYTE* pEnd = pCh + pRd->block.colBytes[ col ];
+    LONGLONG val = 0;
+    UINT64 zz;
+    UINT32 i;
+    int shift;
+
+    for ( i = 0; i < pRd->block.ctEpochs; i++ )
+    {
+        // Varint
+        zz = 0;
+        shift = 0;
+
+        do
+        {
+            if ( pCh == pEnd || shift > 63 )
+                return FALSE;
+
+            zz |= ( UINT64 )( *pCh & 0x7f ) << shift;
+            shift += 7;
+        } while ( *pCh++ & 0x80 );
+
+        // Zigzag, difference to the previous value
+        val += ( LONGLONG )( zz >> 1 ) ^ -( LONGLONG )( zz & 1 );
+        vals[ i ] = val;
+    }
+
+    return pCh == pEnd;
+}
+
+void CloseEpochReader( EpochReader* pRd )
+{
+    IoUnmapFile( &pRd->map );
+}
+
+
+/* local functions */
+
+// Encode the collected epochs, start a new block
+static void WriteBlock( EpochLog* pLog )
+{
+    EpochBlock block = { 0 };
+    const LONGLONG* vals;
+    int col;
+
+    block.ctEpochs = pLog->ctEpochs;
+
+    for ( col = 0; col < EPOCH_COLS; col++ )
+    {
+        vals = pLog->cols + col * EPOCH_BLOCK;
+
+        MinMax( vals, pLog->ctEpochs, &block.min[ col ], &block.max[ col ] );
+        block.colBytes[ col ] = EncodeColumn( vals, pLog->ctEpochs,
+            pLog->enc + block.ctBytes );
+        block.ctBytes += block.colBytes[ col ];
+    }
+
+    BufOutWrite( &pLog->out, &block, sizeof( block ) );
+    BufOutWrite( &pLog->out, pLog->enc, block.ctBytes );
+
+    pLog->ctTotal += pLog->ctEpochs;
+    pLog->ctEpochs = 0;
+}
+
+// Zigzag varints of the differences, returns their size [bytes]
+static DWORD EncodeColumn( const LONGLONG* vals, UINT32 ctVals, BYTE* enc )
+{
+    LONGLONG prev = 0;
+    UINT64 zz;
+    DWORD len = 0;
+    UINT32 i;
+
+    for ( i = 0; i < ctVals; i++ )
+    {
+        zz = ( UINT64 )( vals[ i ] - prev );
+        zz = ( zz << 1 ) ^ ( UINT64 )( ( vals[ i ] - prev ) >> 63 );
+        prev = vals[ i ];
+
+        while ( zz >= 0x80 )
+        {
+            enc[ len++ ] = ( BYTE )( zz | 0x80 );
+            zz >>= 7;
+        }
+
+        enc[ len++ ] = ( BYTE )zz;
+    }
+
+    return len;
+}
+
+static void MinMax( const LONGLONG* vals, UINT32 ctVals, LONGLONG* pMin,
+    LONGLONG* pMax )
+{
+    UINT32 i;
+
+    *pMin = vals[ 0 ];
+    *pMax = vals[ 0 ];
+
+    for ( i = 1; i < ctVals; i++ )
+    {
+        if ( vals[ i ] < *pMin )
+            *pMin = vals[ i ];
+        else if ( vals[ i ] > *pMax )
+            *pMax = vals[ i ];
+    }
+}
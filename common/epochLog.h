@@ -0,0 +1,132 @@
+//
+// epochLog.h -- columnar log of parsed epochs ( <name>.epochs )
+//
+// Every epoch the engine parsed, accepted or not, as integer columns,
+// so a new cutoff or statistic is a pass over a few bytes per epoch
+// instead of a new parse of the nmea text.
+//
+// Epochs are collected in blocks. Each column of a block is stored as
+// the differences between consecutive values (the first one from 0),
+// zigzag mapped ( 0, -1, 1, -2, ... -> 0, 1, 2, 3, ... ) and written
+// as varints (7 bits per byte, low bits first, high bit set if more
+// bytes follow). Neighbouring epochs barely differ, most values take
+// one or two bytes. The block header holds min / max of each column:
+// readers skip blocks (or checks) the min / max already decide.
+//
+// File layout (all fields little endian, no padding):
+//
+//   EpochHeader                    16 bytes
+//   per block, until the end of the file:
+//     EpochBlock                   152 bytes
+//     varints of column 0 ... EPOCH_COLS - 1, colBytes[] each
+//
+// Epoch Log - Interface declarations
+//
+
+#ifndef _EPOCHLOG_H_
+#define _EPOCHLOG_H_
+
+#include "platform.h"
+#include "bufOut.h"
+#include "io.h"
+
+#define     EPOCH_MAGIC     "HPEL"  // File signature
+#define     EPOCH_VERSION   1       // Layout version
+#define     EPOCH_BLOCK     4096    // Max epochs per block
+#define     EPOCH_VARINT    10      // Max bytes of a varint
+
+// Columns
+#define     COL_TIME        0       // [1/100 s] since 2000-01-01 (0: none)
+#define     COL_LAT         1       // Signed lat [ms]
+#define     COL_LON         2       // Signed lon [ms]
+#define     COL_ALT         3       // Alt [dm]
+#define     COL_PDOP        4       // P-DOP [1/100]
+#define     COL_FLAGS       5       // EPOCH_* conditions met
+#define     COL_SATS        6       // Satellites used (GGA)
+#define     EPOCH_COLS      7
+
+// Flags (quality control of hpos but the P-DOP cutoff)
+#define     EPOCH_STATUS    1       // RMC status "A"
+#define     EPOCH_LAT       2       // Lat is ddmm.mmmm
+#define     EPOCH_LON       4       // Lon is dddmm.mmmm
+#define     EPOCH_VALID     ( EPOCH_STATUS | EPOCH_LAT | EPOCH_LON )
+
+typedef struct epochHeader
+{
+    CHAR magic[ 4 ];                // EPOCH_MAGIC
+    UINT16 version;                 // EPOCH_VERSION
+    UINT16 ctCols;                  // EPOCH_COLS
+    UINT32 ctBlock;                 // EPOCH_BLOCK
+    UINT32 reserved;                // 0
+} EpochHeader;
+
+typedef struct epochBlock
+{
+    UINT32 ctEpochs;                // 1 ... ctBlock
+    UINT32 ctBytes;                 // Sum of colBytes
+    LONGLONG min[ EPOCH_COLS ];
+    LONGLONG max[ EPOCH_COLS ];
+    UINT32 colBytes[ EPOCH_COLS ];  // Varints of each column [bytes]
+    UINT32 reserved;                // 0
+} EpochBlock;
+
+// Writer
+typedef struct epochLog
+{
+    BufOut out;
+    LONGLONG* cols;                 // Block being collected, by column
+    BYTE* enc;                      // Encoded block
+    UINT32 ctEpochs;                // Epochs in the block
+    UINT64 ctTotal;                 // Epochs written
+} EpochLog;
+
+// Reader
+typedef struct epochReader
+{
+    IoMap map;
+    size_t pos;                     // Offset of the next block
+    EpochBlock block;               // Current block (copy, unaligned)
+    const BYTE* cols[ EPOCH_COLS ]; // Its varints
+} EpochReader;
+
+/* function prototypes */
+
+/* operation:      create a log file                   */
+/* preconditions:  pLog points to a writer             */
+/*                 fName points to the file's name     */
+/* postconditions: header is written, returns true on  */
+/*                 success, otherwise reports the error*/
+/*                 and returns false                   */
+int OpenEpochLog( EpochLog* pLog, LPCTSTR fName );
+
+/* operation:      add an epoch                        */
+/* preconditions:  vals holds EPOCH_COLS values        */
+/* postconditions: written with its block              */
+void EpochLogAdd( EpochLog* pLog, const LONGLONG* vals );
+
+/* operation:      write the last block, close the file*/
+/* postconditions: returns true if all was written     */
+int CloseEpochLog( EpochLog* pLog );
+
+/* operation:      map a log file                      */
+/* preconditions:  pRd points to a reader              */
+/* postconditions: returns true if the file is a log   */
+/*                 of this layout, otherwise reports   */
+/*                 the error and returns false         */
+int OpenEpochReader( EpochReader* pRd, LPCTSTR fName );
+
+/* operation:      go to the next block                */
+/* postconditions: returns its header, NULL at the end */
+/*                 of the file (or at a broken block)  */
+const EpochBlock* NextEpochBlock( EpochReader* pRd );
+
+/* operation:      decode a column of the current block*/
+/* preconditions:  vals holds ctEpochs values          */
+/* postconditions: vals holds the column, returns false*/
+/*                 if its varints are broken           */
+int ReadEpochColumn( EpochReader* pRd, int col, LONGLONG* vals );
+
+/* operation:      unmap the file                      */
+void CloseEpochReader( EpochReader* pRd );
+
+#endif
@@ -0,0 +1,562 @@
+//
+// fgbOut.c -- FlatGeobuf output of measurement points
+//
+// File layout ( flatgeobuf.org ):
+//
+//   magic bytes                8 bytes
+//   header                     size-prefixed flatbuffer
+//   index                      RTreeNodes() NodeItems, root first
+//   features                   size-prefixed flatbuffers
+//
+// The few tables needed are laid out by hand: vtable first, then the
+// table, then the strings, vectors and subtables it refers to (refs
+// point forward). Alignment is relative to the size prefix.
+//
+// FlatGeobuf Writer - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fgbOut.h"
+#include "bufOut.h"
+#include "packedRTree.h"
+#include "fmtNum.h"
+
+// Field ids ( header.fbs, feature.fbs )
+#define     HDR_NAME        0
+#define     HDR_ENVELOPE    1
+#define     HDR_GEOM_TYPE   2
+#define     HDR_HAS_Z       3
+#define     HDR_COLUMNS     7
+#define     HDR_FEATURES    8
+#define     HDR_NODE_SIZE   9
+#define     HDR_CRS         10
+#define     HDR_FIELDS      11
+
+#define     COL_NAME        0
+#define     COL_TYPE        1
+#define     COL_FIELDS      2
+
+#define     CRS_ORG         0
+#define     CRS_CODE        1
+#define     CRS_FIELDS      2
+
+#define     FEAT_GEOMETRY   0
+#define     FEAT_PROPS      1
+#define     FEAT_FIELDS     2
+
+#define     GEOM_XY         1
+#define     GEOM_Z          2
+#define     GEOM_FIELDS     3
+
+#define     MAX_FIELDS      11
+
+#define     GEOM_POINT      1   // GeometryType
+#define     TYPE_INT        5   // ColumnType
+#define     TYPE_ULONG      8
+#define     TYPE_STRING     11
+#define     TYPE_DATETIME   13
+
+#define     CRS_WGS84       4326
+
+#define     PROP_NAME       0   // Column indices
+#define     PROP_MODIFIED   1
+#define     PROP_SIZE       2
+#define     PROP_FIXES      3
+#define     CT_PROPS        4
+
+#define     NAME_UTF8       ( 3 * MAX_PATH )    // Max name [bytes]
+#define     PROPS_MAX       ( NAME_UTF8 + 64 )  // Max properties [bytes]
+
+// Size-prefixed flatbuffer under construction
+typedef struct fbBuf
+{
+    BYTE* buf;
+    DWORD ct;                           // Used [bytes]
+    DWORD size;                         // Capacity [bytes]
+} FbBuf;
+
+static const struct
+{
+    const CHAR* name;
+    BYTE type;
+} columns[ CT_PROPS ] = {
+    { "name",       TYPE_STRING },
+    { "modified",   TYPE_DATETIME },
+    { "size",       TYPE_ULONG },
+    { "fixes",      TYPE_INT } };
+
+/* protototypes for local functions */
+static int BuildHeader( FbBuf* pFb, const List* plist,
+    const NodeItem* pExtent, UINT64 ctFeatures, WORD nodeSize );
+static int BuildFeature( FbBuf* pFb, const List* plist,
+    const Item* pItem );
+static DWORD PutProp( BYTE* dst, WORD col, const void* val, DWORD len,
+    BOOL prefixLen );
+static DWORD ToUtf8( const TCHAR* txt, size_t len, CHAR* dst,
+    DWORD sizeDst );
+static BYTE* FbAlloc( FbBuf* pFb, DWORD len, DWORD* pPos );
+static int FbPad( FbBuf* pFb, DWORD align, DWORD skew );
+static int FbTable( FbBuf* pFb, int ctFields, const BYTE* sizes,
+    WORD* offs, DWORD* pTab );
+static int FbVector( FbBuf* pFb, const void* data, DWORD ct,
+    DWORD elemSize, DWORD* pPos );
+static int FbString( FbBuf* pFb, const CHAR* str, DWORD len,
+    DWORD* pPos );
+static void FbScalar( FbBuf* pFb, DWORD pos, const void* val,
+    DWORD size );
+static void FbRef( FbBuf* pFb, DWORD pos, DWORD target );
+static void FbFinish( FbBuf* pFb );
+
+/* function definitions */
+int OutputFgb( const List* plist, LPCTSTR fName )
+{
+    BufOut outFgb;
+    FbBuf fb = { 0 };
+    NodeItem extent = { 0 };
+    NodeItem* leaves = NULL;
+    NodeItem* nodes = NULL;
+    UINT32* order = NULL;
+    UINT64 ctNodes = 0;
+    UINT64 offset = 0;
+    size_t ct = plist->iCount;
+    WORD nodeSize = ( ct > 0 ) ? RTREE_NODE_SIZE : 0;
+    int ok = FALSE;
+    size_t i;
+
+    leaves = ( NodeItem* )calloc( ct + 1, sizeof( NodeItem ) );
+    order = ( UINT32* )malloc( ( ct + 1 ) * sizeof( UINT32 ) );
+
+    if ( leaves == NULL || order == NULL )
+        goto noMemory;
+
+    // Points as boxes, offset: item
+    for ( i = 0; i < ct; i++ )
+    {
+        leaves[ i ].minX = leaves[ i ].maxX = plist->items[ i ].lon;
+        leaves[ i ].minY = leaves[ i ].maxY = plist->items[ i ].lat;
+        leaves[ i ].offset = i;
+    }
+
+    RTreeExtent( leaves, ct, &extent );
+
+    if ( ct > 0 && !HilbertSort( leaves, ct, &extent ) )
+        goto noMemory;
+
+    // Features go in Hilbert order, leaves point at them
+    for ( i = 0; i < ct; i++ )
+    {
+        order[ i ] = ( UINT32 )leaves[ i ].offset;
+
+        if ( !BuildFeature( &fb, plist, &plist->items[ order[ i ] ] ) )
+            goto done;
+
+        leaves[ i ].offset = offset;
+        offset += fb.ct;
+    }
+
+    if ( ct > 0 )
+    {
+        nodes = BuildRTree( leaves, ct, nodeSize );
+        if ( nodes == NULL )
+            goto noMemory;
+
+        ctNodes = RTreeNodes( ct, nodeSize );
+    }
+
+    if ( !BuildHeader( &fb, plist, &extent, ct, nodeSize ) )
+        goto done;
+
+    // Output file
+    if ( !OpenBufOut( &outFgb, fName ) )
+        goto done;
+
+    ok = TRUE;
+
+    BufOutWrite( &outFgb, FGB_MAGIC, 8 );
+    BufOutWrite( &outFgb, fb.buf, fb.ct );
+    BufOutWrite( &outFgb, nodes, ( DWORD )( ctNodes * sizeof( NodeItem ) ) );
+
+    for ( i = 0; i < ct && ok; i++ )
+    {
+        ok = BuildFeature( &fb, plist, &plist->items[ order[ i ] ] );
+
+        if ( ok )
+            BufOutWrite( &outFgb, fb.buf, fb.ct );
+    }
+
+    if ( !CloseBufOut( &outFgb ) )
+        ok = FALSE;
+
+    goto done;
+
+noMemory:
+    fwprintf( stderr, TEXT( "No memory available for FlatGeobuf output\n" ) );
+
+done:
+    free( leaves );
+    free( order );
+    free( nodes );
+    free( fb.buf );
+
+    return ok;
+}
+
+
+/* local functions */
+
+static int BuildHeader( FbBuf* pFb, const List* plist,
+    const NodeItem* pExtent, UINT64 ctFeatures, WORD nodeSize )
+{
+    BYTE sizes[ MAX_FIELDS ] = { 0 };
+    WORD offs[ MAX_FIELDS ];
+    WORD offsSub[ MAX_FIELDS ];
+    CHAR name[ NAME_UTF8 ];
+    double envelope[ 4 ];
+    BYTE geomType = GEOM_POINT;
+    BYTE hasZ = TRUE;
+    INT32 crsCode = CRS_WGS84;
+    DWORD tab, sub, vec, pos;
+    DWORD lenName;
+    int i;
+
+    // Size prefix, root
+    pFb->ct = 0;
+    if ( FbAlloc( pFb, 8, NULL ) == NULL )
+        return FALSE;
+
+    sizes[ HDR_NAME ] = 4;
+    sizes[ HDR_ENVELOPE ] = ( ctFeatures > 0 ) ? 4 : 0;
+    sizes[ HDR_GEOM_TYPE ] = 1;
+    sizes[ HDR_HAS_Z ] = 1;
+    sizes[ HDR_COLUMNS ] = 4;
+    sizes[ HDR_FEATURES ] = 8;
+    sizes[ HDR_NODE_SIZE ] = 2;
+    sizes[ HDR_CRS ] = 4;
+
+    if ( !FbTable( pFb, HDR_FIELDS, sizes, offs, &tab ) )
+        return FALSE;
+
+    FbRef( pFb, 4, tab );
+    FbScalar( pFb, tab + offs[ HDR_GEOM_TYPE ], &geomType, 1 );
+    FbScalar( pFb, tab + offs[ HDR_HAS_Z ], &hasZ, 1 );
+    FbScalar( pFb, tab + offs[ HDR_FEATURES ], &ctFeatures, 8 );
+    FbScalar( pFb, tab + offs[ HDR_NODE_SIZE ], &nodeSize, 2 );
+
+    // Dataset name: measurement name
+    lenName = ToUtf8( plist->measureName, wcslen( plist->measureName ),
+        name, sizeof( name ) );
+
+    if ( !FbString( pFb, name, lenName, &pos ) )
+        return FALSE;
+    FbRef( pFb, tab + offs[ HDR_NAME ], pos );
+
+    // Bounds of all points
+    if ( ctFeatures > 0 )
+    {
+        envelope[ 0 ] = pExtent->minX;
+        envelope[ 1 ] = pExtent->minY;
+        envelope[ 2 ] = pExtent->maxX;
+        envelope[ 3 ] = pExtent->maxY;
+
+        if ( !FbVector( pFb, envelope, 4, sizeof( double ), &pos ) )
+            return FALSE;
+        FbRef( pFb, tab + offs[ HDR_ENVELOPE ], pos );
+    }
+
+    // Columns: vector of tables
+    if ( !FbVector( pFb, NULL, CT_PROPS, 4, &vec ) )
+        return FALSE;
+    FbRef( pFb, tab + offs[ HDR_COLUMNS ], vec );
+
+    memset( sizes, 0, sizeof( sizes ) );
+    sizes[ COL_NAME ] = 4;
+    sizes[ COL_TYPE ] = 1;
+
+    for ( i = 0; i < CT_PROPS; i++ )
+    {
+        if ( !FbTable( pFb, COL_FIELDS, sizes, offsSub, &sub ) )
+            return FALSE;
+
+        FbRef( pFb, vec + 4 + 4 * i, sub );
+        FbScalar( pFb, sub + offsSub[ COL_TYPE ], &columns[ i ].type, 1 );
+
+        if ( !FbString( pFb, columns[ i ].name,
+            ( DWORD )strlen( columns[ i ].name ), &pos ) )
+            return FALSE;
+        FbRef( pFb, sub + offsSub[ COL_NAME ], pos );
+    }
+
+    // CRS: EPSG:4326
+    memset( sizes, 0, sizeof( sizes ) );
+    sizes[ CRS_ORG ] = 4;
+    sizes[ CRS_CODE ] = 4;
+
+    if ( !FbTable( pFb, CRS_FIELDS, sizes, offsSub, &sub ) )
+        return FALSE;
+
+    FbRef( pFb, tab + offs[ HDR_CRS ], sub );
+    FbScalar( pFb, sub + offsSub[ CRS_CODE ], &crsCode, 4 );
+
+    if ( !FbString( pFb, "EPSG", 4, &pos ) )
+        return FALSE;
+    FbRef( pFb, sub + offsSub[ CRS_ORG ], pos );
+
+    FbFinish( pFb );
+
+    return TRUE;
+}
+
+static int BuildFeature( FbBuf* pFb, const List* plist,
+    const Item* pItem )
+{
+    BYTE sizes[ MAX_FIELDS ] = { 0 };
+    WORD offs[ MAX_FIELDS ];
+    WORD offsGeom[ MAX_FIELDS ];
+    BYTE props[ PROPS_MAX ];
+    CHAR name[ NAME_UTF8 ];
+    CHAR modified[ FMT_MAX ];
+    double xy[ 2 ];
+    INT32 fixes = pItem->ctMeas;
+    LPCTSTR path = NULL;
+    const TCHAR* ptTchar = NULL;
+    DWORD tab, geom, pos;
+    DWORD ctProps = 0;
+    DWORD len;
+
+    // Point's name: path without extension
+    path = ItemPath( plist, pItem );
+    ptTchar = wcsrchr( path, L'.' );
+    if ( ptTchar == NULL )
+        ptTchar = path + wcslen( path );
+
+    // Properties: column index, value ( strings: length, bytes )
+    len = ToUtf8( path, ptTchar - path, name, sizeof( name ) );
+    ctProps += PutProp( props + ctProps, PROP_NAME, name, len, TRUE );
+
+    len = FmtIsoTime( modified, &pItem->ftLastWriteTime );
+    ctProps += PutProp( props + ctProps, PROP_MODIFIED, modified, len, TRUE );
+
+    ctProps += PutProp( props + ctProps, PROP_SIZE, &pItem->size, 8, FALSE );
+    ctProps += PutProp( props + ctProps, PROP_FIXES, &fixes, 4, FALSE );
+
+    // Size prefix, root
+    pFb->ct = 0;
+    if ( FbAlloc( pFb, 8, NULL ) == NULL )
+        return FALSE;
+
+    sizes[ FEAT_GEOMETRY ] = 4;
+    sizes[ FEAT_PROPS ] = 4;
+
+    if ( !FbTable( pFb, FEAT_FIELDS, sizes, offs, &tab ) )
+        return FALSE;
+    FbRef( pFb, 4, tab );
+
+    // Point geometry (type given by the header)
+    memset( sizes, 0, sizeof( sizes ) );
+    sizes[ GEOM_XY ] = 4;
+    sizes[ GEOM_Z ] = 4;
+
+    if ( !FbTable( pFb, GEOM_FIELDS, sizes, offsGeom, &geom ) )
+        return FALSE;
+    FbRef( pFb, tab + offs[ FEAT_GEOMETRY ], geom );
+
+    xy[ 0 ] = pItem->lon;
+    xy[ 1 ] = pItem->lat;
+
+    if ( !FbVector( pFb, xy, 2, sizeof( double ), &pos ) )
+        return FALSE;
+    FbRef( pFb, geom + offsGeom[ GEOM_XY ], pos );
+
+    if ( !FbVector( pFb, &pItem->alt, 1, sizeof( double ), &pos ) )
+        return FALSE;
+    FbRef( pFb, geom + offsGeom[ GEOM_Z ], pos );
+
+    if ( !FbVector( pFb, props, ctProps, 1, &pos ) )
+        return FALSE;
+    FbRef( pFb, tab + offs[ FEAT_PROPS ], pos );
+
+    FbFinish( pFb );
+
+    return TRUE;
+}
+
+// One property: column index, ( length, ) value
+static DWORD PutProp( BYTE* dst, WORD col, const void* val, DWORD len,
+    BOOL prefixLen )
+{
+    DWORD ct = 0;
+
+    memcpy( dst + ct, &col, 2 );
+    ct += 2;
+
+    if ( prefixLen )
+    {
+        memcpy( dst + ct, &len, 4 );
+        ct += 4;
+    }
+
+    memcpy( dst + ct, val, len );
+
+    return ct + len;
+}
+
+// Not null terminated, 0 on error
+static DWORD ToUtf8( const TCHAR* txt, size_t len, CHAR* dst,
+    DWORD sizeDst )
+{
+    if ( len == 0 )
+        return 0;
+
+    return ( DWORD )WideCharToMultiByte( CP_UTF8, 0, txt, ( int )len,
+        dst, ( int )sizeDst, NULL, NULL );
+}
+
+// Append len zero bytes, NULL if no memory
+static BYTE* FbAlloc( FbBuf* pFb, DWORD len, DWORD* pPos )
+{
+    BYTE* newBuf = NULL;
+    DWORD newSize;
+
+    if ( pFb->ct + len > pFb->size )
+    {
+        newSize = ( pFb->size > 0 ) ? pFb->size : FGB_MIN_BUF;
+        while ( newSize < pFb->ct + len )
+            newSize *= 2;
+
+        newBuf = ( BYTE* )realloc( pFb->buf, newSize );
+        if ( newBuf == NULL )
+        {
+            fwprintf( stderr, TEXT( "No memory available for FlatGeobuf output\n" ) );
+            return NULL;
+        }
+
+        pFb->buf = newBuf;
+        pFb->size = newSize;
+    }
+
+    if ( pPos != NULL )
+        *pPos = pFb->ct;
+
+    memset( pFb->buf + pFb->ct, 0, len );
+    pFb->ct += len;
+
+    return pFb->buf + pFb->ct - len;
+}
+
+// Pad with zeros until ct + skew is a multiple of align
+static int FbPad( FbBuf* pFb, DWORD align, DWORD skew )
+{
+    DWORD pad = ( align - ( pFb->ct + skew ) % align ) % align;
+
+    return pad == 0 || FbAlloc( pFb, pad, NULL ) != NULL;
+}
+
+// vtable and table for the fields with sizes[ id ] > 0
+// offs[ id ] gets the field's offset in the table ( 0: absent )
+static int FbTable( FbBuf* pFb, int ctFields, const BYTE* sizes,
+    WORD* offs, DWORD* pTab )
+{
+    static const BYTE bySize[] = { 8, 4, 2, 1 };
+    BYTE* pt = NULL;
+    DWORD vt;
+    INT32 soff;
+    WORD sizeVt = ( WORD )( 4 + 2 * ctFields );
+    WORD sizeTab = 4;
+    BOOL has8 = FALSE;
+    int i, k;
+
+    // Fields by descending size: no padding inside the table
+    for ( i = 0; i < ctFields; i++ )
+    {
+        offs[ i ] = 0;
+        if ( sizes[ i ] == 8 )
+            has8 = TRUE;
+    }
+
+    for ( k = 0; k < ( int )_countof( bySize ); k++ )
+    {
+        for ( i = 0; i < ctFields; i++ )
+        {
+            if ( sizes[ i ] == bySize[ k ] )
+            {
+                offs[ i ] = sizeTab;
+                sizeTab += sizes[ i ];
+            }
+        }
+    }
+
+    // vtable: its size, table size, field offsets
+    if ( !FbPad( pFb, 2, 0 ) || ( pt = FbAlloc( pFb, sizeVt, &vt ) ) == NULL )
+        return FALSE;
+
+    memcpy( pt, &sizeVt, 2 );
+    memcpy( pt + 2, &sizeTab, 2 );
+    memcpy( pt + 4, offs, 2 * ctFields );
+
+    // Table: offset back to vtable, 8 byte fields aligned
+    if ( !FbPad( pFb, has8 ? 8 : 4, has8 ? 4 : 0 ) ||
+        ( pt = FbAlloc( pFb, sizeTab, pTab ) ) == NULL )
+        return FALSE;
+
+    soff = ( INT32 )( *pTab - vt );
+    memcpy( pt, &soff, 4 );
+
+    return TRUE;
+}
+
+// Count, then elements aligned to their size
+static int FbVector( FbBuf* pFb, const void* data, DWORD ct,
+    DWORD elemSize, DWORD* pPos )
+{
+    BYTE* pt = NULL;
+
+    if ( !FbPad( pFb, ( elemSize > 4 ) ? elemSize : 4, 4 ) ||
+        ( pt = FbAlloc( pFb, 4 + ct * elemSize, pPos ) ) == NULL )
+        return FALSE;
+
+    memcpy( pt, &ct, 4 );
+    if ( data != NULL )
+        memcpy( pt + 4, data, ct * elemSize );
+
+    return TRUE;
+}
+
+// Length, bytes, null
+static int FbString( FbBuf* pFb, const CHAR* str, DWORD len,
+    DWORD* pPos )
+{
+    BYTE* pt = NULL;
+
+    if ( !FbPad( pFb, 4, 0 ) ||
+        ( pt = FbAlloc( pFb, 4 + len + 1, pPos ) ) == NULL )
+        return FALSE;
+
+    memcpy( pt, &len, 4 );
+    memcpy( pt + 4, str, len );
+
+    return TRUE;
+}
+
+static void FbScalar( FbBuf* pFb, DWORD pos, const void* val,
+    DWORD size )
+{
+    memcpy( pFb->buf + pos, val, size );
+}
+
+// Offset from pos forward to target
+static void FbRef( FbBuf* pFb, DWORD pos, DWORD target )
+{
+    UINT32 rel = target - pos;
+
+    memcpy( pFb->buf + pos, &rel, 4 );
+}
+
+// Size prefix: bytes after it
+static void FbFinish( FbBuf* pFb )
+{
+    UINT32 size = pFb->ct - 4;
+
+    memcpy( pFb->buf, &size, 4 );
+}
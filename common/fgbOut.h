@@ -0,0 +1,38 @@
+//
+// fgbOut.h -- FlatGeobuf output of measurement points
+//
+// Writes the items of a list as Point features (lon, lat, alt as z)
+// with their statistics as properties:
+//
+//   name       String      path without extension (as in the kml)
+//   modified   DateTime    last write time, ISO 8601 UTC
+//   size       ULong       file size [bytes]
+//   fixes      Int         accepted fixes
+//
+// Features are stored in Hilbert order behind a packed Hilbert
+// R-tree (see packedRTree.h), so readers can fetch the features of a
+// bounding box without scanning the file. CRS is WGS 84 (EPSG:4326).
+//
+// FlatGeobuf Writer - Interface declarations
+//
+
+#ifndef _FGBOUT_H_
+#define _FGBOUT_H_
+
+#include "platform.h"
+#include "list.h"
+
+#define     FGB_MAGIC       "fgb\x03" "fgb\x00"    // Signature, v3.0
+#define     FGB_MIN_BUF     1024                    // Initial table buffer
+
+/* function prototypes */
+
+/* operation:      write a list as a FlatGeobuf file   */
+/* preconditions:  plist points to an initialized list */
+/*                 fName points to the file's name     */
+/* postconditions: file is created with header, index  */
+/*                 and one feature per item; returns   */
+/*                 false on error (reported)           */
+int OutputFgb( const List* plist, LPCTSTR fName );
+
+#endif
@@ -0,0 +1,251 @@
+//
+// fmtNum.c -- fast numeric text formatting
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "fmtNum.h"
+
+#define     DECS_POW    100000000ULL    // 10 ^ FMT_DECS
+#define     DBL_LIMIT   1e11            // Larger values use sprintf_s
+
+/* protototypes for local functions */
+static int FmtUnsigned( CHAR* dst, unsigned long long val );
+static int FmtFixed( CHAR* dst, int neg, unsigned long long units );
+static int FmtDigits( CHAR* dst, unsigned int val, int width );
+static unsigned long long RoundShift( unsigned long long hi,
+    unsigned long long lo, int shift );
+
+/* function definitions */
+int FmtInt( CHAR* dst, long long val )
+{
+    if ( val < 0 )
+    {
+        dst[ 0 ] = '-';
+        return 1 + FmtUnsigned( dst + 1, 0ULL - ( unsigned long long )val );
+    }
+
+    return FmtUnsigned( dst, ( unsigned long long )val );
+}
+
+int FmtScaled( CHAR* dst, long long val, long long scale )
+{
+    unsigned long long absVal, intPart, rem, frac;
+    int i;
+
+    absVal = ( val < 0 ) ? 0ULL - ( unsigned long long )val :
+        ( unsigned long long )val;
+
+    // Split into integer part and remainder
+    intPart = absVal / scale;
+    rem = absVal % scale;
+
+    // Decimal places of the remainder, one digit at a time
+    // ( rem * 10 ^ FMT_DECS could overflow for large scales )
+    frac = 0;
+    for ( i = 0; i < FMT_DECS; i++ )
+    {
+        rem *= 10;
+        frac = frac * 10 + rem / scale;
+        rem %= scale;
+    }
+
+    // Round to nearest (even)
+    if ( rem * 2 > ( unsigned long long )scale ||
+        ( rem * 2 == ( unsigned long long )scale && ( frac & 1 ) ) )
+        frac++;
+
+    return FmtFixed( dst, val < 0, intPart * DECS_POW + frac );
+}
+
+int FmtDouble( CHAR* dst, double val )
+{
+    unsigned long long bits, mant, units;
+    unsigned long long pLo, pHi, lo, hi;
+    int exp2, neg;
+
+    // Out of range / NaN / Inf (truncated to FMT_MAX)
+    if ( !( val < DBL_LIMIT && val > -DBL_LIMIT ) )
+    {
+        _snprintf_s( dst, FMT_MAX, _TRUNCATE, "%.8f", val );
+        return ( int )strlen( dst );
+    }
+
+    // Decompose: val = mant * 2 ^ exp2
+    memcpy( &bits, &val, sizeof( bits ) );
+    neg = ( int )( bits >> 63 );
+    exp2 = ( int )( ( bits >> 52 ) & 0x7FF );
+    mant = bits & 0xFFFFFFFFFFFFFULL;
+
+    if ( exp2 == 0 )
+        exp2 = 1 - 1075;                // Subnormal
+    else
+    {
+        mant |= 1ULL << 52;             // Implicit bit
+        exp2 -= 1075;
+    }
+
+    if ( exp2 >= 0 )
+    {
+        // Integer value (below DBL_LIMIT, so it fits)
+        units = ( mant << exp2 ) * DECS_POW;
+    }
+    else
+    {
+        // mant * 10 ^ FMT_DECS as 128 bits ( hi : lo )
+        pLo = ( mant & 0xFFFFFFFFULL ) * DECS_POW;
+        pHi = ( mant >> 32 ) * DECS_POW;
+
+        lo = pLo + ( pHi << 32 );
+        hi = ( pHi >> 32 ) + ( lo < pLo ? 1 : 0 );
+
+        // Divide by 2 ^ -exp2, rounding to nearest (even)
+        units = RoundShift( hi, lo, -exp2 );
+    }
+
+    return FmtFixed( dst, neg, units );
+}
+
+int FmtStr( CHAR* dst, const CHAR* src )
+{
+    int len = ( int )strlen( src );
+
+    memcpy( dst, src, len );
+
+    return len;
+}
+
+int FmtIsoTime( CHAR* dst, const FILETIME* pTime )
+{
+    SYSTEMTIME st = { 0 };
+    int len = 0;
+
+    FileTimeToSystemTime( pTime, &st );
+
+    len += FmtDigits( dst + len, st.wYear, 4 );
+    dst[ len++ ] = '-';
+    len += FmtDigits( dst + len, st.wMonth, 2 );
+    dst[ len++ ] = '-';
+    len += FmtDigits( dst + len, st.wDay, 2 );
+    dst[ len++ ] = 'T';
+    len += FmtDigits( dst + len, st.wHour, 2 );
+    dst[ len++ ] = ':';
+    len += FmtDigits( dst + len, st.wMinute, 2 );
+    dst[ len++ ] = ':';
+    len += FmtDigits( dst + len, st.wSecond, 2 );
+    dst[ len++ ] = 'Z';
+
+    return len;
+}
+
+int FmtPad( CHAR* dst, int len, int width )
+{
+    if ( len >= width )
+        return len;
+
+    // Shift text right, fill with blanks
+    memmove( dst + width - len, dst, len );
+    memset( dst, ' ', width - len );
+
+    return width;
+}
+
+
+/* local functions */
+
+// Decimal digits of an unsigned value
+static int FmtUnsigned( CHAR* dst, unsigned long long val )
+{
+    CHAR tmp[ 24 ];
+    int len = 0;
+    int i;
+
+    // Digits in reverse order
+    do
+    {
+        tmp[ len++ ] = ( CHAR )( '0' + val % 10 );
+        val /= 10;
+    } while ( val != 0 );
+
+    for ( i = 0; i < len; i++ )
+        dst[ i ] = tmp[ len - 1 - i ];
+
+    return len;
+}
+
+// Fixed-point output of units [ 10 ^ -FMT_DECS ]
+static int FmtFixed( CHAR* dst, int neg, unsigned long long units )
+{
+    unsigned long long frac = units % DECS_POW;
+    int len = 0;
+    int i;
+
+    if ( neg )
+        dst[ len++ ] = '-';
+
+    len += FmtUnsigned( dst + len, units / DECS_POW );
+
+    dst[ len++ ] = '.';
+
+    for ( i = FMT_DECS - 1; i >= 0; i-- )
+    {
+        dst[ len + i ] = ( CHAR )( '0' + frac % 10 );
+        frac /= 10;
+    }
+
+    return len + FMT_DECS;
+}
+
+// ( hi : lo ) / 2 ^ shift, rounded to nearest, ties to even
+// The result is known to fit in 64 bits
+static unsigned long long RoundShift( unsigned long long hi,
+    unsigned long long lo, int shift )
+{
+    unsigned long long q, half, rest;
+
+    if ( shift >= 128 )
+        return 0;
+
+    if ( shift >= 64 )
+    {
+        // Only hi contributes to the quotient
+        q = ( shift == 64 ) ? hi : hi >> ( shift - 64 );
+
+        if ( shift == 64 )
+        {
+            half = lo >> 63;
+            rest = lo << 1;
+        }
+        else
+        {
+            half = ( hi >> ( shift - 65 ) ) & 1;
+            rest = ( shift == 65 ) ? lo : lo | ( hi << ( 129 - shift ) );
+        }
+    }
+    else
+    {
+        q = ( lo >> shift ) | ( hi << ( 64 - shift ) );
+        half = ( lo >> ( shift - 1 ) ) & 1;
+        rest = ( shift == 1 ) ? 0 : lo << ( 65 - shift );
+    }
+
+    // Round up above half, or on exact half when odd
+    if ( half && ( rest != 0 || ( q & 1 ) ) )
+        q++;
+
+    return q;
+}
+
+// Exactly width digits, zero padded ( "%0<width>u" , val < 10 ^ width )
+static int FmtDigits( CHAR* dst, unsigned int val, int width )
+{
+    int i;
+
+    for ( i = width - 1; i >= 0; i-- )
+    {
+        dst[ i ] = ( CHAR )( '0' + val % 10 );
+        val /= 10;
+    }
+
+    return width;
+}
@@ -0,0 +1,49 @@
+//
+// fmtNum.h -- fast numeric text formatting
+//
+// printf-free replacements for the conversions used in hpos outputs.
+// Results are byte-identical to the printf conversions named below
+// (correctly rounded, round-half-even on exact ties).
+//
+// All functions write into dst (not null terminated) and return the
+// number of chars written. dst must hold at least FMT_MAX chars.
+//
+
+#ifndef _FMTNUM_H_
+#define _FMTNUM_H_
+
+#include "platform.h"
+
+#define     FMT_DECS    8       // Decimal places of fixed-point output
+#define     FMT_MAX     48      // Max chars written by one call
+
+/* operation:      format a signed integer ( "%d" )    */
+int FmtInt( CHAR* dst, long long val );
+
+/* operation:      format val / scale with FMT_DECS    */
+/*                 decimals ( "%.8f" of the quotient ) */
+/* preconditions:  scale > 0, scale < 2 ^ 59          */
+/* postconditions: exact, integer arithmetic only      */
+int FmtScaled( CHAR* dst, long long val, long long scale );
+
+/* operation:      format a double with FMT_DECS       */
+/*                 decimals ( "%.8f" )                 */
+/* postconditions: exact (expands the binary value),   */
+/*                 falls back to the CRT if |val| is   */
+/*                 too large or not a number           */
+int FmtDouble( CHAR* dst, double val );
+
+/* operation:      copy a null terminated string       */
+int FmtStr( CHAR* dst, const CHAR* src );
+
+/* operation:      format a file time as ISO 8601 UTC  */
+/*                 ( "%04d-%02d-%02dT%02d:%02d:%02dZ" )*/
+int FmtIsoTime( CHAR* dst, const FILETIME* pTime );
+
+/* operation:      right-justify the last len chars    */
+/*                 written at dst into width chars     */
+/*                 ( "%<width>..." )                   */
+/* postconditions: returns the new length              */
+int FmtPad( CHAR* dst, int len, int width );
+
+#endif
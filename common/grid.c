@@ -0,0 +1,266 @@
+//
+// grid.c -- grid support functions
+//
+// Grid ADT - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+
+/* protototypes for local functions */
+static unsigned int HashCell( int latCell, int lonCell );
+static int FloorDiv( int val, int div );
+static Cell* SeekSlot( Cell* slots, int ctSlots, int latCell, int lonCell );
+static int GrowGrid( Grid* pgrid );
+static int CmpCellsCt( const void* pA, const void* pB );
+
+/* function definitions */
+int InitializeGrid( Grid* pgrid, int cellSize )
+{
+    pgrid->slots = ( Cell* )calloc( GRID_MIN_SLOTS, sizeof( Cell ) );
+    pgrid->ctSlots = ( pgrid->slots != NULL ) ? GRID_MIN_SLOTS : 0;
+    pgrid->ctTotCells = 0;
+    pgrid->ctTotMeas = 0;
+    pgrid->cellSize = ( cellSize > 0 ) ? cellSize : 1;
+    pgrid->minLatCell = 0;
+    pgrid->maxLatCell = 0;
+    pgrid->minLonCell = 0;
+    pgrid->maxLonCell = 0;
+
+    return ( pgrid->slots != NULL ) ? TRUE : FALSE;
+}
+
+/* returns true if grid is empty */
+int GridIsEmpty( const Grid* pgrid )
+{
+    if ( pgrid->ctTotCells == 0 )
+        return TRUE;
+    else
+        return FALSE;
+}
+
+int AddFixToGrid( int lat, int lon, Grid* pgrid )
+{
+    Cell* pcell;
+    int latCell, lonCell;
+
+    if ( pgrid->slots == NULL )
+        return FALSE;
+
+    // Quantize fix
+    latCell = FloorDiv( lat, pgrid->cellSize );
+    lonCell = FloorDiv( lon, pgrid->cellSize );
+
+    // Look for the cell, or for the free slot where it goes
+    pcell = SeekSlot( pgrid->slots, pgrid->ctSlots, latCell, lonCell );
+
+    if ( pcell->ct == 0 )
+    {
+        // New cell
+        // Keep load factor below 3/4, then look again
+        if ( ( pgrid->ctTotCells + 1 ) * 4 > pgrid->ctSlots * 3 )
+        {
+            if ( !GrowGrid( pgrid ) )
+            {
+                fprintf( stderr, "Couldn't grow grid\n" );
+                return FALSE;
+            }
+
+            pcell = SeekSlot( pgrid->slots, pgrid->ctSlots,
+                latCell, lonCell );
+        }
+
+        pcell->latCell = latCell;
+        pcell->lonCell = lonCell;
+
+        // Update bounding box
+        if ( pgrid->ctTotCells == 0 )
+        {
+            pgrid->minLatCell = pgrid->maxLatCell = latCell;
+            pgrid->minLonCell = pgrid->maxLonCell = lonCell;
+        }
+        else
+        {
+            if ( latCell < pgrid->minLatCell ) pgrid->minLatCell = latCell;
+            if ( latCell > pgrid->maxLatCell ) pgrid->maxLatCell = latCell;
+            if ( lonCell < pgrid->minLonCell ) pgrid->minLonCell = lonCell;
+            if ( lonCell > pgrid->maxLonCell ) pgrid->maxLonCell = lonCell;
+        }
+
+        pgrid->ctTotCells++;
+    }
+
+    // Update cell counters
+    pcell->ct++;
+    pcell->sumLat += lat;
+    pcell->sumLon += lon;
+    pgrid->ctTotMeas++;
+
+    return TRUE;
+}
+
+const Cell* GridModalCell( const Grid* pgrid )
+{
+    const Cell* pmodal = NULL;
+    int i;
+
+    for ( i = 0; i < pgrid->ctSlots; i++ )
+    {
+        if ( pgrid->slots[ i ].ct > 0 &&
+            ( pmodal == NULL || pgrid->slots[ i ].ct > pmodal->ct ) )
+            pmodal = &pgrid->slots[ i ];
+    }
+
+    return pmodal;
+}
+
+int GridTopMean( const Grid* pgrid, int pct,
+    double* pMeanLat, double* pMeanLon )
+{
+    const Cell** sorted;
+    long long sumLat = 0;
+    long long sumLon = 0;
+    long long ct = 0;
+    int ctTop, i, j;
+
+    if ( GridIsEmpty( pgrid ) )
+        return 0;
+
+    // Collect used cells
+    sorted = ( const Cell** )malloc( pgrid->ctTotCells * sizeof( Cell* ) );
+    if ( sorted == NULL )
+        return 0;
+
+    for ( i = 0, j = 0; i < pgrid->ctSlots; i++ )
+    {
+        if ( pgrid->slots[ i ].ct > 0 )
+            sorted[ j++ ] = &pgrid->slots[ i ];
+    }
+
+    // Densest first
+    qsort( sorted, pgrid->ctTotCells, sizeof( Cell* ), CmpCellsCt );
+
+    // Amount of cells in the top pct % (at least one)
+    if ( pct < 1 ) pct = 1;
+    if ( pct > 100 ) pct = 100;
+    ctTop = ( int )( ( ( long long )pgrid->ctTotCells * pct + 99 ) / 100 );
+
+    // Mean of all fixes in the top cells
+    for ( i = 0; i < ctTop; i++ )
+    {
+        sumLat += sorted[ i ]->sumLat;
+        sumLon += sorted[ i ]->sumLon;
+        ct += sorted[ i ]->ct;
+    }
+
+    *pMeanLat = ( double )sumLat / ct;
+    *pMeanLon = ( double )sumLon / ct;
+
+    free( sorted );
+
+    return ctTop;
+}
+
+void TraverseGrid( const Grid* pgrid,
+    void ( *pfun )( const Cell* pcell, void* ctx ), void* ctx )
+{
+    int i;
+
+    for ( i = 0; i < pgrid->ctSlots; i++ )
+    {
+        if ( pgrid->slots[ i ].ct > 0 )
+            ( *pfun )( &pgrid->slots[ i ], ctx );
+    }
+}
+
+void DeleteGrid( Grid* pgrid )
+{
+    free( pgrid->slots );
+
+    pgrid->slots = NULL;
+    pgrid->ctSlots = 0;
+    pgrid->ctTotCells = 0;
+    pgrid->ctTotMeas = 0;
+}
+
+
+/* local functions */
+
+// Mix both cell indices into a well spread hash
+static unsigned int HashCell( int latCell, int lonCell )
+{
+    unsigned int h;
+
+    h = ( unsigned int )latCell * 0x9E3779B1u;
+    h ^= ( unsigned int )lonCell + 0x7F4A7C15u + ( h << 6 ) + ( h >> 2 );
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+
+    return h;
+}
+
+// Integer division rounding towards minus infinity,
+// so that cells keep the same size across the equator / meridian
+static int FloorDiv( int val, int div )
+{
+    int q = val / div;
+
+    if ( ( val % div != 0 ) && ( val < 0 ) )
+        q--;
+
+    return q;
+}
+
+// Returns the slot holding the cell, or the free slot where it goes
+static Cell* SeekSlot( Cell* slots, int ctSlots, int latCell, int lonCell )
+{
+    unsigned int mask = ( unsigned int )ctSlots - 1;
+    unsigned int i = HashCell( latCell, lonCell ) & mask;
+
+    while ( slots[ i ].ct != 0 &&
+        ( slots[ i ].latCell != latCell || slots[ i ].lonCell != lonCell ) )
+        i = ( i + 1 ) & mask;
+
+    return &slots[ i ];
+}
+
+// Double the hash table and re-insert the used cells
+static int GrowGrid( Grid* pgrid )
+{
+    Cell* newSlots;
+    Cell* pcell;
+    int ctNew = pgrid->ctSlots * 2;
+    int i;
+
+    newSlots = ( Cell* )calloc( ctNew, sizeof( Cell ) );
+    if ( newSlots == NULL )
+        return FALSE;
+
+    for ( i = 0; i < pgrid->ctSlots; i++ )
+    {
+        if ( pgrid->slots[ i ].ct > 0 )
+        {
+            pcell = SeekSlot( newSlots, ctNew,
+                pgrid->slots[ i ].latCell, pgrid->slots[ i ].lonCell );
+            *pcell = pgrid->slots[ i ];
+        }
+    }
+
+    free( pgrid->slots );
+    pgrid->slots = newSlots;
+    pgrid->ctSlots = ctNew;
+
+    return TRUE;
+}
+
+// qsort() comparison: higher count first
+static int CmpCellsCt( const void* pA, const void* pB )
+{
+    const Cell* cA = *( const Cell** )pA;
+    const Cell* cB = *( const Cell** )pB;
+
+    return ( cB->ct > cA->ct ) - ( cB->ct < cA->ct );
+}
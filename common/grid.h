@@ -0,0 +1,95 @@
+//
+// grid.h -- sparse 2D histogram of lat/lon fixes
+//
+// Each fix is quantized to a cell of ( cellSize x cellSize ) [ms].
+// Cells are kept in an open-addressing hash table (linear probing),
+// so adding a fix to an already existent cell is an O(1) increment.
+//
+// Grid ADT - Interface declarations
+//
+
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include "platform.h"
+
+#define     GRID_MIN_SLOTS      1024    // Initial table size (power of 2)
+
+typedef struct cell
+{
+    int latCell;            // Lat cell index ( floor( lat / cellSize ) )
+    int lonCell;            // Lon cell index ( floor( lon / cellSize ) )
+    int ct;                 // Count of fixes in this cell (0: free slot)
+    long long sumLat;       // Sum of lat of fixes in this cell [ms]
+    long long sumLon;       // Sum of lon of fixes in this cell [ms]
+} Cell;
+
+typedef struct grid
+{
+    Cell* slots;            // Hash table
+    int ctSlots;            // Size of hash table (power of 2)
+    int ctTotCells;         // Number of used cells
+    int ctTotMeas;          // Total fixes added
+    int cellSize;           // Cell size [ms]
+    int minLatCell;         // Bounding box of used cells
+    int maxLatCell;
+    int minLonCell;
+    int maxLonCell;
+} Grid;
+
+/* function prototypes */
+
+/* operation:      initialize a grid to empty          */
+/* preconditions:  pgrid points to a grid              */
+/*                 cellSize is the cell size [ms] > 0  */
+/* postconditions: the grid is initialized to empty,   */
+/*                 returns false if no memory          */
+int InitializeGrid( Grid* pgrid, int cellSize );
+
+/* operation:      determine if grid is empty          */
+/* preconditions:  pgrid points to a grid              */
+/* postconditions: function returns true if grid is    */
+/*                 empty and returns false otherwise   */
+int GridIsEmpty( const Grid* pgrid );
+
+/* operation:      add a fix to the grid               */
+/* preconditions:  pgrid points to an initialized grid */
+/*                 lat, lon are the fix coords [ms]    */
+/* postconditions: the count of the fix's cell is      */
+/*                 incremented (cell created if new),  */
+/*                 returns false if no memory          */
+int AddFixToGrid( int lat, int lon, Grid* pgrid );
+
+/* operation:      find the cell with the most fixes   */
+/* preconditions:  pgrid points to a non-empty grid    */
+/* postconditions: function returns address of the     */
+/*                 modal cell                          */
+const Cell* GridModalCell( const Grid* pgrid );
+
+/* operation:      mean position of the densest cells  */
+/* preconditions:  pgrid points to a non-empty grid    */
+/*                 pct is a percentage ( 1 .. 100 )    */
+/* postconditions: pMeanLat, pMeanLon receive the mean */
+/*                 of the fixes in the top pct % cells */
+/*                 (by count) [ms], function returns   */
+/*                 the number of cells used, 0 on error*/
+int GridTopMean( const Grid* pgrid, int pct,
+    double* pMeanLat, double* pMeanLon );
+
+/* operation:      apply a function to each used cell  */
+/* preconditions:  pgrid points to a grid              */
+/*                 pfun points to a function that takes*/
+/*                 a Cell argument and has no return   */
+/*                 value                               */
+/* postcondition:  the function pointed to by pfun is  */
+/*                 executed once for each used cell    */
+/*                 (in no particular order)            */
+void TraverseGrid( const Grid* pgrid,
+    void ( *pfun )( const Cell* pcell, void* ctx ), void* ctx );
+
+/* operation:      delete everything from a grid       */
+/* preconditions:  pgrid points to an initialized grid */
+/* postconditions: grid is empty, memory is freed      */
+void DeleteGrid( Grid* pgrid );
+
+#endif
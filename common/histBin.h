@@ -0,0 +1,48 @@
+//
+// histBin.h -- columnar binary histograms ( <name>.hist )
+//
+// Per-value counts of the hpos trees (Lon, Lat, Alt, P-DOP), written
+// as fixed-layout columns, so tools can map them without parsing.
+//
+// File layout (all fields little endian, no padding):
+//
+//   HistHeader                     16 bytes
+//   HistSection[ ctSections ]      32 bytes each
+//   per section, at offset:
+//     int32  intVal[ ctVals ]      ascending
+//     uint32 ct[ ctVals ]          count of fixes per intVal
+//
+// Value in end units [deg] or [m] is intVal / scale.
+// Weighted total of a section is sum( intVal * ct ) / ( ctTot * scale ),
+// stored in wtTotVal as computed by hpos.
+//
+
+#ifndef _HISTBIN_H_
+#define _HISTBIN_H_
+
+#include "platform.h"
+
+#define     HIST_MAGIC      "HPHB"  // File signature
+#define     HIST_VERSION    1       // Layout version
+#define     HIST_SECTIONS   4       // Lon, Lat, Alt, P-DOP
+
+typedef struct histHeader
+{
+    CHAR magic[ 4 ];        // HIST_MAGIC
+    UINT16 version;         // HIST_VERSION
+    UINT16 ctSections;      // Number of sections following
+    UINT32 ctMeas;          // Accepted fixes
+    UINT32 reserved;        // 0
+} HistHeader;
+
+typedef struct histSection
+{
+    CHAR tag[ 4 ];          // "LON", "LAT", "ALT", "PDOP" (zero padded)
+    INT32 scale;            // intVal units per end unit
+    UINT32 ctVals;          // Distinct values (length of both columns)
+    UINT32 ctTot;           // Sum of ct column
+    double wtTotVal;        // Weighted total [deg], [m] or [org]
+    UINT64 offset;          // File offset of intVal column
+} HistSection;
+
+#endif
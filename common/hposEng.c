@@ -0,0 +1,825 @@
+//
+// hposEng.c -- hpos engine: nmea parsing and aggregation
+//
+// hpos Engine - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <wchar.h>
+#include "hposEng.h"
+#include "hposStats.h"
+#include "probes.h"
+#include "nmeaFields.h"
+#include "ring.h"
+#include "io.h"
+
+#define     LINEIN      128
+
+// Text between chunks: line being collected, fix being assembled
+typedef struct hposScan
+{
+    const HposOpts* pOpts;      // Extras of the run (never NULL)
+    char inputLine[ LINEIN ];
+    size_t len;
+    HposFix curFix;
+} HposScan;
+
+// Chunk of the file (reader to parser)
+typedef struct hposChunk
+{
+    DWORD len;
+    char data[ HPOS_CHUNK ];
+} HposChunk;
+
+// Fields of the RMC message not kept in the fix
+typedef struct rmcFields
+{
+    char time[ HPOS_VALIN ];    // hhmmss.ss (epoch log only)
+    char status[ HPOS_VALIN ];
+    char date[ HPOS_VALIN ];    // ddmmyy (epoch log only)
+} RmcFields;
+
+// Stages of HposProcFilePiped()
+typedef struct hposPipe
+{
+    IoFile hFile;
+    const HposOpts* pOpts;
+    Ring chunks;                // Reader to parser
+    Ring fixes;                 // Parser to caller
+    HposResult* pRes;
+    BOOL storeFixes;            // Caller takes fixes
+    BOOL failed;                // Reading failed
+} HposPipe;
+
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+PROBE_SEMAPHORE( epoch_reject );
+
+// No extras
+static const HposOpts optsNone = { NULL, NULL, NULL };
+
+// Fields taken from each message: X( field No., member )
+#define     GGA_FIELDS( X ) \
+    X( 2, lat ) \
+    X( 3, hemiNS ) \
+    X( 4, lon ) \
+    X( 5, hemiEW ) \
+    X( 7, sats ) \
+    X( 9, alt )
+
+#define     GSA_FIELDS( X ) \
+    X( 15, pdop )
+
+#define     RMC_FIELDS( X ) \
+    X( 2, status )
+
+#define     RMC_LOG_FIELDS( X ) \
+    X( 1, time ) \
+    X( 2, status ) \
+    X( 9, date )
+
+/* protototypes for local functions */
+static void ScanText( HposScan* pScan, const char* data, size_t ctData,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx );
+static void ScanLine( HposScan* pScan, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx );
+static unsigned __stdcall PipeReader( void* pArg );
+static unsigned __stdcall PipeParser( void* pArg );
+static void PushFix( const HposFix* pFix, void* ctx );
+static void ProcLine( char* inputLine, HposFix* pFix,
+    const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx );
+static void MeanResult( HposResult* pRes );
+static BOOL ParseRMC( const char* inputLine, HposFix* pFix,
+    const HposOpts* pOpts );
+static void SetIntVals( HposFix* pFix );
+static void LogEpoch( EpochLog* pLog, HposFix* pFix,
+    const RmcFields* pRmc );
+static void SweepFix( HposSweep* pSweep, const HposFix* pFix );
+static LONGLONG EpochTime( const char* date, const char* time );
+static int Digits( const char* str, int ctDigits );
+static void AddFix( HposFix* pFix, HposResult* pRes );
+static int RejectReasons( const HposFix* pFix, const char* status );
+#ifdef HPOS_STATS
+static void CountRejects( HposStats* pStats, int reasons );
+#endif
+
+// Field extractors ( static void ExtractGGA( const char*, HposFix* ), ...)
+NMEA_EXTRACTOR( ExtractGGA, HposFix, GGA_FIELDS )
+NMEA_EXTRACTOR( ExtractGSA, HposFix, GSA_FIELDS )
+NMEA_EXTRACTOR( ExtractRMC, RmcFields, RMC_FIELDS )
+NMEA_EXTRACTOR( ExtractRMCLog, RmcFields, RMC_LOG_FIELDS )
+
+/* function definitions */
+BOOL HposProcFile( LPCTSTR fName, const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx )
+{
+    IoMap map;
+
+    memset( pRes, 0, sizeof( HposResult ) );
+
+    if ( pOpts == NULL )
+        pOpts = &optsNone;
+
+    // Map nmea file, no copy through stdio
+    STATS_MARK( pOpts->pStats );
+    if ( !IoMapFile( fName, &map ) )
+    {
+        ReportError( TEXT( "\nOpening source file failed" ), 0, TRUE );
+        return FALSE;
+    }
+    STATS_LAP( pOpts->pStats, STAGE_READ );
+
+    HposProcBuffer( map.data, map.size, pOpts, pRes, pfun, ctx );
+
+    IoUnmapFile( &map );
+    STATS_LAP( pOpts->pStats, STAGE_READ );
+
+    return TRUE;
+}
+
+BOOL HposProcBuffer( const char* data, size_t ctData, const HposOpts* pOpts,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx )
+{
+    HposScan scan = { 0 };
+
+    memset( pRes, 0, sizeof( HposResult ) );
+
+    scan.pOpts = ( pOpts != NULL ) ? pOpts : &optsNone;
+
+    STATS_ADD( scan.pOpts->pStats, ctBytes, ctData );
+    STATS_MARK( scan.pOpts->pStats );
+
+    ScanText( &scan, data, ctData, pRes, pfun, ctx );
+
+    // Last line without white space after it
+    if ( scan.len > 0 )
+        ScanLine( &scan, pRes, pfun, ctx );
+
+    MeanResult( pRes );
+
+    return TRUE;
+}
+
+BOOL HposProcFilePiped( LPCTSTR fName, const HposOpts* pOpts,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx )
+{
+    HposPipe pipe;
+    HANDLE hReader, hParser;
+    const HposFix* pFix;
+    UINT64 size = 0;
+
+    if ( pOpts == NULL )
+        pOpts = &optsNone;
+
+    // Stage timing (laps) is for one thread
+#ifdef HPOS_STATS
+    if ( pOpts->pStats != NULL )
+        return HposProcFile( fName, pOpts, pRes, pfun, ctx );
+#endif
+
+    memset( &pipe, 0, sizeof( HposPipe ) );
+
+    pipe.hFile = IoOpenFile( fName );
+    if ( pipe.hFile == IO_NO_FILE )
+    {
+        ReportError( TEXT( "\nOpening source file failed" ), 0, TRUE );
+        return FALSE;
+    }
+
+    // Small files: threads cost more than they save
+    if ( !IoFileSize( pipe.hFile, &size ) || size <= HPOS_CHUNK )
+    {
+        IoCloseFile( pipe.hFile );
+        return HposProcFile( fName, pOpts, pRes, pfun, ctx );
+    }
+
+    if ( !InitializeRing( &pipe.chunks, sizeof( HposChunk ), HPOS_CHUNKS,
+        1 ) )
+    {
+        IoCloseFile( pipe.hFile );
+        return HposProcFile( fName, pOpts, pRes, pfun, ctx );
+    }
+
+    if ( !InitializeRing( &pipe.fixes, sizeof( HposFix ), HPOS_FIXES,
+        HPOS_FIX_BATCH ) )
+    {
+        DeleteRing( &pipe.chunks );
+        IoCloseFile( pipe.hFile );
+        return HposProcFile( fName, pOpts, pRes, pfun, ctx );
+    }
+
+    pipe.pOpts = pOpts;
+    pipe.pRes = pRes;
+    pipe.storeFixes = ( pfun != NULL );
+
+    // Reader and parser
+    hReader = ( HANDLE )_beginthreadex( NULL, 0, PipeReader, &pipe, 0,
+        NULL );
+    hParser = ( hReader != 0 ) ? ( HANDLE )_beginthreadex( NULL, 0,
+        PipeParser, &pipe, 0, NULL ) : 0;
+
+    if ( hParser == 0 )
+    {
+        // Reader alone: take its chunks, parse here
+        if ( hReader != 0 )
+        {
+            while ( RingPeek( &pipe.chunks ) != NULL )
+                RingRelease( &pipe.chunks );
+
+            WaitForSingleObject( hReader, INFINITE );
+            CloseHandle( hReader );
+        }
+
+        DeleteRing( &pipe.chunks );
+        DeleteRing( &pipe.fixes );
+        IoCloseFile( pipe.hFile );
+        return HposProcFile( fName, pOpts, pRes, pfun, ctx );
+    }
+
+    // Store fixes here, in file order
+    while ( ( pFix = ( const HposFix* )RingPeek( &pipe.fixes ) ) != NULL )
+    {
+        ( *pfun )( pFix, ctx );
+        RingRelease( &pipe.fixes );
+    }
+
+    WaitForSingleObject( hParser, INFINITE );
+    WaitForSingleObject( hReader, INFINITE );
+    CloseHandle( hParser );
+    CloseHandle( hReader );
+
+    DeleteRing( &pipe.chunks );
+    DeleteRing( &pipe.fixes );
+    IoCloseFile( pipe.hFile );
+
+    if ( pipe.failed )
+    {
+        ReportError( TEXT( "\nReading source file failed" ), 0, TRUE );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL HposProcEpochLog( LPCTSTR fName, int pdopCutoff,
+    const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx )
+{
+    static const int needed[] = { COL_PDOP, COL_FLAGS, COL_LAT, COL_LON,
+        COL_ALT };
+    HposSweep* pSweep = ( pOpts != NULL ) ? pOpts->pSweep : NULL;
+    EpochReader rd;
+    const EpochBlock* pBlock;
+    LONGLONG* cols;
+    const LONGLONG *lat, *lon, *alt, *pdop, *flags;
+    HposFix fix = { 0 };
+    BOOL allPass, broken = FALSE;
+    UINT32 i;
+    int col;
+
+    memset( pRes, 0, sizeof( HposResult ) );
+
+    if ( !OpenEpochReader( &rd, fName ) )
+        return FALSE;
+
+    cols = ( LONGLONG* )malloc( sizeof( LONGLONG ) * EPOCH_COLS *
+        EPOCH_BLOCK );
+    if ( cols == NULL )
+    {
+        ReportError( TEXT( "\nNo memory available for epoch log" ), 0,
+            FALSE );
+        CloseEpochReader( &rd );
+        return FALSE;
+    }
+
+    lat = cols + COL_LAT * EPOCH_BLOCK;
+    lon = cols + COL_LON * EPOCH_BLOCK;
+    alt = cols + COL_ALT * EPOCH_BLOCK;
+    pdop = cols + COL_PDOP * EPOCH_BLOCK;
+    flags = cols + COL_FLAGS * EPOCH_BLOCK;
+
+    while ( !broken && ( pBlock = NextEpochBlock( &rd ) ) != NULL )
+    {
+        // Min / max decide: no epoch passes (a sweep takes all P-DOP)
+        if ( pBlock->max[ COL_FLAGS ] != EPOCH_VALID ||
+            ( pSweep == NULL && pBlock->min[ COL_PDOP ] > pdopCutoff ) )
+            continue;
+
+        // Columns of the quality control and the sums only
+        for ( col = 0; col < ( int )_countof( needed ); col++ )
+        {
+            if ( !ReadEpochColumn( &rd, needed[ col ],
+                cols + needed[ col ] * EPOCH_BLOCK ) )
+                broken = TRUE;
+        }
+
+        if ( broken )
+            break;
+
+        // Min / max decide: all epochs pass
+        allPass = pBlock->max[ COL_PDOP ] <= pdopCutoff &&
+            pBlock->min[ COL_FLAGS ] == EPOCH_VALID;
+
+        for ( i = 0; i < pBlock->ctEpochs; i++ )
+        {
+            if ( !allPass && flags[ i ] != EPOCH_VALID )
+                continue;
+
+            fix.latInt = ( int )lat[ i ];
+            fix.lonInt = ( int )lon[ i ];
+            fix.altInt = ( int )alt[ i ];
+            fix.pdopInt = ( int )pdop[ i ];
+
+            if ( pSweep != NULL )
+                SweepFix( pSweep, &fix );
+
+            if ( !allPass && pdop[ i ] > pdopCutoff )
+                continue;
+
+            AddFix( &fix, pRes );
+
+            if ( pfun != NULL )
+                ( *pfun )( &fix, ctx );
+        }
+    }
+
+    // Broken blocks end the reading early
+    if ( broken || rd.pos != rd.map.size )
+        ReportError( TEXT( "\nEpoch log is broken, read up to the error" ),
+            0, FALSE );
+
+    free( cols );
+    CloseEpochReader( &rd );
+
+    MeanResult( pRes );
+
+    return TRUE;
+}
+
+int HposLatToInt( const char* hemis, const char* valStr )
+{
+    char tmpStr[ HPOS_VALIN ] = { 0 };
+    int intVal = 0;
+
+    // Degs
+    strncpy_s( tmpStr, _countof( tmpStr ), valStr, 2 );
+    intVal = atoi( tmpStr ) * 3600000;
+
+    // Mins
+    memset( tmpStr, 0, _countof( tmpStr ) );
+    strncpy_s( tmpStr, _countof( tmpStr ), valStr + 2, 2 );
+    intVal += atoi( tmpStr ) * 60000;
+
+    // Fractions of mins
+    intVal += atoi( valStr + 5 ) * 6;
+
+    // Sign
+    if ( strstr( hemis, "S" ) )
+        intVal *= ( -1 );
+
+    return intVal;
+}
+
+int HposLonToInt( const char* hemis, const char* valStr )
+{
+    char tmpStr[ HPOS_VALIN ] = { 0 };
+    int intVal = 0;
+
+    // Degs
+    strncpy_s( tmpStr, _countof( tmpStr ), valStr, 3 );
+    intVal = atoi( tmpStr ) * 3600000;
+
+    // Mins
+    memset( tmpStr, 0, _countof( tmpStr ) );
+    strncpy_s( tmpStr, _countof( tmpStr ), valStr + 3, 2 );
+    intVal += atoi( tmpStr ) * 60000;
+
+    // Fractions of mins
+    intVal += atoi( valStr + 6 ) * 6;
+
+    // Sign
+    if ( strstr( hemis, "W" ) )
+        intVal *= ( -1 );
+
+    return intVal;
+}
+
+int HposAltToInt( const char* valStr )
+{
+    const char* chPt = NULL;
+    int intVal = 0;
+
+    // Metres -> decimetres
+    intVal = atoi( valStr ) * 10;
+
+    // Decimetres
+    chPt = strchr( valStr, '.' );
+    if ( chPt )
+        intVal += ( valStr[ 0 ] == '-' ? (-1) : 1 ) * atoi( chPt + 1 );
+
+    return intVal;
+}
+
+int HposPdopToInt( const char* valStr )
+{
+    const char* chPt = NULL;
+    int intVal = 0;
+
+    // No fix, truncated sentence: never accepted
+    if ( strpbrk( valStr, "0123456789" ) == NULL )
+        return HPOS_PDOP_NONE;
+
+    // Int val
+    intVal = atoi( valStr ) * 100;
+
+    // Decimal places
+    chPt = strchr( valStr, '.' );
+    if ( chPt )
+        intVal += ( valStr[ 0 ] == '-' ? (-1) : 1 ) * atoi( chPt + 1 );
+
+    return intVal;
+}
+
+
+/* local functions */
+
+// Same lines as "%127s" fetches from a file, the last line may be
+// continued by the next text
+static void ScanText( HposScan* pScan, const char* data, size_t ctData,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx )
+{
+    const char* pCh;
+    const char* pEnd = data + ctData;
+
+    for ( pCh = data; pCh < pEnd; pCh++ )
+    {
+        if ( isspace( ( unsigned char )*pCh ) )
+        {
+            if ( pScan->len > 0 )
+                ScanLine( pScan, pRes, pfun, ctx );
+
+            continue;
+        }
+
+        pScan->inputLine[ pScan->len++ ] = *pCh;
+
+        if ( pScan->len == LINEIN - 1 )
+            ScanLine( pScan, pRes, pfun, ctx );
+    }
+}
+
+// Process the line collected
+static void ScanLine( HposScan* pScan, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx )
+{
+    STATS_COUNT( pScan->pOpts->pStats, ctLines );
+    STATS_LAP( pScan->pOpts->pStats, STAGE_READ );
+
+    ProcLine( pScan->inputLine, &pScan->curFix, pScan->pOpts, pRes, pfun,
+        ctx );
+
+    // Reset input line buffer
+    memset( pScan->inputLine, 0, _countof( pScan->inputLine ) );
+    pScan->len = 0;
+}
+
+// Fill chunks until the end of the file (reader thread)
+static unsigned __stdcall PipeReader( void* pArg )
+{
+    HposPipe* pPipe = ( HposPipe* )pArg;
+    HposChunk* pChunk;
+
+    for ( ;; )
+    {
+        pChunk = ( HposChunk* )RingReserve( &pPipe->chunks );
+
+        if ( !IoRead( pPipe->hFile, pChunk->data, HPOS_CHUNK,
+            &pChunk->len ) )
+        {
+            pPipe->failed = TRUE;
+            break;
+        }
+
+        if ( pChunk->len == 0 )
+            break;
+
+        RingCommit( &pPipe->chunks );
+    }
+
+    RingClose( &pPipe->chunks );
+
+    return 0;
+}
+
+// Parse chunks, pass accepted fixes on (parser thread)
+static unsigned __stdcall PipeParser( void* pArg )
+{
+    HposPipe* pPipe = ( HposPipe* )pArg;
+    HposScan scan = { 0 };
+    const HposChunk* pChunk;
+    void ( *pfun )( const HposFix* pFix, void* ctx );
+
+    memset( pPipe->pRes, 0, sizeof( HposResult ) );
+    scan.pOpts = pPipe->pOpts;
+    pfun = pPipe->storeFixes ? PushFix : NULL;
+
+    while ( ( pChunk = ( const HposChunk* )RingPeek( &pPipe->chunks ) ) !=
+        NULL )
+    {
+        ScanText( &scan, pChunk->data, pChunk->len, pPipe->pRes, pfun,
+            &pPipe->fixes );
+        RingRelease( &pPipe->chunks );
+    }
+
+    if ( scan.len > 0 )
+        ScanLine( &scan, pPipe->pRes, pfun, &pPipe->fixes );
+
+    MeanResult( pPipe->pRes );
+    RingClose( &pPipe->fixes );
+
+    return 0;
+}
+
+// Copy of an accepted fix into the ring to the caller
+static void PushFix( const HposFix* pFix, void* ctx )
+{
+    Ring* pRing = ( Ring* )ctx;
+
+    memcpy( RingReserve( pRing ), pFix, sizeof( HposFix ) );
+    RingCommit( pRing );
+}
+
+// Dispatch one line on its message type
+static void ProcLine( char* inputLine, HposFix* pFix,
+    const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx )
+{
+    if ( strstr( inputLine, "$GPGGA" ) )        // Catch 'GGA' messages
+    {
+        ExtractGGA( inputLine, pFix );
+        STATS_COUNT( pOpts->pStats, ctSents[ SENT_GGA ] );
+        STATS_LAP( pOpts->pStats, STAGE_TOKENIZE );
+    }
+    else if ( strstr( inputLine, "$GPGSA" ) )   // Catch 'GSA' messages
+    {
+        ExtractGSA( inputLine, pFix );
+        STATS_COUNT( pOpts->pStats, ctSents[ SENT_GSA ] );
+        STATS_LAP( pOpts->pStats, STAGE_TOKENIZE );
+    }
+    else if ( strstr( inputLine, "$GPRMC" ) )   // Catch 'RMC' messages
+    {
+        STATS_COUNT( pOpts->pStats, ctSents[ SENT_RMC ] );
+
+        // The RMC message is the last message received
+        // for each point: validate and store it
+        if ( ParseRMC( inputLine, pFix, pOpts ) )
+        {
+            AddFix( pFix, pRes );
+            STATS_COUNT( pOpts->pStats, ctAccepted );
+            STATS_LAP( pOpts->pStats, STAGE_DECODE );
+
+            if ( pfun != NULL )
+            {
+                ( *pfun )( pFix, ctx );
+                STATS_LAP( pOpts->pStats, STAGE_INSERT );
+            }
+        }
+
+        // Reset result strings
+        memset( pFix, 0, sizeof( HposFix ) );
+        STATS_LAP( pOpts->pStats, STAGE_DECODE );
+    }
+    else
+    {
+        STATS_COUNT( pOpts->pStats, ctSents[ SENT_OTHER ] );
+        STATS_LAP( pOpts->pStats, STAGE_TOKENIZE );
+    }
+}
+
+// Means from the integer sums
+static void MeanResult( HposResult* pRes )
+{
+    if ( pRes->ctMeas > 0 )
+    {
+        pRes->lon = ( double )pRes->sumLon /
+            ( ( double )pRes->ctMeas * HPOS_SCALE_DEG );
+        pRes->lat = ( double )pRes->sumLat /
+            ( ( double )pRes->ctMeas * HPOS_SCALE_DEG );
+        pRes->alt = ( double )pRes->sumAlt /
+            ( ( double )pRes->ctMeas * HPOS_SCALE_ALT );
+    }
+}
+
+// Status of the current point - Quality control
+// Returns true if the point is valid (int vals set up)
+static BOOL ParseRMC( const char* inputLine, HposFix* pFix,
+    const HposOpts* pOpts )
+{
+    RmcFields rmc = { 0 };
+    const char* status = rmc.status;
+    BOOL intVals = FALSE;
+
+    // Time and date for the epoch log only
+    if ( pOpts->pEpochLog != NULL )
+        ExtractRMCLog( inputLine, &rmc );
+    else
+        ExtractRMC( inputLine, &rmc );
+
+    STATS_LAP( pOpts->pStats, STAGE_TOKENIZE );
+
+    // Get PDOP int val
+    pFix->pdopInt = HposPdopToInt( pFix->pdop );
+
+    // Every epoch goes to the log (int vals set up)
+    if ( pOpts->pEpochLog != NULL )
+    {
+        LogEpoch( pOpts->pEpochLog, pFix, &rmc );
+        intVals = TRUE;
+    }
+
+    // All cutoffs: the other conditions only
+    if ( pOpts->pSweep != NULL &&
+        ( RejectReasons( pFix, status ) & ~( 1 << REJ_PDOP ) ) == 0 )
+    {
+        if ( !intVals )
+            SetIntVals( pFix );
+
+        SweepFix( pOpts->pSweep, pFix );
+        intVals = TRUE;
+    }
+
+    // Assess all conditions
+    if ( !( ( pFix->pdopInt <= HPOS_PDOP_CUTOFF ) &&
+        ( strlen( status ) == 1 ) && ( strstr( status, "A" ) ) &&
+        ( strlen( pFix->lat ) == 9 ) && ( strlen( pFix->lon ) == 10 ) ) )
+    {
+#ifdef HPOS_STATS
+        if ( pOpts->pStats != NULL )
+            CountRejects( pOpts->pStats, RejectReasons( pFix, status ) );
+#endif
+        if ( PROBE_ENABLED( epoch_reject ) )
+            PROBE_SEM2( epoch_reject, pFix->pdopInt,
+                RejectReasons( pFix, status ) );
+
+        return FALSE;
+    }
+
+    // Set up int vals (unless done above)
+    if ( !intVals )
+        SetIntVals( pFix );
+
+    PROBE3( epoch_accept, pFix->latInt, pFix->lonInt, pFix->pdopInt );
+
+    return TRUE;
+}
+
+// Int vals of the current point (but P-DOP)
+static void SetIntVals( HposFix* pFix )
+{
+    pFix->latInt = HposLatToInt( pFix->hemiNS, pFix->lat );
+    pFix->lonInt = HposLonToInt( pFix->hemiEW, pFix->lon );
+    pFix->altInt = HposAltToInt( pFix->alt );
+}
+
+// Int vals and conditions met of the current point
+static void LogEpoch( EpochLog* pLog, HposFix* pFix,
+    const RmcFields* pRmc )
+{
+    LONGLONG vals[ EPOCH_COLS ];
+    int flags = 0;
+
+    SetIntVals( pFix );
+
+    if ( strcmp( pRmc->status, "A" ) == 0 )
+        flags |= EPOCH_STATUS;
+
+    if ( strlen( pFix->lat ) == 9 )
+        flags |= EPOCH_LAT;
+
+    if ( strlen( pFix->lon ) == 10 )
+        flags |= EPOCH_LON;
+
+    vals[ COL_TIME ] = EpochTime( pRmc->date, pRmc->time );
+    vals[ COL_LAT ] = pFix->latInt;
+    vals[ COL_LON ] = pFix->lonInt;
+    vals[ COL_ALT ] = pFix->altInt;
+    vals[ COL_PDOP ] = pFix->pdopInt;
+    vals[ COL_FLAGS ] = flags;
+    vals[ COL_SATS ] = atoi( pFix->sats );
+
+    EpochLogAdd( pLog, vals );
+}
+
+// RMC date ( ddmmyy ) and time ( hhmmss.ss ) [1/100 s] since
+// 2000-01-01, 0 if either is missing
+static LONGLONG EpochTime( const char* date, const char* time )
+{
+    static const int daysBefore[ 12 ] =
+        { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    int day, month, year, hour, min, sec, cs = 0;
+    LONGLONG days;
+
+    day = Digits( date, 2 );
+    month = Digits( date + 2, 2 );
+    year = Digits( date + 4, 2 );
+    hour = Digits( time, 2 );
+    min = Digits( time + 2, 2 );
+    sec = Digits( time + 4, 2 );
+
+    if ( day < 1 || month < 1 || month > 12 || year < 0 || hour < 0 ||
+        min < 0 || sec < 0 )
+        return 0;
+
+    // Hundredths, if any
+    if ( time[ 6 ] == '.' && Digits( time + 7, 2 ) >= 0 )
+        cs = Digits( time + 7, 2 );
+
+    // Leap years 2000 ... 2099
+    days = year * 365 + ( year + 3 ) / 4 + daysBefore[ month - 1 ] +
+        day - 1 + ( ( month > 2 && year % 4 == 0 ) ? 1 : 0 );
+
+    return ( ( days * 24 + hour ) * 60 + min ) * 6000 + sec * 100 + cs;
+}
+
+// Value of ctDigits decimal digits, -1 if str has fewer
+static int Digits( const char* str, int ctDigits )
+{
+    int val = 0;
+    int i;
+
+    for ( i = 0; i < ctDigits; i++ )
+    {
+        if ( !isdigit( ( unsigned char )str[ i ] ) )
+            return -1;
+
+        val = val * 10 + ( str[ i ] - '0' );
+    }
+
+    return val;
+}
+
+// Sums of the point's P-DOP value (none over the last cutoff)
+static void SweepFix( HposSweep* pSweep, const HposFix* pFix )
+{
+    int i = pFix->pdopInt < 0 ? 0 : pFix->pdopInt;
+
+    if ( i > HPOS_SWEEP_LAST )
+        return;
+
+    pSweep->sumLat[ i ] += pFix->latInt;
+    pSweep->sumLon[ i ] += pFix->lonInt;
+    pSweep->sumAlt[ i ] += pFix->altInt;
+    pSweep->ctMeas[ i ]++;
+}
+
+// Update running sums
+static void AddFix( HposFix* pFix, HposResult* pRes )
+{
+    pRes->sumLat += pFix->latInt;
+    pRes->sumLon += pFix->lonInt;
+    pRes->sumAlt += pFix->altInt;
+    pRes->ctMeas++;
+}
+
+// Each condition the epoch failed (bit 1 << REJ_*)
+static int RejectReasons( const HposFix* pFix, const char* status )
+{
+    int reasons = 0;
+
+    if ( pFix->pdopInt > HPOS_PDOP_CUTOFF )
+        reasons |= 1 << REJ_PDOP;
+
+    if ( strcmp( status, "A" ) != 0 )
+        reasons |= 1 << REJ_STATUS;
+
+    if ( strlen( pFix->lat ) != 9 )
+        reasons |= 1 << REJ_LAT;
+
+    if ( strlen( pFix->lon ) != 10 )
+        reasons |= 1 << REJ_LON;
+
+    return reasons;
+}
+
+#ifdef HPOS_STATS
+static void CountRejects( HposStats* pStats, int reasons )
+{
+    int i;
+
+    STATS_COUNT( pStats, ctRejected );
+
+    for ( i = 0; i < CT_REJS; i++ )
+    {
+        if ( reasons & ( 1 << i ) )
+            STATS_COUNT( pStats, ctRejs[ i ] );
+    }
+}
+#endif
@@ -0,0 +1,170 @@
+//
+// hposEng.h -- hpos engine: nmea parsing and aggregation
+//
+// Reads an nmea file, applies the quality control of hpos and
+// accumulates the accepted fixes. Numeric results are returned in
+// a result struct, so callers (hpos, jdots) need no text round-trip.
+// Callers that store single fixes (trees, grid) pass a fix function.
+//
+// HposProcFilePiped() runs the same on three threads: a reader fills
+// large chunks, a parser turns them into accepted fixes, the caller's
+// thread stores them (fix function). The stages are connected by
+// single producer / single consumer rings (ring.h); full rings hold
+// the stages before them back.
+//
+// The engine keeps no state between calls: jdots runs it on many
+// threads at once. Extras of a run are asked for by the caller in
+// HposOpts (NULL: none), they belong to that run only:
+//
+// With an open log (epochLog.h), every parsed epoch, accepted or not,
+// is added to it. HposProcEpochLog() aggregates such a log again,
+// with any P-DOP cutoff, without text.
+//
+// With a sweep block, epochs meeting all conditions but the P-DOP
+// cutoff are summed per P-DOP value as well. Running sums over the
+// values give count and sums of the accepted epochs for every cutoff
+// HPOS_SWEEP_FIRST ... HPOS_SWEEP_LAST, in the same pass.
+//
+// With a stats block (hposStats.h), lines, sentences and rejects are
+// counted and the stages timed.
+//
+// hpos Engine - Interface declarations
+//
+
+#ifndef _HPOSENG_H_
+#define _HPOSENG_H_
+
+#include <limits.h>
+#include "platform.h"
+#include "epochLog.h"
+#include "hposStats.h"
+
+#define     HPOS_VALIN          32          // Max length of a nmea field
+
+#define     HPOS_PDOP_CUTOFF    210         // Max accepted P-DOP [1/100]
+#define     HPOS_PDOP_NONE      INT_MAX     // P-DOP missing (rejected)
+#define     HPOS_SWEEP_FIRST    100         // Lowest cutoff of a sweep
+#define     HPOS_SWEEP_LAST     1000        // Highest cutoff of a sweep
+
+#define     HPOS_SCALE_DEG      3600000     // Lat, lon [ms] per [deg]
+#define     HPOS_SCALE_ALT      10          // Alt [dm] per [m]
+#define     HPOS_SCALE_PDOP     100         // P-DOP [1/100] per [org]
+
+#define     HPOS_CHUNK          ( 1024 * 1024 ) // Read at once [bytes]
+#define     HPOS_CHUNKS         8           // Chunks in flight (power of 2)
+#define     HPOS_FIXES          4096        // Fixes in flight (power of 2)
+#define     HPOS_FIX_BATCH      64          // Fixes passed at once
+
+typedef struct hposFix
+{
+    char hemiNS[ HPOS_VALIN ];  // Raw nmea fields
+    char lat[ HPOS_VALIN ];
+    char hemiEW[ HPOS_VALIN ];
+    char lon[ HPOS_VALIN ];
+    char alt[ HPOS_VALIN ];
+    char pdop[ HPOS_VALIN ];
+    char sats[ HPOS_VALIN ];
+    int latInt;                 // Signed lat [ms]
+    int lonInt;                 // Signed lon [ms]
+    int altInt;                 // Alt [dm]
+    int pdopInt;                // P-DOP [1/100]
+} HposFix;
+
+typedef struct hposResult
+{
+    long long sumLat;           // Sum of lats [ms]
+    long long sumLon;           // Sum of lons [ms]
+    long long sumAlt;           // Sum of alts [dm]
+    int ctMeas;                 // Accepted fixes
+    double lon;                 // Mean lon [deg] (0 if no fixes)
+    double lat;                 // Mean lat [deg] (0 if no fixes)
+    double alt;                 // Mean alt [m] (0 if no fixes)
+} HposResult;
+
+// Sums per P-DOP value (index [1/100], negative P-DOP at 0)
+typedef struct hposSweep
+{
+    long long sumLat[ HPOS_SWEEP_LAST + 1 ];
+    long long sumLon[ HPOS_SWEEP_LAST + 1 ];
+    long long sumAlt[ HPOS_SWEEP_LAST + 1 ];
+    int ctMeas[ HPOS_SWEEP_LAST + 1 ];
+} HposSweep;
+
+// Extras of a run
+typedef struct hposOpts
+{
+    EpochLog* pEpochLog;        // Log of all parsed epochs (NULL: none)
+    HposSweep* pSweep;          // Sums of all cutoffs (NULL: none)
+    HposStats* pStats;          // Counters, stage timing (NULL: none)
+} HposOpts;
+
+/* function prototypes */
+
+/* operation:      parse a nmea file and aggregate the */
+/*                 accepted fixes                      */
+/* preconditions:  fName points to the file's name     */
+/*                 pOpts is NULL or points to extras   */
+/*                 pRes points to a result struct      */
+/*                 pfun is NULL or points to a function*/
+/*                 called once per accepted fix with   */
+/*                 ctx passed on                       */
+/* postconditions: pRes holds sums, count and means of */
+/*                 the accepted fixes, returns true on */
+/*                 success, otherwise reports the error*/
+/*                 and returns false                   */
+BOOL HposProcFile( LPCTSTR fName, const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx );
+
+/* operation:      same as HposProcFile() on the text  */
+/*                 of a file read into memory          */
+/* preconditions:  data points to ctData chars         */
+/*                 pOpts, pRes, pfun and ctx as above  */
+/* postconditions: pRes holds the same results as for  */
+/*                 the file, returns true              */
+BOOL HposProcBuffer( const char* data, size_t ctData, const HposOpts* pOpts,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx );
+
+/* operation:      same as HposProcFile(), the file is */
+/*                 read and parsed on two threads of   */
+/*                 their own                           */
+/* preconditions:  as HposProcFile()                   */
+/* postconditions: as HposProcFile(); pfun is called   */
+/*                 on the calling thread, in file      */
+/*                 order; files up to one chunk, stats */
+/*                 (hpos --stats) and failed threads   */
+/*                 take HposProcFile()                 */
+BOOL HposProcFilePiped( LPCTSTR fName, const HposOpts* pOpts,
+    HposResult* pRes, void ( *pfun )( const HposFix* pFix, void* ctx ),
+    void* ctx );
+
+/* operation:      aggregate the epochs of a log       */
+/* preconditions:  fName points to an epoch log        */
+/*                 pdopCutoff is the max accepted P-DOP*/
+/*                 [1/100]; pOpts, pRes, pfun and ctx  */
+/*                 as above (of pOpts the sweep only)  */
+/* postconditions: as HposProcFile() for the nmea file */
+/*                 of the log and this cutoff; fixes   */
+/*                 passed to pfun hold int vals only   */
+/*                 (raw nmea fields are empty)         */
+BOOL HposProcEpochLog( LPCTSTR fName, int pdopCutoff,
+    const HposOpts* pOpts, HposResult* pRes,
+    void ( *pfun )( const HposFix* pFix, void* ctx ), void* ctx );
+
+/* operation:      convert nmea lat ( ddmm.mmmm ) [ms] */
+/* preconditions:  hemis is "N" or "S"                 */
+int HposLatToInt( const char* hemis, const char* valStr );
+
+/* operation:      convert nmea lon ( dddmm.mmmm ) [ms]*/
+/* preconditions:  hemis is "E" or "W"                 */
+int HposLonToInt( const char* hemis, const char* valStr );
+
+/* operation:      convert nmea alt [m] to [dm]        */
+int HposAltToInt( const char* valStr );
+
+/* operation:      convert nmea P-DOP to [1/100]       */
+/* postconditions: HPOS_PDOP_NONE if valStr holds no   */
+/*                 digit (field missing or empty)      */
+int HposPdopToInt( const char* valStr );
+
+#endif
@@ -0,0 +1,121 @@
+//
+// hposStats.c -- instrumentation of the hpos engine and hpos
+//
+// hpos Stats - Interface implementation
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include "hposStats.h"
+
+static const char* const stageNames[ CT_STAGES ] =
+    { "read", "tokenize", "decode", "insert", "weight", "output" };
+static const char* const sentNames[ CT_SENTS ] =
+    { "gga", "gsa", "rmc", "other" };
+static const char* const rejNames[ CT_REJS ] =
+    { "pdop", "status", "lat_length", "lon_length" };
+static const char* const treeNames[ CT_STAT_TREES ] =
+    { "lat", "lon", "alt", "pdop" };
+
+/* protototypes for local functions */
+static UINT64 ReadCycles( void );
+
+/* function definitions */
+void HposStatsStart( HposStats* pStats )
+{
+    memset( pStats, 0, sizeof( HposStats ) );
+
+    pStats->ticksStart = HposStatsTicks();
+    pStats->cyclesStart = ReadCycles();
+    pStats->lap = pStats->cyclesStart;
+}
+
+void HposStatsStop( HposStats* pStats )
+{
+    pStats->cyclesStop = ReadCycles();
+    pStats->ticksStop = HposStatsTicks();
+}
+
+int HposStatsWrite( const HposStats* pStats, LPCTSTR fName, BufOut* pOut )
+{
+    LARGE_INTEGER freq;
+    double secs, cyclesPerSec = 0;
+    UINT64 cyclesTotal = 0;
+    int i;
+
+    // Cycles per second over the whole run
+    QueryPerformanceFrequency( &freq );
+    secs = ( double )( pStats->ticksStop - pStats->ticksStart ) /
+        ( double )freq.QuadPart;
+    if ( secs > 0 )
+        cyclesPerSec = ( double )( pStats->cyclesStop -
+            pStats->cyclesStart ) / secs;
+
+    BufOutText( pOut, "{\n  \"stats\": {\n    \"file\": \"" );
+    BufOutJson( pOut, fName, wcslen( fName ) );
+    BufOutPrintf( pOut, "\",\n    \"bytes\": %llu,\n    \"lines\": %llu,\n"
+        "    \"cycles_per_sec\": %.0f,\n    \"cycles\": { ",
+        pStats->ctBytes, pStats->ctLines, cyclesPerSec );
+
+    for ( i = 0; i < CT_STAGES; i++ )
+    {
+        BufOutPrintf( pOut, "\"%s\": %llu, ", stageNames[ i ],
+            pStats->cycles[ i ] );
+        cyclesTotal += pStats->cycles[ i ];
+    }
+
+    BufOutPrintf( pOut, "\"total\": %llu },\n    \"seconds\": { ",
+        cyclesTotal );
+
+    for ( i = 0; i < CT_STAGES; i++ )
+        BufOutPrintf( pOut, "\"%s\": %.6f, ", stageNames[ i ],
+            cyclesPerSec > 0 ? pStats->cycles[ i ] / cyclesPerSec : 0.0 );
+
+    BufOutPrintf( pOut, "\"total\": %.6f },\n    \"sentences\": { ",
+        cyclesPerSec > 0 ? cyclesTotal / cyclesPerSec : 0.0 );
+
+    for ( i = 0; i < CT_SENTS; i++ )
+        BufOutPrintf( pOut, "\"%s\": %llu%s", sentNames[ i ],
+            pStats->ctSents[ i ], ( i + 1 < CT_SENTS ) ? ", " : "" );
+
+    BufOutPrintf( pOut, " },\n    \"epochs\": { \"accepted\": %llu, "
+        "\"rejected\": %llu },\n    \"rejects\": { ",
+        pStats->ctAccepted, pStats->ctRejected );
+
+    for ( i = 0; i < CT_REJS; i++ )
+        BufOutPrintf( pOut, "\"%s\": %llu%s", rejNames[ i ],
+            pStats->ctRejs[ i ], ( i + 1 < CT_REJS ) ? ", " : "" );
+
+    BufOutText( pOut, " },\n    \"trees\": {\n" );
+
+    for ( i = 0; i < CT_STAT_TREES; i++ )
+        BufOutPrintf( pOut, "      \"%s\": { \"nodes\": %d, \"depth\": %d, "
+            "\"values\": %d }%s\n", treeNames[ i ], pStats->trees[ i ].ctNodes,
+            pStats->trees[ i ].depth, pStats->trees[ i ].ctMeas,
+            ( i + 1 < CT_STAT_TREES ) ? "," : "" );
+
+    return BufOutText( pOut, "    }\n  }\n}\n" );
+}
+
+LONGLONG HposStatsTicks( void )
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter( &count );
+
+    return count.QuadPart;
+}
+
+
+/* local functions */
+
+// Cycle counter (0 if not built with HPOS_STATS)
+static UINT64 ReadCycles( void )
+{
+#ifdef HPOS_STATS
+    return STATS_CYCLES();
+#else
+    return 0;
+#endif
+}
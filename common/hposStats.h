@@ -0,0 +1,131 @@
+//
+// hposStats.h -- instrumentation of the hpos engine and hpos
+//
+// Built with HPOS_STATS, the engine counts lines, sentences and
+// rejected epochs (per reason) and times its stages with the CPU's
+// cycle counter, if the caller passes a stats block (hpos --stats).
+// Without HPOS_STATS the macros compile to nothing.
+//
+// Stages are timed as laps: STATS_LAP( pStats, stage ) adds the cycles
+// since the previous lap (or STATS_MARK()) to the stage. The macros do
+// nothing while pStats is NULL. One thread per stats block.
+//
+// hpos Stats - Interface declarations
+//
+
+#ifndef _HPOSSTATS_H_
+#define _HPOSSTATS_H_
+
+#include "platform.h"
+#include "bufOut.h"
+
+// Stages
+#define     STAGE_READ          0   // Mapping, splitting lines
+#define     STAGE_TOKENIZE      1   // Sentence type, fields
+#define     STAGE_DECODE        2   // Quality control, int values
+#define     STAGE_INSERT        3   // Trees, grid (hpos)
+#define     STAGE_WEIGHT        4   // Weighted values (hpos)
+#define     STAGE_OUTPUT        5   // Screen and files (hpos)
+#define     CT_STAGES           6
+
+// Sentences
+#define     SENT_GGA            0
+#define     SENT_GSA            1
+#define     SENT_RMC            2
+#define     SENT_OTHER          3   // Other types, other talkers
+#define     CT_SENTS            4
+
+// Reasons of rejected epochs (an epoch may have several)
+#define     REJ_PDOP            0   // P-DOP over HPOS_PDOP_CUTOFF
+#define     REJ_STATUS          1   // RMC status not "A"
+#define     REJ_LAT             2   // Lat not ddmm.mmmm
+#define     REJ_LON             3   // Lon not dddmm.mmmm
+#define     CT_REJS             4
+
+#define     CT_STAT_TREES       4   // Lat, lon, alt, P-DOP
+
+typedef struct hposTreeStats
+{
+    int ctNodes;                // Distinct values
+    int depth;                  // Longest path [nodes]
+    int ctMeas;                 // Values added
+} HposTreeStats;
+
+typedef struct hposStats
+{
+    UINT64 cycles[ CT_STAGES ];
+    UINT64 lap;                 // Cycle count of the last lap
+    UINT64 ctBytes;
+    UINT64 ctLines;
+    UINT64 ctSents[ CT_SENTS ];
+    UINT64 ctAccepted;          // Epochs
+    UINT64 ctRejected;
+    UINT64 ctRejs[ CT_REJS ];
+    HposTreeStats trees[ CT_STAT_TREES ];   // Filled in by hpos
+    UINT64 cyclesStart;         // Calibration of the cycle counter
+    UINT64 cyclesStop;
+    LONGLONG ticksStart;
+    LONGLONG ticksStop;
+} HposStats;
+
+#ifdef HPOS_STATS
+
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+#include <intrin.h>
+#define     STATS_CYCLES()      ( ( UINT64 )__rdtsc() )
+#elif defined( __i386__ ) || defined( __x86_64__ )
+#include <x86intrin.h>
+#define     STATS_CYCLES()      ( ( UINT64 )__rdtsc() )
+#else
+#define     STATS_CYCLES()      ( ( UINT64 )HposStatsTicks() )
+#endif
+
+#define     STATS_MARK( pStats ) \
+    do { if ( ( pStats ) != NULL ) \
+        ( pStats )->lap = STATS_CYCLES(); } while ( 0 )
+
+#define     STATS_LAP( pStats, stage ) \
+    do { if ( ( pStats ) != NULL ) { \
+        UINT64 now_ = STATS_CYCLES(); \
+        ( pStats )->cycles[ stage ] += now_ - ( pStats )->lap; \
+        ( pStats )->lap = now_; } } while ( 0 )
+
+#define     STATS_COUNT( pStats, field ) \
+    do { if ( ( pStats ) != NULL ) ( pStats )->field++; } while ( 0 )
+
+#define     STATS_ADD( pStats, field, val ) \
+    do { if ( ( pStats ) != NULL ) \
+        ( pStats )->field += ( val ); } while ( 0 )
+
+#else
+
+#define     STATS_MARK( pStats )                ( ( void )0 )
+#define     STATS_LAP( pStats, stage )          ( ( void )0 )
+#define     STATS_COUNT( pStats, field )        ( ( void )0 )
+#define     STATS_ADD( pStats, field, val )     ( ( void )0 )
+
+#endif
+
+/* function prototypes */
+
+/* operation:      start collecting stats              */
+/* preconditions:  pStats points to a stats block      */
+/* postconditions: the block is cleared, the cycle     */
+/*                 counter calibration started         */
+void HposStatsStart( HposStats* pStats );
+
+/* operation:      stop collecting stats               */
+/* postconditions: the calibration is complete         */
+void HposStatsStop( HposStats* pStats );
+
+/* operation:      write the stats as a JSON object    */
+/* preconditions:  pOut points to an open writer       */
+/*                 fName is the nmea file              */
+/* postconditions: cycles are converted to seconds by  */
+/*                 the calibration of start and stop   */
+int HposStatsWrite( const HposStats* pStats, LPCTSTR fName, BufOut* pOut );
+
+/* operation:      performance counter ticks           */
+LONGLONG HposStatsTicks( void );
+
+#endif
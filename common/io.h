@@ -0,0 +1,250 @@
+//
+// io.h -- files and dirs on Win32 and POSIX
+//
+// The tools reach the file system only through these calls: listing
+// dirs, reading whole files (mapped, or read ahead asynchronously),
+// writing files, locking, renaming and deleting them, the current dir
+// and watching a dir for changes. ioWin32.c implements them with the
+// Win32 API, ioPosix.c with POSIX and Linux calls (getdents64, mmap,
+// posix_fadvise, inotify).
+//
+// Paths are TCHAR text (UTF-8 on POSIX). On failure, the error is
+// left in GetLastError() for ReportError().
+//
+// File I/O - Interface declarations
+//
+
+#ifndef _IO_H_
+#define _IO_H_
+
+#include "platform.h"
+
+#ifdef _WIN32
+#define     IO_SEP          TEXT( "\\" )    // Path separator
+#define     IO_SEP_CH       TEXT( '\\' )
+#define     IO_NO_FILE      INVALID_HANDLE_VALUE
+#define     IO_CASE_PATHS   FALSE           // Case-sensitive paths
+#define     IoPathCmp       _wcsicmp        // Compare paths
+typedef HANDLE IoFile;
+#else
+#define     IO_SEP          TEXT( "/" )
+#define     IO_SEP_CH       TEXT( '/' )
+#define     IO_NO_FILE      ( -1 )
+#define     IO_CASE_PATHS   TRUE
+#define     IoPathCmp       wcscmp
+typedef int IoFile;
+#endif
+
+#define     IO_DIR_BUF      ( 32 * 1024 )   // Dir entries read at once [bytes]
+#define     IO_WATCH_BUF    ( 64 * 1024 )   // Change records [bytes]
+
+#define     IO_ATTR_DIR     0x01    // Dir (or link to a dir)
+#define     IO_ATTR_LINK    0x02    // Symbolic link (reparse point)
+
+#define     IO_ERROR        ( -1 )  // Results of IoReadDir()
+#define     IO_END          0
+#define     IO_ENTRY        1
+
+#define     IO_TIMEOUT      0       // Results of IoWaitWatch()
+#define     IO_CHANGED      1
+#define     IO_LOST         2
+
+typedef struct ioEntry
+{
+    TCHAR name[ MAX_PATH ];     // Name in its dir
+    UINT64 size;                // Files only [bytes]
+    FILETIME ftLastWriteTime;   // Files only
+    DWORD attrs;                // IO_ATTR_...
+} IoEntry;
+
+typedef struct ioDir
+{
+    LPCTSTR ext;                // Files listed (NULL: all)
+#ifdef _WIN32
+    HANDLE hFind;
+    WIN32_FIND_DATA findInfo;
+    BOOL pending;               // findInfo not returned yet
+#else
+    int fd;
+    char* buf;                  // Entries read at once
+    int ctBuf;                  // Bytes in buf
+    int pos;                    // Next entry in buf
+#endif
+} IoDir;
+
+typedef struct ioMap
+{
+    const char* data;           // Whole file
+    size_t size;                // [bytes]
+#ifdef _WIN32
+    HANDLE hMap;
+#endif
+} IoMap;
+
+typedef struct ioAsyncRead
+{
+    char* data;                 // Set by IoStartRead()
+    size_t size;                // Bytes asked for
+#ifdef _WIN32
+    HANDLE hFile;
+    OVERLAPPED ov;
+#else
+    int fd;
+#endif
+} IoAsyncRead;
+
+typedef struct ioWatch
+{
+    void* records;              // Change records
+#ifdef _WIN32
+    HANDLE hDir;
+    OVERLAPPED ov;
+#else
+    int fd;
+#endif
+} IoWatch;
+
+/* function prototypes */
+
+/* operation:      start listing a dir                 */
+/* preconditions:  pDir points to a dir listing        */
+/*                 path is the dir ("" current dir)    */
+/*                 ext is NULL or a file name ending   */
+/* postconditions: returns true on success, false on   */
+/*                 error (nothing to close)            */
+int IoOpenDir( IoDir* pDir, LPCTSTR path, LPCTSTR ext );
+
+/* operation:      get the next entry of a dir         */
+/* preconditions:  pDir points to an open listing      */
+/* postconditions: returns IO_ENTRY with the entry in  */
+/*                 pEntry, IO_END if no more entries,  */
+/*                 IO_ERROR on error                   */
+/*                 "." and ".." are skipped, so are    */
+/*                 files not ending with ext (names    */
+/*                 compared case-insensitive)          */
+int IoReadDir( IoDir* pDir, IoEntry* pEntry );
+
+/* operation:      stop listing a dir                  */
+void IoCloseDir( IoDir* pDir );
+
+/* operation:      get size, time and attributes of a  */
+/*                 file or dir (links not followed)    */
+/* postconditions: returns true with pEntry set (but   */
+/*                 its name), false if not found       */
+int IoStat( LPCTSTR path, IoEntry* pEntry );
+
+/* operation:      get the file id of a dir (links are */
+/*                 followed)                           */
+/* postconditions: returns true with the volume and    */
+/*                 the index of the dir on the volume  */
+int IoDirId( LPCTSTR path, UINT64* pVolume, UINT64* pIndex );
+
+/* operation:      get the current dir                 */
+/* preconditions:  buf holds ctBuf TCHARs              */
+/* postconditions: returns the length of the path, 0   */
+/*                 on error, ctBuf or more if too long */
+DWORD IoGetCwd( LPTSTR buf, DWORD ctBuf );
+
+/* operation:      set the current dir                 */
+/* postconditions: returns true on success             */
+int IoSetCwd( LPCTSTR path );
+
+/* operation:      create a file to write (truncated)  */
+/* postconditions: returns the file, IO_NO_FILE on     */
+/*                 error                               */
+IoFile IoCreateFile( LPCTSTR fName );
+
+/* operation:      open a file to read sequentially    */
+/* postconditions: returns the file, IO_NO_FILE on     */
+/*                 error                               */
+IoFile IoOpenFile( LPCTSTR fName );
+
+/* operation:      get the standard output             */
+/* postconditions: not to be closed                    */
+IoFile IoStdOut( void );
+
+/* operation:      write bytes at the file's position  */
+/* postconditions: returns true if all were written    */
+int IoWrite( IoFile hFile, const void* data, DWORD len );
+
+/* operation:      read bytes at the file's position   */
+/* postconditions: returns true with the bytes read in */
+/*                 pRead (fewer at the end of file)    */
+int IoRead( IoFile hFile, void* data, DWORD len, DWORD* pRead );
+
+/* operation:      get the size of an open file        */
+int IoFileSize( IoFile hFile, UINT64* pSize );
+
+/* operation:      close a file                        */
+void IoCloseFile( IoFile hFile );
+
+/* operation:      map a whole file into memory (read  */
+/*                 only, sequential access)            */
+/* preconditions:  pMap points to a map                */
+/* postconditions: returns true with the text of the   */
+/*                 file in data and size, false on     */
+/*                 error (nothing to unmap)            */
+int IoMapFile( LPCTSTR fName, IoMap* pMap );
+
+/* operation:      unmap a mapped file                 */
+void IoUnmapFile( IoMap* pMap );
+
+/* operation:      start reading a file from its start */
+/*                 into a buffer (asynchronous)        */
+/* preconditions:  buf holds size bytes                */
+/* postconditions: returns true if the read is started */
+/*                 (to be finished), false on error    */
+int IoStartRead( IoAsyncRead* pRead, LPCTSTR fName, char* buf,
+    size_t size );
+
+/* operation:      wait for a read and close the file  */
+/* preconditions:  IoStartRead() returned true         */
+/* postconditions: returns true with the bytes read in */
+/*                 pGot (fewer at the end of file)     */
+int IoFinishRead( IoAsyncRead* pRead, size_t* pGot );
+
+/* operation:      open a lock file and lock it        */
+/*                 exclusively (waits for others)      */
+/* postconditions: returns the locked file, IO_NO_FILE */
+/*                 on error                            */
+IoFile IoLockFile( LPCTSTR fName );
+
+/* operation:      unlock and close a lock file        */
+void IoUnlockFile( IoFile hLock );
+
+/* operation:      rename a file, replacing the target */
+/* postconditions: returns true on success             */
+int IoRename( LPCTSTR oldName, LPCTSTR newName );
+
+/* operation:      delete a file                       */
+/* postconditions: returns true on success             */
+int IoDelete( LPCTSTR fName );
+
+/* operation:      create a dir                        */
+/* postconditions: returns true if created or if it    */
+/*                 exists already                      */
+int IoCreateDir( LPCTSTR path );
+
+/* operation:      start watching a dir for changes of */
+/*                 its files (not of subdirs)          */
+/* postconditions: returns true on success, false on   */
+/*                 error (nothing to stop)             */
+int IoStartWatch( IoWatch* pWatch, LPCTSTR path );
+
+/* operation:      wait for changes                    */
+/* preconditions:  ms is the max time to wait [ms] or  */
+/*                 INFINITE                            */
+/*                 pfun points to a function called    */
+/*                 with each changed name (len TCHARs, */
+/*                 not null terminated), ctx passed on */
+/* postconditions: returns IO_CHANGED after reporting  */
+/*                 the changes, IO_LOST if changes     */
+/*                 were lost (too many), IO_TIMEOUT if */
+/*                 none, IO_ERROR on error             */
+int IoWaitWatch( IoWatch* pWatch, DWORD ms,
+    void ( *pfun )( LPCTSTR name, size_t len, void* ctx ), void* ctx );
+
+/* operation:      stop watching a dir                 */
+void IoStopWatch( IoWatch* pWatch );
+
+#endif
@@ -0,0 +1,609 @@
+//
+// ioPosix.c -- files and dirs on POSIX (Linux)
+//
+// Dirs are read in large batches with getdents64; only entries that
+// are listed (dirs, links, files ending with ext) are stat'ed. Whole
+// files are mapped (mmap) or read with pread after posix_fadvise has
+// started the kernel's read ahead, so several reads are in flight
+// while the workers parse. Dirs are watched with inotify.
+//
+// File I/O - Interface implementation (POSIX)
+//
+
+#ifndef _WIN32
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include "io.h"
+
+#define     PATH_BYTES      ( 4 * MAX_PATH )    // UTF-8 path [bytes]
+
+#define     FT_PER_SEC      10000000ULL     // FILETIME units per [s]
+#define     FT_UNIX_SECS    11644473600ULL  // 1601-01-01 to 1970-01-01 [s]
+
+#define     WATCH_MASK      ( IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+                            IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE )
+
+// Record of getdents64
+typedef struct linuxDirent64
+{
+    UINT64 d_ino;
+    LONGLONG d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} DirEnt64;
+
+/* protototypes for local functions */
+static int ToPath( LPCTSTR path, char* dst );
+static void FromStat( const struct stat* pSt, IoEntry* pEntry );
+static BOOL MatchExt( LPCTSTR name, LPCTSTR ext );
+
+/* function definitions */
+int IoOpenDir( IoDir* pDir, LPCTSTR path, LPCTSTR ext )
+{
+    char pathU[ PATH_BYTES ];
+
+    pDir->ext = ext;
+    pDir->ctBuf = 0;
+    pDir->pos = 0;
+    pDir->buf = NULL;
+
+    if ( !ToPath( ( path[ 0 ] != TEXT( '\0' ) ) ? path : TEXT( "." ),
+        pathU ) )
+        return FALSE;
+
+    pDir->fd = open( pathU, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( pDir->fd < 0 )
+        return FALSE;
+
+    pDir->buf = ( char* )malloc( IO_DIR_BUF );
+    if ( pDir->buf == NULL )
+    {
+        close( pDir->fd );
+        pDir->fd = -1;
+        errno = ENOMEM;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int IoReadDir( IoDir* pDir, IoEntry* pEntry )
+{
+    const DirEnt64* pEnt = NULL;
+    struct stat st;
+    long ct;
+
+    for ( ;; )
+    {
+        // Next batch of entries
+        if ( pDir->pos >= pDir->ctBuf )
+        {
+            ct = syscall( SYS_getdents64, pDir->fd, pDir->buf, IO_DIR_BUF );
+            if ( ct < 0 )
+                return IO_ERROR;
+            if ( ct == 0 )
+                return IO_END;
+
+            pDir->ctBuf = ( int )ct;
+            pDir->pos = 0;
+        }
+
+        pEnt = ( const DirEnt64* )( pDir->buf + pDir->pos );
+        pDir->pos += pEnt->d_reclen;
+
+        // Skip "." and ".."
+        if ( strcmp( pEnt->d_name, "." ) == 0 ||
+            strcmp( pEnt->d_name, ".." ) == 0 )
+            continue;
+
+        // Names longer than MAX_PATH cannot be used
+        if ( !PlatFromUtf8( pEnt->d_name, pEntry->name,
+            _countof( pEntry->name ) ) )
+            continue;
+
+        memset( &pEntry->ftLastWriteTime, 0, sizeof( FILETIME ) );
+        pEntry->size = 0;
+        pEntry->attrs = 0;
+
+        switch ( pEnt->d_type )
+        {
+        case DT_DIR:
+            pEntry->attrs = IO_ATTR_DIR;
+            return IO_ENTRY;
+
+        case DT_LNK:
+            // Link to a dir?
+            pEntry->attrs = IO_ATTR_LINK;
+            if ( fstatat( pDir->fd, pEnt->d_name, &st, 0 ) == 0 &&
+                S_ISDIR( st.st_mode ) )
+                pEntry->attrs |= IO_ATTR_DIR;
+            return IO_ENTRY;
+
+        case DT_REG:
+        case DT_UNKNOWN:
+            if ( pEnt->d_type == DT_REG &&
+                !MatchExt( pEntry->name, pDir->ext ) )
+                continue;
+
+            // Entry vanished since listed
+            if ( fstatat( pDir->fd, pEnt->d_name, &st,
+                AT_SYMLINK_NOFOLLOW ) != 0 )
+                continue;
+
+            FromStat( &st, pEntry );
+
+            if ( S_ISDIR( st.st_mode ) ||
+                ( S_ISREG( st.st_mode ) &&
+                MatchExt( pEntry->name, pDir->ext ) ) )
+                return IO_ENTRY;
+
+            if ( S_ISLNK( st.st_mode ) )
+            {
+                if ( fstatat( pDir->fd, pEnt->d_name, &st, 0 ) == 0 &&
+                    S_ISDIR( st.st_mode ) )
+                    pEntry->attrs |= IO_ATTR_DIR;
+                return IO_ENTRY;
+            }
+            continue;
+
+        default:
+            // Devices, pipes, sockets
+            continue;
+        }
+    }
+}
+
+void IoCloseDir( IoDir* pDir )
+{
+    if ( pDir->fd >= 0 )
+        close( pDir->fd );
+
+    free( pDir->buf );
+
+    pDir->fd = -1;
+    pDir->buf = NULL;
+}
+
+int IoStat( LPCTSTR path, IoEntry* pEntry )
+{
+    char pathU[ PATH_BYTES ];
+    struct stat st;
+
+    if ( !ToPath( path, pathU ) || lstat( pathU, &st ) != 0 )
+        return FALSE;
+
+    FromStat( &st, pEntry );
+
+    return TRUE;
+}
+
+int IoDirId( LPCTSTR path, UINT64* pVolume, UINT64* pIndex )
+{
+    char pathU[ PATH_BYTES ];
+    struct stat st;
+
+    if ( !ToPath( path, pathU ) || stat( pathU, &st ) != 0 )
+        return FALSE;
+
+    *pVolume = ( UINT64 )st.st_dev;
+    *pIndex = ( UINT64 )st.st_ino;
+
+    return TRUE;
+}
+
+DWORD IoGetCwd( LPTSTR buf, DWORD ctBuf )
+{
+    char pathU[ PATH_BYTES ];
+
+    if ( getcwd( pathU, sizeof( pathU ) ) == NULL )
+        return ( errno == ERANGE ) ? ctBuf : 0;
+
+    if ( !PlatFromUtf8( pathU, buf, ctBuf ) )
+        return ctBuf;
+
+    return ( DWORD )wcslen( buf );
+}
+
+int IoSetCwd( LPCTSTR path )
+{
+    char pathU[ PATH_BYTES ];
+
+    return ToPath( path, pathU ) && chdir( pathU ) == 0;
+}
+
+IoFile IoCreateFile( LPCTSTR fName )
+{
+    char pathU[ PATH_BYTES ];
+
+    if ( !ToPath( fName, pathU ) )
+        return IO_NO_FILE;
+
+    return open( pathU, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666 );
+}
+
+IoFile IoOpenFile( LPCTSTR fName )
+{
+    char pathU[ PATH_BYTES ];
+    int fd;
+
+    if ( !ToPath( fName, pathU ) )
+        return IO_NO_FILE;
+
+    fd = open( pathU, O_RDONLY | O_CLOEXEC );
+    if ( fd >= 0 )
+        posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+    return fd;
+}
+
+IoFile IoStdOut( void )
+{
+    return STDOUT_FILENO;
+}
+
+int IoWrite( IoFile hFile, const void* data, DWORD len )
+{
+    const char* pCh = ( const char* )data;
+    ssize_t ct;
+
+    while ( len > 0 )
+    {
+        ct = write( hFile, pCh, len );
+        if ( ct < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return FALSE;
+        }
+
+        pCh += ct;
+        len -= ( DWORD )ct;
+    }
+
+    return TRUE;
+}
+
+int IoRead( IoFile hFile, void* data, DWORD len, DWORD* pRead )
+{
+    char* pCh = ( char* )data;
+    ssize_t ct;
+
+    *pRead = 0;
+
+    while ( len > 0 )
+    {
+        ct = read( hFile, pCh, len );
+        if ( ct < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return FALSE;
+        }
+
+        if ( ct == 0 )
+            break;
+
+        pCh += ct;
+        len -= ( DWORD )ct;
+        *pRead += ( DWORD )ct;
+    }
+
+    return TRUE;
+}
+
+int IoFileSize( IoFile hFile, UINT64* pSize )
+{
+    struct stat st;
+
+    if ( fstat( hFile, &st ) != 0 )
+        return FALSE;
+
+    *pSize = ( UINT64 )st.st_size;
+
+    return TRUE;
+}
+
+void IoCloseFile( IoFile hFile )
+{
+    close( hFile );
+}
+
+int IoMapFile( LPCTSTR fName, IoMap* pMap )
+{
+    UINT64 size = 0;
+    void* data;
+    int fd;
+
+    pMap->data = NULL;
+    pMap->size = 0;
+
+    fd = IoOpenFile( fName );
+    if ( fd < 0 )
+        return FALSE;
+
+    if ( !IoFileSize( fd, &size ) || size > ( size_t )-1 )
+    {
+        close( fd );
+        return FALSE;
+    }
+
+    // Empty files cannot be mapped
+    if ( size == 0 )
+    {
+        close( fd );
+        pMap->data = "";
+        return TRUE;
+    }
+
+    data = mmap( NULL, ( size_t )size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    // The mapping keeps the file open
+    close( fd );
+
+    if ( data == MAP_FAILED )
+        return FALSE;
+
+    madvise( data, ( size_t )size, MADV_SEQUENTIAL );
+    madvise( data, ( size_t )size, MADV_WILLNEED );
+
+    pMap->data = ( const char* )data;
+    pMap->size = ( size_t )size;
+
+    return TRUE;
+}
+
+void IoUnmapFile( IoMap* pMap )
+{
+    if ( pMap->size > 0 )
+        munmap( ( void* )pMap->data, pMap->size );
+
+    pMap->data = NULL;
+    pMap->size = 0;
+}
+
+// Kernel reads ahead while earlier files are parsed
+int IoStartRead( IoAsyncRead* pRead, LPCTSTR fName, char* buf,
+    size_t size )
+{
+    char pathU[ PATH_BYTES ];
+
+    pRead->data = buf;
+    pRead->size = size;
+
+    if ( !ToPath( fName, pathU ) )
+        return FALSE;
+
+    pRead->fd = open( pathU, O_RDONLY | O_CLOEXEC );
+    if ( pRead->fd < 0 )
+        return FALSE;
+
+    posix_fadvise( pRead->fd, 0, 0, POSIX_FADV_WILLNEED );
+
+    return TRUE;
+}
+
+int IoFinishRead( IoAsyncRead* pRead, size_t* pGot )
+{
+    size_t got = 0;
+    ssize_t ct;
+    BOOL ok = TRUE;
+
+    while ( got < pRead->size )
+    {
+        ct = pread( pRead->fd, pRead->data + got, pRead->size - got,
+            ( off_t )got );
+        if ( ct < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            ok = FALSE;
+            break;
+        }
+
+        if ( ct == 0 )
+            break;
+
+        got += ( size_t )ct;
+    }
+
+    close( pRead->fd );
+    pRead->fd = -1;
+
+    *pGot = got;
+
+    return ok;
+}
+
+IoFile IoLockFile( LPCTSTR fName )
+{
+    char pathU[ PATH_BYTES ];
+    int fd;
+
+    if ( !ToPath( fName, pathU ) )
+        return IO_NO_FILE;
+
+    fd = open( pathU, O_RDWR | O_CREAT | O_CLOEXEC, 0666 );
+    if ( fd < 0 )
+        return IO_NO_FILE;
+
+    while ( flock( fd, LOCK_EX ) != 0 )
+    {
+        if ( errno != EINTR )
+        {
+            close( fd );
+            return IO_NO_FILE;
+        }
+    }
+
+    return fd;
+}
+
+void IoUnlockFile( IoFile hLock )
+{
+    flock( hLock, LOCK_UN );
+    close( hLock );
+}
+
+int IoRename( LPCTSTR oldName, LPCTSTR newName )
+{
+    char oldU[ PATH_BYTES ];
+    char newU[ PATH_BYTES ];
+
+    return ToPath( oldName, oldU ) && ToPath( newName, newU ) &&
+        rename( oldU, newU ) == 0;
+}
+
+int IoDelete( LPCTSTR fName )
+{
+    char pathU[ PATH_BYTES ];
+
+    return ToPath( fName, pathU ) && unlink( pathU ) == 0;
+}
+
+int IoCreateDir( LPCTSTR path )
+{
+    char pathU[ PATH_BYTES ];
+
+    return ToPath( path, pathU ) &&
+        ( mkdir( pathU, 0777 ) == 0 || errno == EEXIST );
+}
+
+int IoStartWatch( IoWatch* pWatch, LPCTSTR path )
+{
+    char pathU[ PATH_BYTES ];
+
+    pWatch->records = malloc( IO_WATCH_BUF );
+    pWatch->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if ( pWatch->records == NULL || pWatch->fd < 0 ||
+        !ToPath( path, pathU ) ||
+        inotify_add_watch( pWatch->fd, pathU, WATCH_MASK ) < 0 )
+    {
+        IoStopWatch( pWatch );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int IoWaitWatch( IoWatch* pWatch, DWORD ms,
+    void ( *pfun )( LPCTSTR name, size_t len, void* ctx ), void* ctx )
+{
+    const struct inotify_event* pEvent = NULL;
+    const char* records = ( const char* )pWatch->records;
+    TCHAR name[ MAX_PATH ];
+    struct pollfd pfd;
+    ssize_t ct, off;
+    int result = IO_CHANGED;
+    int ready;
+
+    pfd.fd = pWatch->fd;
+    pfd.events = POLLIN;
+
+    ready = poll( &pfd, 1, ( ms == INFINITE ) ? -1 : ( int )ms );
+    if ( ready < 0 )
+        return ( errno == EINTR ) ? IO_TIMEOUT : IO_ERROR;
+    if ( ready == 0 )
+        return IO_TIMEOUT;
+
+    // All events queued so far
+    for ( ;; )
+    {
+        ct = read( pWatch->fd, pWatch->records, IO_WATCH_BUF );
+        if ( ct < 0 )
+        {
+            if ( errno == EAGAIN )
+                break;
+            if ( errno == EINTR )
+                continue;
+            return IO_ERROR;
+        }
+
+        for ( off = 0; off < ct;
+            off += ( ssize_t )sizeof( struct inotify_event ) + pEvent->len )
+        {
+            pEvent = ( const struct inotify_event* )( records + off );
+
+            if ( pEvent->mask & IN_Q_OVERFLOW )
+                result = IO_LOST;
+            else if ( pEvent->len > 0 &&
+                PlatFromUtf8( pEvent->name, name, _countof( name ) ) )
+                ( *pfun )( name, wcslen( name ), ctx );
+        }
+    }
+
+    return result;
+}
+
+void IoStopWatch( IoWatch* pWatch )
+{
+    if ( pWatch->fd >= 0 )
+        close( pWatch->fd );
+
+    free( pWatch->records );
+
+    pWatch->fd = -1;
+    pWatch->records = NULL;
+}
+
+
+/* local functions */
+
+// UTF-8 path of the file system, false if too long (errno set)
+static int ToPath( LPCTSTR path, char* dst )
+{
+    if ( !PlatToUtf8( path, dst, PATH_BYTES ) )
+    {
+        errno = ENAMETOOLONG;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void FromStat( const struct stat* pSt, IoEntry* pEntry )
+{
+    UINT64 ft;
+
+    ft = ( ( UINT64 )pSt->st_mtim.tv_sec + FT_UNIX_SECS ) * FT_PER_SEC +
+        ( UINT64 )pSt->st_mtim.tv_nsec / 100;
+
+    pEntry->size = ( UINT64 )pSt->st_size;
+    pEntry->ftLastWriteTime.dwLowDateTime = ( DWORD )ft;
+    pEntry->ftLastWriteTime.dwHighDateTime = ( DWORD )( ft >> 32 );
+    pEntry->attrs = 0;
+
+    if ( S_ISDIR( pSt->st_mode ) )
+        pEntry->attrs |= IO_ATTR_DIR;
+
+    if ( S_ISLNK( pSt->st_mode ) )
+        pEntry->attrs |= IO_ATTR_LINK;
+}
+
+// Name ends with ext (any case), or no ext given
+static BOOL MatchExt( LPCTSTR name, LPCTSTR ext )
+{
+    size_t len = wcslen( name );
+    size_t lenExt;
+
+    if ( ext == NULL )
+        return TRUE;
+
+    lenExt = wcslen( ext );
+
+    return len > lenExt && _wcsicmp( name + len - lenExt, ext ) == 0;
+}
+
+#endif
@@ -0,0 +1,472 @@
+//
+// ioWin32.c -- files and dirs on Win32
+//
+// File I/O - Interface implementation (Win32)
+//
+
+#ifdef _WIN32
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "io.h"
+
+/* protototypes for local functions */
+static void FromFindData( const WIN32_FIND_DATA* pInfo, IoEntry* pEntry );
+static BOOL MatchExt( LPCTSTR name, LPCTSTR ext );
+
+/* function definitions */
+int IoOpenDir( IoDir* pDir, LPCTSTR path, LPCTSTR ext )
+{
+    TCHAR dirStr[ MAX_PATH ] = { 0 };
+    size_t len = wcslen( path );
+
+    pDir->ext = ext;
+    pDir->pending = FALSE;
+
+    // "path\*" or "*"
+    if ( len >= MAX_PATH - 3 )
+    {
+        SetLastError( ERROR_BUFFER_OVERFLOW );
+        return FALSE;
+    }
+
+    wcscpy_s( dirStr, _countof( dirStr ), path );
+    if ( len > 0 && path[ len - 1 ] != TEXT( '\\' ) )
+        wcscat_s( dirStr, _countof( dirStr ), TEXT( "\\" ) );
+    wcscat_s( dirStr, _countof( dirStr ), TEXT( "*" ) );
+
+    // Batched listing, short names not needed
+    pDir->hFind = FindFirstFileEx( dirStr, FindExInfoBasic, &pDir->findInfo,
+        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH );
+
+    if ( pDir->hFind == INVALID_HANDLE_VALUE )
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+    pDir->pending = TRUE;
+
+    return TRUE;
+}
+
+int IoReadDir( IoDir* pDir, IoEntry* pEntry )
+{
+    WIN32_FIND_DATA* pInfo = &pDir->findInfo;
+
+    for ( ;; )
+    {
+        if ( !pDir->pending )
+        {
+            if ( pDir->hFind == INVALID_HANDLE_VALUE )
+                return IO_END;
+
+            if ( !FindNextFile( pDir->hFind, pInfo ) )
+                return ( GetLastError() == ERROR_NO_MORE_FILES ) ?
+                    IO_END : IO_ERROR;
+        }
+
+        pDir->pending = FALSE;
+
+        // Skip "." and ".."
+        if ( wcscmp( pInfo->cFileName, TEXT( "." ) ) == 0 ||
+            wcscmp( pInfo->cFileName, TEXT( ".." ) ) == 0 )
+            continue;
+
+        if ( !( pInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) &&
+            !MatchExt( pInfo->cFileName, pDir->ext ) )
+            continue;
+
+        wcscpy_s( pEntry->name, _countof( pEntry->name ), pInfo->cFileName );
+        FromFindData( pInfo, pEntry );
+
+        return IO_ENTRY;
+    }
+}
+
+void IoCloseDir( IoDir* pDir )
+{
+    if ( pDir->hFind != INVALID_HANDLE_VALUE )
+        FindClose( pDir->hFind );
+
+    pDir->hFind = INVALID_HANDLE_VALUE;
+}
+
+int IoStat( LPCTSTR path, IoEntry* pEntry )
+{
+    WIN32_FILE_ATTRIBUTE_DATA attr = { 0 };
+
+    if ( !GetFileAttributesEx( path, GetFileExInfoStandard, &attr ) )
+        return FALSE;
+
+    pEntry->size = ( ( UINT64 )attr.nFileSizeHigh << 32 ) |
+        attr.nFileSizeLow;
+    pEntry->ftLastWriteTime = attr.ftLastWriteTime;
+    pEntry->attrs = 0;
+
+    if ( attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+        pEntry->attrs |= IO_ATTR_DIR;
+
+    if ( attr.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT )
+        pEntry->attrs |= IO_ATTR_LINK;
+
+    return TRUE;
+}
+
+int IoDirId( LPCTSTR path, UINT64* pVolume, UINT64* pIndex )
+{
+    HANDLE hDir = INVALID_HANDLE_VALUE;
+    BY_HANDLE_FILE_INFORMATION dirInfo;
+    BOOL ok;
+
+    // Open dir itself
+    hDir = CreateFile( path, 0,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL );
+
+    if ( hDir == INVALID_HANDLE_VALUE )
+        return FALSE;
+
+    ok = GetFileInformationByHandle( hDir, &dirInfo );
+
+    CloseHandle( hDir );
+
+    if ( !ok )
+        return FALSE;
+
+    *pVolume = dirInfo.dwVolumeSerialNumber;
+    *pIndex = ( ( UINT64 )dirInfo.nFileIndexHigh << 32 ) |
+        dirInfo.nFileIndexLow;
+
+    return TRUE;
+}
+
+DWORD IoGetCwd( LPTSTR buf, DWORD ctBuf )
+{
+    return GetCurrentDirectory( ctBuf, buf );
+}
+
+int IoSetCwd( LPCTSTR path )
+{
+    return SetCurrentDirectory( path );
+}
+
+IoFile IoCreateFile( LPCTSTR fName )
+{
+    return CreateFile( fName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL );
+}
+
+IoFile IoOpenFile( LPCTSTR fName )
+{
+    return CreateFile( fName, GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+}
+
+IoFile IoStdOut( void )
+{
+    return GetStdHandle( STD_OUTPUT_HANDLE );
+}
+
+int IoWrite( IoFile hFile, const void* data, DWORD len )
+{
+    DWORD nOut = 0;
+
+    return WriteFile( hFile, data, len, &nOut, NULL ) && nOut == len;
+}
+
+int IoRead( IoFile hFile, void* data, DWORD len, DWORD* pRead )
+{
+    return ReadFile( hFile, data, len, pRead, NULL );
+}
+
+int IoFileSize( IoFile hFile, UINT64* pSize )
+{
+    LARGE_INTEGER fileSize = { 0 };
+
+    if ( !GetFileSizeEx( hFile, &fileSize ) )
+        return FALSE;
+
+    *pSize = ( UINT64 )fileSize.QuadPart;
+
+    return TRUE;
+}
+
+void IoCloseFile( IoFile hFile )
+{
+    CloseHandle( hFile );
+}
+
+int IoMapFile( LPCTSTR fName, IoMap* pMap )
+{
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    UINT64 size = 0;
+
+    pMap->data = NULL;
+    pMap->size = 0;
+    pMap->hMap = NULL;
+
+    hFile = IoOpenFile( fName );
+    if ( hFile == INVALID_HANDLE_VALUE )
+        return FALSE;
+
+    if ( !IoFileSize( hFile, &size ) || size > ( SIZE_T )-1 )
+    {
+        CloseHandle( hFile );
+        return FALSE;
+    }
+
+    // Empty files cannot be mapped
+    if ( size == 0 )
+    {
+        CloseHandle( hFile );
+        pMap->data = "";
+        return TRUE;
+    }
+
+    pMap->hMap = CreateFileMapping( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+
+    // The mapping keeps the file open
+    CloseHandle( hFile );
+
+    if ( pMap->hMap == NULL )
+        return FALSE;
+
+    pMap->data = ( const char* )MapViewOfFile( pMap->hMap, FILE_MAP_READ,
+        0, 0, 0 );
+
+    if ( pMap->data == NULL )
+    {
+        CloseHandle( pMap->hMap );
+        pMap->hMap = NULL;
+        return FALSE;
+    }
+
+    pMap->size = ( size_t )size;
+
+    return TRUE;
+}
+
+void IoUnmapFile( IoMap* pMap )
+{
+    if ( pMap->hMap != NULL )
+    {
+        UnmapViewOfFile( pMap->data );
+        CloseHandle( pMap->hMap );
+    }
+
+    pMap->data = NULL;
+    pMap->size = 0;
+    pMap->hMap = NULL;
+}
+
+// Overlapped read of the whole buffer
+int IoStartRead( IoAsyncRead* pRead, LPCTSTR fName, char* buf,
+    size_t size )
+{
+    DWORD err;
+
+    pRead->data = buf;
+    pRead->size = size;
+
+    pRead->hFile = CreateFile( fName, GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    if ( pRead->hFile == INVALID_HANDLE_VALUE )
+        return FALSE;
+
+    memset( &pRead->ov, 0, sizeof( OVERLAPPED ) );
+
+    if ( !ReadFile( pRead->hFile, buf, ( DWORD )size, NULL, &pRead->ov ) )
+    {
+        err = GetLastError();
+
+        // Empty file: nothing to read
+        if ( err != ERROR_IO_PENDING && err != ERROR_HANDLE_EOF )
+        {
+            CloseHandle( pRead->hFile );
+            pRead->hFile = INVALID_HANDLE_VALUE;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+int IoFinishRead( IoAsyncRead* pRead, size_t* pGot )
+{
+    DWORD bytes = 0;
+    BOOL ok;
+
+    ok = GetOverlappedResult( pRead->hFile, &pRead->ov, &bytes, TRUE ) ||
+        GetLastError() == ERROR_HANDLE_EOF;
+
+    CloseHandle( pRead->hFile );
+    pRead->hFile = INVALID_HANDLE_VALUE;
+
+    *pGot = bytes;
+
+    return ok;
+}
+
+IoFile IoLockFile( LPCTSTR fName )
+{
+    HANDLE hLock = INVALID_HANDLE_VALUE;
+    OVERLAPPED ovLock = { 0 };
+
+    hLock = CreateFile( fName, GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+
+    if ( hLock == INVALID_HANDLE_VALUE )
+        return INVALID_HANDLE_VALUE;
+
+    if ( !LockFileEx( hLock, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ovLock ) )
+    {
+        CloseHandle( hLock );
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return hLock;
+}
+
+void IoUnlockFile( IoFile hLock )
+{
+    OVERLAPPED ovLock = { 0 };
+
+    UnlockFileEx( hLock, 0, 1, 0, &ovLock );
+    CloseHandle( hLock );
+}
+
+int IoRename( LPCTSTR oldName, LPCTSTR newName )
+{
+    return MoveFileEx( oldName, newName,
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+}
+
+int IoDelete( LPCTSTR fName )
+{
+    return DeleteFile( fName );
+}
+
+int IoCreateDir( LPCTSTR path )
+{
+    return CreateDirectory( path, NULL ) ||
+        GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+int IoStartWatch( IoWatch* pWatch, LPCTSTR path )
+{
+    memset( pWatch, 0, sizeof( IoWatch ) );
+
+    pWatch->records = malloc( IO_WATCH_BUF );
+    pWatch->ov.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+    pWatch->hDir = CreateFile( path, FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL );
+
+    // Changes are queued by the system while we work
+    if ( pWatch->records == NULL || pWatch->ov.hEvent == NULL ||
+        pWatch->hDir == INVALID_HANDLE_VALUE ||
+        !ReadDirectoryChangesW( pWatch->hDir, pWatch->records, IO_WATCH_BUF,
+        FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+        FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &pWatch->ov, NULL ) )
+    {
+        IoStopWatch( pWatch );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int IoWaitWatch( IoWatch* pWatch, DWORD ms,
+    void ( *pfun )( LPCTSTR name, size_t len, void* ctx ), void* ctx )
+{
+    const FILE_NOTIFY_INFORMATION* pInfo = NULL;
+    const BYTE* records = ( const BYTE* )pWatch->records;
+    DWORD bytes = 0;
+    DWORD off = 0;
+    int result = IO_CHANGED;
+
+    if ( WaitForSingleObject( pWatch->ov.hEvent, ms ) != WAIT_OBJECT_0 )
+        return IO_TIMEOUT;
+
+    if ( !GetOverlappedResult( pWatch->hDir, &pWatch->ov, &bytes, FALSE ) )
+        return IO_ERROR;
+
+    // No records: more changes than the buffer holds
+    if ( bytes == 0 )
+        result = IO_LOST;
+    else
+    {
+        do
+        {
+            pInfo = ( const FILE_NOTIFY_INFORMATION* )( records + off );
+
+            ( *pfun )( pInfo->FileName,
+                pInfo->FileNameLength / sizeof( WCHAR ), ctx );
+
+            off += pInfo->NextEntryOffset;
+        } while ( pInfo->NextEntryOffset != 0 );
+    }
+
+    if ( !ReadDirectoryChangesW( pWatch->hDir, pWatch->records, IO_WATCH_BUF,
+        FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE |
+        FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &pWatch->ov, NULL ) )
+        return IO_ERROR;
+
+    return result;
+}
+
+void IoStopWatch( IoWatch* pWatch )
+{
+    if ( pWatch->hDir != INVALID_HANDLE_VALUE && pWatch->hDir != NULL )
+    {
+        CancelIo( pWatch->hDir );
+        CloseHandle( pWatch->hDir );
+    }
+
+    if ( pWatch->ov.hEvent != NULL )
+        CloseHandle( pWatch->ov.hEvent );
+
+    free( pWatch->records );
+
+    pWatch->hDir = INVALID_HANDLE_VALUE;
+    pWatch->ov.hEvent = NULL;
+    pWatch->records = NULL;
+}
+
+
+/* local functions */
+
+static void FromFindData( const WIN32_FIND_DATA* pInfo, IoEntry* pEntry )
+{
+    pEntry->size = ( ( UINT64 )pInfo->nFileSizeHigh << 32 ) |
+        pInfo->nFileSizeLow;
+    pEntry->ftLastWriteTime = pInfo->ftLastWriteTime;
+    pEntry->attrs = 0;
+
+    if ( pInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+        pEntry->attrs |= IO_ATTR_DIR;
+
+    if ( pInfo->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT )
+        pEntry->attrs |= IO_ATTR_LINK;
+}
+
+// Name ends with ext (any case), or no ext given
+static BOOL MatchExt( LPCTSTR name, LPCTSTR ext )
+{
+    size_t len = wcslen( name );
+    size_t lenExt;
+
+    if ( ext == NULL )
+        return TRUE;
+
+    lenExt = wcslen( ext );
+
+    return len > lenExt && _wcsicmp( name + len - lenExt, ext ) == 0;
+}
+
+#endif
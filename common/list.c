@@ -8,20 +8,39 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
 #include <wchar.h>
 #include "list.h"
+#include "io.h"
+
+#define     SORT_MIN_KEYS   ( 64 * MAX_PATH )   // Initial key arena [TCHARs]
+
+// One item to be sorted on its key (see SortList)
+typedef struct sortRec
+{
+    unsigned int ind;           // Item index
+    size_t offKey;              // Key in key arena
+    const TCHAR* key;
+} SortRec;
 
 /* local function prototype */
-static void CopyToNode( Item item, Node * pnode );
+static int MakeRoom( List* plist, size_t lenPath );
+static void CompactNames( List* plist );
+static void SortRecs( SortRec* recs, SortRec* tmpRecs, unsigned int ct );
 
 /* interface functions   */
 
 /* set the list to empty */
 void InitializeList( List* plist )
 {
-    plist->head = NULL;
-    plist->end = NULL;
+    plist->items = NULL;
     plist->iCount = 0;
+    plist->sizeItems = 0;
+    plist->names = NULL;
+    plist->ctNames = 0;
+    plist->sizeNames = 0;
+    plist->ctDeadNames = 0;
     wmemset( plist->measureName, 0, _countof( plist->measureName ) );
 }
 
@@ -33,7 +52,7 @@ void IniListName( List* plist, TCHAR* mName )
 /* returns true if list is empty */
 int ListIsEmpty( const List* plist )
 {
-    if ( ( *plist ).head == NULL )
+    if ( plist->iCount == 0 )
         return true;
     else
         return false;
@@ -42,156 +61,378 @@ int ListIsEmpty( const List* plist )
 /* returns true if list is full */
 int ListIsFull( const List* plist )
 {
-    Node* pt;
+    Item* pt;
     int full;
 
-    // Create test node
-    pt = ( Node* )malloc( sizeof( Node ) );
+    // Create test item
+    pt = ( Item* )malloc( sizeof( Item ) );
 
     // Validate allocation
     if ( pt == NULL )
         full = true;
     else
         full = false;
-    
-    // Destroy test node
+
+    // Destroy test item
     free( pt );
 
     return full;
 }
 
-/* returns number of nodes */
+/* returns number of items */
 unsigned int ListItemCount( const List* plist )
 {
-    return ( *plist ).iCount;
-} 
+    return plist->iCount;
+}
 
-/* creates node to hold item and adds it to the end of */
-/* the list pointed to by plist (slow implementation)  */
-int AddItem( Item item, List* plist )
+/* copies item to the end of the array, */
+/* its path to the end of the arena     */
+int AddItem( const Item* pItem, LPCTSTR path, List* plist )
 {
-    // Declare new node
-    Node* pnew;
+    Item* pnew;
+    size_t lenPath = wcslen( path );
 
-    // Allocate mem for new node
-    pnew = ( Node* )malloc( sizeof( Node ) );
-    
-    // Validate allocation
-    if ( pnew == NULL )
+    // Make room for item and path
+    if ( !MakeRoom( plist, lenPath ) )
         return false;               // quit function on failure
 
-    // Fill up new node elements
-    CopyToNode( item, pnew );
-    pnew->next = NULL;              // New node will be the new end
+    // Fill up new item
+    pnew = &plist->items[ plist->iCount ];
+    *pnew = *pItem;                 /* structure copy */
+    pnew->offPath = ( unsigned int )plist->ctNames;
 
-    // Check for empty list
-    if ( ( *plist ).head == NULL )
-        // List is empty
-        ( *plist ).head = pnew;         // Point head to new node
-    else
-        // List has at least one node
-        ( ( *plist ).end )->next = pnew;    // Point current end to new node
-
-    // Update end pointer, point it to new node
-    ( *plist ).end = pnew;
+    wmemcpy( plist->names + plist->ctNames, path, lenPath + 1 );
+    plist->ctNames += lenPath + 1;
 
     // Increment items count
-    ++( *plist ).iCount;
+    ++plist->iCount;
 
     return true;
 }
 
-/* visit each node and execute function pointed to by pfun */
-void Traverse( List* plist, void ( *pfun )( Item* pItem ) )
+/* copies item into the array at ind, */
+/* its path to the end of the arena    */
+int InsertItem( const Item* pItem, LPCTSTR path, unsigned int ind,
+    List* plist )
 {
-    Node* pnode = ( *plist ).head;      /* set to start of list   */
+    Item* pnew;
+    size_t lenPath = wcslen( path );
 
-    while ( pnode != NULL )
-    {
-        ( *pfun )( &pnode->item );      /* apply function to item */
-        pnode = pnode->next;            /* advance to next item   */
-    }
+    // Make room for item and path
+    if ( !MakeRoom( plist, lenPath ) )
+        return false;
+
+    // Later items move up one
+    memmove( &plist->items[ ind + 1 ], &plist->items[ ind ],
+        ( plist->iCount - ind ) * sizeof( Item ) );
+
+    pnew = &plist->items[ ind ];
+    *pnew = *pItem;
+    pnew->offPath = ( unsigned int )plist->ctNames;
+
+    wmemcpy( plist->names + plist->ctNames, path, lenPath + 1 );
+    plist->ctNames += lenPath + 1;
+
+    ++plist->iCount;
+
+    return true;
+}
+
+void RemoveItem( unsigned int ind, List* plist )
+{
+    // Path stays in the arena until compacted
+    plist->ctDeadNames += wcslen( ItemPath( plist, &plist->items[ ind ] ) ) + 1;
+
+    memmove( &plist->items[ ind ], &plist->items[ ind + 1 ],
+        ( plist->iCount - ind - 1 ) * sizeof( Item ) );
+
+    --plist->iCount;
+
+    if ( plist->ctDeadNames > plist->ctNames / 2 )
+        CompactNames( plist );
 }
 
-void TraverseToFile( List* plist, FILE* filePt,
-    void ( *pfun )( FILE* outKml, Item* pitem ) )
+/* binary search on keys, then exact path among equal keys */
+int FindItem( const List* plist, LPCTSTR path,
+    size_t ( *keyFun )( const Item* pItem, LPCTSTR path, TCHAR* key ),
+    unsigned int* pInd )
 {
-    Node* pnode = ( *plist ).head;      /* set to start of list   */
+    TCHAR key[ SORT_KEY ] = { 0 };
+    TCHAR keyMid[ SORT_KEY ] = { 0 };
+    Item probe = { 0 };
+    unsigned int lo = 0;
+    unsigned int hi = plist->iCount;
+    unsigned int mid;
+    int cmp;
+
+    ( *keyFun )( &probe, path, key );
+
+    // First item with key not below path's key
+    while ( lo < hi )
+    {
+        mid = lo + ( hi - lo ) / 2;
+        ( *keyFun )( &plist->items[ mid ],
+            ItemPath( plist, &plist->items[ mid ] ), keyMid );
+
+        if ( wcscmp( keyMid, key ) < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    while ( pnode != NULL )
+    // Same key: same path? Else insert in path order
+    *pInd = plist->iCount;
+    for ( ; lo < plist->iCount; lo++ )
     {
-        ( *pfun )( filePt, &pnode->item );  /* apply function to item */
-        pnode = pnode->next;                /* advance to next item   */
+        ( *keyFun )( &plist->items[ lo ],
+            ItemPath( plist, &plist->items[ lo ] ), keyMid );
+
+        if ( wcscmp( keyMid, key ) != 0 )
+            break;
+
+        // Case-folded key, but A.nmea and a.nmea are two files on POSIX
+        cmp = IoPathCmp( ItemPath( plist, &plist->items[ lo ] ), path );
+
+        if ( cmp == 0 )
+        {
+            *pInd = lo;
+            return true;
+        }
+
+        if ( cmp > 0 && *pInd == plist->iCount )
+            *pInd = lo;
     }
+
+    if ( *pInd == plist->iCount )
+        *pInd = lo;
+
+    return false;
+}
+
+LPCTSTR ItemPath( const List* plist, const Item* pItem )
+{
+    return plist->names + pItem->offPath;
+}
+
+/* visit each item and execute function pointed to by pfun */
+void Traverse( List* plist, void ( *pfun )( Item* pItem, LPCTSTR path ) )
+{
+    Item* pItem = plist->items;
+    Item* pEnd = plist->items + plist->iCount;
+
+    for ( ; pItem < pEnd; pItem++ )
+        ( *pfun )( pItem, plist->names + pItem->offPath );
+}
+
+void TraverseToFile( List* plist, BufOut* pOut,
+    void ( *pfun )( BufOut* pOut, Item* pitem, LPCTSTR path ) )
+{
+    Item* pItem = plist->items;
+    Item* pEnd = plist->items + plist->iCount;
+
+    for ( ; pItem < pEnd; pItem++ )
+        ( *pfun )( pOut, pItem, plist->names + pItem->offPath );
 }
 
 /* free memory allocated by malloc() */
 /* reset list structure              */
 void EmptyTheList( List* plist )
 {
-    Node* tmp;
+    free( plist->items );
+    free( plist->names );
 
-    while ( ( *plist ).head != NULL )
+    InitializeList( plist );
+}
+
+/* sort list on keys computed once per item */
+int SortList( List* plist,
+    size_t ( *keyFun )( const Item* pItem, LPCTSTR path, TCHAR* key ) )
+{
+    TCHAR keyBuf[ SORT_KEY ] = { 0 };
+    TCHAR* keys = NULL;
+    TCHAR* tmpKeys = NULL;
+    size_t ctKeys = 0;
+    size_t sizeKeys = SORT_MIN_KEYS;
+    size_t lenKey = 0;
+    SortRec* recs = NULL;
+    Item* sorted = NULL;
+    unsigned int i;
+
+    if ( plist->iCount < 2 )
+        return true;
+
+    // Records and their merge buffer in one block
+    recs = ( SortRec* )malloc( 2 * plist->iCount * sizeof( SortRec ) );
+    keys = ( TCHAR* )malloc( sizeKeys * sizeof( TCHAR ) );
+    sorted = ( Item* )malloc( plist->sizeItems * sizeof( Item ) );
+
+    if ( recs == NULL || keys == NULL || sorted == NULL )
     {
-        tmp = ( ( *plist ).head )->next;    /* save address of next node */
-        free( ( *plist ).head );            /* free current node         */
-        ( *plist ).head = tmp;              /* advance to next node      */
+        free( recs );
+        free( keys );
+        free( sorted );
+        return false;
     }
 
-    // Reset end pointer
-    ( *plist ).end = NULL;
+    // Compute keys into one arena
+    for ( i = 0; i < plist->iCount; i++ )
+    {
+        lenKey = ( *keyFun )( &plist->items[ i ],
+            plist->names + plist->items[ i ].offPath, keyBuf );
 
-    // Reset items count
-    ( *plist ).iCount = 0;
+        if ( ctKeys + lenKey + 1 > sizeKeys )
+        {
+            tmpKeys = ( TCHAR* )realloc( keys,
+                2 * ( sizeKeys + lenKey + 1 ) * sizeof( TCHAR ) );
+
+            if ( tmpKeys == NULL )
+            {
+                free( recs );
+                free( keys );
+                free( sorted );
+                return false;
+            }
+
+            keys = tmpKeys;
+            sizeKeys = 2 * ( sizeKeys + lenKey + 1 );
+        }
 
-    // Reset measurement name
-    wmemset( plist->measureName, 0, _countof( plist->measureName ) );
-}
+        wmemcpy( keys + ctKeys, keyBuf, lenKey );
+        keys[ ctKeys + lenKey ] = TEXT( '\0' );
 
-/* local function definition  */
-/* copies an item into a node */
-static void CopyToNode( Item item, Node* pnode )
-{
-    pnode->item = item;         /* structure copy */
+        recs[ i ].ind = i;
+        recs[ i ].offKey = ctKeys;
+        ctKeys += lenKey + 1;
+    }
+
+    // Arena is complete: offsets to pointers
+    for ( i = 0; i < plist->iCount; i++ )
+        recs[ i ].key = keys + recs[ i ].offKey;
+
+    SortRecs( recs, recs + plist->iCount, plist->iCount );
+
+    // Items in sorted order (paths stay in place)
+    for ( i = 0; i < plist->iCount; i++ )
+        sorted[ i ] = plist->items[ recs[ i ].ind ];
+
+    free( plist->items );
+    plist->items = sorted;
+
+    free( recs );
+    free( keys );
+
+    return true;
 }
 
-/* swap nodes */
-void SwapNodes( Node* pN, Node* pM )
+/* local function definitions */
+
+/* grow items and arena, if needed, for one more item */
+static int MakeRoom( List* plist, size_t lenPath )
 {
-    Node tmpNode = { 0 };
+    Item* tmpItems = NULL;
+    TCHAR* tmpNames = NULL;
+    unsigned int sizeItems;
+    size_t sizeNames;
 
-    // Copy item of node M to node tmp
-    CopyToNode( pM->item, &tmpNode );
+    if ( plist->iCount == plist->sizeItems )
+    {
+        sizeItems = ( plist->sizeItems == 0 ) ?
+            LIST_MIN_ITEMS : 2 * plist->sizeItems;
+        tmpItems = ( Item* )realloc( plist->items, sizeItems * sizeof( Item ) );
+
+        if ( tmpItems == NULL )
+            return false;
+
+        plist->items = tmpItems;
+        plist->sizeItems = sizeItems;
+    }
+
+    if ( plist->ctNames + lenPath + 1 > plist->sizeNames )
+    {
+        sizeNames = ( plist->sizeNames == 0 ) ?
+            LIST_MIN_NAMES : 2 * plist->sizeNames;
 
-    // Copy item of node N to node M
-    CopyToNode( pN->item, pM );
+        while ( plist->ctNames + lenPath + 1 > sizeNames )
+            sizeNames *= 2;
+
+        // Offsets are unsigned int
+        if ( sizeNames > UINT_MAX )
+            return false;
+
+        tmpNames = ( TCHAR* )realloc( plist->names,
+            sizeNames * sizeof( TCHAR ) );
+
+        if ( tmpNames == NULL )
+            return false;
+
+        plist->names = tmpNames;
+        plist->sizeNames = sizeNames;
+    }
 
-    // Copy item of node tmp to node N
-    CopyToNode( tmpNode.item, pN );
+    return true;
 }
 
-/* sort list, sorting order depends on cmpFun */
-/* cmpFun compares two items                  */
-void SortList( List* plist, int ( *cmpFun )( Item* pItemN, Item* pItemM ) )
+/* copy live paths to a new arena, in item order */
+/* unchanged if no memory                        */
+static void CompactNames( List* plist )
 {
-    Node* topPt = NULL;
-    Node* seekPt = NULL;
-    unsigned int top, seek;
+    TCHAR* names = NULL;
+    size_t ctNames = 0;
+    size_t lenPath;
+    unsigned int i;
 
-    topPt = plist->head;
+    names = ( TCHAR* )malloc( plist->sizeNames * sizeof( TCHAR ) );
+    if ( names == NULL )
+        return;
 
-    for ( top = 1; top < plist->iCount; top++ )
+    for ( i = 0; i < plist->iCount; i++ )
     {
-        seekPt = topPt->next;
+        lenPath = wcslen( plist->names + plist->items[ i ].offPath );
+        wmemcpy( names + ctNames, plist->names + plist->items[ i ].offPath,
+            lenPath + 1 );
+        plist->items[ i ].offPath = ( unsigned int )ctNames;
+        ctNames += lenPath + 1;
+    }
 
-        for ( seek = top + 1; seek <= plist->iCount; seek++ )
-        {
-            if ( ( *cmpFun )( &seekPt->item, &topPt->item ) == 1 )
-                SwapNodes( seekPt, topPt );
+    free( plist->names );
+    plist->names = names;
+    plist->ctNames = ctNames;
+    plist->ctDeadNames = 0;
+}
+
+/* bottom-up merge sort of records on keys (stable) */
+/* tmpRecs has room for ct records                  */
+static void SortRecs( SortRec* recs, SortRec* tmpRecs, unsigned int ct )
+{
+    SortRec* pFrom = recs;
+    SortRec* pTo = tmpRecs;
+    SortRec* pSwap = NULL;
+    unsigned int width, lo, mid, hi, l, r, k;
 
-            seekPt = seekPt->next;
+    for ( width = 1; width < ct; width *= 2 )
+    {
+        // Merge runs [ lo, mid ) and [ mid, hi )
+        for ( lo = 0; lo < ct; lo += 2 * width )
+        {
+            mid = ( lo + width < ct ) ? lo + width : ct;
+            hi = ( lo + 2 * width < ct ) ? lo + 2 * width : ct;
+
+            for ( l = lo, r = mid, k = lo; k < hi; k++ )
+            {
+                if ( l < mid &&
+                    ( r >= hi || wcscmp( pFrom[ l ].key, pFrom[ r ].key ) <= 0 ) )
+                    pTo[ k ] = pFrom[ l++ ];
+                else
+                    pTo[ k ] = pFrom[ r++ ];
+            }
         }
 
-        topPt = topPt->next;
+        pSwap = pFrom;
+        pFrom = pTo;
+        pTo = pSwap;
     }
-}
\ No newline at end of file
+
+    // Result ended up in the merge buffer
+    if ( pFrom != recs )
+        memcpy( recs, pFrom, ct * sizeof( SortRec ) );
+}
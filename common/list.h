@@ -1,6 +1,10 @@
 //
 // list.h
 //
+// Items are kept in one growable array, their paths in one growable
+// string arena (items refer to their path by offset), so adding an
+// item costs no malloc per item and traversing is a loop over memory.
+//
 // List ADT - Interface declarations
 //
 // Based on listing 17.3 ( 'list.h' - C Primer Plus - Prata - 5ed )
@@ -9,21 +13,29 @@
 #ifndef LIST_H_
 #define LIST_H_
 
-#include <windows.h>
+#include "platform.h"
+#include "bufOut.h"
 
 // Boolean definitions
 #define     false       0
 #define     true        1
 
-#define     COORDS      64
+#define     LIST_MIN_ITEMS  64                      // Initial size [items]
+#define     LIST_MIN_NAMES  ( 64 * 32 )             // Initial arena [TCHARs]
+#define     SORT_KEY    ( 2 * MAX_PATH + 1 )        // Max sort key [TCHARs]
 
 //================================================================
 // program-specific declarations
 //================================================================
 struct measurePt
 {
-    TCHAR coords[ COORDS ];
-    WIN32_FIND_DATA findInfo;
+    UINT64 size;                        // Size [bytes] (totals: sum)
+    FILETIME ftLastWriteTime;           // (totals: latest)
+    double lon;                         // Mean lon [deg]
+    double lat;                         // Mean lat [deg]
+    double alt;                         // Mean alt [m]
+    int ctMeas;                         // Accepted fixes
+    unsigned int offPath;               // Path in list's string arena
 };
 
 //================================================================
@@ -31,17 +43,15 @@ struct measurePt
 //================================================================
 typedef struct measurePt Item;
 
-typedef struct node
-{
-    Item item;
-    struct node* next;
-} Node;
-
 typedef struct list
 {
-    Node* head;
-    Node* end;
+    Item* items;                        // Items (contiguous)
     unsigned int iCount;                // Items count
+    unsigned int sizeItems;             // Capacity [items]
+    TCHAR* names;                       // String arena (paths)
+    size_t ctNames;                     // Used [TCHARs]
+    size_t sizeNames;                   // Capacity [TCHARs]
+    size_t ctDeadNames;                 // Paths of removed items [TCHARs]
     TCHAR measureName[ MAX_PATH ];      // Measurement name
 } List;
 
@@ -64,7 +74,7 @@ void IniListName( List* plist, TCHAR* mName );
 /* precondition:     plist points to an initialized list        */
 /* postconditions:   function returns True if list is empty     */
 /*                   and returns False otherwise                */
-int ListIsEmpty( const List* plist); 
+int ListIsEmpty( const List* plist);
 
 /* operation:        determine if list is full                  */
 /* precondition:     plist points to an initialized list        */
@@ -78,31 +88,67 @@ int ListIsFull( const List* plist );
 unsigned int ListItemCount( const List *plist );
 
 /* operation:        add item to end of list                    */
-/* preconditions:    item is an item to be added to list        */
+/* preconditions:    pItem points to the item to be added       */
+/*                   path points to the item's path             */
 /*                   plist points to an initialized list        */
-/* postconditions:   if possible, function adds item to end     */
-/*                   of list and returns True; otherwise the    */
-/*                   function returns False                     */
-int AddItem( Item item, List* plist );
+/* postconditions:   if possible, function copies item and path */
+/*                   to end of list and returns True; otherwise */
+/*                   the function returns False                 */
+int AddItem( const Item* pItem, LPCTSTR path, List* plist );
+
+/* operation:        insert item at a position                  */
+/* preconditions:    pItem points to the item to be inserted    */
+/*                   path points to the item's path             */
+/*                   ind <= number of items in list             */
+/* postconditions:   if possible, function copies item and path */
+/*                   to position ind (later items move up) and  */
+/*                   returns True; otherwise returns False      */
+int InsertItem( const Item* pItem, LPCTSTR path, unsigned int ind,
+    List* plist );
+
+/* operation:        remove item at a position                  */
+/* preconditions:    ind < number of items in list              */
+/* postconditions:   item is removed (later items move down),   */
+/*                   arena is compacted when mostly unused      */
+void RemoveItem( unsigned int ind, List* plist );
+
+/* operation:        find an item in a sorted list              */
+/* preconditions:    list is sorted by SortList() on keyFun     */
+/*                   path points to the item's path             */
+/* postconditions:   returns True and its position in pInd if   */
+/*                   an item has this path (case-insensitive    */
+/*                   on Win32 only);                            */
+/*                   otherwise returns False and the position   */
+/*                   the item would be inserted at (equal keys  */
+/*                   in path order)                             */
+int FindItem( const List* plist, LPCTSTR path,
+    size_t ( *keyFun )( const Item* pItem, LPCTSTR path, TCHAR* key ),
+    unsigned int* pInd );
+
+/* operation:        get the path of an item                    */
+/* preconditions:    pItem points to an item of the list        */
+/* postconditions:   returns the path (valid until next add)    */
+LPCTSTR ItemPath( const List* plist, const Item* pItem );
 
 /* operation:        apply a function to each item in list      */
 /* preconditions:    plist points to an initialized list        */
 /*                   pfun points to a function that takes an    */
-/*                   Item argument and has no return value      */
+/*                   Item argument and its path and has no      */
+/*                   return value                               */
 /* postcondition:    the function pointed to by pfun is         */
 /*                   executed once for each item in the list    */
-void Traverse( List* plist, void ( *pfun )( Item* pItem ) );
+void Traverse( List* plist, void ( *pfun )( Item* pItem, LPCTSTR path ) );
 
 /* operation:        apply a function to each item in list      */
 /* preconditions:    plist points to an initialized list        */
-/*                   filePt points to open output file          */
+/*                   pOut points to open output writer          */
 /*                   pfun points to a function that takes an    */
-/*                   Item argument and a pointer to open stream */
-/*                   file and has no return value               */
+/*                   Item argument, its path and a pointer to   */
+/*                   the output writer and has no return value  */
 /* postcondition:    the function pointed to by pfun is         */
 /*                   executed once for each item in the list    */
-void TraverseToFile( List* plist, FILE* filePt,
-    void ( *pfun )( FILE* outKml, Item* pitem ) );
+void TraverseToFile( List* plist, BufOut* pOut,
+    void ( *pfun )( BufOut* pOut, Item* pitem, LPCTSTR path ) );
 
 /* operation:        free allocated memory, if any              */
 /* precondition:     plist points to an initialized list        */
@@ -110,18 +156,18 @@ void TraverseToFile( List* plist, FILE* filePt,
 /*                   and the list is set to empty               */
 void EmptyTheList( List* plist );
 
-/* operation:        swap nodes                                 */
-/* precondition:     pN, pM valid pointers to nodes             */
-/* postconditions:   item component of nodes are swaped         */
-void SwapNodes( Node* pN, Node* pM );
-
-/* operation:        sort a list using a comparison function    */
-/* precondition:     plist points to non-empty list             */
-/*                   cmpFun points to comparison function       */
-/* postconditions:   the list is sorted,                        */
-/*                   the return values of cmpFun determine the  */
-/*                   sorting order                              */
-/*                   cmpFun compares two items                  */
-void SortList( List* plist, int ( *cmpFun )( Item* pItemN, Item* pItemM ) );
+/* operation:        sort a list on precomputed keys            */
+/* precondition:     plist points to an initialized list        */
+/*                   keyFun points to a function that writes    */
+/*                   the key of an item (at most SORT_KEY       */
+/*                   TCHARs, null included) and returns its     */
+/*                   length; keys are compared TCHAR by TCHAR   */
+/* postconditions:   keyFun was executed once per item, the     */
+/*                   list is sorted on ascending keys (equal    */
+/*                   items keep their order) and the function   */
+/*                   returns True; returns False if no memory   */
+/*                   (list is unchanged)                        */
+int SortList( List* plist,
+    size_t ( *keyFun )( const Item* pItem, LPCTSTR path, TCHAR* key ) );
 
 #endif
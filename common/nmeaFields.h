@@ -0,0 +1,69 @@
+//
+// nmeaFields.h -- field extractors generated from sentence schemas
+//
+// A schema lists the fields taken from a sentence as X( field No.,
+// destination member ), field 0 being the sentence type ("$GPGGA"):
+//
+//     #define     GGA_FIELDS( X )     X( 2, lat ) X( 9, alt )
+//
+//     NMEA_EXTRACTOR( ExtractGGA, HposFix, GGA_FIELDS )
+//
+// defines static void ExtractGGA( const char* line, HposFix* pDst ). The
+// extractor counts fields by position (empty fields count, as in
+// "$GPGSA,A,3,04,,,"), copies each listed one into its char array member
+// and stops after the last listed field or at the checksum ('*'). Its
+// switch on the field No. compiles to a jump table: a field added to a
+// schema costs one more case.
+//
+// Fields that do not fit their member are taken as empty.
+//
+// nmea Fields - Interface declarations
+//
+
+#ifndef _NMEAFIELDS_H_
+#define _NMEAFIELDS_H_
+
+#include <string.h>
+
+#define     NMEA_FIELD_SEPS     ",*"
+
+// Field as a null terminated string (empty if too long)
+#define     NMEA_COPY_FIELD( dst, src, len ) \
+    do { if ( ( len ) < sizeof( dst ) ) { \
+        memcpy( ( dst ), ( src ), ( len ) ); ( dst )[ len ] = '\0'; } \
+        else ( dst )[ 0 ] = '\0'; } while ( 0 )
+
+// One case of the extractor's switch
+#define     NMEA_FIELD_CASE( no, dst ) \
+    case ( no ): \
+        NMEA_COPY_FIELD( pDst->dst, pField, len ); \
+        ctTaken++; \
+        break;
+
+#define     NMEA_FIELD_ONE( no, dst )   + 1
+
+#define     NMEA_EXTRACTOR( name, type, FIELDS ) \
+static void name( const char* line, type* pDst ) \
+{ \
+    const char* pField = line; \
+    size_t len; \
+    int fieldNo, ctTaken = 0; \
+ \
+    for ( fieldNo = 0; ; fieldNo++ ) \
+    { \
+        len = strcspn( pField, NMEA_FIELD_SEPS ); \
+ \
+        switch ( fieldNo ) \
+        { \
+            FIELDS( NMEA_FIELD_CASE ) \
+        } \
+ \
+        if ( ctTaken == 0 FIELDS( NMEA_FIELD_ONE ) || \
+            pField[ len ] != ',' ) \
+            break; \
+ \
+        pField += len + 1; \
+    } \
+}
+
+#endif
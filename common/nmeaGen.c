@@ -0,0 +1,248 @@
+//
+// nmeaGen.c -- synthetic nmea data
+//
+// nmea Generator - Interface implementation
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "nmeaGen.h"
+#include "bufOut.h"
+
+#define     M_PER_DEG       111320.0    // Metres per deg of lat
+#define     SECS_PER_DAY    86400
+#define     CT_SATS_MAX     12          // Sat ids of a GSA sentence
+#define     GEOID_SEP       "47.0"      // Geoid separation of GGA [m]
+#define     PDOP_MIN        0.5
+#define     PDOP_MAX        99.99
+
+#define     PI              3.14159265358979323846
+
+/* protototypes for local functions */
+static double Uniform( NmeaGen* pGen );
+static double Gauss( NmeaGen* pGen );
+static double PdopLogNormal( NmeaGen* pGen );
+static int FmtCoord( char* dst, size_t size, double deg, int degDigits );
+static size_t EndSentence( NmeaGen* pGen, char* line, size_t len );
+
+/* function definitions */
+void NmeaGenDefaults( NmeaGenCfg* pCfg )
+{
+    memset( pCfg, 0, sizeof( NmeaGenCfg ) );
+
+    pCfg->lat = 47.376888;
+    pCfg->lon = -8.541694;
+    pCfg->alt = 408.0;
+    pCfg->drift = 0.02;
+    pCfg->noise = 1.5;
+    pCfg->pdop = 1.6;
+    pCfg->pdopSd = 0.4;
+    pCfg->corrupt = 0.0;
+    strcpy_s( pCfg->talkers[ 0 ], _countof( pCfg->talkers[ 0 ] ), "GP" );
+    pCfg->ctTalkers = 1;
+    pCfg->seed = 1;
+}
+
+void NmeaGenInit( NmeaGen* pGen, const NmeaGenCfg* pCfg )
+{
+    memset( pGen, 0, sizeof( NmeaGen ) );
+
+    pGen->cfg = *pCfg;
+
+    // xorshift state must not be 0
+    pGen->rng = pCfg->seed * 0x9E3779B97F4A7C15ULL;
+    if ( pGen->rng == 0 )
+        pGen->rng = 0x9E3779B97F4A7C15ULL;
+}
+
+size_t NmeaGenEpoch( NmeaGen* pGen, char* dst )
+{
+    const char* talker;
+    char lat[ 16 ], lon[ 16 ], timeStr[ 16 ], dateStr[ 8 ], sats[ 64 ];
+    double latDeg, lonDeg, alt, pdop;
+    int ctSats, i, secs, day, satLen;
+    size_t len = 0;
+
+    // True position walks, the fix adds noise
+    pGen->northM += pGen->cfg.drift * Gauss( pGen );
+    pGen->eastM += pGen->cfg.drift * Gauss( pGen );
+    pGen->upM += pGen->cfg.drift * Gauss( pGen );
+
+    latDeg = pGen->cfg.lat +
+        ( pGen->northM + pGen->cfg.noise * Gauss( pGen ) ) / M_PER_DEG;
+    lonDeg = pGen->cfg.lon +
+        ( pGen->eastM + pGen->cfg.noise * Gauss( pGen ) ) /
+        ( M_PER_DEG * cos( pGen->cfg.lat * PI / 180.0 ) );
+    alt = pGen->cfg.alt + pGen->upM + 1.5 * pGen->cfg.noise * Gauss( pGen );
+
+    pdop = PdopLogNormal( pGen );
+
+    // Fewer satellites, higher P-DOP
+    ctSats = ( int )( 14.0 - 4.0 * pdop );
+    if ( ctSats < 4 )
+        ctSats = 4;
+    if ( ctSats > CT_SATS_MAX )
+        ctSats = CT_SATS_MAX;
+
+    talker = pGen->cfg.talkers[
+        NmeaGenRand( &pGen->rng ) % pGen->cfg.ctTalkers ];
+
+    // One epoch per second, from 2026-01-01 (28 days cycle)
+    secs = ( int )( pGen->epoch % SECS_PER_DAY );
+    day = 1 + ( int )( ( pGen->epoch / SECS_PER_DAY ) % 28 );
+    _snprintf_s( timeStr, sizeof( timeStr ), _TRUNCATE, "%02d%02d%02d.00",
+        secs / 3600, ( secs / 60 ) % 60, secs % 60 );
+    _snprintf_s( dateStr, sizeof( dateStr ), _TRUNCATE, "%02d0126", day );
+
+    FmtCoord( lat, sizeof( lat ), latDeg, 2 );
+    FmtCoord( lon, sizeof( lon ), lonDeg, 3 );
+
+    // Sat ids, empty fields up to 12
+    for ( i = 0, satLen = 0; i < CT_SATS_MAX; i++ )
+        satLen += _snprintf_s( sats + satLen, sizeof( sats ) - satLen,
+            _TRUNCATE, i < ctSats ? "%02d," : ",", 2 + 3 * i );
+
+    len += EndSentence( pGen, dst + len, _snprintf_s( dst + len,
+        NMEAGEN_EPOCH_MAX - len, _TRUNCATE,
+        "$%sGGA,%s,%s,%c,%s,%c,1,%02d,%.1f,%.1f,M," GEOID_SEP ",M,,",
+        talker, timeStr, lat, latDeg < 0 ? 'S' : 'N', lon,
+        lonDeg < 0 ? 'W' : 'E', ctSats, 0.8 * pdop, alt ) );
+
+    len += EndSentence( pGen, dst + len, _snprintf_s( dst + len,
+        NMEAGEN_EPOCH_MAX - len, _TRUNCATE, "$%sGSA,A,3,%s%.2f,%.2f,%.2f",
+        talker, sats, pdop, 0.8 * pdop, 0.6 * pdop ) );
+
+    len += EndSentence( pGen, dst + len, _snprintf_s( dst + len,
+        NMEAGEN_EPOCH_MAX - len, _TRUNCATE,
+        "$%sRMC,%s,A,%s,%c,%s,%c,0.02,0.00,%s,,,A",
+        talker, timeStr, lat, latDeg < 0 ? 'S' : 'N', lon,
+        lonDeg < 0 ? 'W' : 'E', dateStr ) );
+
+    pGen->epoch++;
+
+    return len;
+}
+
+BOOL NmeaGenFile( LPCTSTR fName, const NmeaGenCfg* pCfg, UINT64 size )
+{
+    NmeaGen gen;
+    BufOut out;
+    CHAR* pDst;
+    UINT64 written = 0;
+    size_t len;
+
+    if ( !OpenBufOut( &out, fName ) )
+        return FALSE;
+
+    NmeaGenInit( &gen, pCfg );
+
+    while ( written < size )
+    {
+        if ( ( pDst = BufOutReserve( &out, NMEAGEN_EPOCH_MAX ) ) == NULL )
+            break;
+
+        len = NmeaGenEpoch( &gen, pDst );
+        BufOutCommit( &out, ( DWORD )len );
+        written += len;
+    }
+
+    return CloseBufOut( &out ) && written >= size;
+}
+
+UINT64 NmeaGenRand( UINT64* pState )
+{
+    UINT64 x = *pState;
+
+    // xorshift64*
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *pState = x;
+
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+/* local functions */
+
+// Uniform in ( 0, 1 )
+static double Uniform( NmeaGen* pGen )
+{
+    return ( ( NmeaGenRand( &pGen->rng ) >> 11 ) + 0.5 ) /
+        9007199254740992.0;
+}
+
+// Standard normal (Box-Muller)
+static double Gauss( NmeaGen* pGen )
+{
+    double u1 = Uniform( pGen );
+    double u2 = Uniform( pGen );
+
+    return sqrt( -2.0 * log( u1 ) ) * cos( 2.0 * PI * u2 );
+}
+
+// P-DOP of the configured mean and deviation
+static double PdopLogNormal( NmeaGen* pGen )
+{
+    double mean = pGen->cfg.pdop;
+    double var = pGen->cfg.pdopSd * pGen->cfg.pdopSd;
+    double sigma2 = log( 1.0 + var / ( mean * mean ) );
+    double pdop;
+
+    pdop = exp( log( mean ) - sigma2 / 2.0 + sqrt( sigma2 ) * Gauss( pGen ) );
+
+    if ( pdop < PDOP_MIN )
+        pdop = PDOP_MIN;
+    if ( pdop > PDOP_MAX )
+        pdop = PDOP_MAX;
+
+    return pdop;
+}
+
+// nmea coord ( d..dmm.mmmm ), sign goes to the hemisphere field
+static int FmtCoord( char* dst, size_t size, double deg, int degDigits )
+{
+    long long units;
+
+    // [1/10000 min]
+    units = ( long long )( fabs( deg ) * 600000.0 + 0.5 );
+
+    return _snprintf_s( dst, size, _TRUNCATE, "%0*lld%02lld.%04lld",
+        degDigits, units / 600000, ( units % 600000 ) / 10000,
+        units % 10000 );
+}
+
+// Checksum and line end, then corrupt at the configured rate
+// Returns the final length
+static size_t EndSentence( NmeaGen* pGen, char* line, size_t len )
+{
+    BYTE sum = 0;
+    size_t i, pos;
+
+    for ( i = 1; i < len; i++ )
+        sum ^= ( BYTE )line[ i ];
+
+    len += _snprintf_s( line + len, 8, _TRUNCATE, "*%02X\r\n", sum );
+
+    if ( pGen->cfg.corrupt <= 0.0 ||
+        Uniform( pGen ) * 100.0 >= pGen->cfg.corrupt )
+        return len;
+
+    pos = 1 + ( size_t )( NmeaGenRand( &pGen->rng ) % ( len - 3 ) );
+
+    switch ( NmeaGenRand( &pGen->rng ) % 3 )
+    {
+    case 0:     // Flipped char
+        line[ pos ] = ( char )( '0' + NmeaGenRand( &pGen->rng ) % 43 );
+        return len;
+
+    case 1:     // Cut off
+        line[ pos ] = '\r';
+        line[ pos + 1 ] = '\n';
+        return pos + 2;
+
+    default:    // Lost
+        return 0;
+    }
+}
@@ -0,0 +1,75 @@
+//
+// nmeaGen.h -- synthetic nmea data
+//
+// Writes GGA, GSA and RMC epochs (one per second) of a receiver that
+// stands still: the true position drifts slowly (random walk), each
+// fix adds gaussian noise, P-DOP is log-normal. Talkers are picked per
+// epoch, a rate of sentences is corrupted. The output is reproducible
+// from the seed, so benchmarks run on the same data every time.
+//
+// nmea Generator - Interface declarations
+//
+
+#ifndef _NMEAGEN_H_
+#define _NMEAGEN_H_
+
+#include "platform.h"
+
+#define     NMEAGEN_EPOCH_MAX   512     // Max bytes of one epoch
+#define     NMEAGEN_TALKERS     4       // Max talkers per config
+
+typedef struct nmeaGenCfg
+{
+    double lat;                 // Start position [deg]
+    double lon;                 // [deg]
+    double alt;                 // [m]
+    double drift;               // Walk of the true position [m/epoch]
+    double noise;               // Noise of single fixes (1 sigma) [m]
+    double pdop;                // Mean P-DOP
+    double pdopSd;              // Standard deviation of P-DOP
+    double corrupt;             // Corrupted sentences [%]
+    char talkers[ NMEAGEN_TALKERS ][ 3 ];   // "GP", "GN", "GL", ...
+    int ctTalkers;
+    UINT64 seed;
+} NmeaGenCfg;
+
+typedef struct nmeaGen
+{
+    NmeaGenCfg cfg;
+    UINT64 rng;                 // Random state (xorshift)
+    double northM;              // True position from start [m]
+    double eastM;
+    double upM;
+    UINT64 epoch;               // Epochs written
+} NmeaGen;
+
+/* function prototypes */
+
+/* operation:      set a config to the defaults        */
+/* postconditions: one talker ("GP"), no corruption,   */
+/*                 seed 1                              */
+void NmeaGenDefaults( NmeaGenCfg* pCfg );
+
+/* operation:      start a generator                   */
+/* preconditions:  pCfg points to a config, at least   */
+/*                 one talker                          */
+void NmeaGenInit( NmeaGen* pGen, const NmeaGenCfg* pCfg );
+
+/* operation:      write the next epoch                */
+/* preconditions:  dst holds NMEAGEN_EPOCH_MAX bytes   */
+/* postconditions: returns the bytes written (lines    */
+/*                 end with "\r\n", not terminated)    */
+size_t NmeaGenEpoch( NmeaGen* pGen, char* dst );
+
+/* operation:      write a nmea file                   */
+/* preconditions:  size is the min file size [bytes]   */
+/* postconditions: whole epochs are written until size */
+/*                 is reached, returns true on success,*/
+/*                 false on error (reported)           */
+BOOL NmeaGenFile( LPCTSTR fName, const NmeaGenCfg* pCfg, UINT64 size );
+
+/* operation:      next pseudo-random number           */
+/* preconditions:  *pState is not 0                    */
+UINT64 NmeaGenRand( UINT64* pState );
+
+#endif
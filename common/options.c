@@ -4,9 +4,10 @@
 //  Based on 'Windows System Programming - Hart - 4Ed'
 //  ( '..\WSP4_Examples\UTILITY\OPTIONS.C' )
 //
-//  Utility function to extract option flags from the command line.
+//  Utility functions to extract option flags and "key=value" settings
+//  from the command line.
 
-#include <windows.h>
+#include "platform.h"
 #include <wchar.h>
 
 /*
@@ -20,6 +21,7 @@
 
     These flags are set if and only if the corresponding option
     character occurs in argv[1], argv[2], ...
+    Long options ( "--name" ) are skipped, see OptionLong().
 
     The return value is the argv index of the first argument
     beyond the options. */
@@ -55,7 +57,8 @@ DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... )
             {
                 // Search option No. iflag in argv No. iArg
                 // (find wchar in buffer)
-                *pFlag = wmemchr( argv[ iArg ],
+                *pFlag = argv[ iArg ][ 1 ] != TEXT( '-' ) &&
+                         wmemchr( argv[ iArg ],
                                   OptStr[ iFlag ],
                                   wcslen( argv[ iArg ] ) ) != NULL;
             }
@@ -78,3 +81,47 @@ DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... )
 
     return iArg;
 }
+
+/*
+    Long options are "--name" arguments among the options.
+
+    The return value is TRUE if and only if "--name" occurs in
+    argv[1], argv[2], ... */
+BOOL OptionLong( int argc, LPCWSTR argv[], LPCWSTR name )
+{
+    int iArg;
+
+    for ( iArg = 1;
+          ( iArg < argc ) &&
+          ( argv[ iArg ][ 0 ] == TEXT( '-' ) );
+          iArg++ )
+    {
+        if ( argv[ iArg ][ 1 ] == TEXT( '-' ) &&
+            wcscmp( argv[ iArg ] + 2, name ) == 0 )
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+    Settings follow the options as "key=value" arguments,
+    starting at argv[ iFirst ].
+
+    The return value is the value of the last setting of key,
+    NULL if key is not set. */
+LPCWSTR OptionValue( int argc, LPCWSTR argv[], int iFirst, LPCWSTR key )
+{
+    LPCWSTR value = NULL;
+    size_t lenKey = wcslen( key );
+    int iArg;
+
+    for ( iArg = iFirst; iArg < argc; iArg++ )
+    {
+        if ( _wcsnicmp( argv[ iArg ], key, lenKey ) == 0 &&
+            argv[ iArg ][ lenKey ] == TEXT( '=' ) )
+            value = argv[ iArg ] + lenKey + 1;
+    }
+
+    return value;
+}
@@ -0,0 +1,246 @@
+//
+// packedRTree.c -- static packed Hilbert R-tree
+//
+// Packed R-tree - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "packedRTree.h"
+
+#define     MAX_LEVELS      64          // Levels of the tallest tree
+
+typedef struct hilbertRec
+{
+    UINT32 hilbert;                     // Key of the box's center
+    UINT32 ind;                         // Box before sorting
+} HilbertRec;
+
+/* protototypes for local functions */
+static UINT32 Hilbert( UINT32 x, UINT32 y );
+static int cmpHilbert( const void* pA, const void* pB );
+static void Expand( NodeItem* pBox, const NodeItem* pOther );
+
+/* function definitions */
+UINT64 RTreeNodes( UINT64 ctItems, WORD nodeSize )
+{
+    UINT64 n = ctItems;
+    UINT64 ctNodes = n;
+
+    // One level per pass, up to the root
+    do
+    {
+        n = ( n + nodeSize - 1 ) / nodeSize;
+        ctNodes += n;
+    } while ( n != 1 );
+
+    return ctNodes;
+}
+
+void RTreeExtent( const NodeItem* items, size_t ctItems,
+    NodeItem* pExtent )
+{
+    size_t i;
+
+    pExtent->minX = HUGE_VAL;
+    pExtent->minY = HUGE_VAL;
+    pExtent->maxX = -HUGE_VAL;
+    pExtent->maxY = -HUGE_VAL;
+    pExtent->offset = 0;
+
+    for ( i = 0; i < ctItems; i++ )
+        Expand( pExtent, &items[ i ] );
+}
+
+int HilbertSort( NodeItem* items, size_t ctItems, const NodeItem* pExtent )
+{
+    HilbertRec* recs = NULL;
+    NodeItem* sorted = NULL;
+    double width, height;
+    UINT32 x, y;
+    size_t i;
+
+    recs = ( HilbertRec* )malloc( ctItems * sizeof( HilbertRec ) );
+    sorted = ( NodeItem* )malloc( ctItems * sizeof( NodeItem ) );
+
+    if ( recs == NULL || sorted == NULL )
+    {
+        free( recs );
+        free( sorted );
+        return FALSE;
+    }
+
+    width = pExtent->maxX - pExtent->minX;
+    height = pExtent->maxY - pExtent->minY;
+
+    // Centers on a RTREE_HILBERT_MAX grid over the extent
+    for ( i = 0; i < ctItems; i++ )
+    {
+        x = 0;
+        y = 0;
+
+        if ( width != 0.0 )
+            x = ( UINT32 )floor( RTREE_HILBERT_MAX *
+                ( ( items[ i ].minX + items[ i ].maxX ) / 2 -
+                pExtent->minX ) / width );
+
+        if ( height != 0.0 )
+            y = ( UINT32 )floor( RTREE_HILBERT_MAX *
+                ( ( items[ i ].minY + items[ i ].maxY ) / 2 -
+                pExtent->minY ) / height );
+
+        recs[ i ].hilbert = Hilbert( x, y );
+        recs[ i ].ind = ( UINT32 )i;
+    }
+
+    qsort( recs, ctItems, sizeof( HilbertRec ), cmpHilbert );
+
+    for ( i = 0; i < ctItems; i++ )
+        sorted[ i ] = items[ recs[ i ].ind ];
+
+    memcpy( items, sorted, ctItems * sizeof( NodeItem ) );
+
+    free( recs );
+    free( sorted );
+
+    return TRUE;
+}
+
+NodeItem* BuildRTree( const NodeItem* leaves, size_t ctItems,
+    WORD nodeSize )
+{
+    UINT64 levelStart[ MAX_LEVELS ];
+    UINT64 levelNodes[ MAX_LEVELS ];
+    UINT64 ctNodes, n, pos, end, newPos;
+    NodeItem* nodes = NULL;
+    int ctLevels = 0;
+    int i, j;
+
+    ctNodes = RTreeNodes( ctItems, nodeSize );
+
+    nodes = ( NodeItem* )malloc( ( size_t )ctNodes * sizeof( NodeItem ) );
+    if ( nodes == NULL )
+        return NULL;
+
+    // Nodes per level, leaves first
+    n = ctItems;
+    levelNodes[ ctLevels++ ] = n;
+
+    do
+    {
+        n = ( n + nodeSize - 1 ) / nodeSize;
+        levelNodes[ ctLevels++ ] = n;
+    } while ( n != 1 );
+
+    // Levels are stored root first
+    n = ctNodes;
+    for ( i = 0; i < ctLevels; i++ )
+    {
+        n -= levelNodes[ i ];
+        levelStart[ i ] = n;
+    }
+
+    memcpy( nodes + levelStart[ 0 ], leaves, ctItems * sizeof( NodeItem ) );
+
+    // Each level's nodes enclose nodeSize nodes of the level below
+    for ( i = 0; i < ctLevels - 1; i++ )
+    {
+        pos = levelStart[ i ];
+        end = pos + levelNodes[ i ];
+        newPos = levelStart[ i + 1 ];
+
+        while ( pos < end )
+        {
+            RTreeExtent( nodes + pos, 0, &nodes[ newPos ] );
+            nodes[ newPos ].offset = pos;
+
+            for ( j = 0; j < nodeSize && pos < end; j++ )
+                Expand( &nodes[ newPos ], &nodes[ pos++ ] );
+
+            newPos++;
+        }
+    }
+
+    return nodes;
+}
+
+
+/* local functions */
+
+// Hilbert value of a point on a 16 bit grid
+// ( branch-free, after 'Fast Hilbert curve generation' - rawrunprotected )
+static UINT32 Hilbert( UINT32 x, UINT32 y )
+{
+    UINT32 a = x ^ y;
+    UINT32 b = 0xFFFF ^ a;
+    UINT32 c = 0xFFFF ^ ( x | y );
+    UINT32 d = x & ( y ^ 0xFFFF );
+    UINT32 A, B, C, D;
+    UINT32 i0, i1;
+
+    A = a | ( b >> 1 );
+    B = ( a >> 1 ) ^ a;
+    C = ( ( c >> 1 ) ^ ( b & ( d >> 1 ) ) ) ^ c;
+    D = ( ( a & ( c >> 1 ) ) ^ ( d >> 1 ) ) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ( a & ( a >> 2 ) ) ^ ( b & ( b >> 2 ) );
+    B = ( a & ( b >> 2 ) ) ^ ( b & ( ( a ^ b ) >> 2 ) );
+    C ^= ( a & ( c >> 2 ) ) ^ ( b & ( d >> 2 ) );
+    D ^= ( b & ( c >> 2 ) ) ^ ( ( a ^ b ) & ( d >> 2 ) );
+
+    a = A; b = B; c = C; d = D;
+    A = ( a & ( a >> 4 ) ) ^ ( b & ( b >> 4 ) );
+    B = ( a & ( b >> 4 ) ) ^ ( b & ( ( a ^ b ) >> 4 ) );
+    C ^= ( a & ( c >> 4 ) ) ^ ( b & ( d >> 4 ) );
+    D ^= ( b & ( c >> 4 ) ) ^ ( ( a ^ b ) & ( d >> 4 ) );
+
+    a = A; b = B; c = C; d = D;
+    C ^= ( a & ( c >> 8 ) ) ^ ( b & ( d >> 8 ) );
+    D ^= ( b & ( c >> 8 ) ) ^ ( ( a ^ b ) & ( d >> 8 ) );
+
+    a = C ^ ( C >> 1 );
+    b = D ^ ( D >> 1 );
+
+    i0 = x ^ y;
+    i1 = b | ( 0xFFFF ^ ( i0 | a ) );
+
+    // Interleave bits
+    i0 = ( i0 | ( i0 << 8 ) ) & 0x00FF00FF;
+    i0 = ( i0 | ( i0 << 4 ) ) & 0x0F0F0F0F;
+    i0 = ( i0 | ( i0 << 2 ) ) & 0x33333333;
+    i0 = ( i0 | ( i0 << 1 ) ) & 0x55555555;
+
+    i1 = ( i1 | ( i1 << 8 ) ) & 0x00FF00FF;
+    i1 = ( i1 | ( i1 << 4 ) ) & 0x0F0F0F0F;
+    i1 = ( i1 | ( i1 << 2 ) ) & 0x33333333;
+    i1 = ( i1 | ( i1 << 1 ) ) & 0x55555555;
+
+    return ( i1 << 1 ) | i0;
+}
+
+// Descending Hilbert value, then input order
+static int cmpHilbert( const void* pA, const void* pB )
+{
+    const HilbertRec* a = ( const HilbertRec* )pA;
+    const HilbertRec* b = ( const HilbertRec* )pB;
+
+    if ( a->hilbert != b->hilbert )
+        return ( a->hilbert > b->hilbert ) ? -1 : 1;
+
+    return ( a->ind > b->ind ) - ( a->ind < b->ind );
+}
+
+static void Expand( NodeItem* pBox, const NodeItem* pOther )
+{
+    if ( pOther->minX < pBox->minX )
+        pBox->minX = pOther->minX;
+    if ( pOther->minY < pBox->minY )
+        pBox->minY = pOther->minY;
+    if ( pOther->maxX > pBox->maxX )
+        pBox->maxX = pOther->maxX;
+    if ( pOther->maxY > pBox->maxY )
+        pBox->maxY = pOther->maxY;
+}
@@ -0,0 +1,63 @@
+//
+// packedRTree.h -- static packed Hilbert R-tree
+//
+// Index layout of FlatGeobuf: boxes are sorted on the Hilbert value
+// of their centers and packed bottom-up into nodes of nodeSize
+// children. All nodes live in one array, root first, leaves last;
+// a parent's offset is the index of its first child, a leaf's offset
+// is whatever the caller stored (e.g. a byte offset into a file).
+//
+// Packed R-tree - Interface declarations
+//
+
+#ifndef _PACKEDRTREE_H_
+#define _PACKEDRTREE_H_
+
+#include "platform.h"
+
+#define     RTREE_NODE_SIZE     16      // Default children per node
+#define     RTREE_HILBERT_MAX   0xFFFF  // Grid of Hilbert values
+
+typedef struct nodeItem
+{
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    UINT64 offset;          // Leaf: caller's data, node: first child
+} NodeItem;                 // 40 bytes, written as is
+
+/* function prototypes */
+
+/* operation:      count nodes of a tree               */
+/* preconditions:  ctItems > 0, nodeSize >= 2          */
+/* postconditions: returns total number of nodes       */
+/*                 (leaves included)                   */
+UINT64 RTreeNodes( UINT64 ctItems, WORD nodeSize );
+
+/* operation:      get the box enclosing all boxes     */
+/* preconditions:  items points to ctItems boxes       */
+/* postconditions: pExtent holds the enclosing box     */
+void RTreeExtent( const NodeItem* items, size_t ctItems,
+    NodeItem* pExtent );
+
+/* operation:      sort boxes along the Hilbert curve  */
+/* preconditions:  items points to ctItems boxes       */
+/*                 pExtent encloses all of them        */
+/* postconditions: boxes are sorted on descending      */
+/*                 Hilbert value of their centers      */
+/*                 (ties keep their order);            */
+/*                 returns false if no memory (boxes   */
+/*                 are unchanged)                      */
+int HilbertSort( NodeItem* items, size_t ctItems, const NodeItem* pExtent );
+
+/* operation:      build the tree over sorted leaves   */
+/* preconditions:  leaves points to ctItems sorted     */
+/*                 boxes ( ctItems > 0 )               */
+/* postconditions: returns RTreeNodes() nodes, root    */
+/*                 first, leaves copied last (caller   */
+/*                 frees); NULL if no memory           */
+NodeItem* BuildRTree( const NodeItem* leaves, size_t ctItems,
+    WORD nodeSize );
+
+#endif
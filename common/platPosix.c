@@ -0,0 +1,781 @@
+//
+// platPosix.c -- system base of the tools on POSIX systems
+//
+// Platform - Interface implementation (POSIX)
+//
+
+#ifndef _WIN32
+
+#include <locale.h>
+#include <time.h>
+#include <unistd.h>
+#include "platform.h"
+
+#define     FMT_MAX         1024            // Translated format [wchar_t]
+#define     OUT_LINE        1024            // Output on the stack [wchar_t]
+#define     OUT_MAX         ( 1024 * 1024 ) // Longest output [wchar_t]
+
+#define     FT_PER_SEC      10000000LL      // FILETIME units per [s]
+#define     FT_UNIX_SECS    11644473600LL   // 1601-01-01 to 1970-01-01 [s]
+
+#define     ESC_FIRST       0xDC80          // Bytes that are no UTF-8
+#define     ESC_LAST        0xDCFF
+
+// Thread of _beginthreadex()
+typedef struct platThread
+{
+    pthread_t thread;
+    unsigned ( *pfun )( void* );
+    void* arg;
+    BOOL joined;
+} PlatThread;
+
+extern int wmain( int argc, wchar_t* argv[] );
+
+/* protototypes for local functions */
+static void* ThreadStart( void* pArg );
+static int FixFormat( const wchar_t* fmt, wchar_t* dst );
+static int PutWide( FILE* pStream, const wchar_t* fmt, va_list args );
+static size_t ToUtf8( const wchar_t* src, size_t len, char* dst,
+    size_t sizeDst, BOOL rawBytes );
+static size_t PutCodePoint( UINT32 cp, char* dst );
+static FILETIME ToFileTime( LONGLONG val );
+static LONGLONG FromFileTime( const FILETIME* pTime );
+
+/* function definitions */
+
+// Wide command line, as wmain() gets it on Windows
+int main( int argc, char* argv[] )
+{
+    wchar_t** argvW = NULL;
+    size_t ct;
+    int i;
+
+    setlocale( LC_CTYPE, "" );
+
+    argvW = ( wchar_t** )calloc( ( size_t )argc + 1, sizeof( wchar_t* ) );
+    if ( argvW == NULL )
+        return 1;
+
+    for ( i = 0; i < argc; i++ )
+    {
+        ct = strlen( argv[ i ] ) + 1;
+        argvW[ i ] = ( wchar_t* )malloc( ct * sizeof( wchar_t ) );
+
+        if ( argvW[ i ] == NULL ||
+            !PlatFromUtf8( argv[ i ], argvW[ i ], ct ) )
+            return 1;
+    }
+
+    return wmain( argc, argvW );
+}
+
+BOOL PlatSleepCondition( CONDITION_VARIABLE* pCv, CRITICAL_SECTION* pCs,
+    DWORD ms )
+{
+    struct timespec until;
+    int err;
+
+    if ( ms == INFINITE )
+        return pthread_cond_wait( pCv, pCs ) == 0;
+
+    clock_gettime( CLOCK_REALTIME, &until );
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += ( long )( ms % 1000 ) * 1000000;
+
+    if ( until.tv_nsec >= 1000000000 )
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    err = pthread_cond_timedwait( pCv, pCs, &until );
+    if ( err != 0 )
+    {
+        errno = err;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+uintptr_t _beginthreadex( void* security, unsigned stackSize,
+    unsigned ( *pfun )( void* ), void* arg, unsigned initFlag,
+    unsigned* pThreadId )
+{
+    PlatThread* pThread = NULL;
+    int err;
+
+    pThread = ( PlatThread* )calloc( 1, sizeof( PlatThread ) );
+    if ( pThread == NULL )
+        return 0;
+
+    pThread->pfun = pfun;
+    pThread->arg = arg;
+
+    err = pthread_create( &pThread->thread, NULL, ThreadStart, pThread );
+    if ( err != 0 )
+    {
+        free( pThread );
+        errno = err;
+        return 0;
+    }
+
+    if ( pThreadId != NULL )
+        *pThreadId = 0;
+
+    return ( uintptr_t )pThread;
+}
+
+// Waits until the thread has exited (ms is INFINITE)
+DWORD PlatWaitThread( HANDLE hThread, DWORD ms )
+{
+    PlatThread* pThread = ( PlatThread* )hThread;
+
+    if ( !pThread->joined )
+    {
+        pthread_join( pThread->thread, NULL );
+        pThread->joined = TRUE;
+    }
+
+    return WAIT_OBJECT_0;
+}
+
+BOOL PlatCloseThread( HANDLE hThread )
+{
+    PlatThread* pThread = ( PlatThread* )hThread;
+
+    if ( !pThread->joined )
+        pthread_detach( pThread->thread );
+
+    free( pThread );
+
+    return TRUE;
+}
+
+void GetSystemInfo( SYSTEM_INFO* pInfo )
+{
+    long ct = sysconf( _SC_NPROCESSORS_ONLN );
+
+    pInfo->dwNumberOfProcessors = ( ct > 0 ) ? ( DWORD )ct : 1;
+}
+
+DWORD GetTickCount( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( DWORD )( ( UINT64 )now.tv_sec * 1000 + now.tv_nsec / 1000000 );
+}
+
+BOOL QueryPerformanceCounter( LARGE_INTEGER* pCount )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    pCount->QuadPart = ( LONGLONG )now.tv_sec * 1000000000 + now.tv_nsec;
+
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency( LARGE_INTEGER* pFreq )
+{
+    pFreq->QuadPart = 1000000000;   // [ns]
+
+    return TRUE;
+}
+
+void GetLocalTime( SYSTEMTIME* pTime )
+{
+    struct timespec now;
+    struct tm local;
+
+    clock_gettime( CLOCK_REALTIME, &now );
+    localtime_r( &now.tv_sec, &local );
+
+    pTime->wYear = ( WORD )( local.tm_year + 1900 );
+    pTime->wMonth = ( WORD )( local.tm_mon + 1 );
+    pTime->wDayOfWeek = ( WORD )local.tm_wday;
+    pTime->wDay = ( WORD )local.tm_mday;
+    pTime->wHour = ( WORD )local.tm_hour;
+    pTime->wMinute = ( WORD )local.tm_min;
+    pTime->wSecond = ( WORD )local.tm_sec;
+    pTime->wMilliseconds = ( WORD )( now.tv_nsec / 1000000 );
+}
+
+LONG CompareFileTime( const FILETIME* pA, const FILETIME* pB )
+{
+    LONGLONG valA = FromFileTime( pA );
+    LONGLONG valB = FromFileTime( pB );
+
+    return ( valA > valB ) - ( valA < valB );
+}
+
+BOOL FileTimeToLocalFileTime( const FILETIME* pUtc, FILETIME* pLocal )
+{
+    LONGLONG val = FromFileTime( pUtc );
+    time_t secs = ( time_t )( val / FT_PER_SEC - FT_UNIX_SECS );
+    struct tm local;
+
+    if ( localtime_r( &secs, &local ) == NULL )
+        return FALSE;
+
+    *pLocal = ToFileTime( val + ( LONGLONG )local.tm_gmtoff * FT_PER_SEC );
+
+    return TRUE;
+}
+
+BOOL FileTimeToSystemTime( const FILETIME* pTime, SYSTEMTIME* pSysTime )
+{
+    LONGLONG val = FromFileTime( pTime );
+    time_t secs = ( time_t )( val / FT_PER_SEC - FT_UNIX_SECS );
+    struct tm utc;
+
+    if ( gmtime_r( &secs, &utc ) == NULL )
+        return FALSE;
+
+    pSysTime->wYear = ( WORD )( utc.tm_year + 1900 );
+    pSysTime->wMonth = ( WORD )( utc.tm_mon + 1 );
+    pSysTime->wDayOfWeek = ( WORD )utc.tm_wday;
+    pSysTime->wDay = ( WORD )utc.tm_mday;
+    pSysTime->wHour = ( WORD )utc.tm_hour;
+    pSysTime->wMinute = ( WORD )utc.tm_min;
+    pSysTime->wSecond = ( WORD )utc.tm_sec;
+    pSysTime->wMilliseconds = ( WORD )( val % FT_PER_SEC / 10000 );
+
+    return TRUE;
+}
+
+// CP_UTF8 only, no default char
+int WideCharToMultiByte( UINT codePage, DWORD flags, LPCWSTR src,
+    int ctSrc, CHAR* dst, int sizeDst, const CHAR* defChar,
+    BOOL* pUsedDef )
+{
+    char tmp[ 4 ];
+    size_t len = 0;
+    size_t ct;
+    int i;
+
+    if ( ctSrc < 0 )
+        ctSrc = ( int )wcslen( src ) + 1;
+
+    // Size needed
+    if ( sizeDst == 0 )
+    {
+        for ( i = 0; i < ctSrc; i++ )
+            len += PutCodePoint( ( UINT32 )src[ i ], tmp );
+
+        return ( int )len;
+    }
+
+    ct = ToUtf8( src, ( size_t )ctSrc, dst, ( size_t )sizeDst, FALSE );
+    if ( ct == ( size_t )-1 )
+    {
+        errno = ENOBUFS;
+        return 0;
+    }
+
+    return ( int )ct;
+}
+
+errno_t wcscpy_s( wchar_t* dst, size_t ctDst, const wchar_t* src )
+{
+    size_t len = wcslen( src );
+
+    if ( len >= ctDst )
+    {
+        dst[ 0 ] = L'\0';
+        return ERANGE;
+    }
+
+    wmemcpy( dst, src, len + 1 );
+
+    return 0;
+}
+
+errno_t wcscat_s( wchar_t* dst, size_t ctDst, const wchar_t* src )
+{
+    size_t lenDst = wcsnlen( dst, ctDst );
+
+    if ( lenDst == ctDst || wcscpy_s( dst + lenDst, ctDst - lenDst,
+        src ) != 0 )
+    {
+        dst[ 0 ] = L'\0';
+        return ERANGE;
+    }
+
+    return 0;
+}
+
+errno_t wcsncpy_s( wchar_t* dst, size_t ctDst, const wchar_t* src,
+    size_t ct )
+{
+    size_t len = wcsnlen( src, ct );
+
+    if ( len >= ctDst )
+    {
+        dst[ 0 ] = L'\0';
+        return ERANGE;
+    }
+
+    wmemcpy( dst, src, len );
+    dst[ len ] = L'\0';
+
+    return 0;
+}
+
+errno_t strcpy_s( char* dst, size_t sizeDst, const char* src )
+{
+    size_t len = strlen( src );
+
+    if ( len >= sizeDst )
+    {
+        dst[ 0 ] = '\0';
+        return ERANGE;
+    }
+
+    memcpy( dst, src, len + 1 );
+
+    return 0;
+}
+
+errno_t strcat_s( char* dst, size_t sizeDst, const char* src )
+{
+    size_t lenDst = strnlen( dst, sizeDst );
+
+    if ( lenDst == sizeDst || strcpy_s( dst + lenDst, sizeDst - lenDst,
+        src ) != 0 )
+    {
+        dst[ 0 ] = '\0';
+        return ERANGE;
+    }
+
+    return 0;
+}
+
+errno_t strncpy_s( char* dst, size_t sizeDst, const char* src,
+    size_t ct )
+{
+    size_t len = strnlen( src, ct );
+
+    if ( len >= sizeDst )
+    {
+        dst[ 0 ] = '\0';
+        return ERANGE;
+    }
+
+    memcpy( dst, src, len );
+    dst[ len ] = '\0';
+
+    return 0;
+}
+
+int _snprintf_s( char* dst, size_t sizeDst, size_t ct, const char* fmt,
+    ... )
+{
+    va_list args;
+    int len;
+
+    va_start( args, fmt );
+    len = _vsnprintf_s( dst, sizeDst, ct, fmt, args );
+    va_end( args );
+
+    return len;
+}
+
+// Truncated output returns -1 (ct is _TRUNCATE or a max length)
+int _vsnprintf_s( char* dst, size_t sizeDst, size_t ct, const char* fmt,
+    va_list args )
+{
+    size_t limit = sizeDst;
+    int len;
+
+    if ( ct != _TRUNCATE && ct < limit )
+        limit = ct + 1;
+
+    len = vsnprintf( dst, limit, fmt, args );
+
+    if ( len < 0 || ( size_t )len >= limit )
+        return -1;
+
+    return len;
+}
+
+int PlatWprintf( const wchar_t* fmt, ... )
+{
+    va_list args;
+    int len;
+
+    va_start( args, fmt );
+    len = PutWide( stdout, fmt, args );
+    va_end( args );
+
+    return len;
+}
+
+int PlatFwprintf( FILE* pStream, const wchar_t* fmt, ... )
+{
+    va_list args;
+    int len;
+
+    va_start( args, fmt );
+    len = PutWide( pStream, fmt, args );
+    va_end( args );
+
+    return len;
+}
+
+int PlatSwprintf( wchar_t* dst, size_t ctDst, const wchar_t* fmt, ... )
+{
+    va_list args;
+    int len;
+
+    va_start( args, fmt );
+    len = PlatVsnwprintf( dst, ctDst, _TRUNCATE, fmt, args );
+    va_end( args );
+
+    if ( len < 0 )
+        dst[ 0 ] = L'\0';
+
+    return len;
+}
+
+// Truncated output returns -1 (ct is _TRUNCATE or a max length)
+int PlatVsnwprintf( wchar_t* dst, size_t ctDst, size_t ct,
+    const wchar_t* fmt, va_list args )
+{
+    wchar_t fmtW[ FMT_MAX ];
+    size_t limit = ctDst;
+    int len;
+
+    if ( ct != _TRUNCATE && ct < limit )
+        limit = ct + 1;
+
+    if ( !FixFormat( fmt, fmtW ) )
+        return -1;
+
+    len = vswprintf( dst, limit, fmtW, args );
+
+    if ( len < 0 )
+    {
+        dst[ limit - 1 ] = L'\0';
+        return -1;
+    }
+
+    return len;
+}
+
+int PlatSystem( const wchar_t* cmd )
+{
+    size_t sizeCmd = 4 * wcslen( cmd ) + 1;
+    char* cmdU = ( char* )malloc( sizeCmd );
+    int status = -1;
+
+    if ( cmdU != NULL && PlatToUtf8( cmd, cmdU, sizeCmd ) )
+    {
+        // Output so far goes first
+        fflush( NULL );
+        status = system( cmdU );
+    }
+
+    free( cmdU );
+
+    return status;
+}
+
+int PlatToUtf8( LPCTSTR src, char* dst, size_t sizeDst )
+{
+    size_t len = ToUtf8( src, wcslen( src ) + 1, dst, sizeDst, TRUE );
+
+    return len != ( size_t )-1;
+}
+
+int PlatFromUtf8( const char* src, LPTSTR dst, size_t ctDst )
+{
+    const unsigned char* pCh = ( const unsigned char* )src;
+    size_t ct = 0;
+    UINT32 cp;
+    int ctCont, i;
+
+    for ( ;; )
+    {
+        if ( ct == ctDst )
+            return FALSE;
+
+        cp = *pCh;
+
+        if ( cp < 0x80 )
+            ctCont = 0;
+        else if ( cp >= 0xC2 && cp <= 0xDF )
+            ctCont = 1;
+        else if ( cp >= 0xE0 && cp <= 0xEF )
+            ctCont = 2;
+        else if ( cp >= 0xF0 && cp <= 0xF4 )
+            ctCont = 3;
+        else
+            ctCont = -1;
+
+        for ( i = 1; i <= ctCont; i++ )
+        {
+            if ( ( pCh[ i ] & 0xC0 ) != 0x80 )
+            {
+                ctCont = -1;
+                break;
+            }
+        }
+
+        if ( ctCont > 0 )
+        {
+            cp &= 0x3F >> ctCont;
+            for ( i = 1; i <= ctCont; i++ )
+                cp = ( cp << 6 ) | ( pCh[ i ] & 0x3F );
+
+            // Overlong, surrogate or out of range
+            if ( ( ctCont == 2 && cp < 0x800 ) ||
+                ( ctCont == 3 && ( cp < 0x10000 || cp > 0x10FFFF ) ) ||
+                ( cp >= 0xD800 && cp <= 0xDFFF ) )
+                ctCont = -1;
+        }
+
+        // No UTF-8: keep the byte
+        if ( ctCont < 0 )
+        {
+            cp = 0xDC00 + *pCh;
+            ctCont = 0;
+        }
+
+        dst[ ct++ ] = ( wchar_t )cp;
+
+        if ( cp == 0 )
+            return TRUE;
+
+        pCh += ctCont + 1;
+    }
+}
+
+
+/* local functions */
+
+static void* ThreadStart( void* pArg )
+{
+    PlatThread* pThread = ( PlatThread* )pArg;
+
+    ( *pThread->pfun )( pThread->arg );
+
+    return NULL;
+}
+
+// Microsoft wide format to C99 wide format
+// "%s" and "%c" are wide, "%S", "%C", "%hs" and "%hc" narrow
+// Returns false if too long
+static int FixFormat( const wchar_t* fmt, wchar_t* dst )
+{
+    wchar_t* pEnd = dst + FMT_MAX - 3;
+
+    while ( *fmt != L'\0' )
+    {
+        if ( dst >= pEnd )
+            return FALSE;
+
+        if ( *fmt != L'%' )
+        {
+            *dst++ = *fmt++;
+            continue;
+        }
+
+        // "%%" is a literal '%'
+        if ( fmt[ 1 ] == L'%' )
+        {
+            *dst++ = *fmt++;
+            *dst++ = *fmt++;
+            continue;
+        }
+
+        *dst++ = *fmt++;
+
+        // Flags, width, precision
+        while ( *fmt != L'\0' && wcschr( L"-+ #0123456789.*", *fmt ) &&
+            dst < pEnd )
+            *dst++ = *fmt++;
+
+        if ( ( *fmt == L'h' || *fmt == L'w' || *fmt == L'l' ) &&
+            ( fmt[ 1 ] == L's' || fmt[ 1 ] == L'c' ) )
+        {
+            if ( *fmt != L'h' )
+                *dst++ = L'l';
+            fmt++;
+            *dst++ = *fmt++;
+        }
+        else if ( *fmt == L's' || *fmt == L'c' )
+        {
+            *dst++ = L'l';
+            *dst++ = *fmt++;
+        }
+        else if ( *fmt == L'S' || *fmt == L'C' )
+        {
+            *dst++ = ( *fmt == L'S' ) ? L's' : L'c';
+            fmt++;
+        }
+    }
+
+    *dst = L'\0';
+
+    return TRUE;
+}
+
+// Format wide text, write it as UTF-8
+// The stream stays byte oriented, so narrow output can be mixed in
+static int PutWide( FILE* pStream, const wchar_t* fmt, va_list args )
+{
+    wchar_t fmtW[ FMT_MAX ];
+    wchar_t lineW[ OUT_LINE ];
+    char line[ 4 * OUT_LINE ];
+    wchar_t* pText = lineW;
+    char* pOut = line;
+    size_t ctText = OUT_LINE;
+    size_t sizeOut;
+    va_list argsTry;
+    int len;
+
+    if ( !FixFormat( fmt, fmtW ) )
+        return -1;
+
+    // Longer text: grow the buffer until it fits
+    for ( ;; )
+    {
+        va_copy( argsTry, args );
+        len = vswprintf( pText, ctText, fmtW, argsTry );
+        va_end( argsTry );
+
+        if ( len >= 0 || ctText >= OUT_MAX )
+            break;
+
+        if ( pText != lineW )
+            free( pText );
+
+        ctText *= 4;
+        pText = ( wchar_t* )malloc( ctText * sizeof( wchar_t ) );
+        if ( pText == NULL )
+            return -1;
+    }
+
+    if ( len >= 0 )
+    {
+        sizeOut = 4 * ( size_t )len + 1;
+        if ( sizeOut > sizeof( line ) )
+            pOut = ( char* )malloc( sizeOut );
+
+        if ( pOut != NULL )
+        {
+            ToUtf8( pText, ( size_t )len + 1, pOut, sizeOut, TRUE );
+            fputs( pOut, pStream );
+        }
+        else
+            len = -1;
+
+        if ( pOut != line )
+            free( pOut );
+    }
+
+    if ( pText != lineW )
+        free( pText );
+
+    return len;
+}
+
+// Encode wide text (UTF-32, or UTF-16 pairs) as UTF-8
+// rawBytes: U+DC80..U+DCFF back to the bytes they stand for
+// Other lone surrogates become U+FFFD
+// Returns bytes written, ( size_t )-1 if dst is too small
+static size_t ToUtf8( const wchar_t* src, size_t len, char* dst,
+    size_t sizeDst, BOOL rawBytes )
+{
+    char tmp[ 4 ];
+    size_t ct = 0;
+    size_t ctCp;
+    UINT32 cp;
+    size_t i;
+
+    for ( i = 0; i < len; i++ )
+    {
+        cp = ( UINT32 )src[ i ];
+
+        if ( rawBytes && cp >= ESC_FIRST && cp <= ESC_LAST )
+        {
+            tmp[ 0 ] = ( char )( cp - 0xDC00 );
+            ctCp = 1;
+        }
+        else
+        {
+            if ( cp >= 0xD800 && cp <= 0xDBFF && i + 1 < len &&
+                ( UINT32 )src[ i + 1 ] >= 0xDC00 &&
+                ( UINT32 )src[ i + 1 ] <= 0xDFFF )
+            {
+                cp = 0x10000 + ( ( cp - 0xD800 ) << 10 ) +
+                    ( ( UINT32 )src[ ++i ] - 0xDC00 );
+            }
+            else if ( ( cp >= 0xD800 && cp <= 0xDFFF ) || cp > 0x10FFFF )
+                cp = 0xFFFD;
+
+            ctCp = PutCodePoint( cp, tmp );
+        }
+
+        if ( ct + ctCp > sizeDst )
+            return ( size_t )-1;
+
+        memcpy( dst + ct, tmp, ctCp );
+        ct += ctCp;
+    }
+
+    return ct;
+}
+
+// UTF-8 bytes of one code point, returns their number
+static size_t PutCodePoint( UINT32 cp, char* dst )
+{
+    if ( cp < 0x80 )
+    {
+        dst[ 0 ] = ( char )cp;
+        return 1;
+    }
+
+    if ( cp < 0x800 )
+    {
+        dst[ 0 ] = ( char )( 0xC0 | ( cp >> 6 ) );
+        dst[ 1 ] = ( char )( 0x80 | ( cp & 0x3F ) );
+        return 2;
+    }
+
+    if ( cp < 0x10000 )
+    {
+        dst[ 0 ] = ( char )( 0xE0 | ( cp >> 12 ) );
+        dst[ 1 ] = ( char )( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+        dst[ 2 ] = ( char )( 0x80 | ( cp & 0x3F ) );
+        return 3;
+    }
+
+    dst[ 0 ] = ( char )( 0xF0 | ( cp >> 18 ) );
+    dst[ 1 ] = ( char )( 0x80 | ( ( cp >> 12 ) & 0x3F ) );
+    dst[ 2 ] = ( char )( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+    dst[ 3 ] = ( char )( 0x80 | ( cp & 0x3F ) );
+    return 4;
+}
+
+static FILETIME ToFileTime( LONGLONG val )
+{
+    FILETIME ft;
+
+    ft.dwLowDateTime = ( DWORD )val;
+    ft.dwHighDateTime = ( DWORD )( ( ULONGLONG )val >> 32 );
+
+    return ft;
+}
+
+static LONGLONG FromFileTime( const FILETIME* pTime )
+{
+    return ( LONGLONG )( ( ( ULONGLONG )pTime->dwHighDateTime << 32 ) |
+        pTime->dwLowDateTime );
+}
+
+#endif
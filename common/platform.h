@@ -0,0 +1,249 @@
+//
+// platform.h -- system base of the tools (Win32 or POSIX)
+//
+// On Windows this is <windows.h>. On POSIX systems it declares the
+// part of the Win32 API the tools use beside file access: base types,
+// locks and condition variables, threads, time, the secure CRT string
+// functions and wide text output. These are implemented over the C
+// library and pthreads (platPosix.c). Files and dirs are accessed
+// through io.h on both.
+//
+// Wide text (TCHAR) is UTF-32 on POSIX and written as UTF-8. Wide
+// format strings keep their Microsoft meaning: "%s" is a wide string,
+// "%S" a narrow one.
+//
+// Platform - Interface declarations
+//
+
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <process.h>
+
+// Variable of each thread
+#define     THREAD_LOCAL    __declspec( thread )
+
+// Ordered access to a LONG shared by two threads
+#define     AtomicLoadAcquire( pVal )           ReadAcquire( pVal )
+#define     AtomicStoreRelease( pVal, val )     WriteRelease( ( pVal ), ( val ) )
+
+// Narrow printf-like function (format and first argument index)
+#define     PLAT_PRINTF( iFmt, iArg )
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Base types (Win32 sizes)
+typedef int                 BOOL;
+typedef BOOL*               LPBOOL;
+typedef uint8_t             BYTE;
+typedef uint16_t            WORD;
+typedef uint32_t            DWORD;
+typedef int32_t             LONG;
+typedef long long           LONGLONG;
+typedef unsigned long long  ULONGLONG;
+typedef unsigned int        UINT;
+typedef int32_t             INT32;
+typedef uint16_t            UINT16;
+typedef uint32_t            UINT32;
+typedef unsigned long long  UINT64;
+typedef char                CHAR;
+typedef void                VOID;
+typedef void*               PVOID;
+typedef void*               HANDLE;         // Threads only
+typedef wchar_t             WCHAR;
+typedef wchar_t             TCHAR;
+typedef TCHAR*              LPTSTR;
+typedef const TCHAR*        LPCTSTR;
+typedef const WCHAR*        LPCWSTR;
+typedef int                 errno_t;
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;    // 100 ns since 1601-01-01 (UTC)
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct _SYSTEMTIME
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+typedef struct _SYSTEM_INFO
+{
+    DWORD dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+typedef union _LARGE_INTEGER
+{
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef pthread_mutex_t     CRITICAL_SECTION;
+typedef pthread_cond_t      CONDITION_VARIABLE;
+
+#define     TRUE            1
+#define     FALSE           0
+#define     MAX_PATH        260
+#define     INFINITE        0xFFFFFFFF
+#define     WAIT_OBJECT_0   0
+#define     CP_UTF8         65001
+#define     _TRUNCATE       ( ( size_t )-1 )
+
+#define     TEXT( txt )     L##txt
+#define     _countof( arr ) ( sizeof( arr ) / sizeof( ( arr )[ 0 ] ) )
+#define     __stdcall
+#define     THREAD_LOCAL    _Thread_local
+
+// Narrow printf-like function, arguments checked by the compiler
+// (GCC and Clang have no such check for wide formats)
+#define     PLAT_PRINTF( iFmt, iArg ) \
+    __attribute__( ( format( printf, ( iFmt ), ( iArg ) ) ) )
+
+// Errors are errno values
+#define     GetLastError()  ( ( DWORD )errno )
+#define     ERROR_ACCESS_DENIED     EACCES
+#define     ExitProcess( code )     exit( ( int )( code ) )
+
+// No file system redirection
+static inline BOOL Wow64DisableWow64FsRedirection( PVOID* pOld )
+{
+    *pOld = NULL;
+    return FALSE;
+}
+
+static inline BOOL Wow64RevertWow64FsRedirection( PVOID old )
+{
+    ( void )old;
+    return TRUE;
+}
+
+// Locks and condition variables
+#define     InitializeCriticalSection( pCs )    pthread_mutex_init( pCs, NULL )
+#define     DeleteCriticalSection( pCs )        pthread_mutex_destroy( pCs )
+#define     EnterCriticalSection( pCs )         pthread_mutex_lock( pCs )
+#define     LeaveCriticalSection( pCs )         pthread_mutex_unlock( pCs )
+#define     InitializeConditionVariable( pCv )  pthread_cond_init( pCv, NULL )
+#define     WakeConditionVariable( pCv )        pthread_cond_signal( pCv )
+#define     WakeAllConditionVariable( pCv )     pthread_cond_broadcast( pCv )
+#define     SleepConditionVariableCS            PlatSleepCondition
+
+#define     InterlockedIncrement( pVal ) \
+    __atomic_add_fetch( ( pVal ), 1, __ATOMIC_SEQ_CST )
+#define     InterlockedDecrement( pVal ) \
+    __atomic_sub_fetch( ( pVal ), 1, __ATOMIC_SEQ_CST )
+#define     AtomicLoadAcquire( pVal ) \
+    __atomic_load_n( ( pVal ), __ATOMIC_ACQUIRE )
+#define     AtomicStoreRelease( pVal, val ) \
+    __atomic_store_n( ( pVal ), ( val ), __ATOMIC_RELEASE )
+
+// Threads
+#define     WaitForSingleObject     PlatWaitThread
+#define     CloseHandle             PlatCloseThread
+
+static inline BOOL SwitchToThread( void )
+{
+    return sched_yield() == 0;
+}
+
+// Secure CRT
+#define     _wcsicmp                wcscasecmp
+#define     _wcsnicmp               wcsncasecmp
+#define     strtok_s                strtok_r
+#define     _wtoi( str )            ( ( int )wcstol( ( str ), NULL, 10 ) )
+#define     _wsystem                PlatSystem
+
+// Wide output (Microsoft format strings)
+#define     wprintf_s               PlatWprintf
+#define     fwprintf_s              PlatFwprintf
+#define     fwprintf                PlatFwprintf
+#define     swprintf_s              PlatSwprintf
+#define     _vsnwprintf_s           PlatVsnwprintf
+
+/* function prototypes */
+
+/* operation:      Win32 calls of the same name        */
+BOOL PlatSleepCondition( CONDITION_VARIABLE* pCv, CRITICAL_SECTION* pCs,
+    DWORD ms );
+uintptr_t _beginthreadex( void* security, unsigned stackSize,
+    unsigned ( *pfun )( void* ), void* arg, unsigned initFlag,
+    unsigned* pThreadId );
+DWORD PlatWaitThread( HANDLE hThread, DWORD ms );
+BOOL PlatCloseThread( HANDLE hThread );
+void GetSystemInfo( SYSTEM_INFO* pInfo );
+DWORD GetTickCount( void );
+BOOL QueryPerformanceCounter( LARGE_INTEGER* pCount );
+BOOL QueryPerformanceFrequency( LARGE_INTEGER* pFreq );
+void GetLocalTime( SYSTEMTIME* pTime );
+LONG CompareFileTime( const FILETIME* pA, const FILETIME* pB );
+BOOL FileTimeToLocalFileTime( const FILETIME* pUtc, FILETIME* pLocal );
+BOOL FileTimeToSystemTime( const FILETIME* pTime, SYSTEMTIME* pSysTime );
+int WideCharToMultiByte( UINT codePage, DWORD flags, LPCWSTR src,
+    int ctSrc, CHAR* dst, int sizeDst, const CHAR* defChar,
+    BOOL* pUsedDef );
+
+/* operation:      secure CRT functions of the same    */
+/*                 name                                */
+/* postconditions: if dst is too small, dst is emptied */
+/*                 and ERANGE returned                 */
+errno_t wcscpy_s( wchar_t* dst, size_t ctDst, const wchar_t* src );
+errno_t wcscat_s( wchar_t* dst, size_t ctDst, const wchar_t* src );
+errno_t wcsncpy_s( wchar_t* dst, size_t ctDst, const wchar_t* src,
+    size_t ct );
+errno_t strcpy_s( char* dst, size_t sizeDst, const char* src );
+errno_t strcat_s( char* dst, size_t sizeDst, const char* src );
+errno_t strncpy_s( char* dst, size_t sizeDst, const char* src,
+    size_t ct );
+int _snprintf_s( char* dst, size_t sizeDst, size_t ct, const char* fmt,
+    ... ) PLAT_PRINTF( 4, 5 );
+int _vsnprintf_s( char* dst, size_t sizeDst, size_t ct, const char* fmt,
+    va_list args ) PLAT_PRINTF( 4, 0 );
+
+/* operation:      run a command by the shell          */
+/* postconditions: returns the status as system() does*/
+int PlatSystem( const wchar_t* cmd );
+
+/* operation:      format wide text (Microsoft format) */
+/* postconditions: output is written as UTF-8, returns */
+/*                 the number of wide chars or < 0     */
+int PlatWprintf( const wchar_t* fmt, ... );
+int PlatFwprintf( FILE* pStream, const wchar_t* fmt, ... );
+int PlatSwprintf( wchar_t* dst, size_t ctDst, const wchar_t* fmt, ... );
+int PlatVsnwprintf( wchar_t* dst, size_t ctDst, size_t ct,
+    const wchar_t* fmt, va_list args );
+
+/* operation:      convert a null terminated path      */
+/*                 between wide text and UTF-8         */
+/* preconditions:  dst holds sizeDst bytes (ctDst      */
+/*                 TCHARs)                             */
+/* postconditions: returns true; false if too long     */
+/*                 Bytes that are no UTF-8 are kept as */
+/*                 U+DC80..U+DCFF, so any name of the  */
+/*                 file system converts back unchanged */
+int PlatToUtf8( LPCTSTR src, char* dst, size_t sizeDst );
+int PlatFromUtf8( const char* src, LPTSTR dst, size_t ctDst );
+
+#endif
+
+#endif
@@ -0,0 +1,322 @@
+//
+// pool.c -- worker threads over jobs
+//
+// Work Pool - Interface implementation
+//
+
+#include <stdlib.h>
+#include "pool.h"
+
+typedef struct poolRun
+{
+    BYTE* jobs;             // Job array
+    int ctJobs;             // Number of jobs
+    size_t sizeJob;         // Size of one job [bytes]
+    void ( *pfun )( void* pJob, void* ctx );
+    void* ctx;              // Passed on to pfun
+    volatile LONG nextJob;  // Shared cursor (next free job)
+    volatile LONG nextWorker;   // Index of the next worker
+} PoolRun;
+
+// Index of the calling worker (-1: not a worker)
+static THREAD_LOCAL int workerIndex = -1;
+
+/* protototypes for local functions */
+static unsigned __stdcall PoolWorker( void* pArg );
+static unsigned __stdcall QueueWorker( void* pArg );
+static void SiftUp( WorkJob* heap, int pos );
+static void SiftDown( WorkJob* heap, int ctHeap, int pos );
+
+/* function definitions */
+int PoolWorkerIndex( void )
+{
+    return workerIndex;
+}
+
+int PoolDefaultThreads( void )
+{
+    SYSTEM_INFO sysInfo;
+
+    GetSystemInfo( &sysInfo );
+
+    if ( sysInfo.dwNumberOfProcessors < 1 )
+        return 1;
+
+    if ( sysInfo.dwNumberOfProcessors > POOL_MAX_THREADS )
+        return POOL_MAX_THREADS;
+
+    return ( int )sysInfo.dwNumberOfProcessors;
+}
+
+int RunPool( void* jobs, int ctJobs, size_t sizeJob,
+    void ( *pfun )( void* pJob, void* ctx ), void* ctx, int ctThreads )
+{
+    PoolRun run;
+    HANDLE hThreads[ POOL_MAX_THREADS ];
+    int ctStarted = 0;
+    int i;
+
+    run.jobs = ( BYTE* )jobs;
+    run.ctJobs = ctJobs;
+    run.sizeJob = sizeJob;
+    run.pfun = pfun;
+    run.ctx = ctx;
+    run.nextJob = 0;
+    run.nextWorker = 0;
+
+    // No more threads than jobs
+    if ( ctThreads > ctJobs )
+        ctThreads = ctJobs;
+    if ( ctThreads > POOL_MAX_THREADS )
+        ctThreads = POOL_MAX_THREADS;
+
+    // Start workers
+    for ( i = 0; i < ctThreads; i++ )
+    {
+        hThreads[ ctStarted ] = ( HANDLE )_beginthreadex( NULL, 0,
+            PoolWorker, &run, 0, NULL );
+
+        if ( hThreads[ ctStarted ] != 0 )
+            ctStarted++;
+    }
+
+    // No worker: do the jobs here
+    if ( ctStarted == 0 )
+    {
+        PoolWorker( &run );
+        return ctJobs == 0;
+    }
+
+    // Wait for all workers
+    for ( i = 0; i < ctStarted; i++ )
+    {
+        WaitForSingleObject( hThreads[ i ], INFINITE );
+        CloseHandle( hThreads[ i ] );
+    }
+
+    return TRUE;
+}
+
+int StartWorkQueue( WorkQueue* pQueue,
+    void ( *pfun )( void* pJob, void* ctx ), void* ctx, int ctThreads )
+{
+    int i;
+
+    pQueue->heap = ( WorkJob* )malloc( QUEUE_MIN_JOBS * sizeof( WorkJob ) );
+    if ( pQueue->heap == NULL )
+        return FALSE;
+
+    pQueue->sizeHeap = QUEUE_MIN_JOBS;
+    pQueue->ctHeap = 0;
+    pQueue->ctRunning = 0;
+    pQueue->stopping = FALSE;
+    pQueue->pfun = pfun;
+    pQueue->ctx = ctx;
+    pQueue->ctThreads = 0;
+    pQueue->nextWorker = 0;
+
+    InitializeCriticalSection( &pQueue->lock );
+    InitializeConditionVariable( &pQueue->workReady );
+    InitializeConditionVariable( &pQueue->allDone );
+
+    if ( ctThreads > POOL_MAX_THREADS )
+        ctThreads = POOL_MAX_THREADS;
+
+    // Start workers
+    for ( i = 0; i < ctThreads; i++ )
+    {
+        pQueue->hThreads[ pQueue->ctThreads ] = ( HANDLE )_beginthreadex(
+            NULL, 0, QueueWorker, pQueue, 0, NULL );
+
+        if ( pQueue->hThreads[ pQueue->ctThreads ] != 0 )
+            pQueue->ctThreads++;
+    }
+
+    if ( pQueue->ctThreads == 0 )
+    {
+        DeleteCriticalSection( &pQueue->lock );
+        free( pQueue->heap );
+        pQueue->heap = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int QueueWork( WorkQueue* pQueue, void* pJob, long long prio )
+{
+    WorkJob* tmpHeap = NULL;
+
+    EnterCriticalSection( &pQueue->lock );
+
+    // Make room for the job
+    if ( pQueue->ctHeap == pQueue->sizeHeap )
+    {
+        tmpHeap = ( WorkJob* )realloc( pQueue->heap,
+            2 * pQueue->sizeHeap * sizeof( WorkJob ) );
+
+        if ( tmpHeap == NULL )
+        {
+            LeaveCriticalSection( &pQueue->lock );
+            return FALSE;
+        }
+
+        pQueue->heap = tmpHeap;
+        pQueue->sizeHeap *= 2;
+    }
+
+    pQueue->heap[ pQueue->ctHeap ].pJob = pJob;
+    pQueue->heap[ pQueue->ctHeap ].prio = prio;
+    SiftUp( pQueue->heap, pQueue->ctHeap );
+    pQueue->ctHeap++;
+
+    LeaveCriticalSection( &pQueue->lock );
+
+    WakeConditionVariable( &pQueue->workReady );
+
+    return TRUE;
+}
+
+void WaitWorkQueue( WorkQueue* pQueue )
+{
+    EnterCriticalSection( &pQueue->lock );
+
+    while ( pQueue->ctHeap > 0 || pQueue->ctRunning > 0 )
+        SleepConditionVariableCS( &pQueue->allDone, &pQueue->lock, INFINITE );
+
+    LeaveCriticalSection( &pQueue->lock );
+}
+
+void StopWorkQueue( WorkQueue* pQueue )
+{
+    int i;
+
+    EnterCriticalSection( &pQueue->lock );
+    pQueue->stopping = TRUE;
+    LeaveCriticalSection( &pQueue->lock );
+
+    WakeAllConditionVariable( &pQueue->workReady );
+
+    // Wait for all workers
+    for ( i = 0; i < pQueue->ctThreads; i++ )
+    {
+        WaitForSingleObject( pQueue->hThreads[ i ], INFINITE );
+        CloseHandle( pQueue->hThreads[ i ] );
+    }
+
+    DeleteCriticalSection( &pQueue->lock );
+    free( pQueue->heap );
+
+    pQueue->heap = NULL;
+    pQueue->ctHeap = 0;
+    pQueue->sizeHeap = 0;
+    pQueue->ctThreads = 0;
+}
+
+
+/* local functions */
+
+// Take jobs until none is left
+static unsigned __stdcall PoolWorker( void* pArg )
+{
+    PoolRun* pRun = ( PoolRun* )pArg;
+    int oldIndex = workerIndex;
+    LONG job;
+
+    workerIndex = InterlockedIncrement( &pRun->nextWorker ) - 1;
+
+    while ( ( job = InterlockedIncrement( &pRun->nextJob ) - 1 ) <
+        pRun->ctJobs )
+    {
+        ( *pRun->pfun )( pRun->jobs + job * pRun->sizeJob, pRun->ctx );
+    }
+
+    // Calling thread (no worker started) keeps its own index
+    workerIndex = oldIndex;
+
+    return 0;
+}
+
+// Run queued jobs until the queue is stopped
+static unsigned __stdcall QueueWorker( void* pArg )
+{
+    WorkQueue* pQueue = ( WorkQueue* )pArg;
+    void* pJob;
+
+    workerIndex = InterlockedIncrement( &pQueue->nextWorker ) - 1;
+
+    EnterCriticalSection( &pQueue->lock );
+
+    for ( ;; )
+    {
+        while ( pQueue->ctHeap == 0 && !pQueue->stopping )
+            SleepConditionVariableCS( &pQueue->workReady, &pQueue->lock,
+                INFINITE );
+
+        if ( pQueue->stopping )
+            break;
+
+        // Take job of highest prio
+        pJob = pQueue->heap[ 0 ].pJob;
+        pQueue->ctHeap--;
+        pQueue->heap[ 0 ] = pQueue->heap[ pQueue->ctHeap ];
+        SiftDown( pQueue->heap, pQueue->ctHeap, 0 );
+        pQueue->ctRunning++;
+
+        // Run it unlocked (it may queue more jobs)
+        LeaveCriticalSection( &pQueue->lock );
+        ( *pQueue->pfun )( pJob, pQueue->ctx );
+        EnterCriticalSection( &pQueue->lock );
+
+        pQueue->ctRunning--;
+
+        if ( pQueue->ctHeap == 0 && pQueue->ctRunning == 0 )
+            WakeAllConditionVariable( &pQueue->allDone );
+    }
+
+    LeaveCriticalSection( &pQueue->lock );
+
+    return 0;
+}
+
+// Move job at pos up to its place in the heap
+static void SiftUp( WorkJob* heap, int pos )
+{
+    WorkJob tmpJob = heap[ pos ];
+    int parent;
+
+    while ( pos > 0 )
+    {
+        parent = ( pos - 1 ) / 2;
+
+        if ( heap[ parent ].prio >= tmpJob.prio )
+            break;
+
+        heap[ pos ] = heap[ parent ];
+        pos = parent;
+    }
+
+    heap[ pos ] = tmpJob;
+}
+
+// Move job at pos down to its place in the heap
+static void SiftDown( WorkJob* heap, int ctHeap, int pos )
+{
+    WorkJob tmpJob = heap[ pos ];
+    int child;
+
+    while ( ( child = 2 * pos + 1 ) < ctHeap )
+    {
+        // Larger child
+        if ( child + 1 < ctHeap && heap[ child + 1 ].prio > heap[ child ].prio )
+            child++;
+
+        if ( tmpJob.prio >= heap[ child ].prio )
+            break;
+
+        heap[ pos ] = heap[ child ];
+        pos = child;
+    }
+
+    heap[ pos ] = tmpJob;
+}
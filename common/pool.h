@@ -0,0 +1,109 @@
+//
+// pool.h -- worker threads over jobs
+//
+// RunPool(): the jobs of an array are handed out in array order through
+// a shared cursor: a worker that is done takes the next free job, so
+// fast workers take over the jobs slow workers would otherwise queue up.
+// Callers order the array (e.g. largest first) and keep per-job
+// results in the job itself, so results do not depend on timing.
+//
+// WorkQueue: jobs are queued while workers already run them (jobs may
+// queue further jobs), highest priority first.
+//
+// Workers are numbered, so jobs can keep per-worker data without locks
+// (see PoolWorkerIndex).
+//
+// Work Pool - Interface declarations
+//
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include "platform.h"
+
+#define     POOL_MAX_THREADS    64      // Max worker threads
+#define     QUEUE_MIN_JOBS      256     // Initial size of job heap
+
+typedef struct workJob
+{
+    void* pJob;             // Caller's job
+    long long prio;         // Higher priority jobs run first
+} WorkJob;
+
+typedef struct workQueue
+{
+    CRITICAL_SECTION lock;          // Guards all fields below
+    CONDITION_VARIABLE workReady;   // Job queued or queue stopping
+    CONDITION_VARIABLE allDone;     // No job queued or running
+    WorkJob* heap;                  // Queued jobs (max heap on prio)
+    int ctHeap;                     // Queued jobs
+    int sizeHeap;                   // Heap capacity [jobs]
+    int ctRunning;                  // Jobs being run
+    BOOL stopping;                  // Workers are to exit
+    void ( *pfun )( void* pJob, void* ctx );
+    void* ctx;                      // Passed on to pfun
+    HANDLE hThreads[ POOL_MAX_THREADS ];
+    int ctThreads;                  // Started workers
+    volatile LONG nextWorker;       // Index of the next worker
+} WorkQueue;
+
+/* function prototypes */
+
+/* operation:      determine number of worker threads  */
+/* postconditions: returns the number of logical       */
+/*                 processors ( 1 .. POOL_MAX_THREADS )*/
+int PoolDefaultThreads( void );
+
+/* operation:      index of the calling worker         */
+/* postconditions: returns 0 .. POOL_MAX_THREADS - 1 on*/
+/*                 a worker of RunPool() or a queue    */
+/*                 (the same index on its own pool     */
+/*                 only), -1 on other threads          */
+int PoolWorkerIndex( void );
+
+/* operation:      run a function on each job          */
+/* preconditions:  jobs points to ctJobs jobs of       */
+/*                 sizeJob bytes each                  */
+/*                 pfun points to a function that takes*/
+/*                 a job and ctx, is thread safe and   */
+/*                 has no return value                 */
+/*                 ctThreads > 0                       */
+/* postconditions: pfun was executed once per job on up*/
+/*                 to ctThreads threads, returns after */
+/*                 all jobs are done; returns false if */
+/*                 no thread could be started (jobs    */
+/*                 are then run on the calling thread) */
+int RunPool( void* jobs, int ctJobs, size_t sizeJob,
+    void ( *pfun )( void* pJob, void* ctx ), void* ctx, int ctThreads );
+
+/* operation:      start workers on an empty queue     */
+/* preconditions:  pQueue points to a queue            */
+/*                 pfun points to a thread safe job    */
+/*                 function, it may queue more jobs    */
+/*                 ctThreads > 0                       */
+/* postconditions: returns true if at least one worker */
+/*                 was started, false otherwise (no    */
+/*                 memory, no thread)                  */
+int StartWorkQueue( WorkQueue* pQueue,
+    void ( *pfun )( void* pJob, void* ctx ), void* ctx, int ctThreads );
+
+/* operation:      queue a job                         */
+/* preconditions:  pQueue points to a started queue    */
+/* postconditions: job is run by a worker as soon as no*/
+/*                 job of higher prio is queued,       */
+/*                 returns false if no memory          */
+int QueueWork( WorkQueue* pQueue, void* pJob, long long prio );
+
+/* operation:      wait until all jobs are done        */
+/* preconditions:  pQueue points to a started queue    */
+/* postconditions: no job is queued or running (jobs   */
+/*                 queued by jobs included)            */
+void WaitWorkQueue( WorkQueue* pQueue );
+
+/* operation:      stop the workers                    */
+/* preconditions:  pQueue points to a started queue    */
+/* postconditions: workers have exited, queued jobs    */
+/*                 are dropped, memory is freed        */
+void StopWorkQueue( WorkQueue* pQueue );
+
+#endif
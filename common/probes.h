@@ -0,0 +1,137 @@
+//
+// probes.h -- static tracepoints (USDT) of hpos and jdots
+//
+// Each probe is a NOP at the probed point plus an ELF note
+// (.note.stapsdt, the layout of SystemTap's <sys/sdt.h>) naming the
+// provider, the probe and where its arguments are. bpftrace, perf and
+// SystemTap find the probes in the binary of a running tool and patch
+// the NOP while attached, e.g.
+//
+//     bpftrace -e 'usdt:./hpos:locbench:epoch_accept { @[arg2] = count(); }'
+//     perf probe -x ./jdots sdt_locbench:file_end
+//
+// Arguments are passed as 64 bit signed values. Probes with arguments
+// that cost time to get (latencies) have a semaphore: the tracer
+// increments it while attached, PROBE_ENABLED() tests it.
+//
+// Probes ( provider locbench ):
+//
+//     epoch_accept    latInt [ms], lonInt [ms], pdopInt [1/100]
+//     epoch_reject    pdopInt [1/100], reasons (bit 1 << REJ_*,
+//                     semaphore)
+//     tree_node_new   intVal, nodes in the tree
+//     tree_node_count intVal, measurements of the value
+//     scan_start      files listed, files to parse (jdots)
+//     scan_end        files parsed, latency [ns] (jdots, semaphore)
+//     file_start      file size [bytes] (jdots)
+//     file_end        file size [bytes], latency [ns], fixes (-1:
+//                     failed) (jdots, semaphore)
+//     buf_flush       bytes, latency [ns] (semaphore)
+//
+// GCC and Clang on ELF targets (x86-64, ARM64) only. Elsewhere, or
+// with NO_PROBES, the macros compile to nothing and PROBE_ENABLED()
+// is FALSE.
+//
+// Probes - Interface declarations
+//
+
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+#include "platform.h"
+
+#if defined( __GNUC__ ) && defined( __ELF__ ) && \
+    ( defined( __x86_64__ ) || defined( __aarch64__ ) ) && \
+    !defined( NO_PROBES )
+
+#define     HAVE_PROBES
+
+// Semaphore of a probe, defined once at file scope of its user
+#define     PROBE_SEMAPHORE( name ) \
+    __attribute__( ( section( ".probes" ), used ) ) \
+    volatile unsigned short locbench_##name##_semaphore = 0
+
+#define     PROBE_ENABLED( name ) \
+    __builtin_expect( locbench_##name##_semaphore != 0, 0 )
+
+// Time for latencies [ns] (performance counter, POSIX)
+#define     PROBE_NOW()         probeNow()
+
+static inline LONGLONG probeNow( void )
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter( &count );
+
+    return count.QuadPart;
+}
+
+// NOP and its note ( version 3 ), base symbol for prelinked binaries
+#define     PROBE_NOTE_( name, sem, args ) \
+    "990:\tnop\n" \
+    "\t.pushsection .note.stapsdt,\"?\",\"note\"\n" \
+    "\t.balign 4\n" \
+    "\t.4byte 992f-991f, 994f-993f, 3\n" \
+    "991:\t.asciz \"stapsdt\"\n" \
+    "992:\t.balign 4\n" \
+    "993:\t.8byte 990b\n" \
+    "\t.8byte _.stapsdt.base\n" \
+    "\t.8byte " sem "\n" \
+    "\t.asciz \"locbench\"\n" \
+    "\t.asciz \"" name "\"\n" \
+    "\t.asciz \"" args "\"\n" \
+    "994:\t.balign 4\n" \
+    "\t.popsection\n" \
+    "\t.ifndef _.stapsdt.base\n" \
+    "\t.pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    "\t.weak _.stapsdt.base\n" \
+    "\t.hidden _.stapsdt.base\n" \
+    "_.stapsdt.base:\t.space 1\n" \
+    "\t.size _.stapsdt.base, 1\n" \
+    "\t.popsection\n" \
+    "\t.endif\n"
+
+#define     PROBE_ARG_( x )     "nor"( ( long long )( x ) )
+#define     PROBE_SEM_( name )  "locbench_" #name "_semaphore"
+
+#define     PROBE1( name, a1 ) \
+    __asm__ __volatile__ ( PROBE_NOTE_( #name, "0", "-8@%0" ) \
+        :: PROBE_ARG_( a1 ) )
+
+#define     PROBE2( name, a1, a2 ) \
+    __asm__ __volatile__ ( PROBE_NOTE_( #name, "0", "-8@%0 -8@%1" ) \
+        :: PROBE_ARG_( a1 ), PROBE_ARG_( a2 ) )
+
+#define     PROBE3( name, a1, a2, a3 ) \
+    __asm__ __volatile__ ( PROBE_NOTE_( #name, "0", \
+        "-8@%0 -8@%1 -8@%2" ) \
+        :: PROBE_ARG_( a1 ), PROBE_ARG_( a2 ), PROBE_ARG_( a3 ) )
+
+// Probes with a semaphore
+#define     PROBE_SEM2( name, a1, a2 ) \
+    __asm__ __volatile__ ( PROBE_NOTE_( #name, PROBE_SEM_( name ), \
+        "-8@%0 -8@%1" ) \
+        :: PROBE_ARG_( a1 ), PROBE_ARG_( a2 ) )
+
+#define     PROBE_SEM3( name, a1, a2, a3 ) \
+    __asm__ __volatile__ ( PROBE_NOTE_( #name, PROBE_SEM_( name ), \
+        "-8@%0 -8@%1 -8@%2" ) \
+        :: PROBE_ARG_( a1 ), PROBE_ARG_( a2 ), PROBE_ARG_( a3 ) )
+
+#else
+
+#define     PROBE_SEMAPHORE( name )     typedef int probeNoSem_##name
+#define     PROBE_ENABLED( name )       FALSE
+#define     PROBE_NOW()                 0LL
+
+// Arguments are only referenced (no unused variables)
+#define     PROBE1( name, a1 )          ( ( void )( a1 ) )
+#define     PROBE2( name, a1, a2 )      ( ( void )( a1 ), ( void )( a2 ) )
+#define     PROBE3( name, a1, a2, a3 ) \
+    ( ( void )( a1 ), ( void )( a2 ), ( void )( a3 ) )
+#define     PROBE_SEM2( name, a1, a2 )  PROBE2( name, a1, a2 )
+#define     PROBE_SEM3( name, a1, a2, a3 )  PROBE3( name, a1, a2, a3 )
+
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+//
+// readAhead.c -- read files ahead of the workers that parse them
+//
+// Read Ahead - Interface implementation
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "readAhead.h"
+
+/* protototypes for local functions */
+static unsigned __stdcall ReadWorker( void* pArg );
+static void IssueRead( RaFile* pFile );
+static void CompleteRead( RaFile* pFile );
+
+/* function definitions */
+int StartReadAhead( ReadAhead* pRead, RaFile* files, int ctFiles,
+    UINT64 budget )
+{
+    int i;
+
+    for ( i = 0; i < ctFiles; i++ )
+    {
+        files[ i ].state = RA_QUEUED;
+        files[ i ].data = NULL;
+    }
+
+    pRead->files = files;
+    pRead->ctFiles = ctFiles;
+    pRead->next = 0;
+    pRead->done = 0;
+    pRead->budget = budget;
+    pRead->held = 0;
+    pRead->stopping = FALSE;
+
+    InitializeCriticalSection( &pRead->lock );
+    InitializeConditionVariable( &pRead->fileRead );
+    InitializeConditionVariable( &pRead->budgetFree );
+
+    pRead->hThread = ( HANDLE )_beginthreadex( NULL, 0, ReadWorker, pRead,
+        0, NULL );
+
+    if ( pRead->hThread == 0 )
+    {
+        DeleteCriticalSection( &pRead->lock );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int FetchReadAhead( ReadAhead* pRead, int ind, const char** pData,
+    size_t* pLen )
+{
+    RaFile* pFile = &pRead->files[ ind ];
+    int ready;
+
+    EnterCriticalSection( &pRead->lock );
+
+    while ( ind >= pRead->done )
+        SleepConditionVariableCS( &pRead->fileRead, &pRead->lock, INFINITE );
+
+    ready = ( pFile->state == RA_READY );
+
+    LeaveCriticalSection( &pRead->lock );
+
+    if ( ready )
+    {
+        *pData = pFile->data;
+        *pLen = ( size_t )pFile->size;
+    }
+
+    return ready;
+}
+
+void ReleaseReadAhead( ReadAhead* pRead, int ind )
+{
+    RaFile* pFile = &pRead->files[ ind ];
+
+    free( pFile->data );
+
+    EnterCriticalSection( &pRead->lock );
+
+    pFile->data = NULL;
+    pFile->state = RA_DONE;
+    pRead->held -= pFile->size;
+
+    WakeConditionVariable( &pRead->budgetFree );
+
+    LeaveCriticalSection( &pRead->lock );
+}
+
+void StopReadAhead( ReadAhead* pRead )
+{
+    int i;
+
+    EnterCriticalSection( &pRead->lock );
+    pRead->stopping = TRUE;
+    WakeConditionVariable( &pRead->budgetFree );
+    LeaveCriticalSection( &pRead->lock );
+
+    WaitForSingleObject( pRead->hThread, INFINITE );
+    CloseHandle( pRead->hThread );
+
+    // Files no worker fetched
+    for ( i = 0; i < pRead->ctFiles; i++ )
+    {
+        free( pRead->files[ i ].data );
+        pRead->files[ i ].data = NULL;
+    }
+
+    DeleteCriticalSection( &pRead->lock );
+}
+
+
+/* local functions */
+
+// Issue reads in list order while the budget allows, complete the
+// oldest read, the one the workers wait for
+static unsigned __stdcall ReadWorker( void* pArg )
+{
+    ReadAhead* pRead = ( ReadAhead* )pArg;
+    RaFile* pFile = NULL;
+    PVOID oldValueWow64 = NULL;
+    BOOL wow64Disabled = FALSE;
+
+    // File system redirection is set per thread
+    wow64Disabled = Wow64DisableWow64FsRedirection( &oldValueWow64 );
+
+    EnterCriticalSection( &pRead->lock );
+
+    for ( ;; )
+    {
+        // A file larger than the budget is read when nothing else is held
+        while ( !pRead->stopping && pRead->next < pRead->ctFiles &&
+            pRead->next - pRead->done < RA_MAX_PENDING &&
+            ( pRead->held == 0 || pRead->held +
+            pRead->files[ pRead->next ].size <= pRead->budget ) )
+        {
+            pFile = &pRead->files[ pRead->next++ ];
+            pRead->held += pFile->size;
+
+            LeaveCriticalSection( &pRead->lock );
+            IssueRead( pFile );
+            EnterCriticalSection( &pRead->lock );
+        }
+
+        // Nothing in flight: wait for buffers to be released
+        if ( pRead->done == pRead->next )
+        {
+            if ( pRead->stopping || pRead->next == pRead->ctFiles )
+                break;
+
+            SleepConditionVariableCS( &pRead->budgetFree, &pRead->lock,
+                INFINITE );
+            continue;
+        }
+
+        pFile = &pRead->files[ pRead->done ];
+
+        LeaveCriticalSection( &pRead->lock );
+        CompleteRead( pFile );
+        EnterCriticalSection( &pRead->lock );
+
+        // Skipped files hold no bytes
+        if ( pFile->state == RA_SKIPPED )
+            pRead->held -= pFile->size;
+
+        pRead->done++;
+        WakeAllConditionVariable( &pRead->fileRead );
+    }
+
+    LeaveCriticalSection( &pRead->lock );
+
+    if ( wow64Disabled )
+        Wow64RevertWow64FsRedirection( oldValueWow64 );
+
+    return 0;
+}
+
+// Open a file and start reading it whole
+static void IssueRead( RaFile* pFile )
+{
+    pFile->state = RA_SKIPPED;
+
+    if ( pFile->size > RA_MAX_READ )
+        return;
+
+    // One byte more: a file that grew is noticed
+    pFile->data = ( char* )malloc( ( size_t )pFile->size + 1 );
+    if ( pFile->data == NULL )
+        return;
+
+    if ( !IoStartRead( &pFile->read, pFile->path, pFile->data,
+        ( size_t )pFile->size + 1 ) )
+    {
+        free( pFile->data );
+        pFile->data = NULL;
+        return;
+    }
+
+    pFile->state = RA_READING;
+}
+
+// Wait for the read of a file, keep its text if whole
+static void CompleteRead( RaFile* pFile )
+{
+    size_t bytes = 0;
+
+    if ( pFile->state != RA_READING )
+        return;
+
+    if ( IoFinishRead( &pFile->read, &bytes ) && bytes == pFile->size )
+        pFile->state = RA_READY;
+    else
+    {
+        free( pFile->data );
+        pFile->data = NULL;
+        pFile->state = RA_SKIPPED;
+    }
+}
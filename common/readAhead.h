@@ -0,0 +1,89 @@
+//
+// readAhead.h -- read files ahead of the workers that parse them
+//
+// One I/O thread reads the files of a list into memory with
+// asynchronous reads (io.h), in list order, while workers parse the files
+// read before. Reads in flight and buffers not yet released are
+// kept within a byte budget. Workers that take the files in list
+// order (RunPool) never wait on a file that is not being read.
+//
+// Files that cannot be read ahead (too large, no memory, open or
+// read failed, size changed) are left to the worker, which reads
+// them the usual way and reports errors as before.
+//
+// Read Ahead - Interface declarations
+//
+
+#ifndef _READAHEAD_H_
+#define _READAHEAD_H_
+
+#include "io.h"
+
+#define     RA_MAX_PENDING      16                      // Reads in flight
+#define     RA_MAX_READ         ( 256 * 1024 * 1024 )   // Largest file [bytes]
+
+#define     RA_QUEUED           0   // States of a file
+#define     RA_READING          1
+#define     RA_READY            2   // Buffer holds the file
+#define     RA_SKIPPED          3   // Worker reads the file
+#define     RA_DONE             4   // Buffer released
+
+typedef struct raFile
+{
+    LPCTSTR path;           // Set by caller
+    UINT64 size;            // Set by caller (as listed) [bytes]
+    int state;
+    char* data;             // Whole file
+    IoAsyncRead read;       // Read in flight
+} RaFile;
+
+typedef struct readAhead
+{
+    CRITICAL_SECTION lock;          // Guards all fields below
+    CONDITION_VARIABLE fileRead;    // File read or skipped
+    CONDITION_VARIABLE budgetFree;  // Buffer released or stopping
+    RaFile* files;
+    int ctFiles;
+    int next;               // First file not issued
+    int done;               // First file not read or skipped
+    UINT64 budget;          // Max bytes held [bytes]
+    UINT64 held;            // Bytes in flight or in buffers
+    BOOL stopping;          // No more reads are to be issued
+    HANDLE hThread;
+} ReadAhead;
+
+/* function prototypes */
+
+/* operation:      start reading files ahead           */
+/* preconditions:  files points to ctFiles files with  */
+/*                 path and size set; budget > 0       */
+/* postconditions: I/O thread reads the files in order */
+/*                 and returns true; false if it could */
+/*                 not be started (nothing to stop)    */
+int StartReadAhead( ReadAhead* pRead, RaFile* files, int ctFiles,
+    UINT64 budget );
+
+/* operation:      get the text of a file              */
+/* preconditions:  pRead points to a started reader    */
+/*                 ind < ctFiles, fetched only once    */
+/* postconditions: waits until the file is read, then  */
+/*                 returns true with its text in pData */
+/*                 and pLen (to be released), or false */
+/*                 if the caller is to read the file   */
+int FetchReadAhead( ReadAhead* pRead, int ind, const char** pData,
+    size_t* pLen );
+
+/* operation:      release the text of a file          */
+/* preconditions:  FetchReadAhead( ind ) returned true */
+/* postconditions: buffer is freed, its bytes leave    */
+/*                 the budget                          */
+void ReleaseReadAhead( ReadAhead* pRead, int ind );
+
+/* operation:      stop reading ahead                  */
+/* preconditions:  pRead points to a started reader    */
+/* postconditions: reads in flight are completed, the  */
+/*                 I/O thread has exited, buffers not  */
+/*                 released are freed                  */
+void StopReadAhead( ReadAhead* pRead );
+
+#endif
@@ -16,18 +16,23 @@
 //  prtErrorMsg : Display the last system error message
 //                if this flag is set.
 
-#include <windows.h>
+#include "platform.h"
 #include <stdio.h>
+#include <string.h>
 
 VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg )
 {
-    DWORD eMsgLen, errNum;
+    DWORD errNum;
+#ifdef _WIN32
+    DWORD eMsgLen;
     LPTSTR lpvSysMsg = NULL;
+#endif
 
     errNum = GetLastError();
 
     fwprintf( stderr, TEXT( "%s\n" ), userMsg );
 
+#ifdef _WIN32
     if ( prtErrorMsg )
     {
         eMsgLen = FormatMessage(
@@ -47,6 +52,11 @@ VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg )
         if ( lpvSysMsg != NULL )
             LocalFree( lpvSysMsg );
     }
+#else
+    // Last error is errno
+    if ( prtErrorMsg )
+        fwprintf( stderr, TEXT( "%S\n" ), strerror( ( int )errNum ) );
+#endif
 
     if ( exitCode > 0 )
         ExitProcess( exitCode );
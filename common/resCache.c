@@ -0,0 +1,392 @@
+//
+// resCache.c -- persistent cache of per-file results
+//
+// Result Cache ADT - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include "resCache.h"
+#include "io.h"
+
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+#define     FNV_OFFSET      0xcbf29ce484222325ULL   // FNV-1a 64 bit
+#define     FNV_PRIME       0x00000100000001b3ULL
+
+#define     CACHE_MAX_ALT   1e6     // Max |alt| of a valid entry [m]
+
+/* protototypes for local functions */
+static UINT64 HashPath( LPCTSTR path );
+static BOOL LoadEntries( LPCTSTR fName, CacheEntry** pEntries, int* pCt );
+static BOOL WriteEntries( LPCTSTR fName, const CacheEntry* entries, int ct );
+static CacheEntry* FindEntry( CacheEntry* entries, int ct, UINT64 pathHash );
+static int CmpEntries( const void* pA, const void* pB );
+static BOOL EntryIsValid( const CacheEntry* pEntry );
+
+/* function definitions */
+void OpenResCache( ResCache* pCache, LPCTSTR fName )
+{
+    memset( pCache, 0, sizeof( ResCache ) );
+    wcscpy_s( pCache->fName, _countof( pCache->fName ), fName );
+    InitializeCriticalSection( &pCache->lock );
+
+    // Missing or invalid file: start empty
+    LoadEntries( fName, &pCache->entries, &pCache->ctEntries );
+}
+
+int CacheLookup( ResCache* pCache, LPCTSTR path, UINT64 size,
+    UINT64 writeTime, CacheEntry* pEntry )
+{
+    CacheEntry* pFound = NULL;
+
+    pFound = FindEntry( pCache->entries, pCache->ctEntries, HashPath( path ) );
+
+    if ( pFound == NULL || pFound->size != size ||
+        pFound->writeTime != writeTime )
+    {
+        InterlockedIncrement( &pCache->ctMisses );
+        return FALSE;
+    }
+
+    *pEntry = *pFound;
+    InterlockedIncrement( &pCache->ctHits );
+
+    return TRUE;
+}
+
+int CacheStore( ResCache* pCache, LPCTSTR path, UINT64 size,
+    UINT64 writeTime, const CacheEntry* pEntry )
+{
+    CacheEntry* tmpEntries = NULL;
+    CacheEntry* pNew = NULL;
+
+    EnterCriticalSection( &pCache->lock );
+
+    // Make room for the entry
+    if ( pCache->ctNew == pCache->sizeNew )
+    {
+        tmpEntries = ( CacheEntry* )realloc( pCache->newEntries,
+            ( pCache->sizeNew == 0 ? CACHE_MIN_NEW : 2 * pCache->sizeNew ) *
+            sizeof( CacheEntry ) );
+
+        if ( tmpEntries == NULL )
+        {
+            LeaveCriticalSection( &pCache->lock );
+            return FALSE;
+        }
+
+        pCache->newEntries = tmpEntries;
+        pCache->sizeNew = ( pCache->sizeNew == 0 ) ?
+            CACHE_MIN_NEW : 2 * pCache->sizeNew;
+    }
+
+    pNew = &pCache->newEntries[ pCache->ctNew++ ];
+    *pNew = *pEntry;
+    pNew->pathHash = HashPath( path );
+    pNew->size = size;
+    pNew->writeTime = writeTime;
+    pNew->reserved = 0;
+
+    LeaveCriticalSection( &pCache->lock );
+
+    return TRUE;
+}
+
+int SaveResCache( ResCache* pCache )
+{
+    TCHAR lockName[ MAX_PATH ] = { 0 };
+    TCHAR tmpName[ MAX_PATH ] = { 0 };
+    IoFile hLock = IO_NO_FILE;
+    CacheEntry* curEntries = NULL;
+    CacheEntry* merged = NULL;
+    int ctCur = 0;
+    int ctMerged = 0;
+    int i = 0;
+    int j = 0;
+    BOOL result = TRUE;
+
+    if ( pCache->ctNew == 0 )
+        return TRUE;
+
+    if ( swprintf_s( lockName, _countof( lockName ), TEXT( "%s.lock" ),
+            pCache->fName ) < 0 ||
+        swprintf_s( tmpName, _countof( tmpName ), TEXT( "%s.tmp" ),
+            pCache->fName ) < 0 )
+    {
+        fwprintf( stderr, TEXT( "Cache file path is too long\n" ) );
+        return FALSE;
+    }
+
+    //==============================================
+    // One writer at a time (other jdots runs wait)
+    //==============================================
+    hLock = IoLockFile( lockName );
+
+    if ( hLock == IO_NO_FILE )
+    {
+        ReportError( TEXT( "Locking cache file failed." ), 0, TRUE );
+        return FALSE;
+    }
+
+    //==============================================
+    // Merge new entries into the current file
+    // (it may have been saved by another run)
+    //==============================================
+    LoadEntries( pCache->fName, &curEntries, &ctCur );
+
+    qsort( pCache->newEntries, pCache->ctNew, sizeof( CacheEntry ),
+        CmpEntries );
+
+    // One entry per path (the file must stay strictly ascending)
+    for ( i = 1; i < pCache->ctNew; i++ )
+    {
+        if ( pCache->newEntries[ i ].pathHash !=
+            pCache->newEntries[ j ].pathHash )
+            j++;
+
+        pCache->newEntries[ j ] = pCache->newEntries[ i ];
+    }
+
+    pCache->ctNew = j + 1;
+
+    i = 0;
+    j = 0;
+
+    merged = ( CacheEntry* )malloc(
+        ( ( size_t )ctCur + pCache->ctNew ) * sizeof( CacheEntry ) );
+
+    if ( merged == NULL )
+    {
+        fwprintf( stderr, TEXT( "No memory available for cache\n" ) );
+        result = FALSE;
+    }
+    else
+    {
+        while ( i < ctCur || j < pCache->ctNew )
+        {
+            if ( j == pCache->ctNew ||
+                ( i < ctCur && curEntries[ i ].pathHash <
+                    pCache->newEntries[ j ].pathHash ) )
+                merged[ ctMerged++ ] = curEntries[ i++ ];
+            else
+            {
+                // New entry replaces the current one of the same path
+                if ( i < ctCur && curEntries[ i ].pathHash ==
+                    pCache->newEntries[ j ].pathHash )
+                    i++;
+
+                merged[ ctMerged++ ] = pCache->newEntries[ j++ ];
+            }
+        }
+
+        // Replace the file as a whole
+        if ( !WriteEntries( tmpName, merged, ctMerged ) )
+            result = FALSE;
+        else if ( !IoRename( tmpName, pCache->fName ) )
+        {
+            ReportError( TEXT( "Replacing cache file failed." ), 0, TRUE );
+            IoDelete( tmpName );
+            result = FALSE;
+        }
+    }
+
+    IoUnlockFile( hLock );
+
+    free( curEntries );
+    free( merged );
+
+    if ( result )
+        pCache->ctNew = 0;
+
+    return result;
+}
+
+void CloseResCache( ResCache* pCache )
+{
+    DeleteCriticalSection( &pCache->lock );
+
+    free( pCache->entries );
+    free( pCache->newEntries );
+
+    pCache->entries = NULL;
+    pCache->ctEntries = 0;
+    pCache->newEntries = NULL;
+    pCache->ctNew = 0;
+    pCache->sizeNew = 0;
+}
+
+
+/* local functions */
+
+// FNV-1a of the upper case path (paths are case-insensitive)
+static UINT64 HashPath( LPCTSTR path )
+{
+    UINT64 hash = FNV_OFFSET;
+    WCHAR ch;
+
+    for ( ; *path != TEXT( '\0' ); path++ )
+    {
+        // A.nmea and a.nmea are two files on POSIX
+        ch = IO_CASE_PATHS ? *path : ( WCHAR )towupper( *path );
+
+        hash = ( hash ^ ( ch & 0xff ) ) * FNV_PRIME;
+        hash = ( hash ^ ( ch >> 8 ) ) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Read the entries of a cache file
+// Returns false (no entries) if the file is missing or not valid,
+// that is a header or any entry not valid, or entries not ascending
+static BOOL LoadEntries( LPCTSTR fName, CacheEntry** pEntries, int* pCt )
+{
+    IoFile hIn = IO_NO_FILE;
+    CacheHeader header = { 0 };
+    UINT64 fileSize = 0;
+    CacheEntry* entries = NULL;
+    DWORD bytesRead = 0;
+    DWORD bytesEntries = 0;
+    UINT32 i;
+
+    *pEntries = NULL;
+    *pCt = 0;
+
+    hIn = IoOpenFile( fName );
+
+    if ( hIn == IO_NO_FILE )
+        return FALSE;
+
+    // Header must match the file's size
+    if ( !IoFileSize( hIn, &fileSize ) ||
+        !IoRead( hIn, &header, sizeof( header ), &bytesRead ) ||
+        bytesRead != sizeof( header ) ||
+        memcmp( header.magic, CACHE_MAGIC, sizeof( header.magic ) ) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.sizeEntry != sizeof( CacheEntry ) ||
+        header.ctEntries > INT_MAX / sizeof( CacheEntry ) ||
+        fileSize != ( UINT64 )sizeof( header ) +
+            ( UINT64 )header.ctEntries * sizeof( CacheEntry ) )
+    {
+        IoCloseFile( hIn );
+        return FALSE;
+    }
+
+    bytesEntries = header.ctEntries * sizeof( CacheEntry );
+
+    if ( header.ctEntries > 0 )
+    {
+        entries = ( CacheEntry* )malloc( bytesEntries );
+
+        if ( entries == NULL ||
+            !IoRead( hIn, entries, bytesEntries, &bytesRead ) ||
+            bytesRead != bytesEntries )
+        {
+            free( entries );
+            IoCloseFile( hIn );
+            return FALSE;
+        }
+    }
+
+    IoCloseFile( hIn );
+
+    // Torn or corrupt contents: start empty
+    for ( i = 0; i < header.ctEntries; i++ )
+    {
+        if ( !EntryIsValid( &entries[ i ] ) ||
+            ( i > 0 && entries[ i ].pathHash <= entries[ i - 1 ].pathHash ) )
+        {
+            free( entries );
+            return FALSE;
+        }
+    }
+
+    *pEntries = entries;
+    *pCt = ( int )header.ctEntries;
+
+    return TRUE;
+}
+
+// Write a complete cache file
+static BOOL WriteEntries( LPCTSTR fName, const CacheEntry* entries, int ct )
+{
+    IoFile hOut = IO_NO_FILE;
+    CacheHeader header = { 0 };
+    DWORD bytesEntries = ( DWORD )ct * sizeof( CacheEntry );
+    BOOL result = TRUE;
+
+    memcpy( header.magic, CACHE_MAGIC, sizeof( header.magic ) );
+    header.version = CACHE_VERSION;
+    header.ctEntries = ( UINT32 )ct;
+    header.sizeEntry = sizeof( CacheEntry );
+
+    hOut = IoCreateFile( fName );
+
+    if ( hOut == IO_NO_FILE )
+    {
+        ReportError( TEXT( "Open cache file failed." ), 0, TRUE );
+        return FALSE;
+    }
+
+    if ( !IoWrite( hOut, &header, sizeof( header ) ) ||
+        ( ct > 0 && !IoWrite( hOut, entries, bytesEntries ) ) )
+    {
+        ReportError( TEXT( "Output to cache file failed." ), 0, TRUE );
+        result = FALSE;
+    }
+
+    IoCloseFile( hOut );
+
+    if ( !result )
+        IoDelete( fName );
+
+    return result;
+}
+
+// Binary search on pathHash
+static CacheEntry* FindEntry( CacheEntry* entries, int ct, UINT64 pathHash )
+{
+    int lo = 0;
+    int hi = ct - 1;
+    int mid;
+
+    while ( lo <= hi )
+    {
+        mid = lo + ( hi - lo ) / 2;
+
+        if ( entries[ mid ].pathHash < pathHash )
+            lo = mid + 1;
+        else if ( entries[ mid ].pathHash > pathHash )
+            hi = mid - 1;
+        else
+            return &entries[ mid ];
+    }
+
+    return NULL;
+}
+
+// Ascending pathHash
+static int CmpEntries( const void* pA, const void* pB )
+{
+    const CacheEntry* pEntryA = ( const CacheEntry* )pA;
+    const CacheEntry* pEntryB = ( const CacheEntry* )pB;
+
+    if ( pEntryA->pathHash < pEntryB->pathHash )
+        return -1;
+
+    return pEntryA->pathHash > pEntryB->pathHash;
+}
+
+// Results in range (comparisons fail for NaN)
+static BOOL EntryIsValid( const CacheEntry* pEntry )
+{
+    return pEntry->lon >= -180.0 && pEntry->lon <= 180.0 &&
+        pEntry->lat >= -90.0 && pEntry->lat <= 90.0 &&
+        pEntry->alt >= -CACHE_MAX_ALT && pEntry->alt <= CACHE_MAX_ALT &&
+        pEntry->ctMeas >= 0 && pEntry->reserved == 0;
+}
@@ -0,0 +1,105 @@
+//
+// resCache.h -- persistent cache of per-file results
+//
+// Results of unchanged files are taken from a cache file instead of
+// parsing the file again. A file is unchanged if its path (relative,
+// case-insensitive on Win32 only), size and last write time are the
+// same.
+//
+// Cache file layout (little endian, no padding):
+//
+//   CacheHeader                    16 bytes
+//   CacheEntry[ ctEntries ]        56 bytes each, ascending pathHash
+//
+// The file is replaced as a whole (temp file + rename), so readers
+// never see a partly written cache. Writers merge under a lock file,
+// so concurrent runs do not drop each other's results.
+//
+// Result Cache ADT - Interface declarations
+//
+
+#ifndef _RESCACHE_H_
+#define _RESCACHE_H_
+
+#include "platform.h"
+
+#define     CACHE_MAGIC     "JDCA"  // File signature
+#define     CACHE_VERSION   1       // Layout version
+#define     CACHE_MIN_NEW   64      // Initial room for new entries
+
+typedef struct cacheHeader
+{
+    CHAR magic[ 4 ];        // CACHE_MAGIC
+    UINT32 version;         // CACHE_VERSION
+    UINT32 ctEntries;       // Number of entries following
+    UINT32 sizeEntry;       // sizeof( CacheEntry )
+} CacheHeader;
+
+typedef struct cacheEntry
+{
+    UINT64 pathHash;        // FNV-1a of path (upper case on Win32)
+    UINT64 size;            // File size [bytes]
+    UINT64 writeTime;       // Last write time (FILETIME)
+    double lon;             // Mean lon [deg]
+    double lat;             // Mean lat [deg]
+    double alt;             // Mean alt [m]
+    INT32 ctMeas;           // Accepted fixes
+    UINT32 reserved;        // 0
+} CacheEntry;
+
+typedef struct resCache
+{
+    TCHAR fName[ MAX_PATH ];    // Cache file
+    CacheEntry* entries;        // Loaded entries (read only)
+    int ctEntries;
+    CacheEntry* newEntries;     // Entries of processed files
+    int ctNew;
+    int sizeNew;
+    CRITICAL_SECTION lock;      // Guards new entries
+    volatile LONG ctHits;       // Lookups answered
+    volatile LONG ctMisses;     // Lookups not answered
+} ResCache;
+
+/* function prototypes */
+
+/* operation:      load a cache file                   */
+/* preconditions:  pCache points to a cache            */
+/*                 fName points to the file's name     */
+/* postconditions: entries of the file are loaded, the */
+/*                 cache is empty if the file does not */
+/*                 exist or is not valid               */
+void OpenResCache( ResCache* pCache, LPCTSTR fName );
+
+/* operation:      look up results of a file           */
+/* preconditions:  pCache points to an open cache      */
+/*                 path, size and writeTime identify   */
+/*                 the file                            */
+/* postconditions: returns true and copies the entry   */
+/*                 to pEntry if the file is unchanged, */
+/*                 false otherwise; thread safe        */
+int CacheLookup( ResCache* pCache, LPCTSTR path, UINT64 size,
+    UINT64 writeTime, CacheEntry* pEntry );
+
+/* operation:      add results of a processed file     */
+/* preconditions:  pCache points to an open cache      */
+/*                 pEntry holds the results            */
+/* postconditions: entry is kept for SaveResCache(),   */
+/*                 returns false if no memory; thread  */
+/*                 safe                                */
+int CacheStore( ResCache* pCache, LPCTSTR path, UINT64 size,
+    UINT64 writeTime, const CacheEntry* pEntry );
+
+/* operation:      write the cache file                */
+/* preconditions:  pCache points to an open cache      */
+/* postconditions: if there are new entries, they are  */
+/*                 merged with the current file and    */
+/*                 the file is replaced; returns false */
+/*                 on error (reported)                 */
+int SaveResCache( ResCache* pCache );
+
+/* operation:      free a cache                        */
+/* preconditions:  pCache points to an open cache      */
+/* postconditions: memory is freed                     */
+void CloseResCache( ResCache* pCache );
+
+#endif
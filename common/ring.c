@@ -0,0 +1,165 @@
+//
+// ring.c -- single producer / single consumer ring of slots
+//
+// Ring - Interface implementation
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+
+/* protototypes for local functions */
+static void PublishHead( Ring* pRing );
+static void PublishTail( Ring* pRing );
+static void WakeSleeping( Ring* pRing );
+static void WaitOther( Ring* pRing, int* pSpins );
+
+/* function definitions */
+int InitializeRing( Ring* pRing, size_t sizeSlot, UINT32 ctSlots,
+    UINT32 batch )
+{
+    memset( pRing, 0, sizeof( Ring ) );
+
+    pRing->slots = ( BYTE* )malloc( sizeSlot * ctSlots );
+    if ( pRing->slots == NULL )
+        return FALSE;
+
+    pRing->sizeSlot = sizeSlot;
+    pRing->ctSlots = ctSlots;
+    pRing->batch = batch;
+
+    InitializeCriticalSection( &pRing->lock );
+    InitializeConditionVariable( &pRing->wake );
+
+    return TRUE;
+}
+
+void* RingReserve( Ring* pRing )
+{
+    int spins = 0;
+
+    // Full: let the consumer see all slots, wait for free ones
+    while ( pRing->headLocal - pRing->tailSeen == pRing->ctSlots )
+    {
+        PublishHead( pRing );
+        pRing->tailSeen = ( UINT32 )AtomicLoadAcquire( &pRing->tail );
+
+        if ( pRing->headLocal - pRing->tailSeen == pRing->ctSlots )
+            WaitOther( pRing, &spins );
+    }
+
+    return pRing->slots +
+        ( pRing->headLocal & ( pRing->ctSlots - 1 ) ) * pRing->sizeSlot;
+}
+
+void RingCommit( Ring* pRing )
+{
+    pRing->headLocal++;
+
+    if ( pRing->headLocal - ( UINT32 )pRing->head >= pRing->batch )
+        PublishHead( pRing );
+}
+
+void RingFlush( Ring* pRing )
+{
+    if ( pRing->headLocal != ( UINT32 )pRing->head )
+        PublishHead( pRing );
+}
+
+void RingClose( Ring* pRing )
+{
+    PublishHead( pRing );
+    AtomicStoreRelease( &pRing->closed, TRUE );
+    WakeSleeping( pRing );
+}
+
+const void* RingPeek( Ring* pRing )
+{
+    int spins = 0;
+
+    // Empty: give taken slots back, wait for filled ones
+    while ( pRing->tailLocal == pRing->headSeen )
+    {
+        PublishTail( pRing );
+        pRing->headSeen = ( UINT32 )AtomicLoadAcquire( &pRing->head );
+
+        if ( pRing->tailLocal != pRing->headSeen )
+            break;
+
+        // Head published before closing: read it once more
+        if ( AtomicLoadAcquire( &pRing->closed ) )
+        {
+            pRing->headSeen = ( UINT32 )AtomicLoadAcquire( &pRing->head );
+
+            if ( pRing->tailLocal == pRing->headSeen )
+                return NULL;
+
+            break;
+        }
+
+        WaitOther( pRing, &spins );
+    }
+
+    return pRing->slots +
+        ( pRing->tailLocal & ( pRing->ctSlots - 1 ) ) * pRing->sizeSlot;
+}
+
+void RingRelease( Ring* pRing )
+{
+    pRing->tailLocal++;
+
+    if ( pRing->tailLocal - ( UINT32 )pRing->tail >= pRing->batch )
+        PublishTail( pRing );
+}
+
+void DeleteRing( Ring* pRing )
+{
+    DeleteCriticalSection( &pRing->lock );
+    free( pRing->slots );
+    pRing->slots = NULL;
+}
+
+
+/* local functions */
+
+static void PublishHead( Ring* pRing )
+{
+    AtomicStoreRelease( &pRing->head, ( LONG )pRing->headLocal );
+    WakeSleeping( pRing );
+}
+
+static void PublishTail( Ring* pRing )
+{
+    if ( pRing->tailLocal == ( UINT32 )pRing->tail )
+        return;
+
+    AtomicStoreRelease( &pRing->tail, ( LONG )pRing->tailLocal );
+    WakeSleeping( pRing );
+}
+
+// Only if the other side went to sleep
+static void WakeSleeping( Ring* pRing )
+{
+    if ( AtomicLoadAcquire( &pRing->ctSleeping ) == 0 )
+        return;
+
+    EnterCriticalSection( &pRing->lock );
+    WakeAllConditionVariable( &pRing->wake );
+    LeaveCriticalSection( &pRing->lock );
+}
+
+// Yield first, then sleep until woken (or RING_NAP passed)
+static void WaitOther( Ring* pRing, int* pSpins )
+{
+    if ( ++*pSpins < RING_SPINS )
+    {
+        SwitchToThread();
+        return;
+    }
+
+    EnterCriticalSection( &pRing->lock );
+    InterlockedIncrement( &pRing->ctSleeping );
+    SleepConditionVariableCS( &pRing->wake, &pRing->lock, RING_NAP );
+    InterlockedDecrement( &pRing->ctSleeping );
+    LeaveCriticalSection( &pRing->lock );
+}
@@ -0,0 +1,93 @@
+//
+// ring.h -- single producer / single consumer ring of slots
+//
+// One thread fills slots (RingReserve, RingCommit), another one takes
+// them in the same order (RingPeek, RingRelease). Positions are
+// published with release stores and read with acquire loads, no
+// locks. Each side publishes its position in batches and keeps the
+// last position seen of the other side, so the two sides share a
+// cache line once per batch, not once per slot.
+//
+// A full ring stops the producer (backpressure), an empty one the
+// consumer: the waiting side yields a few times, then sleeps until
+// the other side publishes (at most RING_NAP ms late).
+//
+// Ring - Interface declarations
+//
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "platform.h"
+
+#define     RING_LINE       128     // Distance of shared fields [bytes]
+#define     RING_SPINS      64      // Yields before a waiting side sleeps
+#define     RING_NAP        1       // Max sleep of a waiting side [ms]
+
+typedef struct ring
+{
+    BYTE* slots;
+    size_t sizeSlot;                // Size of one slot [bytes]
+    UINT32 ctSlots;                 // Power of 2
+    UINT32 batch;                   // Slots published at once
+    CRITICAL_SECTION lock;          // Sleeping sides only
+    CONDITION_VARIABLE wake;
+    volatile LONG ctSleeping;
+    BYTE pad0[ RING_LINE ];
+
+    // Producer
+    volatile LONG head;             // Published slots filled
+    UINT32 headLocal;               // Slots filled
+    UINT32 tailSeen;                // Last tail read
+    volatile LONG closed;           // No more slots
+    BYTE pad1[ RING_LINE ];
+
+    // Consumer
+    volatile LONG tail;             // Published slots taken
+    UINT32 tailLocal;               // Slots taken
+    UINT32 headSeen;                // Last head read
+    BYTE pad2[ RING_LINE ];
+} Ring;
+
+/* function prototypes */
+
+/* operation:      initialize a ring                   */
+/* preconditions:  ctSlots is a power of 2             */
+/*                 0 < batch <= ctSlots                */
+/* postconditions: ring is empty and open; returns     */
+/*                 false if no memory                  */
+int InitializeRing( Ring* pRing, size_t sizeSlot, UINT32 ctSlots,
+    UINT32 batch );
+
+/* operation:      next free slot (producer)           */
+/* postconditions: waits while the ring is full,       */
+/*                 returns the slot to fill            */
+void* RingReserve( Ring* pRing );
+
+/* operation:      pass the reserved slot (producer)   */
+/* postconditions: the consumer sees it at the latest  */
+/*                 after batch slots or RingClose()    */
+void RingCommit( Ring* pRing );
+
+/* operation:      publish committed slots (producer)  */
+void RingFlush( Ring* pRing );
+
+/* operation:      end of the slots (producer)         */
+/* postconditions: committed slots are published, the  */
+/*                 consumer gets NULL after the last   */
+void RingClose( Ring* pRing );
+
+/* operation:      next filled slot (consumer)         */
+/* postconditions: waits while the ring is empty,      */
+/*                 returns the slot, NULL if the ring  */
+/*                 is empty and closed                 */
+const void* RingPeek( Ring* pRing );
+
+/* operation:      give the peeked slot back (consumer)*/
+void RingRelease( Ring* pRing );
+
+/* operation:      free the slots                      */
+/* preconditions:  neither side uses the ring          */
+void DeleteRing( Ring* pRing );
+
+#endif
@@ -0,0 +1,253 @@
+//
+// telemetry.c -- live progress of long runs
+//
+// Telemetry - Interface implementation
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include "telemetry.h"
+#include "bufOut.h"
+#include "io.h"
+
+/* protototypes for local functions */
+static unsigned __stdcall Reporter( void* pArg );
+static void WriteReport( Telemetry* pTel, BOOL finished );
+static TelemCounts* OwnCounts( Telemetry* pTel );
+static LONGLONG Now( void );
+
+/* function definitions */
+int StartTelemetry( Telemetry* pTel, LPCTSTR fName, DWORD ms )
+{
+    memset( pTel, 0, sizeof( Telemetry ) );
+
+    wcscpy_s( pTel->fName, _countof( pTel->fName ), fName );
+    swprintf_s( pTel->tmpName, _countof( pTel->tmpName ), TEXT( "%s.tmp" ),
+        fName );
+
+    pTel->ms = ms;
+    pTel->start = Now();
+    pTel->last = pTel->start;
+    pTel->stopping = FALSE;
+
+    InitializeCriticalSection( &pTel->lock );
+    InitializeConditionVariable( &pTel->wake );
+
+    pTel->hReporter = ( HANDLE )_beginthreadex( NULL, 0, Reporter, pTel, 0,
+        NULL );
+
+    if ( pTel->hReporter == 0 )
+    {
+        DeleteCriticalSection( &pTel->lock );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void StopTelemetry( Telemetry* pTel )
+{
+    EnterCriticalSection( &pTel->lock );
+    pTel->stopping = TRUE;
+    WakeConditionVariable( &pTel->wake );
+    LeaveCriticalSection( &pTel->lock );
+
+    WaitForSingleObject( pTel->hReporter, INFINITE );
+    CloseHandle( pTel->hReporter );
+    DeleteCriticalSection( &pTel->lock );
+
+    WriteReport( pTel, TRUE );
+}
+
+void TelemetryQueue( Telemetry* pTel, int ctFiles, UINT64 bytes )
+{
+    TelemCounts* pCounts;
+
+    if ( pTel == NULL )
+        return;
+
+    pCounts = OwnCounts( pTel );
+    pCounts->ctQueued += ctFiles;
+    pCounts->ctQueuedBytes += ( LONGLONG )bytes;
+}
+
+void TelemetryCached( Telemetry* pTel, UINT64 bytes )
+{
+    TelemCounts* pCounts;
+
+    if ( pTel == NULL )
+        return;
+
+    pCounts = OwnCounts( pTel );
+    pCounts->ctCached++;
+    pCounts->ctCachedBytes += ( LONGLONG )bytes;
+}
+
+void TelemetryBegin( Telemetry* pTel )
+{
+    if ( pTel == NULL )
+        return;
+
+    OwnCounts( pTel )->busySince = Now();
+}
+
+void TelemetryEnd( Telemetry* pTel, UINT64 bytes, int ctEpochs )
+{
+    TelemCounts* pCounts;
+
+    if ( pTel == NULL )
+        return;
+
+    pCounts = OwnCounts( pTel );
+    pCounts->ctFiles++;
+    pCounts->ctBytes += ( LONGLONG )bytes;
+    pCounts->ctEpochs += ctEpochs;
+    pCounts->busy += Now() - pCounts->busySince;
+    pCounts->busySince = 0;
+}
+
+
+/* local functions */
+
+// Report every interval until stopped
+static unsigned __stdcall Reporter( void* pArg )
+{
+    Telemetry* pTel = ( Telemetry* )pArg;
+    BOOL stopping;
+
+    for ( ;; )
+    {
+        EnterCriticalSection( &pTel->lock );
+
+        if ( !pTel->stopping )
+            SleepConditionVariableCS( &pTel->wake, &pTel->lock, pTel->ms );
+
+        stopping = pTel->stopping;
+        LeaveCriticalSection( &pTel->lock );
+
+        // Last report is written by StopTelemetry()
+        if ( stopping )
+            break;
+
+        WriteReport( pTel, FALSE );
+    }
+
+    return 0;
+}
+
+// Sum of the slots, rates since the last report
+static void WriteReport( Telemetry* pTel, BOOL finished )
+{
+    TelemCounts sum = { 0 };
+    const TelemCounts* pCounts;
+    LONGLONG busy[ TELEM_SLOTS ];
+    LONGLONG now, since, left;
+    LARGE_INTEGER freq;
+    double elapsed, interval, rate;
+    BufOut out;
+    BOOL first = TRUE;
+    int i;
+
+    now = Now();
+    QueryPerformanceFrequency( &freq );
+    elapsed = ( double )( now - pTel->start ) / ( double )freq.QuadPart;
+    interval = ( double )( now - pTel->last ) / ( double )freq.QuadPart;
+
+    for ( i = 0; i < TELEM_SLOTS; i++ )
+    {
+        pCounts = &pTel->slots[ i ].counts;
+
+        sum.ctFiles += pCounts->ctFiles;
+        sum.ctBytes += pCounts->ctBytes;
+        sum.ctEpochs += pCounts->ctEpochs;
+        sum.ctCached += pCounts->ctCached;
+        sum.ctCachedBytes += pCounts->ctCachedBytes;
+        sum.ctQueued += pCounts->ctQueued;
+        sum.ctQueuedBytes += pCounts->ctQueuedBytes;
+
+        // Time of the file being parsed included
+        since = pCounts->busySince;
+        busy[ i ] = pCounts->busy + ( since != 0 ? now - since : 0 );
+    }
+
+    if ( !OpenBufOut( &out, pTel->tmpName ) )
+        return;
+
+    BufOutPrintf( &out, "{\n  \"finished\": %s,\n  \"elapsed_sec\": %.3f,\n"
+        "  \"files\": { \"done\": %lld, \"cached\": %lld, \"queued\": %lld },\n"
+        "  \"bytes\": { \"done\": %lld, \"cached\": %lld, \"queued\": %lld },\n"
+        "  \"epochs\": %lld,\n", finished ? "true" : "false", elapsed,
+        ( long long )sum.ctFiles, ( long long )sum.ctCached,
+        ( long long )sum.ctQueued, ( long long )sum.ctBytes,
+        ( long long )sum.ctCachedBytes, ( long long )sum.ctQueuedBytes,
+        ( long long )sum.ctEpochs );
+
+    // Rates of the last interval
+    BufOutPrintf( &out, "  \"bytes_per_sec\": %.0f,\n"
+        "  \"epochs_per_sec\": %.0f,\n",
+        interval > 0 ? ( sum.ctBytes - pTel->lastBytes ) / interval : 0.0,
+        interval > 0 ? ( sum.ctEpochs - pTel->lastEpochs ) / interval : 0.0 );
+
+    // Bytes left at the mean rate of the run
+    left = sum.ctQueuedBytes - sum.ctBytes - sum.ctCachedBytes;
+    rate = elapsed > 0 ? sum.ctBytes / elapsed : 0.0;
+
+    if ( !finished && rate > 0 && left >= 0 )
+        BufOutPrintf( &out, "  \"eta_sec\": %.0f,\n", left / rate );
+    else
+        BufOutText( &out, finished ? "  \"eta_sec\": 0,\n" :
+            "  \"eta_sec\": null,\n" );
+
+    // Share of the last interval each worker was parsing
+    BufOutText( &out, "  \"workers\": [" );
+
+    for ( i = 0; i < TELEM_SLOTS; i++ )
+    {
+        if ( busy[ i ] == 0 && pTel->slots[ i ].counts.ctFiles == 0 )
+            continue;
+
+        rate = now > pTel->last ?
+            ( double )( busy[ i ] - pTel->lastBusy[ i ] ) /
+            ( double )( now - pTel->last ) : 0.0;
+
+        BufOutPrintf( &out, "%s\n    { \"worker\": %d, \"files\": %lld, "
+            "\"utilization\": %.3f }", first ? "" : ",",
+            ( i < TELEM_SLOTS - 1 ) ? i : -1,
+            ( long long )pTel->slots[ i ].counts.ctFiles,
+            rate < 0 ? 0.0 : ( rate > 1 ? 1.0 : rate ) );
+
+        pTel->lastBusy[ i ] = busy[ i ];
+        first = FALSE;
+    }
+
+    BufOutText( &out, first ? "]\n}\n" : "\n  ]\n}\n" );
+
+    if ( CloseBufOut( &out ) )
+        IoRename( pTel->tmpName, pTel->fName );
+
+    pTel->last = now;
+    pTel->lastBytes = sum.ctBytes;
+    pTel->lastEpochs = sum.ctEpochs;
+}
+
+// Slot of the calling thread
+static TelemCounts* OwnCounts( Telemetry* pTel )
+{
+    int i = PoolWorkerIndex();
+
+    if ( i < 0 || i >= TELEM_SLOTS - 1 )
+        i = TELEM_SLOTS - 1;
+
+    return &pTel->slots[ i ].counts;
+}
+
+// Performance counter [ticks]
+static LONGLONG Now( void )
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter( &count );
+
+    return count.QuadPart;
+}
@@ -0,0 +1,98 @@
+//
+// telemetry.h -- live progress of long runs
+//
+// Workers count their files, bytes, epochs and busy time in a slot of
+// their own (see PoolWorkerIndex), padded to its own cache lines: no
+// locks, no shared writes on the hot path. A reporter thread sums the
+// slots every interval and rewrites a JSON file (written aside and
+// renamed, so readers never see half a file) with the rates of the
+// last interval, files done / queued, an ETA from the bytes left and
+// the utilization of each worker.
+//
+// Slots are written by their thread only and read without locks: the
+// reporter may see a count one file late, never a torn one (aligned
+// 64 bit values, 64 bit targets).
+//
+// Telemetry - Interface declarations
+//
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include "platform.h"
+#include "pool.h"
+
+#define     TELEM_SLOTS         ( POOL_MAX_THREADS + 1 )    // Last: others
+#define     TELEM_LINE          128     // Slot size [bytes] (cache lines)
+#define     TELEM_INTERVAL      1000    // Default report interval [ms]
+
+typedef struct telemCounts
+{
+    volatile LONGLONG ctFiles;      // Parsed
+    volatile LONGLONG ctBytes;
+    volatile LONGLONG ctEpochs;     // Accepted fixes
+    volatile LONGLONG ctCached;     // Queued, results were cached
+    volatile LONGLONG ctCachedBytes;
+    volatile LONGLONG ctQueued;     // Files to parse or look up
+    volatile LONGLONG ctQueuedBytes;
+    volatile LONGLONG busy;         // Time parsing [ticks]
+    volatile LONGLONG busySince;    // Start of the current file (0: idle)
+} TelemCounts;
+
+typedef struct telemSlot
+{
+    TelemCounts counts;
+    BYTE pad[ TELEM_LINE - sizeof( TelemCounts ) ];
+} TelemSlot;
+
+typedef struct telemetry
+{
+    TelemSlot slots[ TELEM_SLOTS ];
+    TCHAR fName[ MAX_PATH ];        // JSON file
+    TCHAR tmpName[ MAX_PATH ];      // Written aside
+    DWORD ms;                       // Report interval
+    LONGLONG start;                 // Start of the run [ticks]
+    LONGLONG last;                  // Last report [ticks]
+    LONGLONG lastBusy[ TELEM_SLOTS ];
+    LONGLONG lastBytes;
+    LONGLONG lastEpochs;
+    CRITICAL_SECTION lock;          // Reporter's wake up only
+    CONDITION_VARIABLE wake;
+    BOOL stopping;
+    HANDLE hReporter;
+} Telemetry;
+
+/* function prototypes */
+
+/* operation:      start reporting                     */
+/* preconditions:  pTel points to a telemetry block    */
+/*                 fName is the JSON file to rewrite   */
+/*                 ms > 0 is the report interval       */
+/* postconditions: counters are cleared, the file is   */
+/*                 rewritten every ms; returns false   */
+/*                 if the reporter could not be started*/
+int StartTelemetry( Telemetry* pTel, LPCTSTR fName, DWORD ms );
+
+/* operation:      stop reporting                      */
+/* preconditions:  pTel was started                    */
+/* postconditions: the file is rewritten a last time   */
+/*                 ( "finished": true )                */
+void StopTelemetry( Telemetry* pTel );
+
+/* operation:      count files queued                  */
+/* preconditions:  pTel is NULL or started             */
+/* postconditions: counted in the caller's slot        */
+void TelemetryQueue( Telemetry* pTel, int ctFiles, UINT64 bytes );
+
+/* operation:      count a queued file found cached    */
+void TelemetryCached( Telemetry* pTel, UINT64 bytes );
+
+/* operation:      mark the start of parsing a file    */
+void TelemetryBegin( Telemetry* pTel );
+
+/* operation:      count a parsed file                 */
+/* preconditions:  TelemetryBegin() was called before  */
+/*                 on the same thread                  */
+void TelemetryEnd( Telemetry* pTel, UINT64 bytes, int ctEpochs );
+
+#endif
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "tree.h"
+#include "probes.h"
 
 /* local data type */
 typedef struct pair
@@ -24,9 +25,10 @@ static int ToLeft( const Item* i1, const Item* i2 );
 static int ToRight( const Item* i1, const Item* i2 );
 static void AddNode( Node* new_nodePt, Node* root );
 static void InOrder( Node* root,
-    void ( *pfun )( Item* itemPt, int val, HANDLE hOut ),
-    int wtVal, HANDLE hOut );
+    void ( *pfun )( Item* itemPt, int val, BufOut* pOut ),
+    int wtVal, BufOut* pOut );
 static double InOrderWtVal( Node* root );
+static int NodeDepth( const Node* root );
 static Pair SeekItem( const Item* pi, const Tree* ptree );
 static void DeleteNode( Node** ptr );
 static void DeleteAllNodes( Node* ptr );
@@ -95,6 +97,7 @@ int AddItem( const Item* pi, Tree* ptree )
     {
         serachRes.child->item.ct++;
         ptree->ctTotMeas++;
+        PROBE2( tree_node_count, pi->intVal, serachRes.child->item.ct );
         return TRUE;
     }
 
@@ -109,6 +112,7 @@ int AddItem( const Item* pi, Tree* ptree )
     /* succeeded in creating a new node */
     ptree->ctTotNodes++;
     ptree->ctTotMeas++;
+    PROBE2( tree_node_new, pi->intVal, ptree->ctTotNodes );
 
     if ( ptree->root == NULL )      /* case 1: tree is empty  */
         ptree->root = new_nodePt;   /* new node is tree root  */
@@ -155,10 +159,10 @@ int DeleteItem( const Item* pi, Tree* ptree )
 }
 
 void Traverse( Tree* ptree,
-    void ( *pfun )( Item* itemPt, int val, HANDLE hOut ), HANDLE hOut )
+    void ( *pfun )( Item* itemPt, int val, BufOut* pOut ), BufOut* pOut )
 {
     if ( ptree != NULL )
-        InOrder( ptree->root, pfun, ptree->ctTotMeas, hOut );
+        InOrder( ptree->root, pfun, ptree->ctTotMeas, pOut );
 }
 
 double TraverseWtVal( Tree* ptree )
@@ -173,6 +177,11 @@ double TraverseWtVal( Tree* ptree )
     return res;
 }
 
+int TreeDepth( const Tree* ptree )
+{
+    return NodeDepth( ptree->root );
+}
+
 // Delete the whole tree
 void DeleteAll( Tree* ptree )
 {
@@ -196,19 +205,19 @@ void DeleteAll( Tree* ptree )
 
 /* local functions */
 static void InOrder( Node* root,
-    void ( *pfun )( Item* itemPt, int val, HANDLE hOut ),
-    int wtVal, HANDLE hOut )
+    void ( *pfun )( Item* itemPt, int val, BufOut* pOut ),
+    int wtVal, BufOut* pOut )
 {
     if ( root != NULL )
     {
         // Process left subtree
-        InOrder( root->left, pfun, wtVal, hOut );
+        InOrder( root->left, pfun, wtVal, pOut );
 
         // Process item in node
-        ( *pfun )( &root->item, wtVal, hOut );
+        ( *pfun )( &root->item, wtVal, pOut );
         
         // Process right subtree
-        InOrder( root->right, pfun, wtVal, hOut );
+        InOrder( root->right, pfun, wtVal, pOut );
     }
 }
 
@@ -231,6 +240,19 @@ static double InOrderWtVal( Node* root )
     return wtVal;
 }
 
+static int NodeDepth( const Node* root )
+{
+    int depthLeft, depthRight;
+
+    if ( root == NULL )
+        return 0;
+
+    depthLeft = NodeDepth( root->left );
+    depthRight = NodeDepth( root->right );
+
+    return 1 + ( depthLeft > depthRight ? depthLeft : depthRight );
+}
+
 static void DeleteAllNodes( Node* root )
 {
     Node *pright;
@@ -12,7 +12,8 @@
 #ifndef _TREE_H_
 #define _TREE_H_
 
-#include <windows.h>
+#include "platform.h"
+#include "bufOut.h"
 
 #define     FALSE       0
 #define     TRUE        1
@@ -24,6 +25,7 @@ typedef struct item
     char nmeaVal[ VALSTR ]; // Raw nmea value (extra signed lat, lon)
     int intVal;             // Signed int full precision [ms] or [dm]
     double dblVal;          // Signed double end units [deg] or [m]
+    int scale;              // intVal units per end unit ( intVal / scale )
     int ct;                 // Count of pts with this value
     double wtVal;           // Weighted value [deg] or [m]
 } Item;
@@ -97,16 +99,24 @@ int DeleteItem( const Item* pi, Tree* ptree );
 /*                 pfun points to a function that takes*/
 /*                 an Item argument and has no return  */
 /*                 value                               */
+/*                 pOut is passed on to pfun (output   */
+/*                 writer, may be NULL)                */
 /* postcondition:  the function pointed to by pfun is  */
 /*                 executed once for each item in tree */
 void Traverse( Tree* ptree,
-    void ( *pfun )( Item* itemPt, int val, HANDLE hOut ), HANDLE hOut );
+    void ( *pfun )( Item* itemPt, int val, BufOut* pOut ), BufOut* pOut );
 
 /* operation:      get total weighted value from tree  */
 /* preconditions:  ptree points to a tree              */
 /* postcondition:  total weighted value is retrieved   */
 double TraverseWtVal( Tree* ptree );
 
+/* operation:      determine the depth of the tree     */
+/* preconditions:  ptree points to a tree              */
+/* postconditions: returns the nodes on the longest    */
+/*                 path from the root (0 if empty)     */
+int TreeDepth( const Tree* ptree );
+
 /* operation:      delete everything from a tree       */
 /* preconditions:  ptree points to an initialized tree */
 /* postconditions: tree is empty                       */
@@ -0,0 +1,375 @@
+//
+// zipOut.c -- streaming zip writer (one deflated entry)
+//
+// Zip Writer ADT - Interface implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zipOut.h"
+
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+#define     SIG_LOCAL       0x04034b50  // Zip record signatures
+#define     SIG_DESCR       0x08074b50
+#define     SIG_CENTRAL     0x02014b50
+#define     SIG_END         0x06054b50
+
+#define     ZIP_VERSION     20          // Deflate needs 2.0
+#define     ZIP_FLAGS       0x0808      // Data descriptor, UTF-8 name
+#define     ZIP_DEFLATE     8           // Method
+
+#define     HDR_LOCAL       30          // Record sizes w/o name [bytes]
+#define     HDR_DESCR       16
+#define     HDR_CENTRAL     46
+#define     HDR_END         22
+
+static UINT32 crcTable[ 256 ];          // CRC-32 ( poly 0xEDB88320 )
+
+/* protototypes for local functions */
+static unsigned __stdcall ZipWorker( void* pArg );
+static void CompressChunk( ZipOut* pZip, const BYTE* data, DWORD len );
+static int WriteOut( void* ctx, const BYTE* data, DWORD len );
+static BYTE* Put16( BYTE* dst, UINT32 val );
+static BYTE* Put32( BYTE* dst, UINT32 val );
+static void InitCrcTable( void );
+
+/* function definitions */
+int OpenZipOut( ZipOut* pZip, LPCTSTR fName, const CHAR* entryName )
+{
+    BYTE hdr[ HDR_LOCAL ];
+    BYTE* pt = hdr;
+    SYSTEMTIME now;
+    int i;
+
+    memset( pZip, 0, sizeof( ZipOut ) );
+    pZip->hOut = IO_NO_FILE;
+    pZip->crc = 0xFFFFFFFF;
+
+    InitCrcTable();
+
+    strcpy_s( pZip->name, _countof( pZip->name ), entryName );
+    pZip->lenName = ( WORD )strlen( pZip->name );
+
+    // Entry time: now
+    GetLocalTime( &now );
+    pZip->dosTime = ( WORD )( ( now.wHour << 11 ) | ( now.wMinute << 5 ) |
+        ( now.wSecond / 2 ) );
+    pZip->dosDate = ( WORD )( ( ( now.wYear - 1980 ) << 9 ) |
+        ( now.wMonth << 5 ) | now.wDay );
+
+    for ( i = 0; i < ZIP_CHUNKS; i++ )
+    {
+        pZip->chunks[ i ] = ( BYTE* )malloc( ZIP_CHUNK );
+
+        if ( pZip->chunks[ i ] == NULL )
+        {
+            fwprintf( stderr, TEXT( "No memory available for zip output\n" ) );
+
+            while ( i-- > 0 )
+                free( pZip->chunks[ i ] );
+
+            return FALSE;
+        }
+    }
+
+    if ( !DeflateInit( &pZip->defl, WriteOut, pZip ) )
+    {
+        for ( i = 0; i < ZIP_CHUNKS; i++ )
+            free( pZip->chunks[ i ] );
+
+        return FALSE;
+    }
+
+    // Open output file
+    pZip->hOut = IoCreateFile( fName );
+
+    if ( pZip->hOut == IO_NO_FILE )
+    {
+        ReportError( TEXT( "Open output file failed." ), 0, TRUE );
+        pZip->failed = TRUE;
+        CloseZipOut( pZip );
+        return FALSE;
+    }
+
+    // Local header: CRC and sizes follow the data
+    pt = Put32( pt, SIG_LOCAL );
+    pt = Put16( pt, ZIP_VERSION );
+    pt = Put16( pt, ZIP_FLAGS );
+    pt = Put16( pt, ZIP_DEFLATE );
+    pt = Put16( pt, pZip->dosTime );
+    pt = Put16( pt, pZip->dosDate );
+    pt = Put32( pt, 0 );
+    pt = Put32( pt, 0 );
+    pt = Put32( pt, 0 );
+    pt = Put16( pt, pZip->lenName );
+    pt = Put16( pt, 0 );
+
+    WriteOut( pZip, hdr, HDR_LOCAL );
+    WriteOut( pZip, ( const BYTE* )pZip->name, pZip->lenName );
+
+    // Compress on a worker thread
+    InitializeCriticalSection( &pZip->lock );
+    InitializeConditionVariable( &pZip->chunkFull );
+    InitializeConditionVariable( &pZip->chunkFree );
+
+    pZip->hThread = ( HANDLE )_beginthreadex( NULL, 0, ZipWorker, pZip, 0,
+        NULL );
+
+    return !pZip->failed;
+}
+
+int ZipOutWrite( ZipOut* pZip, const void* data, DWORD len )
+{
+    const BYTE* src = ( const BYTE* )data;
+    DWORD chunk;
+    int slot;
+
+    // No worker: compress here
+    if ( pZip->hThread == NULL )
+    {
+        CompressChunk( pZip, src, len );
+        return !pZip->failed;
+    }
+
+    while ( len > 0 )
+    {
+        // Wait for a free chunk
+        EnterCriticalSection( &pZip->lock );
+
+        while ( pZip->ctFull == ZIP_CHUNKS )
+            SleepConditionVariableCS( &pZip->chunkFree, &pZip->lock,
+                INFINITE );
+
+        slot = ( pZip->headChunk + pZip->ctFull ) % ZIP_CHUNKS;
+
+        LeaveCriticalSection( &pZip->lock );
+
+        // Fill it unlocked (worker does not touch free chunks)
+        chunk = ( len < ZIP_CHUNK ) ? len : ZIP_CHUNK;
+        memcpy( pZip->chunks[ slot ], src, chunk );
+        src += chunk;
+        len -= chunk;
+
+        // Hand it over
+        EnterCriticalSection( &pZip->lock );
+        pZip->ctChunk[ slot ] = chunk;
+        pZip->ctFull++;
+        LeaveCriticalSection( &pZip->lock );
+
+        WakeConditionVariable( &pZip->chunkFull );
+    }
+
+    return !pZip->failed;
+}
+
+int CloseZipOut( ZipOut* pZip )
+{
+    BYTE hdr[ HDR_CENTRAL ];
+    BYTE* pt = NULL;
+    UINT64 offCentral = 0;
+    int i;
+
+    // Let the worker compress what is left
+    if ( pZip->hThread != NULL )
+    {
+        EnterCriticalSection( &pZip->lock );
+        pZip->closing = TRUE;
+        LeaveCriticalSection( &pZip->lock );
+
+        WakeConditionVariable( &pZip->chunkFull );
+
+        WaitForSingleObject( pZip->hThread, INFINITE );
+        CloseHandle( pZip->hThread );
+        pZip->hThread = NULL;
+    }
+
+    if ( pZip->hOut != IO_NO_FILE )
+        DeleteCriticalSection( &pZip->lock );
+
+    if ( !DeflateEnd( &pZip->defl ) )
+        pZip->failed = TRUE;
+
+    pZip->crc ^= 0xFFFFFFFF;
+
+    // Zip64 is not supported
+    if ( !pZip->failed && ( pZip->sizeIn > 0xFFFFFFFF ||
+        pZip->defl.sizeOut > 0xFFFFFFFF ) )
+    {
+        fwprintf( stderr, TEXT( "Zip entry exceeds 4 GB\n" ) );
+        pZip->failed = TRUE;
+    }
+
+    if ( !pZip->failed )
+    {
+        // Data descriptor
+        pt = hdr;
+        pt = Put32( pt, SIG_DESCR );
+        pt = Put32( pt, pZip->crc );
+        pt = Put32( pt, ( UINT32 )pZip->defl.sizeOut );
+        pt = Put32( pt, ( UINT32 )pZip->sizeIn );
+        WriteOut( pZip, hdr, HDR_DESCR );
+
+        offCentral = HDR_LOCAL + pZip->lenName + pZip->defl.sizeOut +
+            HDR_DESCR;
+
+        // Central directory (one entry)
+        pt = hdr;
+        pt = Put32( pt, SIG_CENTRAL );
+        pt = Put16( pt, ZIP_VERSION );
+        pt = Put16( pt, ZIP_VERSION );
+        pt = Put16( pt, ZIP_FLAGS );
+        pt = Put16( pt, ZIP_DEFLATE );
+        pt = Put16( pt, pZip->dosTime );
+        pt = Put16( pt, pZip->dosDate );
+        pt = Put32( pt, pZip->crc );
+        pt = Put32( pt, ( UINT32 )pZip->defl.sizeOut );
+        pt = Put32( pt, ( UINT32 )pZip->sizeIn );
+        pt = Put16( pt, pZip->lenName );
+        pt = Put16( pt, 0 );            // Extra field
+        pt = Put16( pt, 0 );            // Comment
+        pt = Put16( pt, 0 );            // Disk
+        pt = Put16( pt, 0 );            // Internal attributes
+        pt = Put32( pt, 0 );            // External attributes
+        pt = Put32( pt, 0 );            // Offset of local header
+        WriteOut( pZip, hdr, HDR_CENTRAL );
+        WriteOut( pZip, ( const BYTE* )pZip->name, pZip->lenName );
+
+        // End of central directory
+        pt = hdr;
+        pt = Put32( pt, SIG_END );
+        pt = Put16( pt, 0 );
+        pt = Put16( pt, 0 );
+        pt = Put16( pt, 1 );
+        pt = Put16( pt, 1 );
+        pt = Put32( pt, HDR_CENTRAL + pZip->lenName );
+        pt = Put32( pt, ( UINT32 )offCentral );
+        pt = Put16( pt, 0 );
+        WriteOut( pZip, hdr, HDR_END );
+    }
+
+    if ( pZip->hOut != IO_NO_FILE )
+        IoCloseFile( pZip->hOut );
+
+    pZip->hOut = IO_NO_FILE;
+
+    for ( i = 0; i < ZIP_CHUNKS; i++ )
+    {
+        free( pZip->chunks[ i ] );
+        pZip->chunks[ i ] = NULL;
+    }
+
+    return !pZip->failed;
+}
+
+int ZipOutSink( void* ctx, const CHAR* data, DWORD len )
+{
+    return ZipOutWrite( ( ZipOut* )ctx, data, len );
+}
+
+
+/* local functions */
+
+// Compress handed over chunks until the writer is closed
+static unsigned __stdcall ZipWorker( void* pArg )
+{
+    ZipOut* pZip = ( ZipOut* )pArg;
+    int slot;
+
+    EnterCriticalSection( &pZip->lock );
+
+    for ( ;; )
+    {
+        while ( pZip->ctFull == 0 && !pZip->closing )
+            SleepConditionVariableCS( &pZip->chunkFull, &pZip->lock,
+                INFINITE );
+
+        if ( pZip->ctFull == 0 )
+            break;
+
+        slot = pZip->headChunk;
+
+        // Compress unlocked (writer fills other chunks)
+        LeaveCriticalSection( &pZip->lock );
+        CompressChunk( pZip, pZip->chunks[ slot ], pZip->ctChunk[ slot ] );
+        EnterCriticalSection( &pZip->lock );
+
+        pZip->headChunk = ( pZip->headChunk + 1 ) % ZIP_CHUNKS;
+        pZip->ctFull--;
+
+        WakeConditionVariable( &pZip->chunkFree );
+    }
+
+    LeaveCriticalSection( &pZip->lock );
+
+    return 0;
+}
+
+// CRC and deflate one piece of entry data
+static void CompressChunk( ZipOut* pZip, const BYTE* data, DWORD len )
+{
+    UINT32 crc = pZip->crc;
+    DWORD i;
+
+    for ( i = 0; i < len; i++ )
+        crc = crcTable[ ( crc ^ data[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+
+    pZip->crc = crc;
+    pZip->sizeIn += len;
+
+    if ( !DeflateWrite( &pZip->defl, data, len ) )
+        pZip->failed = TRUE;
+}
+
+// Write to the zip file (deflate sink)
+static int WriteOut( void* ctx, const BYTE* data, DWORD len )
+{
+    ZipOut* pZip = ( ZipOut* )ctx;
+
+    if ( pZip->failed )
+        return FALSE;
+
+    if ( !IoWrite( pZip->hOut, data, len ) )
+    {
+        ReportError( TEXT( "Output to file failed." ), 0, TRUE );
+        pZip->failed = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BYTE* Put16( BYTE* dst, UINT32 val )
+{
+    dst[ 0 ] = ( BYTE )val;
+    dst[ 1 ] = ( BYTE )( val >> 8 );
+
+    return dst + 2;
+}
+
+static BYTE* Put32( BYTE* dst, UINT32 val )
+{
+    dst[ 0 ] = ( BYTE )val;
+    dst[ 1 ] = ( BYTE )( val >> 8 );
+    dst[ 2 ] = ( BYTE )( val >> 16 );
+    dst[ 3 ] = ( BYTE )( val >> 24 );
+
+    return dst + 4;
+}
+
+static void InitCrcTable( void )
+{
+    UINT32 crc;
+    int i, k;
+
+    for ( i = 0; i < 256; i++ )
+    {
+        crc = ( UINT32 )i;
+
+        for ( k = 0; k < 8; k++ )
+            crc = ( crc & 1 ) ? 0xEDB88320 ^ ( crc >> 1 ) : crc >> 1;
+
+        crcTable[ i ] = crc;
+    }
+}
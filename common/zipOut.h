@@ -0,0 +1,77 @@
+//
+// zipOut.h -- streaming zip writer (one deflated entry)
+//
+// Writes a zip file holding a single entry (e.g. 'doc.kml' of a kmz)
+// while the entry's data is still being generated: sizes and CRC go
+// to a data descriptor after the data, so nothing is written twice.
+//
+// Data is compressed on a worker thread. ZipOutWrite() only copies
+// into one of ZIP_CHUNKS chunks, so generation and compression
+// overlap; it waits only if all chunks are still being compressed.
+//
+// Zip Writer ADT - Interface declarations
+//
+
+#ifndef _ZIPOUT_H_
+#define _ZIPOUT_H_
+
+#include "io.h"
+#include "deflate.h"
+
+#define     ZIP_CHUNKS      4               // Chunks between threads
+#define     ZIP_CHUNK       ( 256 * 1024 )  // Chunk size [bytes]
+#define     ZIP_NAME        256             // Max entry name [bytes]
+
+typedef struct zipOut
+{
+    IoFile hOut;                    // Zip file
+    Deflater defl;                  // Used by the worker only
+    UINT32 crc;                     // CRC-32 of the entry's data
+    UINT64 sizeIn;                  // Entry's data [bytes]
+    CHAR name[ ZIP_NAME ];          // Entry name (UTF-8)
+    WORD lenName;
+    WORD dosTime;                   // Entry time (local, DOS format)
+    WORD dosDate;
+    BYTE* chunks[ ZIP_CHUNKS ];     // Data handed to the worker
+    DWORD ctChunk[ ZIP_CHUNKS ];    // Bytes per full chunk
+    int headChunk;                  // Oldest full chunk
+    int ctFull;                     // Full chunks
+    CRITICAL_SECTION lock;          // Guards chunk state, closing
+    CONDITION_VARIABLE chunkFull;   // Chunk handed over or closing
+    CONDITION_VARIABLE chunkFree;   // Chunk compressed
+    BOOL closing;                   // No more data
+    HANDLE hThread;                 // Worker (NULL: compress in caller)
+    BOOL failed;                    // Write failed (already reported)
+} ZipOut;
+
+/* function prototypes */
+
+/* operation:      create a zip file for one entry     */
+/* preconditions:  pZip points to a writer             */
+/*                 fName points to the file's name     */
+/*                 entryName is the UTF-8 entry name   */
+/* postconditions: file is created, the local header   */
+/*                 is written and the worker started;  */
+/*                 returns false on error (reported)   */
+int OpenZipOut( ZipOut* pZip, LPCTSTR fName, const CHAR* entryName );
+
+/* operation:      append data to the entry            */
+/* preconditions:  pZip points to an open writer       */
+/* postconditions: data is queued for compression,     */
+/*                 returns false if a write failed     */
+int ZipOutWrite( ZipOut* pZip, const void* data, DWORD len );
+
+/* operation:      finish the zip file                 */
+/* preconditions:  pZip points to an open writer       */
+/* postconditions: all data is compressed, descriptor  */
+/*                 and central directory are written,  */
+/*                 file is closed, memory is freed;    */
+/*                 returns false if any write failed   */
+int CloseZipOut( ZipOut* pZip );
+
+/* operation:      BufOut sink for a zip entry         */
+/* preconditions:  ctx points to an open writer        */
+/* postconditions: see ZipOutWrite()                   */
+int ZipOutSink( void* ctx, const CHAR* data, DWORD len );
+
+#endif
@@ -2,96 +2,188 @@
 //  hpos.c
 //
 
-#include <windows.h>
+#include "platform.h"
 #include <stdio.h>
 #include <wchar.h>
 #include "tree.h"
+#include "hposEng.h"
+#include "grid.h"
+#include "bufOut.h"
+#include "fmtNum.h"
+#include "histBin.h"
+#include "hposStats.h"
+#include "epochLog.h"
 
-#define     ERRMSG      256
 #define     FNAME       260
-#define     LINEIN      128
 #define     LINEOUT     256
-#define     VALIN       32
 
-#define     PDOP_CUTOFF     210
+#define     MAX_OPTIONS     20  // Max # command line options
 
+// Flags indices
+#define     FL_HELP         0   // Print usage
+#define     FL_GRID         1   // Joint lat/lon density grid
+#define     FL_BASIC        2   // Basic output only (no trees, no CSV)
+#define     FL_HIST         3   // Columnar binary histograms
+
+#define     GRID_CELL_DEF   30  // Default grid cell size [ms] ( ~0.9 m )
+#define     GRID_TOP_DEF    10  // Default densest cells of the top mean [%]
+#define     GRID_PGM_MAX    4096    // Max width / height of density image
+
+extern DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... );
+extern BOOL OptionLong( int argc, LPCWSTR argv[], LPCWSTR name );
+extern LPCWSTR OptionValue( int argc, LPCWSTR argv[], int iFirst,
+    LPCWSTR key );
 extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
 
-void addLat( char* hemis, char* valStr, Tree* pt );
-void addLon( char* hemis, char* valStr, Tree* pt );
-void addAlt( char* valStr, Tree* pt );
-void addPDOP( char* valStr, Tree* pt );
+// Storage of single fixes (NULL: not used)
+typedef struct fixStore
+{
+    Tree* pLatTree;
+    Tree* pLonTree;
+    Tree* pAltTree;
+    Tree* pPDOPTree;
+    Grid* pGrid;
+} FixStore;
+
+// Density image under construction (see outGrid)
+typedef struct pgmImage
+{
+    BYTE* pixels;
+    int width;
+    int height;
+    int maxCt;
+    const Grid* pGrid;
+} PgmImage;
+
+void storeFix( const HposFix* pFix, void* ctx );
+void addLat( const char* hemis, const char* valStr, Tree* pt );
+void addLon( const char* hemis, const char* valStr, Tree* pt );
+void addAlt( const char* valStr, Tree* pt );
+void addPDOP( const char* valStr, Tree* pt );
 void fillWtVals( Tree* pt );
-void fillWtValItem( Item* itemPt, int wt, HANDLE hOut );
+void fillWtValItem( Item* itemPt, int wt, BufOut* pOut );
 double calcWtTotVal( Tree* pt );
 double fetchWtTotVal( Tree* pt );
-void showValsScreen( Tree* pt, HANDLE hOut );
-void showValsCSV( Tree* pt, HANDLE hOut );
-void printItemScr( Item* itemPt, int ctTot, HANDLE hOut );
-void printItemCSV( Item* itemPt, int ctTot, HANDLE hOut );
+void showValsScreen( Tree* pt, BufOut* pOut );
+void showValsCSV( Tree* pt, BufOut* pOut );
+void printItemScr( Item* itemPt, int ctTot, BufOut* pOut );
+void printItemCSV( Item* itemPt, int ctTot, BufOut* pOut );
+void printTotScr( Tree* pt, BufOut* pOut );
+void printTotCSV( Tree* pt, BufOut* pOut );
 void outBasic( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt );
+void outBasicRes( const HposResult* pRes );
 void outDetail( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt );
 void outCVS( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt, Tree* ptTrPDOP,
     TCHAR* fName );
-int txtToFile( CHAR* txtInPt, DWORD sizeBuf, HANDLE hOut );
+void outGrid( Grid* pGrid, int topPct, TCHAR* fName );
+void outHist( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt, Tree* ptTrPDOP,
+    int ctMeas, TCHAR* fName );
+void outSweep( const HposSweep* pSweep, TCHAR* fName );
+void writeItemIntVal( Item* itemPt, int ctTot, BufOut* pOut );
+void writeItemCt( Item* itemPt, int ctTot, BufOut* pOut );
+void printCellCSV( const Cell* pCell, void* ctx );
+void fillCellPGM( const Cell* pCell, void* ctx );
+void outStats( HposStats* pStats, Tree* ptTrLon, Tree* ptTrLat,
+    Tree* ptTrAlt, Tree* ptTrPDOP, LPCTSTR fName );
 
 int wmain( int argc, TCHAR* argv[] )
 {
     //==============================================
     // Vars definitions
     //==============================================
-    FILE *inNMEA = NULL;
-    TCHAR errMsg[ ERRMSG ] = { 0 };
-    char inputLine[ LINEIN ] = { 0 };
-    char *ptMsg = NULL;
-    char *nextptMsg = NULL;
-    int fieldNo = 0;
     TCHAR* wchPt = NULL;
     TCHAR fileName[ FNAME ] = { 0 };
-
-    BOOL dataOk = FALSE;
-    char* chPt = NULL;
-    int tmpPDOPint = 0;
-    char status[ VALIN ] = { 0 };
-    char hemiNS[ VALIN ] = { 0 };
-    char hemiEW[ VALIN ] = { 0 };
-    char tmpLat[ VALIN ] = { 0 };
-    char tmpLon[ VALIN ] = { 0 };
-    char tmpAlt[ VALIN ] = { 0 };
-    char tmpPDOP[ VALIN ] = { 0 };
+    TCHAR epochName[ FNAME ] = { 0 };
+    int fileInd = 0;
+    BOOL flags[ MAX_OPTIONS ] = { 0 };
+    BOOL stats = FALSE;
+    BOOL logEpochs = FALSE;
+    BOOL fromLog = FALSE;
+    BOOL sweep = FALSE;
+    int cellSize = GRID_CELL_DEF;
+    int topPct = GRID_TOP_DEF;
+    int setInd = 0;
+    LPCWSTR topStr = NULL;
 
     Tree latTree;
     Tree lonTree;
     Tree altTree;
     Tree pdopTree;
+    Grid posGrid;
+    FixStore store = { 0 };
+    HposResult result = { 0 };
+    HposOpts hposOpts = { 0 };
+    HposStats hposStats;
+    EpochLog epochLog;
+    HposSweep hposSweep;
+    BOOL parsed;
 
 
     //==============================================
     // Parse arguments and options
     //==============================================
     
+    // Get index of first argument after options
+    // Also determine which options are active
+    fileInd = Options( argc, ( LPCWSTR* )argv, TEXT( "hgbx" ),
+        &flags[ FL_HELP ], &flags[ FL_GRID ], &flags[ FL_BASIC ],
+        &flags[ FL_HIST ], NULL );
+
+    // Long options
+    stats = OptionLong( argc, ( LPCWSTR* )argv, TEXT( "stats" ) );
+    logEpochs = OptionLong( argc, ( LPCWSTR* )argv, TEXT( "epochs" ) );
+    sweep = OptionLong( argc, ( LPCWSTR* )argv, TEXT( "sweep" ) );
+
+    // Optional grid cell size after the file name
+    setInd = fileInd + 1;
+    if ( setInd < argc && wcschr( argv[ setInd ], L'=' ) == NULL )
+        cellSize = _wtoi( argv[ setInd++ ] );
+
+    // Settings ( "key=value" ) after both
+    topStr = OptionValue( argc, ( LPCWSTR* )argv, setInd, TEXT( "top" ) );
+    if ( topStr != NULL )
+        topPct = _wtoi( topStr );
+
     // Validate args count
-    if ( argc != 2 )
+    if ( flags[ FL_HELP ] || ( argc < fileInd + 1 ) ||
+        ( argc > setInd + ( topStr != NULL ? 1 : 0 ) ) ||
+        ( cellSize <= 0 ) || ( topPct < 1 ) || ( topPct > 100 ) )
     {
         // Print usage
-        wprintf_s( TEXT( "\n    Usage:  hpos [nmea file]\n" ) );
+        wprintf_s( TEXT( "\n    Usage:  hpos [options] [nmea file] [cell size] [top=pct]\n\n" ) );
+        wprintf_s( TEXT( "    Options:\n\n" ) );
+        wprintf_s( TEXT( "      -h   :  Print usage\n" ) );
+        wprintf_s( TEXT( "      -b   :  Basic output only (mean lon,lat,alt; no CSV)\n" ) );
+        wprintf_s( TEXT( "      -g   :  Joint lat/lon density grid (.grid.csv, .pgm)\n" ) );
+        wprintf_s( TEXT( "      -x   :  Columnar binary histograms (.hist, not with -b)\n" ) );
+        wprintf_s( TEXT( "      --stats  :  Stage timing and rejection counters (JSON)\n" ) );
+        wprintf_s( TEXT( "      --epochs :  Log of all parsed epochs (.epochs)\n" ) );
+        wprintf_s( TEXT( "      --sweep  :  Results of all P-DOP cutoffs %.2f ... %.2f (.sweep.csv)\n\n" ),
+            ( double )HPOS_SWEEP_FIRST / HPOS_SCALE_PDOP,
+            ( double )HPOS_SWEEP_LAST / HPOS_SCALE_PDOP );
+        wprintf_s( TEXT( "    Cell size [ms] of the grid defaults to %d\n" ),
+            GRID_CELL_DEF );
+        wprintf_s( TEXT( "    Top mean of the grid takes the densest pct %% cells (1 .. 100, default %d)\n" ),
+            GRID_TOP_DEF );
+        wprintf_s( TEXT( "    An .epochs log is aggregated again (basic output, -g)\n" ) );
         return 1;
     }
 
-    // Open nmea file
-    if ( _wfopen_s( &inNMEA, argv[ 1 ], TEXT( "r" ) ) != 0 )
+    // Retrieve file name
+    wcscpy_s( fileName, _countof( fileName ), argv[ fileInd ] );
+    wchPt = wcsrchr( fileName, L'.' );
+    if ( wchPt != NULL )
     {
-        wmemset( errMsg, 0, _countof( errMsg ) );
-        __wcserror_s( errMsg, _countof( errMsg ),
-            TEXT( "\nOpening source file failed" ) );
-        fwprintf( stderr, TEXT( "%s\n" ), errMsg );
-        return 1;
+        fromLog = _wcsicmp( wchPt, TEXT( ".epochs" ) ) == 0;
+        *wchPt = L'\0';
     }
 
-    // Retrieve file name
-    wcscpy_s( fileName, _countof( fileName ), argv[ 1 ] );
-    wchPt = wcsrchr( fileName, L'.' );
-    *wchPt = L'\0';
+    // A log holds int vals only: no trees
+    if ( fromLog )
+    {
+        flags[ FL_BASIC ] = TRUE;
+        logEpochs = FALSE;
+    }
 
 
     //==============================================
@@ -102,156 +194,117 @@ int wmain( int argc, TCHAR* argv[] )
     InitializeTree( &altTree );
     InitializeTree( &pdopTree );
 
+    // Joint lat/lon grid (only when asked for)
+    if ( flags[ FL_GRID ] && !InitializeGrid( &posGrid, cellSize ) )
+    {
+        fwprintf( stderr, TEXT( "\nNo memory available for grid\n" ) );
+        return 1;
+    }
+
+    // Single fixes are only stored when needed
+    if ( !flags[ FL_BASIC ] )
+    {
+        store.pLatTree = &latTree;
+        store.pLonTree = &lonTree;
+        store.pAltTree = &altTree;
+        store.pPDOPTree = &pdopTree;
+    }
+
+    if ( flags[ FL_GRID ] )
+        store.pGrid = &posGrid;
+
+
+    // Instrumentation of all stages
+    // Option: --stats
+    if ( stats )
+    {
+        HposStatsStart( &hposStats );
+        hposOpts.pStats = &hposStats;
+    }
+
+
+    // Log of all parsed epochs
+    // Option: --epochs
+    if ( logEpochs )
+    {
+        wcscpy_s( epochName, _countof( epochName ), fileName );
+        wcscat_s( epochName, _countof( epochName ), TEXT( ".epochs" ) );
+
+        if ( OpenEpochLog( &epochLog, epochName ) )
+            hposOpts.pEpochLog = &epochLog;
+    }
+
+
+    // Sums per P-DOP value, all cutoffs in one pass
+    // Option: --sweep
+    if ( sweep )
+    {
+        memset( &hposSweep, 0, sizeof( hposSweep ) );
+        hposOpts.pSweep = &hposSweep;
+    }
+
 
     //==============================================
-    // Parse nmea file
+    // Parse nmea file (or aggregate an epoch log)
+    // Reading, parsing and storing fixes overlap
     //==============================================
-    
-    // Reset input line buffer
-    memset( inputLine, 0, _countof( inputLine ) );
+    if ( fromLog )
+        parsed = HposProcEpochLog( argv[ fileInd ], HPOS_PDOP_CUTOFF,
+            &hposOpts, &result, flags[ FL_GRID ] ? storeFix : NULL,
+            &store );
+    else
+        parsed = HposProcFilePiped( argv[ fileInd ], &hposOpts, &result,
+            ( flags[ FL_BASIC ] && !flags[ FL_GRID ] ) ? NULL : storeFix,
+            &store );
+
+    if ( hposOpts.pEpochLog != NULL )
+        CloseEpochLog( hposOpts.pEpochLog );
 
-    // Fetch one line at a time
-    while ( fscanf_s( inNMEA, "%127s", inputLine,
-        _countof( inputLine ) - 1 ) == 1 )
+    if ( !parsed )
     {
-        if ( strstr( inputLine, "$GPGGA" ) )        // Catch 'GGA' messages
-        {
-            // Reset field counter
-            fieldNo = 0;
-
-            // Locate first field (token)
-            ptMsg = strtok_s( inputLine, ",*", &nextptMsg );
-
-            while ( ptMsg != NULL )
-            {
-                // Process fields of interest
-                // Store value in tree
-                // If already in tree, then update counters
-                if ( fieldNo == 2 )
-                    strcpy_s( tmpLat, _countof( tmpLat ), ptMsg );
-                else if ( fieldNo == 3 )
-                    strcpy_s( hemiNS, _countof( hemiNS ), ptMsg );
-                else if ( fieldNo == 4 )
-                    strcpy_s( tmpLon, _countof( tmpLon ), ptMsg );
-                else if ( fieldNo == 5 )
-                    strcpy_s( hemiEW, _countof( hemiEW ), ptMsg );
-                else if ( fieldNo == 9 )
-                {
-                    strcpy_s( tmpAlt, _countof( tmpAlt ), ptMsg );
-                    break;      // Skip the rest of the fields
-                }
-
-                // Locate next field (token)
-                ptMsg = strtok_s( NULL, ",*", &nextptMsg );
-
-                // Inc field counter
-                ++fieldNo;
-            }
-        }
-        else if ( strstr( inputLine, "$GPGSA" ) )   // Catch 'GSA' messages
-        {
-            // Look for Position-DOP
-
-            // Locate first field (token)
-            ptMsg = strtok_s( inputLine, ",*", &nextptMsg );
-
-            while ( ptMsg != NULL )
-            {
-                // Stop after finding
-                // first field with decimal places (contains a decimal point)
-                if ( strchr( ptMsg, '.' ) != NULL )
-                {
-                    memset( tmpPDOP, 0, _countof( tmpPDOP ) );
-                    strcpy_s( tmpPDOP, _countof( tmpPDOP ), ptMsg );
-                    break;
-                }
-
-                // Locate next field (token)
-                ptMsg = strtok_s( NULL, ",*", &nextptMsg );
-            }
-        }
-        else if ( strstr( inputLine, "$GPRMC" ) )   // Catch 'RMC' messages
-        {
-            // Reset field counter
-            fieldNo = 0;
-
-            // Locate first field (token)
-            ptMsg = strtok_s( inputLine, ",*", &nextptMsg );
-
-            while ( ptMsg != NULL )
-            {
-                // Process fields of interest
-                // Store value in tree
-                // If already in tree, then update counters
-                if ( fieldNo == 2 )
-                {
-                    strcpy_s( status, _countof( status ), ptMsg );
-                    break;      // Skip the rest of the fields
-                }
-
-                // Locate next field (token)
-                ptMsg = strtok_s( NULL, ",*", &nextptMsg );
-
-                // Inc field counter
-                ++fieldNo;
-            }
-
-
-            // Validate processed line - Quality control
-            //
-            // This is done here, because the RMC message is
-            // the last message received for each point
-            
-            // Get PDOP int val
-            tmpPDOPint = atoi( tmpPDOP ) * 100;
-            
-            // Add PDOP decimal places
-            chPt = strchr( tmpPDOP, '.' );
-            if ( chPt )
-                tmpPDOPint += ( tmpPDOP[ 0 ] == '-' ? (-1) : 1 ) *
-                    atoi( chPt + 1 );
-
-            // Assess all conditions
-            dataOk = ( tmpPDOPint <= PDOP_CUTOFF ) &&
-                ( strlen( status ) == 1 ) && ( strstr( status, "A" ) ) &&
-                ( strlen( tmpLat ) == 9 ) && ( strlen( tmpLon ) == 10 );
-
-            // Store data point if valid
-            if ( dataOk )
-            {
-                // Store current vals into trees
-                addLat( hemiNS, tmpLat, &latTree );
-                addLon( hemiEW, tmpLon, &lonTree );
-                addAlt( tmpAlt, &altTree );
-                addPDOP( tmpPDOP, &pdopTree );
-            }
-
-            // Reset result strings
-            dataOk = FALSE;
-            memset( status, 0, _countof( status ) );
-            memset( hemiNS, 0, _countof( hemiNS ) );
-            memset( hemiEW, 0, _countof( hemiEW ) );
-            memset( tmpLat, 0, _countof( tmpLat ) );
-            memset( tmpLon, 0, _countof( tmpLon ) );
-            memset( tmpAlt, 0, _countof( tmpAlt ) );
-            memset( tmpPDOP, 0, _countof( tmpPDOP ) );
-        }
+        if ( stats )
+            HposStatsStop( &hposStats );
+
+        if ( flags[ FL_GRID ] )
+            DeleteGrid( &posGrid );
 
-        // Reset input line buffer
-        memset( inputLine, 0, _countof( inputLine ) );
+        return 1;
     }
 
-    
+
     //==============================================
-    // Close nmea file
+    // Basic output only
+    // Nothing was stored in the trees
     //==============================================
-    if ( fclose( inNMEA ) != 0 )
+    if ( flags[ FL_BASIC ] )
     {
-        wmemset( errMsg, 0, _countof( errMsg ) );
-        __wcserror_s( errMsg, _countof( errMsg ),
-            TEXT( "\nClosing source file failed" ) );
-        fwprintf( stderr, TEXT( "%s\n" ), errMsg );
-        return 1;
+        // Output basic data to screen
+        // (useful for batch processing)
+        // Option: -b
+        STATS_MARK( hposOpts.pStats );
+        outBasicRes( &result );
+
+        // Output joint lat/lon density grid
+        // Option: -g
+        if ( flags[ FL_GRID ] )
+        {
+            outGrid( &posGrid, topPct, fileName );
+            DeleteGrid( &posGrid );
+        }
+
+        // Output results of all P-DOP cutoffs
+        // Option: --sweep
+        if ( sweep )
+            outSweep( &hposSweep, fileName );
+
+        STATS_LAP( hposOpts.pStats, STAGE_OUTPUT );
+
+        // Option: --stats
+        if ( stats )
+            outStats( &hposStats, &lonTree, &latTree, &altTree, &pdopTree,
+                argv[ fileInd ] );
+
+        return 0;
     }
 
 
@@ -263,6 +316,7 @@ int wmain( int argc, TCHAR* argv[] )
     //==============================================
     
     // Calc weighted value per node
+    STATS_MARK( hposOpts.pStats );
     fillWtVals( &latTree );
     fillWtVals( &lonTree );
     fillWtVals( &altTree );
@@ -273,6 +327,7 @@ int wmain( int argc, TCHAR* argv[] )
     calcWtTotVal( &lonTree );
     calcWtTotVal( &altTree );
     calcWtTotVal( &pdopTree );
+    STATS_LAP( hposOpts.pStats, STAGE_WEIGHT );
 
 
     //==============================================
@@ -280,8 +335,7 @@ int wmain( int argc, TCHAR* argv[] )
     //==============================================
 
     // Output basic data to screen
-    // (useful for batch processing)
-    // Option: -b
+    STATS_MARK( hposOpts.pStats );
     outBasic( &lonTree, &latTree, &altTree );
 
     // Output detailed data to screen
@@ -292,6 +346,30 @@ int wmain( int argc, TCHAR* argv[] )
     // Option: -c
     outCVS( &lonTree, &latTree, &altTree, &pdopTree, fileName );
 
+    // Output per-value counts as binary columns
+    // Option: -x
+    if ( flags[ FL_HIST ] )
+        outHist( &lonTree, &latTree, &altTree, &pdopTree,
+            result.ctMeas, fileName );
+
+    // Output joint lat/lon density grid
+    // Option: -g
+    if ( flags[ FL_GRID ] )
+        outGrid( &posGrid, topPct, fileName );
+
+    // Output results of all P-DOP cutoffs
+    // Option: --sweep
+    if ( sweep )
+        outSweep( &hposSweep, fileName );
+
+    STATS_LAP( hposOpts.pStats, STAGE_OUTPUT );
+
+    // Output stage timing and counters (before the trees are gone)
+    // Option: --stats
+    if ( stats )
+        outStats( &hposStats, &lonTree, &latTree, &altTree, &pdopTree,
+            argv[ fileInd ] );
+
 
     //==============================================
     // Destroy storage trees
@@ -301,13 +379,33 @@ int wmain( int argc, TCHAR* argv[] )
     DeleteAll( &altTree );
     DeleteAll( &pdopTree );
 
+    if ( flags[ FL_GRID ] )
+        DeleteGrid( &posGrid );
+
     return 0;
 }
 
-void addLat( char* hemis, char* valStr, Tree* pt )
+void storeFix( const HposFix* pFix, void* ctx )
+{
+    FixStore* pStore = ( FixStore* )ctx;
+
+    // Store current vals into trees
+    if ( pStore->pLatTree != NULL )
+    {
+        addLat( pFix->hemiNS, pFix->lat, pStore->pLatTree );
+        addLon( pFix->hemiEW, pFix->lon, pStore->pLonTree );
+        addAlt( pFix->alt, pStore->pAltTree );
+        addPDOP( pFix->pdop, pStore->pPDOPTree );
+    }
+
+    // Same pass, joint lat/lon cell
+    if ( pStore->pGrid != NULL )
+        AddFixToGrid( pFix->latInt, pFix->lonInt, pStore->pGrid );
+}
+
+void addLat( const char* hemis, const char* valStr, Tree* pt )
 {
     Item tmpItem = { 0 };
-    char tmpStr[ VALIN ] = { 0 };
     int intVal = 0;
 
     if ( TreeIsFull( pt ) )
@@ -327,29 +425,14 @@ void addLat( char* hemis, char* valStr, Tree* pt )
         strcat_s( tmpItem.nmeaVal, _countof( tmpItem.nmeaVal ), valStr );
 
         // Set up int val
-
-        // Degs
-        memset( tmpStr, 0, _countof( tmpStr ) );
-        strncpy_s( tmpStr, _countof( tmpStr ), valStr, 2 );
-        intVal = atoi( tmpStr ) * 3600000;
-
-        // Mins
-        memset( tmpStr, 0, _countof( tmpStr ) );
-        strncpy_s( tmpStr, _countof( tmpStr ), valStr + 2, 2 );
-        intVal += atoi( tmpStr ) * 60000;
-
-        // Fractions of mins
-        intVal += atoi( valStr + 5 ) * 6;
-
-        // Sign
-        if ( strstr( hemis, "S" ) )
-            intVal *= ( -1 );
+        intVal = HposLatToInt( hemis, valStr );
 
         // Store val in item
         tmpItem.intVal = intVal;
 
         // Set up double val [deg]
-        tmpItem.dblVal = ( double )intVal / 3600000;
+        tmpItem.scale = HPOS_SCALE_DEG;
+        tmpItem.dblVal = ( double )intVal / tmpItem.scale;
 
         // Set up pts counter
         tmpItem.ct = 1;
@@ -359,10 +442,9 @@ void addLat( char* hemis, char* valStr, Tree* pt )
     }
 }
 
-void addLon( char* hemis, char* valStr, Tree* pt )
+void addLon( const char* hemis, const char* valStr, Tree* pt )
 {
     Item tmpItem = { 0 };
-    char tmpStr[ VALIN ] = { 0 };
     int intVal = 0;
 
     if ( TreeIsFull( pt ) )
@@ -382,29 +464,14 @@ void addLon( char* hemis, char* valStr, Tree* pt )
         strcat_s( tmpItem.nmeaVal, _countof( tmpItem.nmeaVal ), valStr );
 
         // Set up int val
-
-        // Degs
-        memset( tmpStr, 0, _countof( tmpStr ) );
-        strncpy_s( tmpStr, _countof( tmpStr ), valStr, 3 );
-        intVal = atoi( tmpStr ) * 3600000;
-
-        // Mins
-        memset( tmpStr, 0, _countof( tmpStr ) );
-        strncpy_s( tmpStr, _countof( tmpStr ), valStr + 3, 2 );
-        intVal += atoi( tmpStr ) * 60000;
-
-        // Fractions of mins
-        intVal += atoi( valStr + 6 ) * 6;
-
-        // Sign
-        if ( strstr( hemis, "W" ) )
-            intVal *= ( -1 );
+        intVal = HposLonToInt( hemis, valStr );
 
         // Store val in item
         tmpItem.intVal = intVal;
 
         // Set up double val [deg]
-        tmpItem.dblVal = ( double )intVal / 3600000;
+        tmpItem.scale = HPOS_SCALE_DEG;
+        tmpItem.dblVal = ( double )intVal / tmpItem.scale;
 
         // Set up pts counter
         tmpItem.ct = 1;
@@ -414,10 +481,9 @@ void addLon( char* hemis, char* valStr, Tree* pt )
     }
 }
 
-void addAlt( char* valStr, Tree* pt )
+void addAlt( const char* valStr, Tree* pt )
 {
     Item tmpItem = { 0 };
-    char* chPt = NULL;
 
     if ( TreeIsFull( pt ) )
         puts( "Storage tree is full." );
@@ -429,19 +495,12 @@ void addAlt( char* valStr, Tree* pt )
         memset( tmpItem.nmeaVal, 0, _countof( tmpItem.nmeaVal ) );
         strcpy_s( tmpItem.nmeaVal, _countof( tmpItem.nmeaVal ), valStr );
 
-        // Set up int val
-        
-        // Metres -> decimetres
-        tmpItem.intVal = atoi( valStr ) * 10;
-
-        // Decimetres
-        chPt = strchr( valStr, '.' );
-        if ( chPt )
-            tmpItem.intVal += ( valStr[ 0 ] == '-' ? (-1) : 1 ) *
-                atoi( chPt + 1 );
+        // Set up int val [dm]
+        tmpItem.intVal = HposAltToInt( valStr );
 
         // Set up double val [metres]
-        tmpItem.dblVal = ( double )tmpItem.intVal / 10;
+        tmpItem.scale = HPOS_SCALE_ALT;
+        tmpItem.dblVal = ( double )tmpItem.intVal / tmpItem.scale;
 
         // Set up pts counter
         tmpItem.ct = 1;
@@ -451,10 +510,9 @@ void addAlt( char* valStr, Tree* pt )
     }
 }
 
-void addPDOP( char* valStr, Tree* pt )
+void addPDOP( const char* valStr, Tree* pt )
 {
     Item tmpItem = { 0 };
-    char* chPt = NULL;
 
     if ( TreeIsFull( pt ) )
         puts( "Storage tree is full." );
@@ -466,17 +524,12 @@ void addPDOP( char* valStr, Tree* pt )
         memset( tmpItem.nmeaVal, 0, _countof( tmpItem.nmeaVal ) );
         strcpy_s( tmpItem.nmeaVal, _countof( tmpItem.nmeaVal ), valStr );
 
-        // Set up int val
-        tmpItem.intVal = atoi( valStr ) * 100;
-
-        // Decimal places
-        chPt = strchr( valStr, '.' );
-        if ( chPt )
-            tmpItem.intVal += ( valStr[ 0 ] == '-' ? (-1) : 1 ) *
-                atoi( chPt + 1 );
+        // Set up int val [1/100]
+        tmpItem.intVal = HposPdopToInt( valStr );
 
         // Set up double val org units
-        tmpItem.dblVal = ( double )tmpItem.intVal / 100;
+        tmpItem.scale = HPOS_SCALE_PDOP;
+        tmpItem.dblVal = ( double )tmpItem.intVal / tmpItem.scale;
 
         // Set up pts counter
         tmpItem.ct = 1;
@@ -486,16 +539,16 @@ void addPDOP( char* valStr, Tree* pt )
     }
 }
 
-void showValsScreen( Tree* pt, HANDLE hOut )
+void showValsScreen( Tree* pt, BufOut* pOut )
 {
     if ( !( TreeIsEmpty( pt ) ) )
-        Traverse( pt, printItemScr, hOut );
+        Traverse( pt, printItemScr, pOut );
 }
 
-void showValsCSV( Tree* pt, HANDLE hOut )
+void showValsCSV( Tree* pt, BufOut* pOut )
 {
     if ( !( TreeIsEmpty( pt ) ) )
-        Traverse( pt, printItemCSV, hOut );
+        Traverse( pt, printItemCSV, pOut );
 }
 
 void fillWtVals( Tree* pt )
@@ -504,33 +557,97 @@ void fillWtVals( Tree* pt )
         Traverse( pt, fillWtValItem, NULL );
 }
 
-void printItemScr( Item* itemPt, int ctTot, HANDLE hOut )
+void printItemScr( Item* itemPt, int ctTot, BufOut* pOut )
 {
-    CHAR bufOut[ LINEOUT ] = { 0 };
+    CHAR* bufOut = NULL;
+    int len = 0;
 
-    // Print values's details
-    sprintf_s( bufOut, _countof( bufOut ),
-        "    %12s  %13d  %14.8f  %6d  %6d  %14.8f\n",
-        itemPt->nmeaVal, itemPt->intVal, itemPt->dblVal,
-        itemPt->ct, ctTot, itemPt->wtVal );
+    // Format in place
+    if ( ( bufOut = BufOutReserve( pOut, LINEOUT ) ) == NULL )
+        return;
 
-    txtToFile( bufOut, _countof( bufOut ), hOut );
+    // Print values's details
+    // ( "    %12s  %13d  %14.8f  %6d  %6d  %14.8f\n" )
+    // dblVal is formatted exactly from intVal
+    len += FmtStr( bufOut + len, "    " );
+    len += FmtPad( bufOut + len, FmtStr( bufOut + len, itemPt->nmeaVal ), 12 );
+    len += FmtStr( bufOut + len, "  " );
+    len += FmtPad( bufOut + len, FmtInt( bufOut + len, itemPt->intVal ), 13 );
+    len += FmtStr( bufOut + len, "  " );
+    len += FmtPad( bufOut + len,
+        FmtScaled( bufOut + len, itemPt->intVal, itemPt->scale ), 14 );
+    len += FmtStr( bufOut + len, "  " );
+    len += FmtPad( bufOut + len, FmtInt( bufOut + len, itemPt->ct ), 6 );
+    len += FmtStr( bufOut + len, "  " );
+    len += FmtPad( bufOut + len, FmtInt( bufOut + len, ctTot ), 6 );
+    len += FmtStr( bufOut + len, "  " );
+    len += FmtPad( bufOut + len, FmtDouble( bufOut + len, itemPt->wtVal ), 14 );
+    bufOut[ len++ ] = '\n';
+
+    BufOutCommit( pOut, len );
 }
 
-void printItemCSV( Item* itemPt, int ctTot, HANDLE hOut )
+void printItemCSV( Item* itemPt, int ctTot, BufOut* pOut )
 {
-    CHAR bufOut[ LINEOUT ] = { 0 };
+    CHAR* bufOut = NULL;
+    int len = 0;
+
+    // Format in place
+    if ( ( bufOut = BufOutReserve( pOut, LINEOUT ) ) == NULL )
+        return;
 
     // Print values's details to CSV file
-    sprintf_s( bufOut, _countof( bufOut ),
-        "%s,%d,%.8f,%d,%d,%.8f\n",
-        itemPt->nmeaVal, itemPt->intVal, itemPt->dblVal, itemPt->ct,
-        ctTot, itemPt->wtVal );
+    // ( "%s,%d,%.8f,%d,%d,%.8f\n" )
+    // dblVal is formatted exactly from intVal
+    len += FmtStr( bufOut + len, itemPt->nmeaVal );
+    bufOut[ len++ ] = ',';
+    len += FmtInt( bufOut + len, itemPt->intVal );
+    bufOut[ len++ ] = ',';
+    len += FmtScaled( bufOut + len, itemPt->intVal, itemPt->scale );
+    bufOut[ len++ ] = ',';
+    len += FmtInt( bufOut + len, itemPt->ct );
+    bufOut[ len++ ] = ',';
+    len += FmtInt( bufOut + len, ctTot );
+    bufOut[ len++ ] = ',';
+    len += FmtDouble( bufOut + len, itemPt->wtVal );
+    bufOut[ len++ ] = '\n';
+
+    BufOutCommit( pOut, len );
+}
+
+void printTotScr( Tree* pt, BufOut* pOut )
+{
+    CHAR* bufOut = NULL;
+    int len = 0;
+
+    if ( ( bufOut = BufOutReserve( pOut, LINEOUT ) ) == NULL )
+        return;
 
-    txtToFile( bufOut, _countof( bufOut ), hOut );
+    // Total weighted value ( "%79.8f\n" )
+    len += FmtPad( bufOut, FmtDouble( bufOut, fetchWtTotVal( pt ) ), 79 );
+    bufOut[ len++ ] = '\n';
+
+    BufOutCommit( pOut, len );
 }
 
-void fillWtValItem( Item* itemPt, int wt, HANDLE hOut )
+void printTotCSV( Tree* pt, BufOut* pOut )
+{
+    CHAR* bufOut = NULL;
+    int len = 0;
+
+    if ( ( bufOut = BufOutReserve( pOut, LINEOUT ) ) == NULL )
+        return;
+
+    // Total weighted value ( ",,,,,%.8f\n\n" )
+    len += FmtStr( bufOut, ",,,,," );
+    len += FmtDouble( bufOut + len, fetchWtTotVal( pt ) );
+    bufOut[ len++ ] = '\n';
+    bufOut[ len++ ] = '\n';
+
+    BufOutCommit( pOut, len );
+}
+
+void fillWtValItem( Item* itemPt, int wt, BufOut* pOut )
 {
     // Fill in the item's weighted value
     itemPt->wtVal = itemPt->dblVal * ( double )itemPt->ct / wt;
@@ -560,125 +677,390 @@ void outBasic( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt )
         fetchWtTotVal( ptTrAlt ) );
 }
 
+void outBasicRes( const HposResult* pRes )
+{
+    CHAR bufOut[ LINEOUT ] = { 0 };
+    int len = 0;
+
+    // Exact means from the integer sums ( "%.8f,%.8f,%.8f" )
+    if ( pRes->ctMeas > 0 )
+    {
+        len += FmtScaled( bufOut + len, pRes->sumLon,
+            ( long long )pRes->ctMeas * HPOS_SCALE_DEG );
+        bufOut[ len++ ] = ',';
+        len += FmtScaled( bufOut + len, pRes->sumLat,
+            ( long long )pRes->ctMeas * HPOS_SCALE_DEG );
+        bufOut[ len++ ] = ',';
+        len += FmtScaled( bufOut + len, pRes->sumAlt,
+            ( long long )pRes->ctMeas * HPOS_SCALE_ALT );
+    }
+    else
+        len += FmtStr( bufOut, "0.00000000,0.00000000,0.00000000" );
+
+    bufOut[ len ] = '\0';
+
+    fputs( bufOut, stdout );
+}
+
 void outDetail( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt )
 {
-    wprintf_s( TEXT( "\n" ) );
+    BufOut scrOut;
+
+    // Anything printed so far goes first
+    fflush( stdout );
+
+    if ( !AttachBufOut( &scrOut, IoStdOut() ) )
+        return;
+
+    BufOutText( &scrOut, "\n" );
 
     // Display lon values
-    wprintf_s( TEXT( "    %12s  %13s  %14s  %6s  %6s  %14s\n" ),
-        TEXT( "Lon" ), TEXT( "[ms]" ), TEXT( "[deg]" ),
-        TEXT( "ct" ), TEXT( "ctTot" ), TEXT( "[deg]" ) );
-    showValsScreen( ptTrLon, GetStdHandle( STD_OUTPUT_HANDLE ) );
-    wprintf_s( TEXT( "%79.8f\n\n" ), fetchWtTotVal( ptTrLon ) );
+    BufOutPrintf( &scrOut, "    %12s  %13s  %14s  %6s  %6s  %14s\n",
+        "Lon", "[ms]", "[deg]", "ct", "ctTot", "[deg]" );
+    showValsScreen( ptTrLon, &scrOut );
+    printTotScr( ptTrLon, &scrOut );
+    BufOutText( &scrOut, "\n" );
 
     // Display lat values
-    wprintf_s( TEXT( "    %12s  %13s  %14s  %6s  %6s  %14s\n" ),
-        TEXT( "Lat" ), TEXT( "[ms]" ), TEXT( "[deg]" ),
-        TEXT( "ct" ), TEXT( "ctTot" ), TEXT( "[deg]" ) );
-    showValsScreen( ptTrLat, GetStdHandle( STD_OUTPUT_HANDLE ) );
-    wprintf_s( TEXT( "%79.8f\n\n" ), fetchWtTotVal( ptTrLat ) );
+    BufOutPrintf( &scrOut, "    %12s  %13s  %14s  %6s  %6s  %14s\n",
+        "Lat", "[ms]", "[deg]", "ct", "ctTot", "[deg]" );
+    showValsScreen( ptTrLat, &scrOut );
+    printTotScr( ptTrLat, &scrOut );
+    BufOutText( &scrOut, "\n" );
 
     // Display alt values
-    wprintf_s( TEXT( "    %12s  %13s  %14s  %6s  %6s  %14s\n" ),
-        TEXT( "Alt" ), TEXT( "[dm]" ), TEXT( "[m]" ),
-        TEXT( "ct" ), TEXT( "ctTot" ), TEXT( "[m]" ) );
-    showValsScreen( ptTrAlt, GetStdHandle( STD_OUTPUT_HANDLE ) );
-    wprintf_s( TEXT( "%79.8f\n" ), fetchWtTotVal( ptTrAlt ) );
+    BufOutPrintf( &scrOut, "    %12s  %13s  %14s  %6s  %6s  %14s\n",
+        "Alt", "[dm]", "[m]", "ct", "ctTot", "[m]" );
+    showValsScreen( ptTrAlt, &scrOut );
+    printTotScr( ptTrAlt, &scrOut );
+
+    CloseBufOut( &scrOut );
 }
 
 void outCVS( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt, Tree* ptTrPDOP, TCHAR* fName )
 {
-    HANDLE hFileOut;
+    BufOut fileOut;
     TCHAR fNameTot[ FNAME ] = { 0 };
-    CHAR bufOut[ LINEOUT ] = { 0 };
 
     // Set up complete file name (name + ext)
     wcscpy_s( fNameTot, _countof( fNameTot ), fName );
     wcscat_s( fNameTot, _countof( fNameTot ), TEXT( ".csv" ) );
 
     // Open output file
-    hFileOut = CreateFile( fNameTot, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( !OpenBufOut( &fileOut, fNameTot ) )
+        return;
+
+    // Display Longitudes
+    BufOutText( &fileOut, "Lon,[ms],[deg],ct,ctTot,[deg]\n" );
+    showValsCSV( ptTrLon, &fileOut );
+    printTotCSV( ptTrLon, &fileOut );
 
-    // Validate output handle
-    if ( hFileOut == INVALID_HANDLE_VALUE )
+    // Display Latitudes
+    BufOutText( &fileOut, "Lat,[ms],[deg],ct,ctTot,[deg]\n" );
+    showValsCSV( ptTrLat, &fileOut );
+    printTotCSV( ptTrLat, &fileOut );
+
+    // Display Altitudes
+    BufOutText( &fileOut, "Alt,[dm],[m],ct,ctTot,[m]\n" );
+    showValsCSV( ptTrAlt, &fileOut );
+    printTotCSV( ptTrAlt, &fileOut );
+
+    // Display P-DOP
+    BufOutText( &fileOut, "P-DOP,[int],[org],ct,ctTot,[org]\n" );
+    showValsCSV( ptTrPDOP, &fileOut );
+    printTotCSV( ptTrPDOP, &fileOut );
+
+    // Flush and close file
+    CloseBufOut( &fileOut );
+}
+
+void outGrid( Grid* pGrid, int topPct, TCHAR* fName )
+{
+    BufOut fileOut;
+    TCHAR fNameTot[ FNAME ] = { 0 };
+    const Cell* pModal = NULL;
+    double meanLat = 0;
+    double meanLon = 0;
+    int ctTop = 0;
+    PgmImage image = { 0 };
+
+    if ( GridIsEmpty( pGrid ) )
+        return;
+
+    //==============================================
+    // Cells, modal cell and top cells mean (CSV)
+    //==============================================
+
+    // Set up complete file name (name + ext)
+    wcscpy_s( fNameTot, _countof( fNameTot ), fName );
+    wcscat_s( fNameTot, _countof( fNameTot ), TEXT( ".grid.csv" ) );
+
+    // Open output file
+    if ( !OpenBufOut( &fileOut, fNameTot ) )
+        return;
+
+    // Display used cells
+    BufOutText( &fileOut, "Lat cell,Lon cell,[deg],[deg],ct\n" );
+    TraverseGrid( pGrid, printCellCSV, &fileOut );
+
+    // Display cell size
+    BufOutPrintf( &fileOut, "\nCell size,[ms],%d\n", pGrid->cellSize );
+
+    // Display modal cell (centre)
+    pModal = GridModalCell( pGrid );
+    BufOutPrintf( &fileOut, "Modal,%d,%d,%.8f,%.8f,%d,%d\n",
+        pModal->latCell, pModal->lonCell,
+        ( pModal->latCell + 0.5 ) * pGrid->cellSize / 3600000,
+        ( pModal->lonCell + 0.5 ) * pGrid->cellSize / 3600000,
+        pModal->ct, pGrid->ctTotMeas );
+
+    // Display mean of fixes in the densest cells
+    ctTop = GridTopMean( pGrid, topPct, &meanLat, &meanLon );
+    if ( ctTop > 0 )
+        BufOutPrintf( &fileOut, "Top %d%%,%d,%d,%.8f,%.8f\n",
+            topPct, ctTop, pGrid->ctTotCells,
+            meanLat / 3600000, meanLon / 3600000 );
+
+    // Flush and close file
+    CloseBufOut( &fileOut );
+
+    //==============================================
+    // Density image (binary PGM)
+    // North up, one pixel per cell
+    //==============================================
+    image.width = pGrid->maxLonCell - pGrid->minLonCell + 1;
+    image.height = pGrid->maxLatCell - pGrid->minLatCell + 1;
+    image.maxCt = pModal->ct;
+    image.pGrid = pGrid;
+
+    if ( image.width > GRID_PGM_MAX || image.height > GRID_PGM_MAX )
     {
-        ReportError( TEXT( "Open output file failed." ), 0, TRUE );
+        fwprintf( stderr,
+            TEXT( "Grid too sparse for density image (%d x %d)\n" ),
+            image.width, image.height );
         return;
     }
 
-    // Display Longitudes
-    sprintf_s( bufOut, _countof( bufOut ), "%s",
-        "Lon,[ms],[deg],ct,ctTot,[deg]\n" );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    image.pixels = ( BYTE* )calloc( image.width * image.height, 1 );
+    if ( image.pixels == NULL )
+    {
+        fwprintf( stderr, TEXT( "No memory available for density image\n" ) );
+        return;
+    }
 
-    showValsCSV( ptTrLon, hFileOut );
+    TraverseGrid( pGrid, fillCellPGM, &image );
 
-    sprintf_s( bufOut, _countof( bufOut ), ",,,,,%.8f\n\n",
-        fetchWtTotVal( ptTrLon ) );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
-    
-    // Display Latitudes
-    sprintf_s( bufOut, _countof( bufOut ), "%s",
-        "Lat,[ms],[deg],ct,ctTot,[deg]\n" );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    // Set up complete file name (name + ext)
+    wcscpy_s( fNameTot, _countof( fNameTot ), fName );
+    wcscat_s( fNameTot, _countof( fNameTot ), TEXT( ".pgm" ) );
 
-    showValsCSV( ptTrLat, hFileOut );
+    if ( OpenBufOut( &fileOut, fNameTot ) )
+    {
+        BufOutPrintf( &fileOut, "P5\n%d %d\n255\n",
+            image.width, image.height );
+        BufOutWrite( &fileOut, image.pixels, image.width * image.height );
 
-    sprintf_s( bufOut, _countof( bufOut ), ",,,,,%.8f\n\n",
-        fetchWtTotVal( ptTrLat ) );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+        CloseBufOut( &fileOut );
+    }
 
-    // Display Altitudes
-    sprintf_s( bufOut, _countof( bufOut ), "%s",
-        "Alt,[dm],[m],ct,ctTot,[m]\n" );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    free( image.pixels );
+}
 
-    showValsCSV( ptTrAlt, hFileOut );
+void outHist( Tree* ptTrLon, Tree* ptTrLat, Tree* ptTrAlt, Tree* ptTrPDOP,
+    int ctMeas, TCHAR* fName )
+{
+    BufOut fileOut;
+    TCHAR fNameTot[ FNAME ] = { 0 };
+    HistHeader header = { 0 };
+    HistSection sections[ HIST_SECTIONS ] = { 0 };
+    Tree* trees[ HIST_SECTIONS ] = { ptTrLon, ptTrLat, ptTrAlt, ptTrPDOP };
+    const CHAR* tags[ HIST_SECTIONS ] = { "LON", "LAT", "ALT", "PDOP" };
+    const INT32 scales[ HIST_SECTIONS ] = { HPOS_SCALE_DEG, HPOS_SCALE_DEG,
+        HPOS_SCALE_ALT, HPOS_SCALE_PDOP };
+    UINT64 offset = 0;
+    int i;
+
+    // Set up header
+    memcpy( header.magic, HIST_MAGIC, sizeof( header.magic ) );
+    header.version = HIST_VERSION;
+    header.ctSections = HIST_SECTIONS;
+    header.ctMeas = ctMeas;
+
+    // Set up section table, columns follow it in the same order
+    offset = sizeof( HistHeader ) + sizeof( sections );
+
+    for ( i = 0; i < HIST_SECTIONS; i++ )
+    {
+        memcpy( sections[ i ].tag, tags[ i ], strlen( tags[ i ] ) );
+        sections[ i ].scale = scales[ i ];
+        sections[ i ].ctVals = trees[ i ]->ctTotNodes;
+        sections[ i ].ctTot = trees[ i ]->ctTotMeas;
+        sections[ i ].wtTotVal = fetchWtTotVal( trees[ i ] );
+        sections[ i ].offset = offset;
+
+        offset += ( UINT64 )sections[ i ].ctVals *
+            ( sizeof( INT32 ) + sizeof( UINT32 ) );
+    }
 
-    sprintf_s( bufOut, _countof( bufOut ), ",,,,,%.8f\n\n",
-        fetchWtTotVal( ptTrAlt ) );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    // Set up complete file name (name + ext)
+    wcscpy_s( fNameTot, _countof( fNameTot ), fName );
+    wcscat_s( fNameTot, _countof( fNameTot ), TEXT( ".hist" ) );
 
-    // Display P-DOP
-    sprintf_s( bufOut, _countof( bufOut ), "%s",
-        "P-DOP,[int],[org],ct,ctTot,[org]\n" );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    // Open output file
+    if ( !OpenBufOut( &fileOut, fNameTot ) )
+        return;
 
-    showValsCSV( ptTrPDOP, hFileOut );
+    BufOutWrite( &fileOut, &header, sizeof( header ) );
+    BufOutWrite( &fileOut, sections, sizeof( sections ) );
 
-    sprintf_s( bufOut, _countof( bufOut ), ",,,,,%.8f\n\n",
-        fetchWtTotVal( ptTrPDOP ) );
-    txtToFile( bufOut, _countof( bufOut ), hFileOut );
+    // One pass per column (trees are traversed in ascending order)
+    for ( i = 0; i < HIST_SECTIONS; i++ )
+    {
+        if ( TreeIsEmpty( trees[ i ] ) )
+            continue;
+
+        Traverse( trees[ i ], writeItemIntVal, &fileOut );
+        Traverse( trees[ i ], writeItemCt, &fileOut );
+    }
 
-    // Close handle
-    CloseHandle( hFileOut );
+    // Flush and close file
+    CloseBufOut( &fileOut );
 }
 
-int txtToFile( CHAR* txtInPt, DWORD sizeBuf, HANDLE hOut )
+void outSweep( const HposSweep* pSweep, TCHAR* fName )
 {
-    DWORD txtLen, nOut;
+    BufOut fileOut;
+    TCHAR fNameTot[ FNAME ] = { 0 };
+    CHAR* bufOut = NULL;
+    long long sumLat = 0;
+    long long sumLon = 0;
+    long long sumAlt = 0;
+    long long ctMeas = 0;
+    int len, i;
 
-    // Calc amount of bytes to output
-    txtLen = strnlen( txtInPt, sizeBuf );
-    
-    // Validate text buffer null termination
-    if ( txtLen >= sizeBuf )
+    // Set up complete file name (name + ext)
+    wcscpy_s( fNameTot, _countof( fNameTot ), fName );
+    wcscat_s( fNameTot, _countof( fNameTot ), TEXT( ".sweep.csv" ) );
+
+    // Open output file
+    if ( !OpenBufOut( &fileOut, fNameTot ) )
+        return;
+
+    BufOutText( &fileOut, "P-DOP cutoff,ct,Lon [deg],Lat [deg],Alt [m]\n" );
+
+    // Running sums: all P-DOP values up to the cutoff
+    for ( i = 0; i <= HPOS_SWEEP_LAST; i++ )
     {
-        // String not null terminated -> terminate output
-        fprintf( stderr, "String length error.\n" );
-        return 1;
+        sumLat += pSweep->sumLat[ i ];
+        sumLon += pSweep->sumLon[ i ];
+        sumAlt += pSweep->sumAlt[ i ];
+        ctMeas += pSweep->ctMeas[ i ];
+
+        if ( i < HPOS_SWEEP_FIRST )
+            continue;
+
+        if ( ( bufOut = BufOutReserve( &fileOut, LINEOUT ) ) == NULL )
+            break;
+
+        // Exact means as with -b ( "%.2f,%d,%.8f,%.8f,%.8f\n" )
+        len = FmtInt( bufOut, i / HPOS_SCALE_PDOP );
+        bufOut[ len++ ] = '.';
+        bufOut[ len++ ] = ( CHAR )( '0' + i / 10 % 10 );
+        bufOut[ len++ ] = ( CHAR )( '0' + i % 10 );
+        bufOut[ len++ ] = ',';
+        len += FmtInt( bufOut + len, ctMeas );
+
+        if ( ctMeas > 0 )
+        {
+            bufOut[ len++ ] = ',';
+            len += FmtScaled( bufOut + len, sumLon, ctMeas * HPOS_SCALE_DEG );
+            bufOut[ len++ ] = ',';
+            len += FmtScaled( bufOut + len, sumLat, ctMeas * HPOS_SCALE_DEG );
+            bufOut[ len++ ] = ',';
+            len += FmtScaled( bufOut + len, sumAlt, ctMeas * HPOS_SCALE_ALT );
+        }
+        else
+            len += FmtStr( bufOut + len, ",,," );
+
+        bufOut[ len++ ] = '\n';
+
+        BufOutCommit( &fileOut, len );
     }
 
-    // Write text to file
-    WriteFile( hOut, txtInPt, txtLen, &nOut, NULL );
+    // Flush and close file
+    CloseBufOut( &fileOut );
+}
+
+void writeItemIntVal( Item* itemPt, int ctTot, BufOut* pOut )
+{
+    INT32 val = itemPt->intVal;
+
+    BufOutWrite( pOut, &val, sizeof( val ) );
+}
+
+void writeItemCt( Item* itemPt, int ctTot, BufOut* pOut )
+{
+    UINT32 val = itemPt->ct;
+
+    BufOutWrite( pOut, &val, sizeof( val ) );
+}
 
-    // Validate bytes 'to output' vs 'output' bytes
-    if ( txtLen != nOut )
+void printCellCSV( const Cell* pCell, void* ctx )
+{
+    // Print cell's details to CSV file
+    // Mean position of the fixes in the cell
+    BufOutPrintf( ( BufOut* )ctx, "%d,%d,%.8f,%.8f,%d\n",
+        pCell->latCell, pCell->lonCell,
+        ( double )pCell->sumLat / pCell->ct / 3600000,
+        ( double )pCell->sumLon / pCell->ct / 3600000,
+        pCell->ct );
+}
+
+void fillCellPGM( const Cell* pCell, void* ctx )
+{
+    PgmImage* pImage = ( PgmImage* )ctx;
+    int row, col;
+
+    // Row 0 is the northernmost cell
+    row = pImage->pGrid->maxLatCell - pCell->latCell;
+    col = pCell->lonCell - pImage->pGrid->minLonCell;
+
+    // Scale count to grey level (any used cell is visible)
+    pImage->pixels[ row * pImage->width + col ] = ( BYTE )
+        ( ( ( long long )pCell->ct * 254 + pImage->maxCt - 1 ) /
+        pImage->maxCt + 1 );
+}
+
+// Stats of all stages as JSON on screen
+void outStats( HposStats* pStats, Tree* ptTrLon, Tree* ptTrLat,
+    Tree* ptTrAlt, Tree* ptTrPDOP, LPCTSTR fName )
+{
+    Tree* trees[ CT_STAT_TREES ] = { ptTrLat, ptTrLon, ptTrAlt, ptTrPDOP };
+    BufOut out;
+    int i;
+
+    HposStatsStop( pStats );
+
+    for ( i = 0; i < CT_STAT_TREES; i++ )
     {
-        ReportError( TEXT( "Output to file failed." ), 0, TRUE );
-        return 1;
+        pStats->trees[ i ].ctNodes = TreeItemCount( trees[ i ] );
+        pStats->trees[ i ].depth = TreeDepth( trees[ i ] );
+        pStats->trees[ i ].ctMeas = trees[ i ]->ctTotMeas;
     }
 
-    return 0;
+#ifndef HPOS_STATS
+    fwprintf( stderr, TEXT( "\nhpos built without HPOS_STATS: "
+        "no timing, no counters\n" ) );
+#endif
+
+    // After the results written by stdio
+    fflush( stdout );
+
+    if ( !AttachBufOut( &out, IoStdOut() ) )
+        return;
+
+    // Results end without a new line
+    BufOutText( &out, "\n" );
+    HposStatsWrite( pStats, fName, &out );
+    CloseBufOut( &out );
 }
@@ -4,29 +4,176 @@
 // Command line tool for LocBench
 //
 
-#include <windows.h>
+#include "platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <wchar.h>
+#include <wctype.h>
 #include "list.h"               // Definition list ADT
+#include "hposEng.h"            // nmea parsing and aggregation
+#include "pool.h"               // Worker threads
+#include "resCache.h"           // Results of unchanged files
+#include "fmtNum.h"             // Fast numeric text
+#include "zipOut.h"             // Streaming kmz output
+#include "fgbOut.h"             // FlatGeobuf output
+#include "readAhead.h"          // Files read while others are parsed
+#include "io.h"                 // Files and dirs (Win32, POSIX)
+#include "probes.h"             // Static tracepoints (USDT)
+#include "telemetry.h"          // Live progress file
 
 #define     MAX_OPTIONS     20  // Max # command line options
-#define     CMDBUF          256
+#define     FILES_MIN       64  // Initial size of file listing
+#define     READ_BUDGET     ( 64 * 1024 * 1024 )    // Files read ahead [bytes]
+
+#define     JOB_FILE        0   // Job kinds (recursive mode)
+#define     JOB_DIR         1
+#define     PRIO_DIR        LLONG_MAX   // Dirs are listed first
+
+#define     CACHE_FILE      TEXT( "jdots.cache" )   // In target dir
+#define     TELEM_FILE      TEXT( "jdots.telemetry.json" )  // Same
+
+#define     COORDS          64  // Coords text [TCHARs]
+#define     COORDS_FMT      TEXT( "%.8f,%.8f,%.8f" )    // Same as 'hpos -b'
+
+#define     IS_DIGIT( ch )  ( ( ch ) >= TEXT( '0' ) && ( ch ) <= TEXT( '9' ) )
 
 // Flags indices
 #define     FL_HELP         0   // Print usage
+#define     FL_RECURSE      1   // Recurse into subdirs
+#define     FL_NATURAL      2   // Numbers in names by value
+#define     FL_KMZ          3   // Write kml zipped (kmz)
+#define     FL_FGB          4   // Write FlatGeobuf
+#define     FL_GEOJSON      5   // Write GeoJSON text sequence
+#define     FL_WATCH        6   // Update results on changes
+
+#define     WATCH_INTERVAL  2000                // Min time between updates [ms]
+#define     NMEA_EXT        TEXT( ".nmea" )
+
+#define     KMZ_ENTRY       "doc.kml"   // Kml inside the kmz
+#define     JSON_RS         '\x1e'      // Record separator ( RFC 8142 )
 
 extern DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... );
+extern BOOL OptionLong( int argc, LPCWSTR argv[], LPCWSTR name );
 extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
 
-BOOL scanDir( LPTSTR tDir, List* resList, Item* parentItem );
-int cmpItemsName( Item* pItemN, Item* pItemM );
-void showResults( List* resultsList, Item* resultsLevel );
-void showItem( Item* pItem );
+PROBE_SEMAPHORE( scan_end );
+PROBE_SEMAPHORE( file_end );
+
+// Live progress ( --telemetry ), NULL: off
+static Telemetry* pTelem = NULL;
+
+// One nmea file of the listing (see scanDir, walkTree)
+typedef struct fileJob
+{
+    int kind;               // JOB_FILE
+    Item item;              // Found file, receives the results
+    TCHAR path[ MAX_PATH ]; // Relative to target dir
+    BOOL ok;                // Processing succeeded
+    int readInd;            // File of the read ahead (see scanDir)
+    struct fileJob* next;   // All files of a walk
+} FileJob;
+
+// One dir of a walk (see walkTree)
+typedef struct dirJob
+{
+    int kind;               // JOB_DIR
+    TCHAR path[ MAX_PATH ]; // Relative to target dir, IO_SEP terminated
+    struct dirJob* parent;  // NULL: target dir
+    struct dirJob* next;    // All dirs of a walk
+    struct dirJob* nextLink;    // Linked dirs not yet listed
+    BOOL marked;            // Recorded as visited
+    Item own;               // Size, last write time of own nmea files
+    Item totals;            // Same for this level and below
+    int ctFiles;            // Own nmea files
+    int ctBelow;            // Dirs below with nmea files
+} DirJob;
+
+// File id of a listed dir
+typedef struct dirId
+{
+    UINT64 volume;
+    UINT64 index;
+} DirId;
+
+// Shared state of a walk
+typedef struct walk
+{
+    WorkQueue queue;        // Dir and file jobs
+    ResCache* pCache;       // Results of unchanged files
+    CRITICAL_SECTION lock;  // Guards lists and visited dirs
+    DirJob* dirs;           // All dirs found
+    FileJob* files;         // All nmea files found
+    DirJob* links;          // Linked dirs found (listed after the others)
+    DirId* visited;         // Listed dirs
+    int ctVisited;
+    int sizeVisited;
+    BOOL failed;            // No memory
+} Walk;
+
+// Shared state of a scan (see scanDir)
+typedef struct scan
+{
+    ResCache* pCache;       // Results of unchanged files
+    ReadAhead* pRead;       // NULL: workers read the files
+} Scan;
+
+// State of watch mode
+typedef struct watch
+{
+    List* resList;          // Results, kept sorted
+    List* dirList;          // Empty (no subdirs)
+    Item* pTotals;
+    ResCache* pCache;
+    const BOOL* flags;      // Command line options
+    List pending;           // Names changed since last update
+    BOOL rescan;            // Changes were lost: list dir again
+} Watch;
+
+BOOL scanDir( LPTSTR tDir, List* resList, Item* parentItem,
+    ResCache* pCache );
+void procFileJob( void* pJob, void* ctx );
+void procFile( FileJob* pFile, ResCache* pCache );
+BOOL lookupFile( FileJob* pFile, ResCache* pCache );
+void parseFile( FileJob* pFile, ResCache* pCache, ReadAhead* pRead );
+UINT64 jobWriteTime( const FileJob* pFile );
+int cmpJobsSize( const void* pA, const void* pB );
+void addToTotals( Item* pTotals, UINT64 size, const FILETIME* pWriteTime );
+BOOL walkTree( LPTSTR tDir, List* resList, List* dirList, Item* parentItem,
+    ResCache* pCache );
+void walkJob( void* pJob, void* ctx );
+void listDir( DirJob* pDir, Walk* pWalk );
+BOOL queueLinks( Walk* pWalk );
+BOOL markDirVisited( DirJob* pDir, Walk* pWalk );
+int cmpDirsPath( const void* pA, const void* pB );
+BOOL watchDir( LPTSTR tDir, List* resList, List* dirList, Item* pTotals,
+    ResCache* pCache, const BOOL* flags );
+void queueChange( LPCTSTR fileName, size_t len, void* ctx );
+void updateResults( Watch* pWatch );
+void queueDir( Watch* pWatch );
+BOOL updateFile( Watch* pWatch, LPCTSTR name );
+void sumTotals( List* plist, Item* pTotals );
+BOOL isNmeaName( LPCTSTR name, size_t len );
+size_t keyItemName( const Item* pItem, LPCTSTR path, TCHAR* key );
+size_t keyItemNatural( const Item* pItem, LPCTSTR path, TCHAR* key );
+void sortItems( List* plist, BOOL natural );
+void emitResults( List* resultsList, List* dirList, Item* resultsLevel,
+    ResCache* pCache, const BOOL* flags );
+void showResults( List* resultsList, List* dirList, Item* resultsLevel,
+    ResCache* pCache );
+void showItem( Item* pItem, LPCTSTR path );
+void showTotals( Item* pItem, LPCTSTR path );
+void showRow( const Item* pItem, LPCTSTR coords, LPCTSTR path );
 void sepThousands( const long long* numPt, TCHAR* acc, size_t elemsAcc );
-BOOL procNmeaFile( TCHAR* fName, TCHAR* cdsOut, int cdsSize );
-void outputKml( List* plist );
-void addPtToKml( FILE* outKml, Item* pitem );
-void addCoordsToKml( FILE* outKml, Item* pitem );
+BOOL procNmeaFile( TCHAR* fName, const char* data, size_t ctData,
+    Item* pItem );
+void outputKml( List* plist, BOOL kmz );
+void addPtToKml( BufOut* outKml, Item* pitem, LPCTSTR path );
+void addCoordsToKml( BufOut* outKml, Item* pitem, LPCTSTR path );
+void addCoords( BufOut* outKml, const Item* pitem );
+void outputFgb( List* plist );
+void outputGeoJson( List* plist );
+void addPtToGeoJson( BufOut* outJson, Item* pitem, LPCTSTR path );
 
 
 int wmain( int argc, LPTSTR argv[] )
@@ -38,17 +185,23 @@ int wmain( int argc, LPTSTR argv[] )
     TCHAR targetDir[ MAX_PATH ] = { 0 };
     DWORD workLength = 0;
     List resultsList = { 0 };
+    List dirList = { 0 };
     Item resultsItem = { 0 };
+    ResCache cache;
+    Telemetry telem;
     PVOID oldValueWow64 = NULL;
     BOOL wow64Disabled = FALSE;
     TCHAR* ptTchar = NULL;
 
     // Get index of first argument after options
     // Also determine which options are active
-    targetDirInd = Options( argc, argv, TEXT( "h" ), &flags[ FL_HELP ], NULL );
+    targetDirInd = Options( argc, ( LPCWSTR* )argv, TEXT( "hrnzfjw" ),
+        &flags[ FL_HELP ], &flags[ FL_RECURSE ], &flags[ FL_NATURAL ],
+        &flags[ FL_KMZ ], &flags[ FL_FGB ], &flags[ FL_GEOJSON ],
+        &flags[ FL_WATCH ], NULL );
     
     // Get current working dir
-    workLength = GetCurrentDirectory( _countof( workDir ), workDir );
+    workLength = IoGetCwd( workDir, _countof( workDir ) );
 
     // Validate target dir
     if ( ( argc > targetDirInd + 1 ) || flags[ FL_HELP ] )
@@ -60,7 +213,15 @@ int wmain( int argc, LPTSTR argv[] )
         // Print usage
         wprintf_s( TEXT( "\n    Usage:    jdots [options] [target dir]\n\n" ) );
         wprintf_s( TEXT( "    Options:\n\n" ) );
-        wprintf_s( TEXT( "      -h   :  Print usage\n\n" ) );
+        wprintf_s( TEXT( "      -h   :  Print usage\n" ) );
+        wprintf_s( TEXT( "      -r   :  Include nmea files in subdirs (totals per dir)\n" ) );
+        wprintf_s( TEXT( "      -n   :  Sort numbers in names by value (P2 before P10)\n" ) );
+        wprintf_s( TEXT( "      -z   :  Write kml zipped (.kmz)\n" ) );
+        wprintf_s( TEXT( "      -f   :  Also write FlatGeobuf with spatial index (.fgb)\n" ) );
+        wprintf_s( TEXT( "      -j   :  Also write GeoJSON text sequence (.geojsons)\n" ) );
+        wprintf_s( TEXT( "      -w   :  Keep watching target dir, update results on changes\n" ) );
+        wprintf_s( TEXT( "      --telemetry  :  Rewrite progress every second (%s)\n\n" ),
+            TELEM_FILE );
         wprintf_s( TEXT( "    If no target dir is specified, then the current working dir will be used\n" ) );
 
         return 1;
@@ -86,21 +247,22 @@ int wmain( int argc, LPTSTR argv[] )
     }
 
     // Set up absolute target dir --> resolve '.' and '..' in target dir
-    if ( !SetCurrentDirectory( targetDir ) )
+    if ( !IoSetCwd( targetDir ) )
     {
         ReportError( TEXT( "\nTarget directory not found.\n" ), 0, TRUE );
         return 1;
     }
 
     // Display absolute target dir
-    GetCurrentDirectory( _countof( targetDir ), targetDir );
+    IoGetCwd( targetDir, _countof( targetDir ) );
     wprintf_s( TEXT( "\n    Target dir: \"%s\"\n\n" ), targetDir );
 
     // Initialize results list
     InitializeList( &resultsList );
+    InitializeList( &dirList );
 
     // Initialize list's name (measurement name)
-    ptTchar = wcsrchr( targetDir, L'\\' );
+    ptTchar = wcsrchr( targetDir, IO_SEP_CH );
 
     if ( ptTchar != NULL )
         IniListName( &resultsList, ptTchar + 1 );
@@ -114,11 +276,36 @@ int wmain( int argc, LPTSTR argv[] )
         return 1;
     }
 
+    // Watch mode follows the target dir only
+    if ( flags[ FL_WATCH ] && flags[ FL_RECURSE ] )
+    {
+        wprintf_s( TEXT( "    Watch mode: subdirs are not included\n\n" ) );
+        flags[ FL_RECURSE ] = FALSE;
+    }
+
     // Disable file system redirection
     wow64Disabled = Wow64DisableWow64FsRedirection( &oldValueWow64 );
 
+    // Load results of previous runs
+    OpenResCache( &cache, CACHE_FILE );
+
+    // Live progress next to the cache
+    if ( OptionLong( argc, ( LPCWSTR* )argv, TEXT( "telemetry" ) ) )
+    {
+        if ( StartTelemetry( &telem, TELEM_FILE, TELEM_INTERVAL ) )
+            pTelem = &telem;
+        else
+            ReportError( TEXT( "Starting telemetry failed." ), 0, FALSE );
+    }
+
     // Scan target dir
-    scanDir( targetDir, &resultsList, &resultsItem );
+    if ( flags[ FL_RECURSE ] )
+        walkTree( targetDir, &resultsList, &dirList, &resultsItem, &cache );
+    else
+        scanDir( targetDir, &resultsList, &resultsItem, &cache );
+
+    // Write cache file (merged with other runs)
+    SaveResCache( &cache );
 
     // Re-enable redirection
     if ( wow64Disabled )
@@ -127,165 +314,1016 @@ int wmain( int argc, LPTSTR argv[] )
             ReportError( TEXT( "Re-enable redirection failed." ), 1, TRUE );
     }
 
-    // Display results
-    if ( ListIsEmpty( &resultsList ) )
-        wprintf_s( TEXT( "\nNo data.\n\n" ) );
-    else
-    {
-        // Sort by name (a to Z)
-        SortList( &resultsList, cmpItemsName );
+    // Sort by name (a to Z)
+    sortItems( &resultsList, flags[ FL_NATURAL ] );
+    sortItems( &dirList, flags[ FL_NATURAL ] );
 
-        // Display sorted results
-        showResults( &resultsList, &resultsItem );
+    // Display results, generate output files
+    emitResults( &resultsList, &dirList, &resultsItem, &cache, flags );
 
-        // Generate KML file
-        outputKml( &resultsList );
+    // Keep results up to date
+    if ( flags[ FL_WATCH ] )
+        watchDir( targetDir, &resultsList, &dirList, &resultsItem, &cache,
+            flags );
 
+    // Last progress report
+    if ( pTelem != NULL )
+    {
+        StopTelemetry( pTelem );
+        pTelem = NULL;
     }
 
     // Housekeeping
     EmptyTheList( &resultsList );
+    EmptyTheList( &dirList );
+    CloseResCache( &cache );
 
     return 0;
 }
 
-BOOL scanDir( LPTSTR tDir, List* resList, Item* parentItem )
+BOOL scanDir( LPTSTR tDir, List* resList, Item* parentItem,
+    ResCache* pCache )
 {
-    TCHAR dirStr[ MAX_PATH ] = { 0 };
-    HANDLE hFind = INVALID_HANDLE_VALUE;
+    IoDir dir;
+    IoEntry entry;
+    int found;
+
+    FileJob* files = NULL;          // Found files (listing order)
+    FileJob** order = NULL;         // Files to parse (largest first)
+    FileJob* tmpFiles = NULL;
+    RaFile* reads = NULL;           // Same files, read ahead
+    ReadAhead read;
+    Scan scan;
+    LONGLONG start = 0;
+    int ctFiles = 0;
+    int ctOrder = 0;
+    int sizeFiles = 0;
+    BOOL result = TRUE;
+    int i;
 
-    Item currentItem = { 0 };
-    
-    LARGE_INTEGER parentSize = { 0 };
-    LARGE_INTEGER currentSize = { 0 };
+    // List nmea files of the target dir
+    if ( !IoOpenDir( &dir, tDir, NMEA_EXT ) )
+    {
+        // Only report error if different from 'Access Denied'.
+        // For example, system symbolic links report 'access denied'.
+        // If a handle is obtained and the size is requested,
+        // Win32 reports 0 bytes.
+        // See results using '..\progsDev\others\TestGetFileSizeEx\'
+        if ( GetLastError() != ERROR_ACCESS_DENIED )
+            ReportError( TEXT( "Listing target dir failed." ), 0, TRUE );
 
-    // Prepare string for use with FindFile functions.
-    
-    // Validate space to extend dirStr
-    // There must be enough space to append
-    // "*.nmea" + '\0' or "\*.nmea" + '\0'
-    if ( wcsnlen( tDir, MAX_PATH ) >= MAX_PATH - 8 )
+        // Exit in any case
+        return FALSE;
+    }
+
+    //==============================================
+    // Collect nmea files in target dir
+    //==============================================
+    while ( ( found = IoReadDir( &dir, &entry ) ) == IO_ENTRY )
     {
-        wprintf_s( TEXT( "\nDirectory path is too long.\n" ) );
+        // Do not follow symbolic links, ignore subdirs
+        if ( entry.attrs & ( IO_ATTR_LINK | IO_ATTR_DIR ) )
+            continue;
+
+        // File found
+
+        // Update size and last write time of the parent
+        addToTotals( parentItem, entry.size, &entry.ftLastWriteTime );
+
+        // Make room for current file
+        if ( ctFiles == sizeFiles )
+        {
+            sizeFiles = ( sizeFiles == 0 ) ? FILES_MIN : 2 * sizeFiles;
+            tmpFiles = ( FileJob* )realloc( files,
+                sizeFiles * sizeof( FileJob ) );
+
+            if ( tmpFiles == NULL )
+            {
+                wprintf_s( TEXT( "Problem allocating memory\n" ) );
+                result = FALSE;
+                break;
+            }
+
+            files = tmpFiles;
+        }
+
+        // Keep current file for processing
+        memset( &files[ ctFiles ], 0, sizeof( FileJob ) );
+        files[ ctFiles ].kind = JOB_FILE;
+        files[ ctFiles ].item.size = entry.size;
+        files[ ctFiles ].item.ftLastWriteTime = entry.ftLastWriteTime;
+        wcscpy_s( files[ ctFiles ].path, _countof( files[ ctFiles ].path ),
+            entry.name );
+        files[ ctFiles ].ok = FALSE;
+        files[ ctFiles ].next = NULL;
+        ctFiles++;
+    }
+
+    // Validate end of listing
+    if ( result && found == IO_ERROR )
+    {
+        ReportError( TEXT( "\nListing target dir failed.\n" ), 0, TRUE );
+        result = FALSE;
+    }
+
+    IoCloseDir( &dir );
+
+    //==============================================
+    // Apply hpos engine on all files in parallel
+    // Largest files first, so no long file is left
+    // for the end
+    // Files are read ahead in the same order, so
+    // parsing overlaps with reading the next files
+    //==============================================
+    if ( result && ctFiles > 0 )
+    {
+        order = ( FileJob** )malloc( ctFiles * sizeof( FileJob* ) );
+        reads = ( RaFile* )malloc( ctFiles * sizeof( RaFile ) );
+
+        if ( order == NULL || reads == NULL )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            result = FALSE;
+        }
+        else
+        {
+            // Cached files need no reading
+            for ( i = 0; i < ctFiles; i++ )
+            {
+                TelemetryQueue( pTelem, 1, files[ i ].item.size );
+
+                if ( !lookupFile( &files[ i ], pCache ) )
+                    order[ ctOrder++ ] = &files[ i ];
+            }
+
+            qsort( order, ctOrder, sizeof( FileJob* ), cmpJobsSize );
+
+            for ( i = 0; i < ctOrder; i++ )
+            {
+                order[ i ]->readInd = i;
+                reads[ i ].path = order[ i ]->path;
+                reads[ i ].size = order[ i ]->item.size;
+            }
+
+            scan.pCache = pCache;
+            scan.pRead = NULL;
+
+            PROBE2( scan_start, ctFiles, ctOrder );
+            if ( PROBE_ENABLED( scan_end ) )
+                start = PROBE_NOW();
+
+            if ( ctOrder > 0 &&
+                StartReadAhead( &read, reads, ctOrder, READ_BUDGET ) )
+                scan.pRead = &read;
+
+            RunPool( order, ctOrder, sizeof( FileJob* ), procFileJob, &scan,
+                PoolDefaultThreads() );
+
+            if ( scan.pRead != NULL )
+                StopReadAhead( &read );
+
+            if ( PROBE_ENABLED( scan_end ) )
+                PROBE_SEM2( scan_end, ctOrder, PROBE_NOW() - start );
+        }
+
+        free( order );
+        free( reads );
+    }
+
+    //==============================================
+    // Append results in listing order
+    //==============================================
+    for ( i = 0; result && i < ctFiles; i++ )
+    {
+        if ( files[ i ].ok == FALSE )
+        {
+            wprintf_s( TEXT( "Processing NMEA file failed\n" ) );
+            result = FALSE;
+        }
+        else if ( AddItem( &files[ i ].item, files[ i ].path,
+            resList ) == false )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            result = FALSE;
+        }
+    }
+
+    free( files );
+
+    return result;
+}
+
+// Process one file of the listing (runs on a worker thread)
+void procFileJob( void* pJob, void* ctx )
+{
+    Scan* pScan = ( Scan* )ctx;
+
+    // Cached files were taken out by scanDir
+    parseFile( *( FileJob** )pJob, pScan->pCache, pScan->pRead );
+}
+
+// Process one file, unless its results are cached
+void procFile( FileJob* pFile, ResCache* pCache )
+{
+    if ( !lookupFile( pFile, pCache ) )
+        parseFile( pFile, pCache, NULL );
+}
+
+// Take cached results of an unchanged file
+// Returns true if found
+BOOL lookupFile( FileJob* pFile, ResCache* pCache )
+{
+    CacheEntry entry = { 0 };
+
+    if ( !CacheLookup( pCache, pFile->path, pFile->item.size,
+        jobWriteTime( pFile ), &entry ) )
         return FALSE;
+
+    pFile->item.lon = entry.lon;
+    pFile->item.lat = entry.lat;
+    pFile->item.alt = entry.alt;
+    pFile->item.ctMeas = entry.ctMeas;
+    pFile->ok = TRUE;
+
+    TelemetryCached( pTelem, pFile->item.size );
+
+    return TRUE;
+}
+
+// Parse one file, read ahead (pRead) or read here (pRead NULL)
+void parseFile( FileJob* pFile, ResCache* pCache, ReadAhead* pRead )
+{
+    PVOID oldValueWow64 = NULL;
+    BOOL wow64Disabled = FALSE;
+    CacheEntry entry = { 0 };
+    const char* data = NULL;
+    size_t ctData = 0;
+
+    TelemetryBegin( pTelem );
+
+    if ( pRead != NULL &&
+        FetchReadAhead( pRead, pFile->readInd, &data, &ctData ) )
+    {
+        pFile->ok = procNmeaFile( pFile->path, data, ctData, &pFile->item );
+        ReleaseReadAhead( pRead, pFile->readInd );
+    }
+    else
+    {
+        // File system redirection is set per thread
+        wow64Disabled = Wow64DisableWow64FsRedirection( &oldValueWow64 );
+
+        pFile->ok = procNmeaFile( pFile->path, NULL, 0, &pFile->item );
+
+        if ( wow64Disabled )
+            Wow64RevertWow64FsRedirection( oldValueWow64 );
+    }
+
+    TelemetryEnd( pTelem, pFile->item.size,
+        pFile->ok ? pFile->item.ctMeas : 0 );
+
+    // Keep results for next runs
+    if ( pFile->ok )
+    {
+        entry.lon = pFile->item.lon;
+        entry.lat = pFile->item.lat;
+        entry.alt = pFile->item.alt;
+        entry.ctMeas = pFile->item.ctMeas;
+        CacheStore( pCache, pFile->path, pFile->item.size,
+            jobWriteTime( pFile ), &entry );
+    }
+}
+
+// Last write time of a listed file as cache key
+UINT64 jobWriteTime( const FileJob* pFile )
+{
+    return ( ( UINT64 )pFile->item.ftLastWriteTime.dwHighDateTime
+        << 32 ) | pFile->item.ftLastWriteTime.dwLowDateTime;
+}
+
+// compare sizes of two file jobs
+//  <0 : job A before job B (A is larger)
+//   0 : same size
+//  >0 : job A after job B
+int cmpJobsSize( const void* pA, const void* pB )
+{
+    const FileJob* pJobA = *( const FileJob** )pA;
+    const FileJob* pJobB = *( const FileJob** )pB;
+
+    if ( pJobA->item.size > pJobB->item.size )
+        return -1;
+    if ( pJobA->item.size < pJobB->item.size )
+        return 1;
+
+    // Same size: listing order
+    return ( pJobA < pJobB ) ? -1 : ( pJobA > pJobB );
+}
+
+// Add size and last write time of a found entry to totals
+void addToTotals( Item* pTotals, UINT64 size, const FILETIME* pWriteTime )
+{
+    // Totals get the latest LastWriteTime
+    if ( CompareFileTime( pWriteTime, &pTotals->ftLastWriteTime ) == 1 )
+        pTotals->ftLastWriteTime = *pWriteTime;
+
+    // Add current size to totals
+    pTotals->size += size;
+}
+
+//================================================================
+// Recursive mode (-r)
+//
+// Dir jobs list one dir: subdirs are queued as dir jobs, nmea files
+// as file jobs. Dir jobs run first, file jobs largest first, so hpos
+// work starts as soon as the first files are found.
+//
+// Linked dirs (reparse points) are followed once the dirs found so
+// far are listed, in path order, so a dir reachable both directly and
+// through a link is always listed under the same path. Each dir is
+// listed only once (file id), which also breaks link loops.
+//================================================================
+
+BOOL walkTree( LPTSTR tDir, List* resList, List* dirList, Item* parentItem,
+    ResCache* pCache )
+{
+    Walk walk = { 0 };
+    DirJob* pRoot = NULL;
+    DirJob* pDir = NULL;
+    DirJob* pUp = NULL;
+    FileJob* pFile = NULL;
+    BOOL result = TRUE;
+
+    InitializeCriticalSection( &walk.lock );
+    walk.pCache = pCache;
+
+    // Target dir (paths are relative to it)
+    pRoot = ( DirJob* )calloc( 1, sizeof( DirJob ) );
+
+    if ( pRoot == NULL ||
+        !StartWorkQueue( &walk.queue, walkJob, &walk, PoolDefaultThreads() ) )
+    {
+        wprintf_s( TEXT( "Problem allocating memory\n" ) );
+        DeleteCriticalSection( &walk.lock );
+        free( pRoot );
+        return FALSE;
+    }
+
+    pRoot->kind = JOB_DIR;
+    walk.dirs = pRoot;
+
+    // Walk and process, then stop workers
+    if ( !QueueWork( &walk.queue, pRoot, PRIO_DIR ) )
+        walk.failed = TRUE;
+
+    WaitWorkQueue( &walk.queue );
+
+    // Follow linked dirs, then the links found below them
+    while ( walk.links != NULL && !walk.failed )
+    {
+        if ( !queueLinks( &walk ) )
+            walk.failed = TRUE;
+
+        WaitWorkQueue( &walk.queue );
+    }
+
+    StopWorkQueue( &walk.queue );
+
+    if ( walk.failed )
+    {
+        wprintf_s( TEXT( "Problem allocating memory\n" ) );
+        result = FALSE;
+    }
+
+    //==============================================
+    // Totals per dir level
+    // Each dir's own files count for all dirs above
+    //==============================================
+    for ( pDir = walk.dirs; pDir != NULL; pDir = pDir->next )
+    {
+        for ( pUp = pDir; pUp != NULL; pUp = pUp->parent )
+            addToTotals( &pUp->totals, pDir->own.size,
+                &pDir->own.ftLastWriteTime );
+    }
+
+    // Grand totals
+    addToTotals( parentItem, pRoot->totals.size,
+        &pRoot->totals.ftLastWriteTime );
+
+    // Subdirs with nmea files below
+    for ( pDir = walk.dirs; pDir != NULL; pDir = pDir->next )
+    {
+        if ( pDir != pRoot && pDir->ctFiles + pDir->ctBelow > 0 &&
+            AddItem( &pDir->totals, pDir->path, dirList ) == false )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            result = FALSE;
+            break;
+        }
+    }
+
+    //==============================================
+    // Append results (sorted later on)
+    //==============================================
+    for ( pFile = walk.files; pFile != NULL; pFile = pFile->next )
+    {
+        if ( pFile->ok == FALSE )
+        {
+            wprintf_s( TEXT( "Processing NMEA file failed\n" ) );
+            result = FALSE;
+        }
+        else if ( AddItem( &pFile->item, pFile->path, resList ) == false )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            result = FALSE;
+            break;
+        }
     }
 
-    // Copy passed string to buffer,
-    // then append "*.nmea" + '\0' or "\*.nmea" + '\0' to the directory name.
-    wcscpy_s( dirStr, MAX_PATH, tDir );
+    // Housekeeping
+    while ( walk.files != NULL )
+    {
+        pFile = walk.files->next;
+        free( walk.files );
+        walk.files = pFile;
+    }
 
-    if ( dirStr[ wcslen( dirStr ) - 1 ] == TEXT( '\\' ) )
-        wcscat_s( dirStr, MAX_PATH, TEXT( "*.nmea" ) );
+    while ( walk.dirs != NULL )
+    {
+        pDir = walk.dirs->next;
+        free( walk.dirs );
+        walk.dirs = pDir;
+    }
+
+    free( walk.visited );
+    DeleteCriticalSection( &walk.lock );
+
+    return result;
+}
+
+// Run a dir job or a file job (runs on a worker thread)
+void walkJob( void* pJob, void* ctx )
+{
+    if ( *( int* )pJob == JOB_DIR )
+        listDir( ( DirJob* )pJob, ( Walk* )ctx );
     else
-        wcscat_s( dirStr, MAX_PATH, TEXT( "\\*.nmea" ) );
+        procFile( ( FileJob* )pJob, ( ( Walk* )ctx )->pCache );
+}
+
+// List one dir, queue its subdirs and nmea files
+void listDir( DirJob* pDir, Walk* pWalk )
+{
+    IoDir dir;
+    IoEntry entry;
+    DirJob* pSub = NULL;
+    FileJob* pFile = NULL;
+    PVOID oldValueWow64 = NULL;
+    BOOL wow64Disabled = FALSE;
+
+    // File system redirection is set per thread
+    wow64Disabled = Wow64DisableWow64FsRedirection( &oldValueWow64 );
 
-    // Find the first file in the directory.
-    hFind = FindFirstFile( dirStr, &currentItem.findInfo );
+    // Symbolic link loops: list each dir only once
+    if ( !pDir->marked && !markDirVisited( pDir, pWalk ) )
+        goto done;
 
-    // Validate search handle
-    if ( INVALID_HANDLE_VALUE == hFind )
+    // Subdirs and nmea files ( "path\" or "" )
+    if ( !IoOpenDir( &dir, pDir->path, NMEA_EXT ) )
     {
-        // Only report error if different from 'Access Denied'.
-        // For example, system symbolic links report 'access denied'.
-        // If a handle is obtained and the size is requested,
-        // Win32 reports 0 bytes.
-        // See results using '..\progsDev\others\TestGetFileSizeEx\'
+        // See scanDir
         if ( GetLastError() != ERROR_ACCESS_DENIED )
-            ReportError( TEXT( "FindFirstFile failed." ), 0, TRUE );
+            ReportError( TEXT( "Listing dir failed." ), 0, TRUE );
 
-        // Exit in any case
-        return FALSE;
+        goto done;
     }
 
-    // List only nmea files in target dir
-    do
+    while ( IoReadDir( &dir, &entry ) == IO_ENTRY )
     {
-        // Do not follow symbolic links
-        if ( !( currentItem.findInfo.dwFileAttributes &
-                FILE_ATTRIBUTE_REPARSE_POINT ) )
+        // Validate space for "path\name\"
+        if ( wcslen( pDir->path ) + wcslen( entry.name ) >= MAX_PATH - 2 )
         {
-            // Ignore subdirs
-            if ( !( currentItem.findInfo.dwFileAttributes &
-                FILE_ATTRIBUTE_DIRECTORY ) )
+            wprintf_s( TEXT( "\nDirectory path is too long.\n" ) );
+            continue;
+        }
+
+        if ( entry.attrs & IO_ATTR_DIR )
+        {
+            // Subdir
+            pSub = ( DirJob* )calloc( 1, sizeof( DirJob ) );
+            if ( pSub == NULL )
+            {
+                pWalk->failed = TRUE;
+                break;
+            }
+
+            pSub->kind = JOB_DIR;
+            pSub->parent = pDir;
+            wcscpy_s( pSub->path, _countof( pSub->path ), pDir->path );
+            wcscat_s( pSub->path, _countof( pSub->path ), entry.name );
+            wcscat_s( pSub->path, _countof( pSub->path ), IO_SEP );
+
+            EnterCriticalSection( &pWalk->lock );
+            pSub->next = pWalk->dirs;
+            pWalk->dirs = pSub;
+
+            // Linked dirs wait (see walkTree)
+            if ( entry.attrs & IO_ATTR_LINK )
             {
-                // File found
-
-                // Update last write time information of the parent.
-                // Is current item's LastWriteTime later
-                // than parent's LastWriteTime ?
-                if ( CompareFileTime( &currentItem.findInfo.ftLastWriteTime,
-                    &parentItem->findInfo.ftLastWriteTime ) == 1 )
-                {
-                    // Parent gets the LastWriteTime from current item
-                    parentItem->findInfo.ftLastWriteTime =
-                        currentItem.findInfo.ftLastWriteTime;
-                }
-
-                // Get size of current found file(s)
-                currentSize.LowPart = currentItem.findInfo.nFileSizeLow;
-                currentSize.HighPart = currentItem.findInfo.nFileSizeHigh;
-
-                // Get size of parent so far
-                parentSize.LowPart = parentItem->findInfo.nFileSizeLow;
-                parentSize.HighPart = parentItem->findInfo.nFileSizeHigh;
-
-                // Add current size to parent size (64-bit addition)
-                parentSize.QuadPart += currentSize.QuadPart;
-
-                // Update parent file size
-                parentItem->findInfo.nFileSizeLow = parentSize.LowPart;
-                parentItem->findInfo.nFileSizeHigh = parentSize.HighPart;
-
-                // Apply external tool hpos on current file
-                if ( procNmeaFile( currentItem.findInfo.cFileName,
-                    currentItem.coords, COORDS ) == FALSE )
-                {
-                    wprintf_s( TEXT( "Processing NMEA file failed\n" ) );
-                    return FALSE;
-                }
-
-                // Append current item to results list
-                if ( AddItem( currentItem, resList ) == false )
-                {
-                    wprintf_s( TEXT( "Problem allocating memory\n" ) );
-                    return FALSE;
-                }
+                pSub->nextLink = pWalk->links;
+                pWalk->links = pSub;
+                pSub = NULL;
             }
+            LeaveCriticalSection( &pWalk->lock );
+
+            if ( pSub != NULL && !QueueWork( &pWalk->queue, pSub, PRIO_DIR ) )
+                pWalk->failed = TRUE;
         }
+        else if ( !( entry.attrs & IO_ATTR_LINK ) )
+        {
+            // Only nmea files, do not follow symbolic links
+            pFile = ( FileJob* )calloc( 1, sizeof( FileJob ) );
+            if ( pFile == NULL )
+            {
+                pWalk->failed = TRUE;
+                break;
+            }
+
+            pFile->kind = JOB_FILE;
+            wcscpy_s( pFile->path, _countof( pFile->path ), pDir->path );
+            wcscat_s( pFile->path, _countof( pFile->path ), entry.name );
+
+            pFile->item.size = entry.size;
+            pFile->item.ftLastWriteTime = entry.ftLastWriteTime;
 
-        // Reset current item
-        memset( &currentItem, 0, sizeof( Item ) );
+            // Totals of this dir level
+            addToTotals( &pDir->own, pFile->item.size,
+                &entry.ftLastWriteTime );
+            pDir->ctFiles++;
 
-    } while ( FindNextFile( hFind, &currentItem.findInfo ) != 0 );
+            EnterCriticalSection( &pWalk->lock );
+            pFile->next = pWalk->files;
+            pWalk->files = pFile;
+            LeaveCriticalSection( &pWalk->lock );
 
-    // Validate end of search
-    if ( GetLastError() != ERROR_NO_MORE_FILES )
+            TelemetryQueue( pTelem, 1, pFile->item.size );
+
+            if ( !QueueWork( &pWalk->queue, pFile, pFile->item.size ) )
+                pWalk->failed = TRUE;
+        }
+    }
+
+    IoCloseDir( &dir );
+
+    // Dirs above have nmea files below
+    if ( pDir->ctFiles > 0 )
     {
-        ReportError( TEXT( "\nFindNextFile failed.\n" ), 0, TRUE );
+        EnterCriticalSection( &pWalk->lock );
+        for ( pSub = pDir->parent; pSub != NULL; pSub = pSub->parent )
+            pSub->ctBelow++;
+        LeaveCriticalSection( &pWalk->lock );
+    }
+
+done:
+    if ( wow64Disabled )
+        Wow64RevertWow64FsRedirection( oldValueWow64 );
+}
+
+// Queue the linked dirs found so far, in path order
+// Returns false if no memory
+BOOL queueLinks( Walk* pWalk )
+{
+    DirJob** links = NULL;
+    DirJob* pDir = NULL;
+    int ctLinks = 0;
+    int i;
+
+    // No job is running, so no lock needed
+    for ( pDir = pWalk->links; pDir != NULL; pDir = pDir->nextLink )
+        ctLinks++;
+
+    links = ( DirJob** )malloc( ctLinks * sizeof( DirJob* ) );
+    if ( links == NULL )
         return FALSE;
+
+    for ( i = 0, pDir = pWalk->links; pDir != NULL; pDir = pDir->nextLink )
+        links[ i++ ] = pDir;
+
+    pWalk->links = NULL;
+
+    qsort( links, ctLinks, sizeof( DirJob* ), cmpDirsPath );
+
+    // Record all before listing any, first path wins
+    for ( i = 0; i < ctLinks; i++ )
+        links[ i ]->marked = markDirVisited( links[ i ], pWalk );
+
+    for ( i = 0; i < ctLinks; i++ )
+    {
+        if ( links[ i ]->marked && !QueueWork( &pWalk->queue, links[ i ],
+            PRIO_DIR ) )
+        {
+            free( links );
+            return FALSE;
+        }
     }
 
-    // Close search handle
-    FindClose( hFind );
+    free( links );
 
     return TRUE;
 }
 
-// compare names of two items
-//  >0 : item N before item M
-//   0 : item N same place as item M
-//  <0 : item N after item M
-int cmpItemsName( Item* pItemN, Item* pItemM )
+// compare paths of two dirs (qsort)
+int cmpDirsPath( const void* pA, const void* pB )
+{
+    return _wcsicmp( ( *( const DirJob** )pA )->path,
+        ( *( const DirJob** )pB )->path );
+}
+
+// Record the dir's file id
+// Returns false if the dir was listed already (or cannot be opened)
+BOOL markDirVisited( DirJob* pDir, Walk* pWalk )
+{
+    DirId* tmpVisited = NULL;
+    DirId dirId;
+    BOOL result = TRUE;
+    int i;
+
+    // Dir itself ( "." for the target dir )
+    if ( !IoDirId( ( pDir->path[ 0 ] != L'\0' ) ? pDir->path : TEXT( "." ),
+        &dirId.volume, &dirId.index ) )
+        return FALSE;
+
+    EnterCriticalSection( &pWalk->lock );
+
+    // Already listed ?
+    for ( i = 0; i < pWalk->ctVisited; i++ )
+    {
+        if ( pWalk->visited[ i ].volume == dirId.volume &&
+            pWalk->visited[ i ].index == dirId.index )
+        {
+            result = FALSE;
+            break;
+        }
+    }
+
+    // Record it
+    if ( result )
+    {
+        if ( pWalk->ctVisited == pWalk->sizeVisited )
+        {
+            pWalk->sizeVisited = ( pWalk->sizeVisited == 0 ) ?
+                FILES_MIN : 2 * pWalk->sizeVisited;
+            tmpVisited = ( DirId* )realloc( pWalk->visited,
+                pWalk->sizeVisited * sizeof( DirId ) );
+
+            if ( tmpVisited == NULL )
+            {
+                pWalk->failed = TRUE;
+                result = FALSE;
+            }
+            else
+                pWalk->visited = tmpVisited;
+        }
+
+        if ( result )
+            pWalk->visited[ pWalk->ctVisited++ ] = dirId;
+    }
+
+    LeaveCriticalSection( &pWalk->lock );
+
+    return result;
+}
+
+// Keep results of target dir (current dir) up to date
+// Runs until interrupted or on error
+BOOL watchDir( LPTSTR tDir, List* resList, List* dirList, Item* pTotals,
+    ResCache* pCache, const BOOL* flags )
 {
-    int result;
+    Watch watch = { 0 };
+    IoWatch dirWatch;
+    DWORD wait = INFINITE;
+    DWORD due = 0;
+    LONG remaining = 0;
+    BOOL dirty = FALSE;             // Update due
+    BOOL result = TRUE;
 
-    // case-insensitive comparison
-    result = _wcsicmp( pItemM->findInfo.cFileName, pItemN->findInfo.cFileName );
+    watch.resList = resList;
+    watch.dirList = dirList;
+    watch.pTotals = pTotals;
+    watch.pCache = pCache;
+    watch.flags = flags;
+    InitializeList( &watch.pending );
+
+    // Changes are queued by the system while we work
+    if ( !IoStartWatch( &dirWatch, tDir ) )
+    {
+        ReportError( TEXT( "Watching target dir failed." ), 0, TRUE );
+        EmptyTheList( &watch.pending );
+        return FALSE;
+    }
+
+    wprintf_s( TEXT( "\n    Watching for changes (Ctrl+C to stop)\n\n" ) );
+
+    while ( result )
+    {
+        // Wait for changes, update when due
+        wait = INFINITE;
+        if ( dirty )
+        {
+            remaining = ( LONG )( due - GetTickCount() );
+            wait = ( remaining > 0 ) ? ( DWORD )remaining : 0;
+        }
+
+        switch ( IoWaitWatch( &dirWatch, wait, queueChange, &watch ) )
+        {
+        case IO_TIMEOUT:
+            if ( dirty )
+            {
+                updateResults( &watch );
+                dirty = FALSE;
+            }
+            continue;
+
+        case IO_LOST:
+            // More changes than the system kept
+            watch.rescan = TRUE;
+            break;
+
+        case IO_ERROR:
+            ReportError( TEXT( "Reading dir changes failed." ), 0, TRUE );
+            result = FALSE;
+            continue;
+        }
+
+        // First change starts the interval
+        if ( !dirty && ( watch.rescan || !ListIsEmpty( &watch.pending ) ) )
+        {
+            dirty = TRUE;
+            due = GetTickCount() + WATCH_INTERVAL;
+        }
+    }
+
+    IoStopWatch( &dirWatch );
+    EmptyTheList( &watch.pending );
 
     return result;
 }
 
-void showResults( List* resultsList, Item* resultsLevel )
+// Keep the name of a changed nmea file (IoWaitWatch)
+void queueChange( LPCTSTR fileName, size_t len, void* ctx )
+{
+    Watch* pWatch = ( Watch* )ctx;
+    TCHAR name[ MAX_PATH ] = { 0 };
+    Item noResults = { 0 };
+
+    // Outputs and cache change too
+    if ( len < MAX_PATH && isNmeaName( fileName, len ) )
+    {
+        wmemcpy( name, fileName, len );
+        name[ len ] = TEXT( '\0' );
+
+        // No memory: list the dir instead
+        if ( AddItem( &noResults, name, &pWatch->pending ) == false )
+            pWatch->rescan = TRUE;
+    }
+}
+
+void updateResults( Watch* pWatch )
+{
+    unsigned int ctChanged = 0;
+    unsigned int i;
+
+    // Changes were lost: check every file
+    if ( pWatch->rescan )
+    {
+        wprintf_s( TEXT( "\n    Too many changes, scanning target dir\n" ) );
+        queueDir( pWatch );
+    }
+
+    // Changed files only, list stays sorted
+    for ( i = 0; i < ListItemCount( &pWatch->pending ); i++ )
+    {
+        if ( updateFile( pWatch, ItemPath( &pWatch->pending,
+            &pWatch->pending.items[ i ] ) ) )
+            ctChanged++;
+    }
+
+    sumTotals( pWatch->resList, pWatch->pTotals );
+
+    EmptyTheList( &pWatch->pending );
+    pWatch->rescan = FALSE;
+
+    if ( ctChanged == 0 )
+        return;
+
+    SaveResCache( pWatch->pCache );
+
+    wprintf_s( TEXT( "\n    Updated: %u files\n\n" ), ctChanged );
+
+    emitResults( pWatch->resList, pWatch->dirList, pWatch->pTotals,
+        pWatch->pCache, pWatch->flags );
+}
+
+// Queue the files of the list and of the dir (current dir)
+// Unchanged files are skipped by updateFile
+void queueDir( Watch* pWatch )
+{
+    IoDir dir;
+    IoEntry entry;
+    Item noResults = { 0 };
+    unsigned int i;
+
+    // Listed files: gone or changed
+    for ( i = 0; i < ListItemCount( pWatch->resList ); i++ )
+    {
+        if ( AddItem( &noResults, ItemPath( pWatch->resList,
+            &pWatch->resList->items[ i ] ), &pWatch->pending ) == false )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            return;
+        }
+    }
+
+    // New and changed files
+    if ( !IoOpenDir( &dir, TEXT( "" ), NMEA_EXT ) )
+        return;
+
+    while ( IoReadDir( &dir, &entry ) == IO_ENTRY )
+    {
+        if ( !( entry.attrs & ( IO_ATTR_DIR | IO_ATTR_LINK ) ) &&
+            AddItem( &noResults, entry.name, &pWatch->pending ) == false )
+        {
+            wprintf_s( TEXT( "Problem allocating memory\n" ) );
+            break;
+        }
+    }
+
+    IoCloseDir( &dir );
+}
+
+// Add, replace or remove the results of one file
+// Returns true if results changed
+BOOL updateFile( Watch* pWatch, LPCTSTR name )
+{
+    IoEntry attr = { 0 };
+    FileJob job = { 0 };
+    Item* pItem = NULL;
+    unsigned int ind = 0;
+    BOOL found;
+
+    found = FindItem( pWatch->resList, name, pWatch->flags[ FL_NATURAL ] ?
+        keyItemNatural : keyItemName, &ind );
+
+    if ( found )
+        pItem = &pWatch->resList->items[ ind ];
+
+    // Deleted or renamed
+    if ( !IoStat( name, &attr ) ||
+        ( attr.attrs & ( IO_ATTR_DIR | IO_ATTR_LINK ) ) )
+    {
+        if ( found )
+            RemoveItem( ind, pWatch->resList );
+
+        return found;
+    }
+
+    job.kind = JOB_FILE;
+    job.item.size = attr.size;
+    job.item.ftLastWriteTime = attr.ftLastWriteTime;
+    wcscpy_s( job.path, _countof( job.path ), name );
+
+    // Same name reported more than once
+    if ( found && pItem->size == job.item.size &&
+        CompareFileTime( &pItem->ftLastWriteTime,
+        &job.item.ftLastWriteTime ) == 0 )
+        return FALSE;
+
+    TelemetryQueue( pTelem, 1, job.item.size );
+    procFile( &job, pWatch->pCache );
+
+    // Maybe still being written: next change retries
+    if ( !job.ok )
+    {
+        wprintf_s( TEXT( "Processing NMEA file failed: %s\n" ), name );
+
+        if ( found )
+            RemoveItem( ind, pWatch->resList );
+
+        return found;
+    }
+
+    if ( found )
+    {
+        job.item.offPath = pItem->offPath;
+        *pItem = job.item;
+    }
+    else if ( InsertItem( &job.item, name, ind, pWatch->resList ) == false )
+    {
+        wprintf_s( TEXT( "Problem allocating memory\n" ) );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void sumTotals( List* plist, Item* pTotals )
+{
+    unsigned int i;
+
+    memset( pTotals, 0, sizeof( Item ) );
+
+    for ( i = 0; i < plist->iCount; i++ )
+        addToTotals( pTotals, plist->items[ i ].size,
+            &plist->items[ i ].ftLastWriteTime );
+}
+
+BOOL isNmeaName( LPCTSTR name, size_t len )
+{
+    size_t lenExt = wcslen( NMEA_EXT );
+
+    return len > lenExt &&
+        _wcsnicmp( name + len - lenExt, NMEA_EXT, lenExt ) == 0;
+}
+
+// Sort key: lower case path (same order as _wcsicmp)
+size_t keyItemName( const Item* pItem, LPCTSTR path, TCHAR* key )
+{
+    size_t len;
+
+    for ( len = 0; path[ len ] != TEXT( '\0' ); len++ )
+        key[ len ] = ( TCHAR )towlower( path[ len ] );
+
+    key[ len ] = TEXT( '\0' );
+
+    return len;
+}
+
+// Sort key: lower case path, each number as '0', count of digits
+// (leading zeros dropped) and digits, so shorter numbers go first
+size_t keyItemNatural( const Item* pItem, LPCTSTR path, TCHAR* key )
+{
+    const TCHAR* pCh = path;
+    const TCHAR* pDigits = NULL;
+    size_t len = 0;
+    size_t ctDigits;
+
+    while ( *pCh != TEXT( '\0' ) )
+    {
+        if ( !IS_DIGIT( *pCh ) )
+        {
+            key[ len++ ] = ( TCHAR )towlower( *pCh++ );
+            continue;
+        }
+
+        // Skip leading zeros, keep one digit of zero
+        while ( *pCh == TEXT( '0' ) && IS_DIGIT( pCh[ 1 ] ) )
+            pCh++;
+
+        for ( pDigits = pCh; IS_DIGIT( *pCh ); pCh++ )
+            ;
+
+        // Key fits SORT_KEY: 2 TCHARs per path TCHAR at most, + 1
+        ctDigits = pCh - pDigits;
+        key[ len++ ] = TEXT( '0' );
+        key[ len++ ] = ( TCHAR )( 1 + ctDigits );
+        wmemcpy( key + len, pDigits, ctDigits );
+        len += ctDigits;
+    }
+
+    key[ len ] = TEXT( '\0' );
+
+    return len;
+}
+
+// Sort items by path
+void sortItems( List* plist, BOOL natural )
+{
+    if ( !SortList( plist, natural ? keyItemNatural : keyItemName ) )
+        wprintf_s( TEXT( "Problem allocating memory (not sorted)\n" ) );
+}
+
+void emitResults( List* resultsList, List* dirList, Item* resultsLevel,
+    ResCache* pCache, const BOOL* flags )
+{
+    if ( ListIsEmpty( resultsList ) )
+    {
+        wprintf_s( TEXT( "\nNo data.\n\n" ) );
+        return;
+    }
+
+    // Display sorted results
+    showResults( resultsList, dirList, resultsLevel, pCache );
+
+    // Generate KML file
+    outputKml( resultsList, flags[ FL_KMZ ] );
+
+    // Generate GIS files
+    if ( flags[ FL_FGB ] )
+        outputFgb( resultsList );
+
+    if ( flags[ FL_GEOJSON ] )
+        outputGeoJson( resultsList );
+}
+
+void showResults( List* resultsList, List* dirList, Item* resultsLevel,
+    ResCache* pCache )
 {
     // Display header
     wprintf_s( TEXT( "    %19s %47s %12s %s\n" ),
@@ -303,6 +1341,18 @@ void showResults( List* resultsList, Item* resultsLevel )
     // Display founded entries
     Traverse( resultsList, showItem );
 
+    // Display totals per dir (recursive mode)
+    if ( !ListIsEmpty( dirList ) )
+    {
+        wprintf_s( TEXT( "    %19s %47s %12s %s\n" ),
+            TEXT( "-------------------" ),
+            TEXT( "-----------------------------------------------" ),
+            TEXT( "------------" ),
+            TEXT( "--------------------------------" ) );
+
+        Traverse( dirList, showTotals );
+    }
+
     // Display totals
     wprintf_s( TEXT( "    %19s %47s %12s %s\n" ),
         TEXT( "-------------------" ),
@@ -310,21 +1360,41 @@ void showResults( List* resultsList, Item* resultsLevel )
         TEXT( "------------" ),
         TEXT( "--------------------------------" ) );
 
-    showItem( resultsLevel );
+    showTotals( resultsLevel, TEXT( "" ) );
+
+    // Display cache use
+    wprintf_s( TEXT( "\n    Cache: %ld hits, %ld misses\n" ),
+        ( long )pCache->ctHits, ( long )pCache->ctMisses );
+}
+
+void showItem( Item* pItem, LPCTSTR path )
+{
+    TCHAR coords[ COORDS ] = { 0 };
+
+    // Coords as 'hpos -b' prints them
+    swprintf_s( coords, _countof( coords ), COORDS_FMT,
+        pItem->lon, pItem->lat, pItem->alt );
+
+    showRow( pItem, coords, path );
+}
+
+// Dir totals and grand total: no coords
+void showTotals( Item* pItem, LPCTSTR path )
+{
+    showRow( pItem, TEXT( "" ), path );
 }
 
-void showItem( Item* pItem )
+void showRow( const Item* pItem, LPCTSTR coords, LPCTSTR path )
 {
     FILETIME lastWriteFTIME;
     SYSTEMTIME lastWriteSYSTIME;
-    LARGE_INTEGER entrySize;
+    long long entrySize;
     TCHAR sizeStr[ 32 ] = { 0 };
 
     // Fetch and prepare entry last modification date & time
 
     // UTC time (FILETIME) to local time (FILETIME)
-    FileTimeToLocalFileTime( &pItem->findInfo.ftLastWriteTime,
-        &lastWriteFTIME );
+    FileTimeToLocalFileTime( &pItem->ftLastWriteTime, &lastWriteFTIME );
 
     // local time (FILETIME) to local time (SYSTIME)
     FileTimeToSystemTime( &lastWriteFTIME, &lastWriteSYSTIME );
@@ -339,48 +1409,64 @@ void showItem( Item* pItem )
         lastWriteSYSTIME.wSecond );
 
     // Disp coords
-    wprintf_s( TEXT( " %47s" ), pItem->coords );
+    wprintf_s( TEXT( " %47s" ), coords );
 
-    // Fetch entry size
-    entrySize.LowPart = pItem->findInfo.nFileSizeLow;
-    entrySize.HighPart = pItem->findInfo.nFileSizeHigh;
-
-    // Convert nums to strings (thousands separated)
-    sepThousands( &entrySize.QuadPart, sizeStr,
-        _countof( sizeStr ) );
+    // Convert size to string (thousands separated)
+    entrySize = ( long long )pItem->size;
+    sepThousands( &entrySize, sizeStr, _countof( sizeStr ) );
 
     // Disp entry details
     wprintf_s( TEXT( "%13s %s\n" ),
         sizeStr,
-        pItem->findInfo.cFileName );
+        path );
 }
 
-void addPtToKml( FILE* outKml, Item* pitem )
+void addPtToKml( BufOut* outKml, Item* pitem, LPCTSTR path )
 {
-    TCHAR* ptTchar = NULL;
-    TCHAR ptName[ MAX_PATH ] = { 0 };
+    const TCHAR* ptTchar = NULL;
 
-    // Set up point's name
-    wcscpy_s( ptName, _countof( ptName ), pitem->findInfo.cFileName );
-    ptTchar = wcsrchr( ptName, L'.' );
-    if ( ptTchar != NULL )
-        *ptTchar = L'\0';
+    // Point's name: path without extension
+    ptTchar = wcsrchr( path, L'.' );
+    if ( ptTchar == NULL )
+        ptTchar = path + wcslen( path );
 
     // Output point placemark
-    fwprintf_s( outKml, TEXT( "<Placemark>\n" ) );
-    fwprintf_s( outKml, TEXT( "  <name>%s</name>\n" ),
-        ptName );
-    fwprintf_s( outKml, TEXT( "  <styleUrl>#mypushpin</styleUrl>\n" ) );
-    fwprintf_s( outKml, TEXT( "  <Point>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <coordinates>%s</coordinates>\n" ),
-        pitem->coords );
-    fwprintf_s( outKml, TEXT( "  </Point>\n" ) );
-    fwprintf_s( outKml, TEXT( "</Placemark>\n\n" ) );
+    BufOutText( outKml, "<Placemark>\n  <name>" );
+    BufOutXml( outKml, path, ptTchar - path );
+    BufOutText( outKml, "</name>\n"
+        "  <styleUrl>#mypushpin</styleUrl>\n"
+        "  <Point>\n"
+        "    <coordinates>" );
+    addCoords( outKml, pitem );
+    BufOutText( outKml, "</coordinates>\n"
+        "  </Point>\n"
+        "</Placemark>\n\n" );
 }
 
-void addCoordsToKml( FILE* outKml, Item* pitem )
+void addCoordsToKml( BufOut* outKml, Item* pitem, LPCTSTR path )
 {
-    fwprintf_s( outKml, TEXT( "      %s\n" ), pitem->coords );
+    BufOutText( outKml, "      " );
+    addCoords( outKml, pitem );
+    BufOutText( outKml, "\n" );
+}
+
+// Output "lon,lat,alt" ( same digits as COORDS_FMT )
+void addCoords( BufOut* outKml, const Item* pitem )
+{
+    CHAR* dst;
+    int len = 0;
+
+    dst = BufOutReserve( outKml, 3 * FMT_MAX + 2 );
+    if ( dst == NULL )
+        return;
+
+    len += FmtDouble( dst + len, pitem->lon );
+    dst[ len++ ] = ',';
+    len += FmtDouble( dst + len, pitem->lat );
+    dst[ len++ ] = ',';
+    len += FmtDouble( dst + len, pitem->alt );
+
+    BufOutCommit( outKml, len );
 }
 
 void sepThousands( const long long* numPt, TCHAR* acc, size_t elemsAcc )
@@ -421,118 +1507,207 @@ void sepThousands( const long long* numPt, TCHAR* acc, size_t elemsAcc )
     }
 }
 
-BOOL procNmeaFile( TCHAR* fName, TCHAR* cdsOut, int cdsSize )
+// data: text of the file read ahead, NULL: read the file
+BOOL procNmeaFile( TCHAR* fName, const char* data, size_t ctData,
+    Item* pItem )
 {
-    TCHAR cmdBuffer[ CMDBUF ] = { 0 };
-    FILE* pPipe = NULL;
-    BOOL result = TRUE;
+    HposResult result;
+    LONGLONG start = 0;
 
-    // Set up external command
-    swprintf_s( cmdBuffer, _countof( cmdBuffer ), TEXT( "%s %s" ),
-        TEXT( "C:\\tmp\\myTools\\hpos.exe" ),
-        fName );
+    PROBE1( file_start, pItem->size );
+    if ( PROBE_ENABLED( file_end ) )
+        start = PROBE_NOW();
 
-    // Create pipe (read text mode) and execute external program
-    if ( ( pPipe = _wpopen( cmdBuffer, TEXT( "rt" ) ) ) == NULL )
-        return FALSE;
-
-    // Reset output buffer
-    wmemset( cdsOut, 0, cdsSize );
-
-    // Read pipe until end of file, or an error occurs.
-    // hpos outputs only one line of text
-    while ( fgetws( cdsOut, cdsSize, pPipe ) )
+    // Parse and aggregate in process
+    if ( data != NULL )
+        HposProcBuffer( data, ctData, NULL, &result, NULL, NULL );
+    else if ( !HposProcFile( fName, NULL, &result, NULL, NULL ) )
     {
-        ;
-    }
+        if ( PROBE_ENABLED( file_end ) )
+            PROBE_SEM3( file_end, pItem->size, PROBE_NOW() - start, -1 );
 
-    // Close pipe and print return value of pPipe.
-    if ( feof( pPipe ) )
-        _pclose( pPipe );
-    else
-    {
-        wprintf_s( TEXT( "Failed to read pipe for 'hpos' to the end.\n" ) );
-        result = FALSE;
+        return FALSE;
     }
 
-    return result;
+    if ( PROBE_ENABLED( file_end ) )
+        PROBE_SEM3( file_end, pItem->size, PROBE_NOW() - start,
+            result.ctMeas );
+
+    // Store numeric results
+    pItem->lon = result.lon;
+    pItem->lat = result.lat;
+    pItem->alt = result.alt;
+    pItem->ctMeas = result.ctMeas;
+
+    return TRUE;
 }
 
-void outputKml( List* plist )
+void outputKml( List* plist, BOOL kmz )
 {
-    errno_t err;
-    FILE* outKml = NULL;
+    BufOut outKml;
+    ZipOut zip;
     TCHAR fName[ MAX_PATH ] = { 0 };
 
     // Set up kml file's name
     wcscpy_s( fName, _countof( fName ), plist->measureName );
-    wcscat_s( fName, _countof( fName ), TEXT( ".kml" ) );
+    wcscat_s( fName, _countof( fName ), kmz ? TEXT( ".kmz" ) : TEXT( ".kml" ) );
 
-    // Set up 'lati' output file
-    err = _wfopen_s( &outKml, fName, TEXT( "w" ) );
+    // Set up kml output file
+    // kmz: kml is deflated into the zip while it is generated
+    if ( kmz )
+    {
+        if ( !OpenZipOut( &zip, fName, KMZ_ENTRY ) )
+            return;
 
-    if ( err != 0 )
-    {                       
-        fwprintf_s( stderr, TEXT( "Can't create output file.\n" ) );
-        return;
+        if ( !AttachBufOutSink( &outKml, ZipOutSink, &zip ) )
+        {
+            CloseZipOut( &zip );
+            return;
+        }
     }
+    else if ( !OpenBufOut( &outKml, fName ) )
+        return;
 
     // Output header
-    fwprintf_s( outKml,
-        TEXT( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" ) );
-    fwprintf_s( outKml,
-        TEXT( "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n\n" ) );
-    fwprintf_s( outKml, TEXT( "<Document>\n\n" ) );
+    BufOutText( &outKml,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" );
+    BufOutText( &outKml,
+        "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n\n" );
+    BufOutText( &outKml, "<Document>\n\n" );
 
     // Output styles
-    fwprintf_s( outKml, TEXT( "<Style id=\"mypushpin\">\n" ) );
-    fwprintf_s( outKml, TEXT( "  <LabelStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <scale>0.5</scale>\n" ) );
-    fwprintf_s( outKml, TEXT( "  </LabelStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "  <IconStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <scale>0.5</scale>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <Icon>\n" ) );
-    fwprintf_s( outKml, TEXT( "      <href>http://maps.google.com/mapfiles/kml/pushpin/ylw-pushpin.png</href>\n" ) );
-    fwprintf_s( outKml, TEXT( "    </Icon>\n" ) );
-    fwprintf_s( outKml, TEXT( "  </IconStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "</Style>\n\n" ) );
-
-    fwprintf_s( outKml, TEXT( "<Style id=\"myline\">\n" ) );
-    fwprintf_s( outKml, TEXT( "  <LineStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <color>ff7fff55</color>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <colorMode>normal</colorMode>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <width>3</width>\n" ) );
-    fwprintf_s( outKml, TEXT( "  </LineStyle>\n" ) );
-    fwprintf_s( outKml, TEXT( "</Style>\n\n" ) );
+    BufOutText( &outKml, "<Style id=\"mypushpin\">\n" );
+    BufOutText( &outKml, "  <LabelStyle>\n" );
+    BufOutText( &outKml, "    <scale>0.5</scale>\n" );
+    BufOutText( &outKml, "  </LabelStyle>\n" );
+    BufOutText( &outKml, "  <IconStyle>\n" );
+    BufOutText( &outKml, "    <scale>0.5</scale>\n" );
+    BufOutText( &outKml, "    <Icon>\n" );
+    BufOutText( &outKml, "      <href>http://maps.google.com/mapfiles/kml/pushpin/ylw-pushpin.png</href>\n" );
+    BufOutText( &outKml, "    </Icon>\n" );
+    BufOutText( &outKml, "  </IconStyle>\n" );
+    BufOutText( &outKml, "</Style>\n\n" );
+
+    BufOutText( &outKml, "<Style id=\"myline\">\n" );
+    BufOutText( &outKml, "  <LineStyle>\n" );
+    BufOutText( &outKml, "    <color>ff7fff55</color>\n" );
+    BufOutText( &outKml, "    <colorMode>normal</colorMode>\n" );
+    BufOutText( &outKml, "    <width>3</width>\n" );
+    BufOutText( &outKml, "  </LineStyle>\n" );
+    BufOutText( &outKml, "</Style>\n\n" );
 
     // Output measurement points (placemarks) to kml file
-    TraverseToFile( plist, outKml, addPtToKml );
+    TraverseToFile( plist, &outKml, addPtToKml );
 
     // Output polygon joining measurement points
-    fwprintf_s( outKml, TEXT( "<Placemark>\n" ) );
-    fwprintf_s( outKml, TEXT( "  <name>%s</name>\n" ), plist->measureName );
-    fwprintf_s( outKml, TEXT( "  <styleUrl>#myline</styleUrl>\n" ) );
-    fwprintf_s( outKml, TEXT( "  <LineString>\n" ) );
-    fwprintf_s( outKml, TEXT( "    <coordinates>\n" ) );
+    BufOutText( &outKml, "<Placemark>\n  <name>" );
+    BufOutXml( &outKml, plist->measureName, wcslen( plist->measureName ) );
+    BufOutText( &outKml, "</name>\n" );
+    BufOutText( &outKml, "  <styleUrl>#myline</styleUrl>\n" );
+    BufOutText( &outKml, "  <LineString>\n" );
+    BufOutText( &outKml, "    <coordinates>\n" );
 
     // Add coods of all pts to kml
-    TraverseToFile( plist, outKml, addCoordsToKml );
+    TraverseToFile( plist, &outKml, addCoordsToKml );
 
     // If needed, then close the polygon
     // Output coords of first point again
     if ( plist->iCount > 2 )
-        fwprintf_s( outKml, TEXT( "      %s\n" ), plist->head->item.coords );
+        addCoordsToKml( &outKml, &plist->items[ 0 ], TEXT( "" ) );
 
     // Terminate polygon output
-    fwprintf_s( outKml, TEXT( "    </coordinates>\n" ) );
-    fwprintf_s( outKml, TEXT( "  </LineString>\n" ) );
-    fwprintf_s( outKml, TEXT( "</Placemark>\n\n" ) );
+    BufOutText( &outKml, "    </coordinates>\n" );
+    BufOutText( &outKml, "  </LineString>\n" );
+    BufOutText( &outKml, "</Placemark>\n\n" );
 
     // Output footer
-    fwprintf_s( outKml, TEXT( "</Document>\n\n" ) );
-    fwprintf_s( outKml, TEXT( "</kml>" ) );
+    BufOutText( &outKml, "</Document>\n\n" );
+    BufOutText( &outKml, "</kml>" );
 
-    // Close kml file
-    if ( fclose( outKml ) != 0 )
+    // Flush and close kml file
+    if ( !CloseBufOut( &outKml ) )
         fwprintf_s( stderr, TEXT( "Error closing kml file\n" ) );
+
+    if ( kmz && !CloseZipOut( &zip ) )
+        fwprintf_s( stderr, TEXT( "Error closing kmz file\n" ) );
+}
+
+void outputFgb( List* plist )
+{
+    TCHAR fName[ MAX_PATH ] = { 0 };
+
+    // Set up fgb file's name
+    wcscpy_s( fName, _countof( fName ), plist->measureName );
+    wcscat_s( fName, _countof( fName ), TEXT( ".fgb" ) );
+
+    if ( !OutputFgb( plist, fName ) )
+        fwprintf_s( stderr, TEXT( "Error writing fgb file\n" ) );
+}
+
+void outputGeoJson( List* plist )
+{
+    BufOut outJson;
+    TCHAR fName[ MAX_PATH ] = { 0 };
+
+    // Set up GeoJSON file's name
+    wcscpy_s( fName, _countof( fName ), plist->measureName );
+    wcscat_s( fName, _countof( fName ), TEXT( ".geojsons" ) );
+
+    if ( !OpenBufOut( &outJson, fName ) )
+        return;
+
+    // One feature per record
+    TraverseToFile( plist, &outJson, addPtToGeoJson );
+
+    if ( !CloseBufOut( &outJson ) )
+        fwprintf_s( stderr, TEXT( "Error closing GeoJSON file\n" ) );
+}
+
+void addPtToGeoJson( BufOut* outJson, Item* pitem, LPCTSTR path )
+{
+    static const CHAR geometry[] = "{\"type\":\"Feature\",\"geometry\":"
+        "{\"type\":\"Point\",\"coordinates\":[";
+    static const CHAR properties[] = "]},\"properties\":{\"name\":\"";
+    const TCHAR* ptTchar = NULL;
+    CHAR* dst;
+    int len = 0;
+
+    // Point's name: path without extension
+    ptTchar = wcsrchr( path, L'.' );
+    if ( ptTchar == NULL )
+        ptTchar = path + wcslen( path );
+
+    // Record separator, both literals, 3 numbers, 2 commas
+    dst = BufOutReserve( outJson, sizeof( geometry ) + sizeof( properties ) +
+        3 * FMT_MAX + 3 );
+    if ( dst == NULL )
+        return;
+
+    // Geometry: lon, lat, alt
+    dst[ len++ ] = JSON_RS;
+    len += FmtStr( dst + len, geometry );
+    len += FmtDouble( dst + len, pitem->lon );
+    dst[ len++ ] = ',';
+    len += FmtDouble( dst + len, pitem->lat );
+    dst[ len++ ] = ',';
+    len += FmtDouble( dst + len, pitem->alt );
+    len += FmtStr( dst + len, properties );
+    BufOutCommit( outJson, len );
+
+    BufOutJson( outJson, path, ptTchar - path );
+
+    // Statistics, as in the fgb columns
+    dst = BufOutReserve( outJson, 3 * FMT_MAX + 64 );
+    if ( dst == NULL )
+        return;
+
+    len = 0;
+    len += FmtStr( dst + len, "\",\"modified\":\"" );
+    len += FmtIsoTime( dst + len, &pitem->ftLastWriteTime );
+    len += FmtStr( dst + len, "\",\"size\":" );
+    len += FmtInt( dst + len, ( long long )pitem->size );
+    len += FmtStr( dst + len, ",\"fixes\":" );
+    len += FmtInt( dst + len, pitem->ctMeas );
+    len += FmtStr( dst + len, "}}\n" );
+    BufOutCommit( outJson, len );
 }
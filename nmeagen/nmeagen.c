@@ -0,0 +1,192 @@
+//
+//  nmeagen.c
+//
+//  Synthetic nmea files for benchmarks (see nmeaGen.h)
+//
+
+#include "platform.h"
+#include <stdio.h>
+#include <wchar.h>
+#include "io.h"
+#include "nmeaGen.h"
+
+#define     MAX_OPTIONS     20  // Max # command line options
+
+// Flags indices
+#define     FL_HELP         0   // Print usage
+#define     FL_DIR          1   // Target is a dir (count files)
+
+#define     SIZE_DEF        1024    // Default file size [kB]
+#define     COUNT_DEF       100     // Default files in a dir
+
+extern DWORD Options( int argc, LPCWSTR argv[], LPCWSTR OptStr, ... );
+extern LPCWSTR OptionValue( int argc, LPCWSTR argv[], int iFirst,
+    LPCWSTR key );
+extern VOID ReportError( LPCTSTR userMsg, DWORD exitCode, BOOL prtErrorMsg );
+
+BOOL readSettings( int argc, LPCWSTR argv[], int iFirst, NmeaGenCfg* pCfg,
+    UINT64* pSize, int* pCount );
+BOOL readDouble( int argc, LPCWSTR argv[], int iFirst, LPCWSTR key,
+    double* pVal );
+BOOL readTalkers( LPCWSTR value, NmeaGenCfg* pCfg );
+
+
+int wmain( int argc, LPTSTR argv[] )
+{
+    int targetInd = 0;
+    BOOL flags[ MAX_OPTIONS ] = { 0 };
+    NmeaGenCfg cfg;
+    UINT64 size = 0;
+    int count = 0;
+    int i;
+    TCHAR fileName[ MAX_PATH ] = { 0 };
+
+    // Get index of first argument after options
+    // Also determine which options are active
+    targetInd = Options( argc, ( LPCWSTR* )argv, TEXT( "hd" ),
+        &flags[ FL_HELP ], &flags[ FL_DIR ], NULL );
+
+    NmeaGenDefaults( &cfg );
+    count = flags[ FL_DIR ] ? COUNT_DEF : 1;
+
+    // Validate args
+    if ( flags[ FL_HELP ] || ( argc < targetInd + 1 ) ||
+        !readSettings( argc, ( LPCWSTR* )argv, targetInd + 1, &cfg, &size,
+            &count ) )
+    {
+        // Print usage
+        wprintf_s( TEXT( "\n    Usage:  nmeagen [options] [target] [key=value ...]\n\n" ) );
+        wprintf_s( TEXT( "    Options:\n\n" ) );
+        wprintf_s( TEXT( "      -h   :  Print usage\n" ) );
+        wprintf_s( TEXT( "      -d   :  Target is a dir, write count files into it\n\n" ) );
+        wprintf_s( TEXT( "    Settings:\n\n" ) );
+        wprintf_s( TEXT( "      size=%d      File size [kB]\n" ), SIZE_DEF );
+        wprintf_s( TEXT( "      count=%d      Files in target dir (-d)\n" ), COUNT_DEF );
+        wprintf_s( TEXT( "      seed=1         Random seed (file n: seed + n)\n" ) );
+        wprintf_s( TEXT( "      lat=%.6f lon=%.6f alt=%.1f   Start position [deg], [m]\n" ),
+            cfg.lat, cfg.lon, cfg.alt );
+        wprintf_s( TEXT( "      drift=%.2f     Walk of the position [m/epoch]\n" ), cfg.drift );
+        wprintf_s( TEXT( "      noise=%.1f      Noise of fixes (1 sigma) [m]\n" ), cfg.noise );
+        wprintf_s( TEXT( "      pdop=%.1f pdopsd=%.1f   P-DOP mean and deviation\n" ),
+            cfg.pdop, cfg.pdopSd );
+        wprintf_s( TEXT( "      talkers=GP     Talkers picked per epoch (e.g. GP,GN,GL)\n" ) );
+        wprintf_s( TEXT( "      corrupt=0      Corrupted sentences [%%]\n" ) );
+        return 1;
+    }
+
+    if ( !flags[ FL_DIR ] )
+    {
+        if ( !NmeaGenFile( argv[ targetInd ], &cfg, size ) )
+            return 1;
+
+        wprintf_s( TEXT( "\n    Written: \"%s\"\n" ), argv[ targetInd ] );
+        return 0;
+    }
+
+    if ( !IoCreateDir( argv[ targetInd ] ) )
+    {
+        ReportError( TEXT( "\nCreating target dir failed" ), 0, TRUE );
+        return 1;
+    }
+
+    // One seed per file, same files for the same settings
+    for ( i = 0; i < count; i++ )
+    {
+        swprintf_s( fileName, _countof( fileName ), TEXT( "%s%sgen%05d.nmea" ),
+            argv[ targetInd ], IO_SEP, i + 1 );
+
+        if ( !NmeaGenFile( fileName, &cfg, size ) )
+            return 1;
+
+        cfg.seed++;
+    }
+
+    wprintf_s( TEXT( "\n    Written: %d files to \"%s\"\n" ), count,
+        argv[ targetInd ] );
+
+    return 0;
+}
+
+// Settings after the target, false if one is not valid
+BOOL readSettings( int argc, LPCWSTR argv[], int iFirst, NmeaGenCfg* pCfg,
+    UINT64* pSize, int* pCount )
+{
+    double size = SIZE_DEF;
+    double count = *pCount;
+    double seed = 1;
+    LPCWSTR value;
+
+    if ( !readDouble( argc, argv, iFirst, TEXT( "size" ), &size ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "count" ), &count ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "seed" ), &seed ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "lat" ), &pCfg->lat ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "lon" ), &pCfg->lon ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "alt" ), &pCfg->alt ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "drift" ), &pCfg->drift ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "noise" ), &pCfg->noise ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "pdop" ), &pCfg->pdop ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "pdopsd" ), &pCfg->pdopSd ) ||
+        !readDouble( argc, argv, iFirst, TEXT( "corrupt" ), &pCfg->corrupt ) )
+        return FALSE;
+
+    value = OptionValue( argc, argv, iFirst, TEXT( "talkers" ) );
+    if ( value != NULL && !readTalkers( value, pCfg ) )
+        return FALSE;
+
+    if ( size < 1 || count < 1 || seed < 0 || pCfg->pdop <= 0 ||
+        pCfg->pdopSd < 0 || pCfg->lat <= -90 || pCfg->lat >= 90 ||
+        pCfg->lon <= -180 || pCfg->lon >= 180 )
+        return FALSE;
+
+    *pSize = ( UINT64 )( size * 1024 );
+    *pCount = ( int )count;
+    pCfg->seed = ( UINT64 )seed;
+
+    return TRUE;
+}
+
+// Number setting (unchanged if not set), false if not a number
+BOOL readDouble( int argc, LPCWSTR argv[], int iFirst, LPCWSTR key,
+    double* pVal )
+{
+    LPCWSTR value = OptionValue( argc, argv, iFirst, key );
+    wchar_t* pEnd = NULL;
+    double val;
+
+    if ( value == NULL )
+        return TRUE;
+
+    val = wcstod( value, &pEnd );
+    if ( pEnd == value || *pEnd != TEXT( '\0' ) )
+        return FALSE;
+
+    *pVal = val;
+    return TRUE;
+}
+
+// Comma separated talkers of two letters
+BOOL readTalkers( LPCWSTR value, NmeaGenCfg* pCfg )
+{
+    pCfg->ctTalkers = 0;
+
+    for ( ;; )
+    {
+        if ( pCfg->ctTalkers == NMEAGEN_TALKERS ||
+            value[ 0 ] < TEXT( 'A' ) || value[ 0 ] > TEXT( 'Z' ) ||
+            value[ 1 ] < TEXT( 'A' ) || value[ 1 ] > TEXT( 'Z' ) )
+            return FALSE;
+
+        pCfg->talkers[ pCfg->ctTalkers ][ 0 ] = ( char )value[ 0 ];
+        pCfg->talkers[ pCfg->ctTalkers ][ 1 ] = ( char )value[ 1 ];
+        pCfg->talkers[ pCfg->ctTalkers ][ 2 ] = '\0';
+        pCfg->ctTalkers++;
+
+        if ( value[ 2 ] == TEXT( '\0' ) )
+            return TRUE;
+
+        if ( value[ 2 ] != TEXT( ',' ) )
+            return FALSE;
+
+        value += 3;
+    }
+}
@@ -0,0 +1,118 @@
+# checks.cmake -- end-to-end checks of the tools, run by ctest
+#
+#   cmake -DCHECK=<name> -DHPOS=<exe> -DJDOTS=<exe> -DNMEAGEN=<exe>
+#         -DWORK=<scratch dir> -P checks.cmake
+#
+# The nmea data is written by nmeagen (with corrupted sentences), so
+# the checks need no files of their own. Each check compares two ways
+# to the same result:
+#
+#   basic   hpos -b is the first line of the full output
+#   epochs  aggregating the .epochs log gives the result of the text
+#   sweep   the 2.10 row of the sweep is the result of the default cutoff
+#   cache   a second jdots run takes all files from the cache and
+#           writes the same kml
+#   kmz     the kml inside jdots -z output (deflate, zip) is the kml
+
+cmake_minimum_required( VERSION 3.10 )
+
+# Run a tool in WORK, fail on errors, return its stdout in outVar
+function( run outVar )
+    execute_process( COMMAND ${ARGN}
+        WORKING_DIRECTORY ${WORK}
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE err )
+
+    if( NOT result EQUAL 0 )
+        string( REPLACE ";" " " cmd "${ARGN}" )
+        message( FATAL_ERROR "${cmd} failed (${result}):\n${out}${err}" )
+    endif()
+
+    set( ${outVar} "${out}" PARENT_SCOPE )
+endfunction()
+
+function( expectEqual what expected actual )
+    if( NOT expected STREQUAL actual )
+        message( FATAL_ERROR
+            "${what} differs:\n  expected: ${expected}\n  actual:   ${actual}" )
+    endif()
+endfunction()
+
+function( expectSameFile what expected actual )
+    execute_process( COMMAND ${CMAKE_COMMAND} -E compare_files
+        ${expected} ${actual} RESULT_VARIABLE result )
+
+    if( NOT result EQUAL 0 )
+        message( FATAL_ERROR "${what}: ${actual} differs from ${expected}" )
+    endif()
+endfunction()
+
+file( REMOVE_RECURSE ${WORK} )
+file( MAKE_DIRECTORY ${WORK} )
+
+if( CHECK MATCHES "^(basic|epochs|sweep)$" )
+    # 3 MB: read in chunks by the piped engine
+    run( gen ${NMEAGEN} t.nmea size=3072 corrupt=1 )
+    run( basic ${HPOS} -b t.nmea )
+    string( STRIP "${basic}" basic )
+
+    if( NOT basic MATCHES "^-?[0-9.]+,-?[0-9.]+,-?[0-9.]+$" )
+        message( FATAL_ERROR "No result of hpos -b: ${basic}" )
+    endif()
+endif()
+
+if( CHECK STREQUAL "basic" )
+    run( full ${HPOS} t.nmea )
+    string( REGEX REPLACE "\n.*" "" full "${full}" )
+    string( STRIP "${full}" full )
+    expectEqual( "hpos output" "${basic}" "${full}" )
+
+elseif( CHECK STREQUAL "epochs" )
+    run( logged ${HPOS} -b --epochs t.nmea )
+    string( STRIP "${logged}" logged )
+    expectEqual( "hpos --epochs output" "${basic}" "${logged}" )
+
+    run( again ${HPOS} -b t.epochs )
+    string( STRIP "${again}" again )
+    expectEqual( "hpos output of the epoch log" "${basic}" "${again}" )
+
+elseif( CHECK STREQUAL "sweep" )
+    run( swept ${HPOS} -b --sweep t.nmea )
+    file( STRINGS ${WORK}/t.sweep.csv row REGEX "^2\\.10," )
+    string( REGEX REPLACE "^2\\.10,[0-9]+," "" row "${row}" )
+    expectEqual( "Sweep row 2.10" "${basic}" "${row}" )
+
+elseif( CHECK STREQUAL "cache" )
+    run( gen ${NMEAGEN} -d d count=5 size=64 corrupt=1 )
+
+    run( first ${JDOTS} d )
+    if( NOT first MATCHES "Cache: 0 hits, 5 misses" )
+        message( FATAL_ERROR "First jdots run used a cache:\n${first}" )
+    endif()
+    file( RENAME ${WORK}/d/d.kml ${WORK}/first.kml )
+
+    run( second ${JDOTS} d )
+    if( NOT second MATCHES "Cache: 5 hits, 0 misses" )
+        message( FATAL_ERROR "Second jdots run missed the cache:\n${second}" )
+    endif()
+    expectSameFile( "kml from the cache" ${WORK}/first.kml ${WORK}/d/d.kml )
+
+elseif( CHECK STREQUAL "kmz" )
+    run( gen ${NMEAGEN} -d d count=5 size=64 corrupt=1 )
+    run( plain ${JDOTS} d )
+    run( zipped ${JDOTS} -z d )
+
+    file( MAKE_DIRECTORY ${WORK}/x )
+    execute_process( COMMAND ${CMAKE_COMMAND} -E tar xf ${WORK}/d/d.kmz
+        WORKING_DIRECTORY ${WORK}/x
+        RESULT_VARIABLE result )
+
+    if( NOT result EQUAL 0 )
+        message( FATAL_ERROR "d.kmz is no valid zip file" )
+    endif()
+    expectSameFile( "kml in the kmz" ${WORK}/d/d.kml ${WORK}/x/doc.kml )
+
+else()
+    message( FATAL_ERROR "Unknown check: ${CHECK}" )
+endif()